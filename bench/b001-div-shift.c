@@ -0,0 +1,115 @@
+#include "bench.h"
+
+#define ITERATIONS	(20000000)
+
+static jit_value sum_of_divisions(jit_value n)
+{
+	jit_value sum = 0;
+	for (jit_value i = 1; i <= n; i++)
+		sum += n / i + n % i;
+	return sum;
+}
+
+static jit_value sum_of_shifts(jit_value n)
+{
+	jit_value sum = 0;
+	for (jit_value i = 1; i <= n; i++)
+		sum += (i << (i & 15)) + ((sum >> (i & 7)) ^ i);
+	return sum;
+}
+
+// DIV and MOD in a loop with several live values
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);		// sum
+	jit_movi(p, R(2), 1);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_divr(p, R(3), R(0), R(2));
+	jit_modr(p, R(4), R(0), R(2));
+	jit_addr(p, R(1), R(1), R(3));
+	jit_addr(p, R(1), R(1), R(4));
+	jit_addi(p, R(2), R(2), 1);
+	jit_bler(p, loop, R(2), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS / 4));
+	CHECK_EQ(sum_of_divisions(ITERATIONS / 4), r);
+	return t;
+}
+
+// division by constants, these are emitted as shifts or as an IDIV
+// with a scratch register
+DEFINE_BENCH(bench11)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);		// sum
+	jit_movi(p, R(2), 1);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_divi(p, R(3), R(2), 7);
+	jit_modi(p, R(4), R(2), 10);
+	jit_divi(p, R(5), R(2), 4);
+	jit_addr(p, R(1), R(1), R(3));
+	jit_addr(p, R(1), R(1), R(4));
+	jit_addr(p, R(1), R(1), R(5));
+	jit_addi(p, R(2), R(2), 1);
+	jit_bler(p, loop, R(2), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	jit_value expected = 0;
+	for (jit_value i = 1; i <= ITERATIONS / 4; i++)
+		expected += i / 7 + i % 10 + i / 4;
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS / 4));
+	CHECK_EQ(expected, r);
+	return t;
+}
+
+// variable shifts in a loop
+DEFINE_BENCH(bench12)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);		// sum
+	jit_movi(p, R(2), 1);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_andi(p, R(3), R(2), 15);
+	jit_lshr(p, R(4), R(2), R(3));
+	jit_andi(p, R(5), R(2), 7);
+	jit_rshr(p, R(6), R(1), R(5));
+	jit_xorr(p, R(6), R(6), R(2));
+	jit_addr(p, R(1), R(1), R(4));
+	jit_addr(p, R(1), R(1), R(6));
+	jit_addi(p, R(2), R(2), 1);
+	jit_bler(p, loop, R(2), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(sum_of_shifts(ITERATIONS), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+}
@@ -0,0 +1,58 @@
+#include "bench.h"
+
+#define ITERATIONS	(10000000)
+#define COEFS		(12)
+
+static double coef(int i)
+{
+	return 1.0 / (i + 1);
+}
+
+// evaluates a polynomial with coefficients kept in registers,
+// 16 floating-point values are alive inside the loop
+DEFINE_BENCH(bench10)
+{
+	pdfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; i < COEFS; i++)
+		jit_fmovi(p, FR(i), coef(i));
+	jit_fmovi(p, FR(COEFS), 0.0);			// sum
+	jit_fmovi(p, FR(COEFS + 1), 0.0);		// x
+	jit_fmovi(p, FR(COEFS + 2), 1.0 / ITERATIONS);	// step
+	jit_movi(p, R(1), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_fmovr(p, FR(COEFS + 3), FR(COEFS - 1));
+	for (int i = COEFS - 2; i >= 0; i--) {
+		jit_fmulr(p, FR(COEFS + 3), FR(COEFS + 3), FR(COEFS + 1));
+		jit_faddr(p, FR(COEFS + 3), FR(COEFS + 3), FR(i));
+	}
+	jit_faddr(p, FR(COEFS), FR(COEFS), FR(COEFS + 3));
+	jit_faddr(p, FR(COEFS + 1), FR(COEFS + 1), FR(COEFS + 2));
+	jit_addi(p, R(1), R(1), 1);
+	jit_bltr(p, loop, R(1), R(0));
+	jit_fretr(p, FR(COEFS), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	double expected = 0.0, x = 0.0;
+	for (int n = 0; n < ITERATIONS; n++) {
+		double y = coef(COEFS - 1);
+		for (int i = COEFS - 2; i >= 0; i--)
+			y = y * x + coef(i);
+		expected += y;
+		x += 1.0 / ITERATIONS;
+	}
+
+	double t, r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ((jit_value) expected, (jit_value) r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+}
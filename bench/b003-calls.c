@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#define ITERATIONS	(20000000)
+#define FIB_ARG		(32)
+
+static jit_value fib(jit_value n)
+{
+	return (n < 3) ? 1 : fib(n - 1) + fib(n - 2);
+}
+
+// recursive function, values alive across calls are spilled
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	jit_label * fib_label = jit_get_label(p);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_blti(p, JIT_FORWARD, R(0), 3);
+
+	jit_subi(p, R(1), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_call(p, fib_label);
+	jit_retval(p, R(1));
+
+	jit_subi(p, R(2), R(0), 2);
+	jit_prepare(p);
+	jit_putargr(p, R(2));
+	jit_call(p, fib_label);
+	jit_retval(p, R(2));
+
+	jit_addr(p, R(0), R(1), R(2));
+	jit_retr(p, R(0));
+
+	jit_patch(p, br);
+	jit_reti(p, 1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(FIB_ARG));
+	CHECK_EQ(fib(FIB_ARG), r);
+	return t;
+}
+
+// loop calling a small leaf function which spills one value
+DEFINE_BENCH(bench11)
+{
+	plfl f1, f2;
+	jit_label * leaf = jit_get_label(p);
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_muli(p, R(1), R(0), 3);
+	jit_force_spill(p, R(1));
+	jit_addi(p, R(0), R(0), 1);
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);	// sum
+	jit_movi(p, R(2), 0);	// counter
+
+	jit_label * loop = jit_get_label(p);
+	jit_prepare(p);
+	jit_putargr(p, R(2));
+	jit_call(p, leaf);
+	jit_retval(p, R(3));
+	jit_addr(p, R(1), R(1), R(3));
+	jit_addi(p, R(2), R(2), 1);
+	jit_bltr(p, loop, R(2), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ((jit_value)ITERATIONS * (4 * (jit_value)(ITERATIONS - 1) / 2 + 1), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
@@ -0,0 +1,89 @@
+#include "bench.h"
+
+#define OUTER		(200000)
+#define INNER		(50)
+#define OUTER_VALS	(10)
+#define INNER_VALS	(6)
+
+#define R_N		R(0)
+#define R_OUTER(i)	R(1 + (i))
+#define R_INNER(i)	R(1 + OUTER_VALS + (i))
+#define R_TOTAL		R(30)
+#define R_I		R(31)
+#define R_J		R(32)
+#define R_TMP		R(33)
+
+static jit_value kernel(jit_value n)
+{
+	jit_value outer[OUTER_VALS], inner[INNER_VALS];
+	jit_value total = 0;
+	for (int k = 0; k < OUTER_VALS; k++)
+		outer[k] = n * (k + 1);
+	for (jit_value i = 0; i < n; i++) {
+		for (int k = 0; k < INNER_VALS; k++)
+			inner[k] = i + k;
+		for (jit_value j = 0; j < INNER; j++) {
+			for (int k = 0; k < INNER_VALS; k++)
+				inner[k] += j ^ k;
+			if ((j & 3) == 0) inner[0] += inner[INNER_VALS - 1];
+		}
+		for (int k = 0; k < INNER_VALS; k++)
+			total += inner[k];
+		for (int k = 0; k < OUTER_VALS; k++)
+			total ^= outer[k] + i;
+	}
+	return total;
+}
+
+// nested loops; values used only by the outer loop do not fit into
+// registers together with the values of the inner loop
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R_N, 0);
+	for (int k = 0; k < OUTER_VALS; k++)
+		jit_muli(p, R_OUTER(k), R_N, k + 1);
+	jit_movi(p, R_TOTAL, 0);
+	jit_movi(p, R_I, 0);
+
+	jit_label * outer = jit_get_label(p);
+	for (int k = 0; k < INNER_VALS; k++)
+		jit_addi(p, R_INNER(k), R_I, k);
+	jit_movi(p, R_J, 0);
+
+	jit_label * inner = jit_get_label(p);
+	for (int k = 0; k < INNER_VALS; k++) {
+		jit_xori(p, R_TMP, R_J, k);
+		jit_addr(p, R_INNER(k), R_INNER(k), R_TMP);
+	}
+	jit_op * skip = jit_bmsi(p, JIT_FORWARD, R_J, 3);
+	jit_addr(p, R_INNER(0), R_INNER(0), R_INNER(INNER_VALS - 1));
+	jit_patch(p, skip);
+	jit_addi(p, R_J, R_J, 1);
+	jit_blti(p, inner, R_J, INNER);
+
+	for (int k = 0; k < INNER_VALS; k++)
+		jit_addr(p, R_TOTAL, R_TOTAL, R_INNER(k));
+	for (int k = 0; k < OUTER_VALS; k++) {
+		jit_addr(p, R_TMP, R_OUTER(k), R_I);
+		jit_xorr(p, R_TOTAL, R_TOTAL, R_TMP);
+	}
+	jit_addi(p, R_I, R_I, 1);
+	jit_bltr(p, outer, R_I, R_N);
+	jit_retr(p, R_TOTAL);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(OUTER));
+	CHECK_EQ(kernel(OUTER), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+}
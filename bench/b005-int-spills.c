@@ -0,0 +1,82 @@
+#include "bench.h"
+
+#define ITERATIONS	(10000000)
+#define STATE		(20)
+
+static jit_value kernel(jit_value n)
+{
+	jit_value s[STATE];
+	for (int k = 0; k < STATE; k++)
+		s[k] = n + k;
+	for (jit_value i = 0; i < n; i++) {
+		jit_value s0 = s[0];
+		for (int k = 0; k < STATE; k++)
+			s[k] = (s[k] ^ (k == STATE - 1 ? s0 : s[k + 1])) + i;
+	}
+
+	jit_value sum = 0;
+	for (int k = 0; k < STATE; k++)
+		sum += s[k];
+	return sum;
+}
+
+// integer-only loop keeping more values alive than there are GP registers
+static void generate_kernel(struct jit * p, plfl * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(STATE), 0);
+	for (int k = 0; k < STATE; k++)
+		jit_addi(p, R(k), R(STATE), k);
+	jit_movi(p, R(STATE + 1), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_movr(p, R(STATE + 2), R(0));	// the original value of s[0]
+	for (int k = 0; k < STATE; k++) {
+		jit_xorr(p, R(k), R(k), k == STATE - 1 ? R(STATE + 2) : R(k + 1));
+		jit_addr(p, R(k), R(k), R(STATE + 1));
+	}
+	jit_addi(p, R(STATE + 1), R(STATE + 1), 1);
+	jit_bltr(p, loop, R(STATE + 1), R(STATE));
+
+	jit_movi(p, R(STATE + 3), 0);
+	for (int k = 0; k < STATE; k++)
+		jit_addr(p, R(STATE + 3), R(STATE + 3), R(k));
+	jit_retr(p, R(STATE + 3));
+}
+
+// spilled values are stored in the stack frame
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	generate_kernel(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(kernel(ITERATIONS), r);
+	return t;
+}
+
+// spilled values are kept in unused XMM registers
+DEFINE_BENCH(bench11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SPILLS_TO_FP_REGS);
+	generate_kernel(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(kernel(ITERATIONS), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
@@ -0,0 +1,179 @@
+#include "bench.h"
+
+#define ITERATIONS	(10000000)
+#define ACCUMULATORS	(10)
+
+#define REC_ARG		(27)
+#define VALUES		(8)
+
+static jit_value rec(jit_value n)
+{
+	if (n < 2) return n;
+	jit_value a = rec(n - 1);
+	jit_value s = n ^ 5;
+	for (int k = 0; k < VALUES; k++)
+		s ^= a + n * k;
+	return s ^ rec(n - 2);
+}
+
+static jit_value sum_loop(jit_value n)
+{
+	jit_value acc[ACCUMULATORS] = { 0 };
+	for (jit_value i = 0; i < n; i++)
+		for (int k = 0; k < ACCUMULATORS; k++)
+			acc[k] += ((i + k) ^ 5) + k;
+
+	jit_value sum = 0;
+	for (int k = 0; k < ACCUMULATORS; k++)
+		sum += acc[k];
+	return sum;
+}
+
+static void generate_leaf(struct jit * p, plfl * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_xori(p, R(0), R(0), 5);
+	jit_retr(p, R(0));
+}
+
+// recursive function calling a small function while many values are alive
+static void generate_rec(struct jit * p, plfl * f1, plfl * f2)
+{
+	jit_label * leaf = jit_get_label(p);
+	generate_leaf(p, f2);
+
+	jit_label * rec_label = jit_get_label(p);
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_blti(p, JIT_FORWARD, R(0), 2);
+
+	jit_subi(p, R(1), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_call(p, rec_label);
+	jit_retval(p, R(1));
+
+	for (int k = 0; k < VALUES; k++) {
+		jit_muli(p, R(k + 2), R(0), k);
+		jit_addr(p, R(k + 2), R(k + 2), R(1));
+	}
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, leaf);
+	jit_retval(p, R(1));
+	for (int k = 0; k < VALUES; k++)
+		jit_xorr(p, R(1), R(1), R(k + 2));
+
+	jit_subi(p, R(0), R(0), 2);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, rec_label);
+	jit_retval(p, R(0));
+	jit_xorr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+
+	jit_patch(p, br);
+	jit_retr(p, R(0));
+}
+
+// loop keeping many values in registers while calling a small function
+static void generate_sum_loop(struct jit * p, plfl * f1, plfl * f2)
+{
+	jit_label * leaf = jit_get_label(p);
+	generate_leaf(p, f2);
+
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(ACCUMULATORS), 0);
+	for (int k = 0; k < ACCUMULATORS; k++)
+		jit_movi(p, R(k), 0);
+	jit_movi(p, R(ACCUMULATORS + 1), 0);	// counter
+
+	jit_label * loop = jit_get_label(p);
+	for (int k = 0; k < ACCUMULATORS; k++) {
+		jit_addi(p, R(ACCUMULATORS + 2), R(ACCUMULATORS + 1), k);
+		jit_prepare(p);
+		jit_putargr(p, R(ACCUMULATORS + 2));
+		jit_call(p, leaf);
+		jit_retval(p, R(ACCUMULATORS + 2));
+		jit_addr(p, R(k), R(k), R(ACCUMULATORS + 2));
+		jit_addi(p, R(k), R(k), k);
+	}
+	jit_addi(p, R(ACCUMULATORS + 1), R(ACCUMULATORS + 1), 1);
+	jit_bltr(p, loop, R(ACCUMULATORS + 1), R(ACCUMULATORS));
+
+	jit_movi(p, R(ACCUMULATORS + 2), 0);
+	for (int k = 0; k < ACCUMULATORS; k++)
+		jit_addr(p, R(ACCUMULATORS + 2), R(ACCUMULATORS + 2), R(k));
+	jit_retr(p, R(ACCUMULATORS + 2));
+}
+
+// callers save only registers used by the callee
+DEFINE_BENCH(bench10)
+{
+	plfl f1, f2;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	generate_rec(p, &f1, &f2);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(REC_ARG));
+	CHECK_EQ(rec(REC_ARG), r);
+	return t;
+}
+
+// callers save all live caller-saved registers
+DEFINE_BENCH(bench11)
+{
+	plfl f1, f2;
+	jit_disable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	generate_rec(p, &f1, &f2);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(REC_ARG));
+	CHECK_EQ(rec(REC_ARG), r);
+	return t;
+}
+
+DEFINE_BENCH(bench12)
+{
+	plfl f1, f2;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	generate_sum_loop(p, &f1, &f2);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(sum_loop(ITERATIONS), r);
+	return t;
+}
+
+DEFINE_BENCH(bench13)
+{
+	plfl f1, f2;
+	jit_disable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	generate_sum_loop(p, &f1, &f2);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(sum_loop(ITERATIONS), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+	SETUP_BENCH(bench13);
+}
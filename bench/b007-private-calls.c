@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#define ITERATIONS	(20000000)
+#define ARGS		(8)
+
+static jit_value sum_args(jit_value n)
+{
+	jit_value sum = 0;
+	for (jit_value i = 0; i < n; i++)
+		for (int k = 0; k < ARGS; k++)
+			sum += (i + k) * (k + 1);
+	return sum;
+}
+
+// function with eight arguments called in a loop
+static void generate_calls(struct jit * p, plfl * f1, int private_conv)
+{
+	jit_label * callee = jit_get_label(p);
+	jit_prolog(p, NULL);
+	if (private_conv) jit_declare_private(p);
+	for (int k = 0; k < ARGS; k++)
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_movi(p, R(0), 0);
+	for (int k = 0; k < ARGS; k++) {
+		jit_getarg(p, R(1), k);
+		jit_muli(p, R(1), R(1), k + 1);
+		jit_addr(p, R(0), R(0), R(1));
+	}
+	jit_retr(p, R(0));
+
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);	// counter
+	jit_movi(p, R(2), 0);	// sum
+
+	jit_label * loop = jit_get_label(p);
+	for (int k = 0; k < ARGS; k++)
+		jit_addi(p, R(k + 3), R(1), k);
+	jit_prepare(p);
+	for (int k = 0; k < ARGS; k++)
+		jit_putargr(p, R(k + 3));
+	jit_call(p, callee);
+	jit_retval(p, R(3));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_addi(p, R(1), R(1), 1);
+	jit_bltr(p, loop, R(1), R(0));
+	jit_retr(p, R(2));
+}
+
+// arguments are passed in registers, no AL setup and no stack alignment
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	generate_calls(p, &f1, 1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(sum_args(ITERATIONS), r);
+	return t;
+}
+
+// standard calling convention
+DEFINE_BENCH(bench11)
+{
+	plfl f1;
+	generate_calls(p, &f1, 0);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(sum_args(ITERATIONS), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
@@ -0,0 +1,120 @@
+#include "bench.h"
+
+#define ROUNDS		(20000)
+#define PROGRAM_LEN	(1000)
+
+enum { OP_ADD, OP_XOR, OP_MUL, OP_HALT, OPS };
+
+static unsigned char program[PROGRAM_LEN + 1];
+static void * handlers[OPS];
+
+static void init_program()
+{
+	for (int i = 0; i < PROGRAM_LEN; i++)
+		program[i] = (i * 7 + i / 3) % OP_HALT;
+	program[PROGRAM_LEN] = OP_HALT;
+}
+
+static jit_value interpret(jit_value acc)
+{
+	for (jit_value pc = 0; ; pc++) {
+		switch (program[pc]) {
+			case OP_ADD: acc += pc; break;
+			case OP_XOR: acc ^= pc << 4; break;
+			case OP_MUL: acc = acc * 3 + 1; break;
+			case OP_HALT: return acc;
+		}
+	}
+}
+
+// dispatches to the handler of program[R(0)] with arguments (pc, acc)
+static void generate_dispatch(struct jit * p)
+{
+	jit_movi(p, R(2), program);
+	jit_ldxr_u(p, R(2), R(2), R(0), 1);
+	jit_lshi(p, R(2), R(2), 3);
+	jit_movi(p, R(3), handlers);
+	jit_ldxr(p, R(3), R(3), R(2), sizeof(void *));
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_putargr(p, R(1));
+	jit_callr(p, R(3));
+	jit_retval(p, R(1));
+	jit_retr(p, R(1));
+}
+
+// threaded interpreter, each handler calls the next one
+static void generate_interpreter(struct jit * p, plfl * f1)
+{
+	for (int op = 0; op < OPS; op++) {
+		jit_prolog(p, &handlers[op]);
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+		jit_getarg(p, R(0), 0);
+		jit_getarg(p, R(1), 1);
+		switch (op) {
+			case OP_ADD: jit_addr(p, R(1), R(1), R(0)); break;
+			case OP_XOR:
+				jit_lshi(p, R(2), R(0), 4);
+				jit_xorr(p, R(1), R(1), R(2));
+				break;
+			case OP_MUL:
+				jit_muli(p, R(1), R(1), 3);
+				jit_addi(p, R(1), R(1), 1);
+				break;
+			case OP_HALT:
+				jit_retr(p, R(1));
+				continue;
+		}
+		jit_addi(p, R(0), R(0), 1);
+		generate_dispatch(p);
+	}
+
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(1), 0);
+	jit_movi(p, R(0), 0);
+	generate_dispatch(p);
+}
+
+static double run(plfl f1)
+{
+	double t;
+	jit_value r;
+	MEASURE(t, r = 0; for (int i = 0; i < ROUNDS; i++) r = f1(r));
+
+	jit_value expected = 0;
+	for (int i = 0; i < ROUNDS; i++)
+		expected = interpret(expected);
+	CHECK_EQ(expected, r);
+	return t;
+}
+
+// handlers jump to each other, the stack does not grow
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	init_program();
+	generate_interpreter(p, &f1);
+	JIT_GENERATE_CODE(p);
+	return run(f1);
+}
+
+// each handler keeps its frame until the program halts
+DEFINE_BENCH(bench11)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_TAIL_CALLS);
+	init_program();
+	generate_interpreter(p, &f1);
+	JIT_GENERATE_CODE(p);
+	return run(f1);
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#define ITERATIONS	(50000000)
+
+static jit_value helpers(jit_value n)
+{
+	jit_value sum = 0;
+	for (jit_value i = 0; i < n; i++) {
+		jit_value x = (i & 0xff) - 100;
+		jit_value c = (x < 0 ? 0 : (x > 100 ? 100 : x));
+		sum += c * c + i;
+	}
+	return sum;
+}
+
+// clamp(x) = min(max(x, 0), 100)
+static jit_label * generate_clamp(struct jit * p)
+{
+	jit_label * clamp = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br1 = jit_bgei(p, JIT_FORWARD, R(0), 0);
+	jit_reti(p, 0);
+	jit_patch(p, br1);
+	jit_op * br2 = jit_blei(p, JIT_FORWARD, R(0), 100);
+	jit_reti(p, 100);
+	jit_patch(p, br2);
+	jit_retr(p, R(0));
+	return clamp;
+}
+
+// square_add(x, y) = x * x + y
+static jit_label * generate_square_add(struct jit * p)
+{
+	jit_label * square_add = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_mulr(p, R(0), R(0), R(0));
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	return square_add;
+}
+
+// loop calling tiny helper functions
+static void generate_helpers(struct jit * p, plfl * f1)
+{
+	jit_label * clamp = generate_clamp(p);
+	jit_label * square_add = generate_square_add(p);
+
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);	// counter
+	jit_movi(p, R(2), 0);	// sum
+
+	jit_label * loop = jit_get_label(p);
+	jit_andi(p, R(3), R(1), 0xff);
+	jit_subi(p, R(3), R(3), 100);
+	jit_prepare(p);
+	jit_putargr(p, R(3));
+	jit_call(p, clamp);
+	jit_retval(p, R(3));
+	jit_prepare(p);
+	jit_putargr(p, R(3));
+	jit_putargr(p, R(1));
+	jit_call(p, square_add);
+	jit_retval(p, R(3));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_addi(p, R(1), R(1), 1);
+	jit_bltr(p, loop, R(1), R(0));
+	jit_retr(p, R(2));
+}
+
+// helpers are inlined into the loop
+DEFINE_BENCH(bench10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+	generate_helpers(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(helpers(ITERATIONS), r);
+	return t;
+}
+
+// helpers are called
+DEFINE_BENCH(bench11)
+{
+	plfl f1;
+	generate_helpers(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ITERATIONS));
+	CHECK_EQ(helpers(ITERATIONS), r);
+	return t;
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
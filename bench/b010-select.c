@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#define ITEMS		(1 << 16)
+#define ROUNDS		(500)
+#define PIVOT		(500)
+
+static jit_value items[ITEMS];
+
+static void init_items(int sorted)
+{
+	srand(1);
+	for (int i = 0; i < ITEMS; i++)
+		items[i] = rand() % 1000;
+	if (!sorted) return;
+
+	// counting sort
+	int counts[1000] = { 0 };
+	for (int i = 0; i < ITEMS; i++) counts[items[i]]++;
+	for (int v = 0, i = 0; v < 1000; v++)
+		while (counts[v]--) items[i++] = v;
+}
+
+static jit_value signed_sum(jit_value rounds)
+{
+	jit_value sum = 0;
+	for (jit_value r = 0; r < rounds; r++)
+		for (int i = 0; i < ITEMS; i++)
+			sum += (items[i] < PIVOT ? items[i] : -items[i]);
+	return sum;
+}
+
+// sum of items, items greater or equal to the pivot are subtracted
+static void generate_signed_sum(struct jit * p, plfl * f1, int branchless)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);	// sum
+
+	jit_label * outer = jit_get_label(p);
+	jit_movi(p, R(2), items);
+	jit_movi(p, R(3), 0);
+	jit_label * inner = jit_get_label(p);
+	jit_ldxr(p, R(4), R(2), R(3), sizeof(jit_value));
+	jit_negr(p, R(5), R(4));
+	if (branchless) {
+		jit_lti(p, R(6), R(4), PIVOT);
+		jit_movzr(p, R(4), R(5), R(6));
+	} else {
+		jit_op * br = jit_blti(p, JIT_FORWARD, R(4), PIVOT);
+		jit_movr(p, R(4), R(5));
+		jit_patch(p, br);
+	}
+	jit_addr(p, R(1), R(1), R(4));
+	jit_addi(p, R(3), R(3), sizeof(jit_value));
+	jit_blti(p, inner, R(3), ITEMS * sizeof(jit_value));
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, outer, R(0), 0);
+	jit_retr(p, R(1));
+}
+
+static double run(struct jit * p, int dump, int sorted, int branchless)
+{
+	plfl f1;
+	init_items(sorted);
+	if (!branchless) jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	generate_signed_sum(p, &f1, branchless);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ROUNDS));
+	CHECK_EQ(signed_sum(ROUNDS), r);
+	return t;
+}
+
+// random items, conditional move
+DEFINE_BENCH(bench10)
+{
+	return run(p, dump, 0, 1);
+}
+
+// random items, conditional branch
+DEFINE_BENCH(bench11)
+{
+	return run(p, dump, 0, 0);
+}
+
+// sorted items, conditional move
+DEFINE_BENCH(bench12)
+{
+	return run(p, dump, 1, 1);
+}
+
+// sorted items, conditional branch
+DEFINE_BENCH(bench13)
+{
+	return run(p, dump, 1, 0);
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+	SETUP_BENCH(bench13);
+}
@@ -0,0 +1,132 @@
+#include "bench.h"
+
+#define ITEMS		(1 << 16)
+#define ROUNDS		(500)
+
+#define NO_HINT		(0)
+#define HINT		(1)
+#define PROFILE		(2)
+
+static jit_value items[ITEMS];
+static jit_value counts[2];	// taken and not taken branches measured by the instrumented code
+
+static void init_items()
+{
+	srand(1);
+	for (int i = 0; i < ITEMS; i++)
+		items[i] = rand() % 1000;
+}
+
+static jit_value skewed_sum(jit_value rounds)
+{
+	jit_value sum = 0;
+	for (jit_value r = 0; r < rounds; r++)
+		for (int i = 0; i < ITEMS; i++) {
+			jit_value x = items[i];
+			if ((x & 0x3f) == 0) sum = (sum ^ (x * 7)) + (sum >> 3);
+			sum += x;
+		}
+	return sum;
+}
+
+static void count_branch(struct jit * p, int taken)
+{
+	jit_movi(p, R(6), &counts[taken ? 0 : 1]);
+	jit_ldr(p, R(7), R(6), sizeof(jit_value));
+	jit_addi(p, R(7), R(7), 1);
+	jit_str(p, R(6), R(7), sizeof(jit_value));
+}
+
+// loop containing a rarely executed block; if instrumented, the code counts how
+// often the branch skipping the block is taken
+static void generate_skewed_sum(struct jit * p, plfl * f1, int mode, int instrumented)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+
+	jit_label * outer = jit_get_label(p);
+	jit_movi(p, R(3), items);
+	jit_movi(p, R(4), 0);
+	jit_label * inner = jit_get_label(p);
+	jit_ldxr(p, R(5), R(3), R(4), sizeof(jit_value));
+	jit_op * br = jit_bmsi(p, JIT_FORWARD, R(5), 0x3f);
+	if (mode == HINT) jit_likely(br);
+	if (mode == PROFILE) jit_branch_counts(br, counts[0], counts[1]);
+
+	if (instrumented) count_branch(p, 0);
+	jit_muli(p, R(2), R(5), 7);
+	jit_xorr(p, R(2), R(1), R(2));
+	jit_rshi(p, R(1), R(1), 3);
+	jit_addr(p, R(1), R(1), R(2));
+	jit_op * join = NULL;
+	if (instrumented) join = jit_jmpi(p, JIT_FORWARD);
+
+	jit_patch(p, br);
+	if (instrumented) {
+		count_branch(p, 1);
+		jit_patch(p, join);
+	}
+	jit_addr(p, R(1), R(1), R(5));
+	jit_addi(p, R(4), R(4), sizeof(jit_value));
+	jit_blti(p, inner, R(4), ITEMS * sizeof(jit_value));
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, outer, R(0), 0);
+	jit_retr(p, R(1));
+}
+
+// the first compilation collects the branch counts which are passed to the second one
+static void profile()
+{
+	plfl f1;
+	struct jit * p = jit_init();
+	counts[0] = counts[1] = 0;
+	generate_skewed_sum(p, &f1, NO_HINT, 1);
+	jit_generate_code(p);
+	CHECK_EQ(skewed_sum(1), f1(1));
+	jit_free(p);
+}
+
+static double run(struct jit * p, int dump, int mode)
+{
+	plfl f1;
+	init_items();
+	if (mode == PROFILE) profile();
+	jit_enable_optimization(p, JIT_OPT_BLOCK_LAYOUT);
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	generate_skewed_sum(p, &f1, mode, 0);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ROUNDS));
+	CHECK_EQ(skewed_sum(ROUNDS), r);
+	return t;
+}
+
+// no hints, the cold block is in the loop
+DEFINE_BENCH(bench10)
+{
+	return run(p, dump, NO_HINT);
+}
+
+// the branch is marked as likely
+DEFINE_BENCH(bench11)
+{
+	return run(p, dump, HINT);
+}
+
+// branch counts measured by the instrumented code
+DEFINE_BENCH(bench12)
+{
+	return run(p, dump, PROFILE);
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+}
@@ -0,0 +1,144 @@
+#include "bench.h"
+
+#define ITEMS		(4099)
+#define ROUNDS		(20000)
+
+#define SUM		(0)
+#define DOT		(1)
+#define COPY		(2)
+
+static jit_value ivec[ITEMS];
+static jit_value icopy[ITEMS];
+static double xvec[ITEMS];
+static double yvec[ITEMS];
+
+static void init_items()
+{
+	srand(1);
+	for (int i = 0; i < ITEMS; i++) {
+		ivec[i] = rand() % 1000;
+		xvec[i] = (rand() % 1000) / 100.0;
+		yvec[i] = (rand() % 1000) / 100.0;
+	}
+}
+
+static jit_value sum(jit_value rounds)
+{
+	jit_value s = 0;
+	for (jit_value r = 0; r < rounds; r++)
+		for (int i = 0; i < ITEMS; i++) s += ivec[i];
+	return s;
+}
+
+static double dot(jit_value rounds)
+{
+	double s = 0;
+	for (jit_value r = 0; r < rounds; r++)
+		for (int i = 0; i < ITEMS; i++) s += xvec[i] * yvec[i];
+	return s;
+}
+
+// inner loop of the kernel; it is closed by the returned branch
+static jit_op * generate_loop(struct jit * p, int kernel)
+{
+	jit_movi(p, R(2), 0);
+	jit_label * loop = jit_get_label(p);
+	switch (kernel) {
+		case SUM:
+			jit_ldxr(p, R(3), R(4), R(2), sizeof(jit_value));
+			jit_addr(p, R(1), R(1), R(3));
+			break;
+		case DOT:
+			jit_fldxr(p, FR(1), R(4), R(2), sizeof(double));
+			jit_fldxr(p, FR(2), R(5), R(2), sizeof(double));
+			jit_fmulr(p, FR(1), FR(1), FR(2));
+			jit_faddr(p, FR(0), FR(0), FR(1));
+			break;
+		case COPY:
+			jit_ldxr(p, R(3), R(4), R(2), sizeof(jit_value));
+			jit_stxr(p, R(5), R(2), R(3), sizeof(jit_value));
+			break;
+	}
+	jit_addi(p, R(2), R(2), sizeof(jit_value));
+	return jit_blti(p, loop, R(2), ITEMS * sizeof(jit_value));
+}
+
+static void generate_kernel(struct jit * p, void * f1, int kernel, int factor)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_fmovi(p, FR(0), 0.0);
+	jit_movi(p, R(4), kernel == SUM ? (void *) ivec : (kernel == DOT ? (void *) xvec : (void *) ivec));
+	jit_movi(p, R(5), kernel == DOT ? (void *) yvec : (void *) icopy);
+
+	jit_label * outer = jit_get_label(p);
+	jit_unroll_loop(generate_loop(p, kernel), factor);
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, outer, R(0), 0);
+
+	if (kernel == DOT) jit_fretr(p, FR(0), sizeof(double));
+	else jit_retr(p, R(1));
+}
+
+static double run(struct jit * p, int dump, int kernel, int factor)
+{
+	init_items();
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	double t;
+
+	if (kernel == DOT) {
+		pdfl f1;
+		generate_kernel(p, &f1, kernel, factor);
+		JIT_GENERATE_CODE(p);
+		double r;
+		MEASURE(t, r = f1(ROUNDS));
+		CHECK_EQ(1, r == dot(ROUNDS));
+		return t;
+	}
+
+	plfl f1;
+	generate_kernel(p, &f1, kernel, factor);
+	JIT_GENERATE_CODE(p);
+	jit_value r;
+	MEASURE(t, r = f1(ROUNDS));
+	if (kernel == SUM) CHECK_EQ(sum(ROUNDS), r);
+	if (kernel == COPY) CHECK_EQ(0, memcmp(ivec, icopy, sizeof(ivec)));
+	return t;
+}
+
+// sum of integers, not unrolled and unrolled 2, 4, and 8 times
+DEFINE_BENCH(bench10) { return run(p, dump, SUM, 1); }
+DEFINE_BENCH(bench11) { return run(p, dump, SUM, 2); }
+DEFINE_BENCH(bench12) { return run(p, dump, SUM, 4); }
+DEFINE_BENCH(bench13) { return run(p, dump, SUM, 8); }
+
+// dot product of FP vectors
+DEFINE_BENCH(bench20) { return run(p, dump, DOT, 1); }
+DEFINE_BENCH(bench21) { return run(p, dump, DOT, 2); }
+DEFINE_BENCH(bench22) { return run(p, dump, DOT, 4); }
+DEFINE_BENCH(bench23) { return run(p, dump, DOT, 8); }
+
+// copying of an array
+DEFINE_BENCH(bench30) { return run(p, dump, COPY, 1); }
+DEFINE_BENCH(bench31) { return run(p, dump, COPY, 2); }
+DEFINE_BENCH(bench32) { return run(p, dump, COPY, 4); }
+DEFINE_BENCH(bench33) { return run(p, dump, COPY, 8); }
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+	SETUP_BENCH(bench13);
+	SETUP_BENCH(bench20);
+	SETUP_BENCH(bench21);
+	SETUP_BENCH(bench22);
+	SETUP_BENCH(bench23);
+	SETUP_BENCH(bench30);
+	SETUP_BENCH(bench31);
+	SETUP_BENCH(bench32);
+	SETUP_BENCH(bench33);
+}
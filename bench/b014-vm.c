@@ -0,0 +1,148 @@
+#include "bench.h"
+
+#define ROUNDS		(2000000)
+
+// instructions of a simple accumulator machine
+#define LDA		(0)	// acc = regs[x]
+#define ADD		(1)	// acc += regs[x]
+#define STA		(2)	// regs[x] = acc
+#define DEC		(3)	// regs[x] -= 1
+#define BNZ		(4)	// if (regs[x] != 0) goto the beginning
+
+struct insn {
+	int code;
+	int reg;
+};
+
+// Fibonacci numbers in regs[0] and regs[1], their sum in regs[3], and the counter in regs[4]
+static struct insn program[] = {
+	{ LDA, 0 }, { ADD, 1 }, { STA, 2 },
+	{ LDA, 1 }, { STA, 0 }, { LDA, 2 }, { STA, 1 },
+	{ LDA, 2 }, { ADD, 3 }, { STA, 3 },
+	{ DEC, 4 }, { BNZ, 4 }
+};
+
+static jit_value regs[8];
+
+static void init_regs(jit_value rounds)
+{
+	memset(regs, 0, sizeof(regs));
+	regs[1] = 1;
+	regs[4] = rounds;
+}
+
+static jit_value interpret(jit_value rounds)
+{
+	init_regs(rounds);
+	jit_value acc = 0;
+	for (int pc = 0; pc < sizeof(program) / sizeof(struct insn); pc++) {
+		int x = program[pc].reg;
+		switch (program[pc].code) {
+			case LDA: acc = regs[x]; break;
+			case ADD: acc += regs[x]; break;
+			case STA: regs[x] = acc; break;
+			case DEC: regs[x] -= 1; break;
+			case BNZ: if (regs[x]) pc = -1; break;
+		}
+	}
+	return regs[3];
+}
+
+// each instruction is translated separately; the accumulator lives in the frame
+static void generate_vm_code(struct jit * p, void * f1)
+{
+	jit_prolog(p, f1);
+	int acc = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_movi(p, R(0), regs);
+	jit_getarg(p, R(1), 0);
+	jit_stxi(p, 4 * sizeof(jit_value), R(0), R(1), sizeof(jit_value));
+	jit_movi(p, R(1), 0);
+	jit_stxi(p, acc, R_FP, R(1), sizeof(jit_value));
+
+	jit_label * start = jit_get_label(p);
+	for (int pc = 0; pc < sizeof(program) / sizeof(struct insn); pc++) {
+		jit_value x = program[pc].reg * sizeof(jit_value);
+		switch (program[pc].code) {
+			case LDA:
+				jit_ldxi(p, R(1), R(0), x, sizeof(jit_value));
+				jit_stxi(p, acc, R_FP, R(1), sizeof(jit_value));
+				break;
+			case ADD:
+				jit_ldxi(p, R(1), R_FP, acc, sizeof(jit_value));
+				jit_ldxi(p, R(2), R(0), x, sizeof(jit_value));
+				jit_addr(p, R(1), R(1), R(2));
+				jit_stxi(p, acc, R_FP, R(1), sizeof(jit_value));
+				break;
+			case STA:
+				jit_ldxi(p, R(1), R_FP, acc, sizeof(jit_value));
+				jit_stxi(p, x, R(0), R(1), sizeof(jit_value));
+				break;
+			case DEC:
+				jit_ldxi(p, R(1), R(0), x, sizeof(jit_value));
+				jit_subi(p, R(1), R(1), 1);
+				jit_stxi(p, x, R(0), R(1), sizeof(jit_value));
+				break;
+			case BNZ:
+				jit_ldxi(p, R(1), R(0), x, sizeof(jit_value));
+				jit_bnei(p, start, R(1), 0);
+				break;
+		}
+	}
+	jit_ldxi(p, R(1), R(0), 3 * sizeof(jit_value), sizeof(jit_value));
+	jit_retr(p, R(1));
+}
+
+static double run(struct jit * p, int dump, int opts)
+{
+	plfl f1;
+	jit_enable_optimization(p, opts);
+	generate_vm_code(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	double t;
+	jit_value r;
+	MEASURE(t, { init_regs(0); r = f1(ROUNDS); });
+	CHECK_EQ(interpret(ROUNDS), r);
+	return t;
+}
+
+// each instruction loads its operands and stores its result
+DEFINE_BENCH(bench10)
+{
+	return run(p, dump, 0);
+}
+
+// stored values are forwarded to the following loads
+DEFINE_BENCH(bench11)
+{
+	return run(p, dump, JIT_OPT_REDUNDANT_LOADS);
+}
+
+// stores to the accumulator which are not read any more are removed
+DEFINE_BENCH(bench12)
+{
+	return run(p, dump, JIT_OPT_REDUNDANT_LOADS | JIT_OPT_DEAD_STORES);
+}
+
+// the accumulator is kept in a register
+DEFINE_BENCH(bench13)
+{
+	return run(p, dump, JIT_OPT_MEM2REG);
+}
+
+// loaded operands are read directly by the ALU operations
+DEFINE_BENCH(bench14)
+{
+	return run(p, dump, JIT_OPT_MEMORY_OPERANDS);
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+	SETUP_BENCH(bench12);
+	SETUP_BENCH(bench13);
+	SETUP_BENCH(bench14);
+}
@@ -0,0 +1,111 @@
+#include "bench.h"
+
+#define SIZE		(4096)
+#define ROUNDS		(200)
+#define LIMIT		(1000)
+
+#define R_A		R(0)
+#define R_B		R(1)
+#define R_C		R(2)
+#define R_I		R(3)
+#define R_TOTAL		R(4)
+#define R_CNT		R(5)
+#define R_ROUND		R(6)
+#define R_TMP(i)	R(7 + (i))
+
+static jit_value a[SIZE + 2], b[SIZE + 2], c[SIZE + 2];
+
+static jit_value kernel(jit_value rounds)
+{
+	jit_value total = 0, cnt = 0;
+	for (jit_value r = 0; r < rounds; r++) {
+		jit_value * cp = c;
+		for (jit_value i = 0; i < SIZE; i++) {
+			total += (a[i + 1] - b[i]) ^ cp[2];
+			if (cp[0] > LIMIT) cnt++;
+			cp++;
+		}
+	}
+	return total + cnt;
+}
+
+// array elements are addressed through computed indices and pointers;
+// loaded values are used only once
+static double run(struct jit * p, int dump, int opts)
+{
+	plfl f1;
+	jit_enable_optimization(p, opts);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R_ROUND, 0);
+	jit_movi(p, R_A, a);
+	jit_movi(p, R_B, b);
+	jit_movi(p, R_TOTAL, 0);
+	jit_movi(p, R_CNT, 0);
+
+	jit_label * outer = jit_get_label(p);
+	jit_movi(p, R_C, c);
+	jit_movi(p, R_I, 0);
+
+	jit_label * inner = jit_get_label(p);
+	// a[i + 1]
+	jit_muli(p, R_TMP(0), R_I, sizeof(jit_value));
+	jit_addr(p, R_TMP(0), R_A, R_TMP(0));
+	jit_ldxi(p, R_TMP(1), R_TMP(0), sizeof(jit_value), sizeof(jit_value));
+	// b[i]
+	jit_lshi(p, R_TMP(0), R_I, 3);
+	jit_ldxr(p, R_TMP(2), R_B, R_TMP(0), sizeof(jit_value));
+	jit_subr(p, R_TMP(1), R_TMP(1), R_TMP(2));
+	// cp[2]
+	jit_ldxi(p, R_TMP(2), R_C, 2 * sizeof(jit_value), sizeof(jit_value));
+	jit_xorr(p, R_TMP(1), R_TMP(1), R_TMP(2));
+	jit_addr(p, R_TOTAL, R_TOTAL, R_TMP(1));
+	// cp[0] > LIMIT
+	jit_movi(p, R_TMP(1), LIMIT);
+	jit_ldr(p, R_TMP(2), R_C, sizeof(jit_value));
+	jit_op * skip = jit_bler(p, JIT_FORWARD, R_TMP(2), R_TMP(1));
+	jit_addi(p, R_CNT, R_CNT, 1);
+	jit_patch(p, skip);
+
+	jit_addi(p, R_C, R_C, sizeof(jit_value));
+	jit_addi(p, R_I, R_I, 1);
+	jit_blti(p, inner, R_I, SIZE);
+	jit_subi(p, R_ROUND, R_ROUND, 1);
+	jit_bgti(p, outer, R_ROUND, 0);
+
+	jit_addr(p, R_TOTAL, R_TOTAL, R_CNT);
+	jit_retr(p, R_TOTAL);
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < SIZE + 2; i++) {
+		a[i] = i * 7;
+		b[i] = i * 3 + 1;
+		c[i] = (i * 13) % 2048;
+	}
+
+	double t;
+	jit_value r;
+	MEASURE(t, r = f1(ROUNDS));
+	CHECK_EQ(kernel(ROUNDS), r);
+	return t;
+}
+
+// each load is a separate instruction
+DEFINE_BENCH(bench10)
+{
+	return run(p, dump, 0);
+}
+
+// loads are merged into ALU operations and comparisons; indices are
+// scaled in the addressing modes
+DEFINE_BENCH(bench11)
+{
+	return run(p, dump, JIT_OPT_MEMORY_OPERANDS);
+}
+
+void bench_setup()
+{
+	bench_filename = __FILE__;
+	SETUP_BENCH(bench10);
+	SETUP_BENCH(bench11);
+}
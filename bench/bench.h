@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../myjit/jitlib.h"
+
+typedef jit_value (*plfl)(jit_value);
+typedef jit_value (*plfll)(jit_value, jit_value);
+typedef double (*pdfl)(jit_value);
+
+#define MAX_NUMBER_OF_BENCH	(64)
+
+typedef double (*bench_case_fn)(struct jit *, int);
+bench_case_fn bench_cases[MAX_NUMBER_OF_BENCH];
+char * bench_names[MAX_NUMBER_OF_BENCH];
+int bench_cnt = 0;
+char *bench_filename;
+
+/**
+ * Each benchmark builds its code in the given JIT compiler, runs it and
+ * returns the time spent by the generated code (in seconds) 
+ */
+#define DEFINE_BENCH(_name) \
+	double _name(struct jit *p, int dump)
+
+#define SETUP_BENCH(name) \
+	bench_cases[bench_cnt] = name;\
+	bench_names[bench_cnt] = "" #name "";\
+	bench_cnt++;
+
+#define JIT_GENERATE_CODE(p) { \
+	jit_generate_code(p); \
+	if (dump) jit_dump_ops(p, JIT_DEBUG_CODE); \
+}
+
+static inline double bench_time()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * Measures the time of the given statement; the best of several
+ * rounds is taken
+ */
+#define MEASURE(_result, _stmt) { \
+	_result = 1e9; \
+	for (int _round = 0; _round < 5; _round++) { \
+		double _start = bench_time(); \
+		_stmt; \
+		double _t = bench_time() - _start; \
+		if (_t < _result) _result = _t; \
+	} \
+}
+
+#define CHECK_EQ(_expected, _actual) { \
+	if ((_expected) != (_actual))  {\
+		fprintf(stderr, "%s: %s at line %i (expected: %lli, actual: %lli)\n", bench_filename, __func__, __LINE__, (jit_value)(_expected), (jit_value)(_actual)); \
+		exit(1); \
+	} \
+}
+
+void bench_setup();
+
+int main(int argc, char **argv)
+{
+	int dump = 0;
+	int all = 1;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp("--code", argv[i])) dump = 1;
+		else if (argv[i][0] != '-') all = 0;
+	}
+
+	bench_setup();
+
+	for (int i = 0; i < bench_cnt; i++) {
+		if (!all) {
+			int selected = 0;
+			for (int j = 1; j < argc; j++)
+				if (!strcmp(bench_names[i], argv[j])) selected = 1;
+			if (!selected) continue;
+		}
+		struct jit *p = jit_init();
+		double t = bench_cases[i](p, dump);
+		printf("%-25s %-20s %8.2f ms   spills: %3i   reloads: %3i\n", bench_filename, bench_names[i], t * 1000.0,
+			jit_get_stat(p, JIT_STAT_SPILLS), jit_get_stat(p, JIT_STAT_RELOADS));
+		jit_free(p);
+	}
+	return 0;
+}
@@ -310,9 +310,8 @@ typedef union {
 			amd64_mov_reg_reg(inst, dreg, reg, size); \
 			break; \
 		} \
-		if ((size) == 2) \
-			*(inst)++ = (unsigned char)0x66; \
-		amd64_emit_rex(inst, 8, (dreg), 0, (reg)); \
+		/* the 32-bit form clears the upper half as well; a REX prefix is needed to access SPL-DIL */ \
+		amd64_emit_rex(inst, (((size) == 1) && ((reg) >= 4) && ((reg) <= 7)) ? 1 : 4, (dreg), 0, (reg)); \
 		switch ((size)) {	\
 		case 1: *(inst)++ = (unsigned char)0x0f; *(inst)++ = (unsigned char)0xb6; break;	\
 		case 2: *(inst)++ = (unsigned char)0x0f; *(inst)++ = (unsigned char)0xb7; break;	\
@@ -327,7 +326,7 @@ typedef union {
 			amd64_mov_reg_mem(inst,reg,mem,size); \
 			break; \
 		} \
-		amd64_emit_rex(inst,8,(reg),0,0); \
+		amd64_emit_rex(inst,4,(reg),0,0); \
 		*(inst)++ = (unsigned char)0x0f;        \
 		switch ((size)) {       \
 			case 1: *(inst)++ = (unsigned char)0xb6; break; \
@@ -346,7 +345,7 @@ typedef union {
 			amd64_mov_reg_memindex(inst,reg,basereg,disp,indexreg,shift,size); \
 			break; \
 		} \
-		amd64_emit_rex ((inst),8,(reg),(indexreg),(basereg));\
+		amd64_emit_rex ((inst),4,(reg),(indexreg),(basereg));\
 		*(inst)++ = (unsigned char)0x0f;        \
 		switch ((size)) {       \
 			case 1: *(inst)++ = (unsigned char)0xb6; break; \
@@ -363,7 +362,7 @@ typedef union {
 			amd64_mov_reg_membase(inst, reg, basereg, disp,size); \
 			break; \
 		} \
-		amd64_emit_rex(inst,8,(reg),0,(basereg)); \
+		amd64_emit_rex(inst,4,(reg),0,(basereg)); \
 		*(inst)++ = (unsigned char)0x0f;        \
 		switch (size) {\
 			case 1: *(inst)++ = (unsigned char)0xb6; break; \
@@ -499,6 +498,9 @@ do {     \
 #define amd64_sse_alu_pd_reg_reg_imm(ip, op, dreg, reg, imm) \
 	emit_sse_reg_reg_imm(ip, dreg, reg, 0x66, 0x0f, op, imm)
 
+#define amd64_sse_alu_sd_reg_reg_imm(ip, op, dreg, reg, imm) \
+	emit_sse_reg_reg_imm(ip, dreg, reg, 0xf2, 0x0f, op, imm)
+
 #define amd64_sse_alu_pd_reg_membase(inst,opc,dreg,basereg,disp)       \
 	emit_sse_reg_membase ((inst), (dreg), (basereg), (disp), 0x66, 0x0f, opc)
 
@@ -540,10 +542,20 @@ do {     \
 			x86_imm_emit32 ((inst), (int)(size_t)(imm));	\
 	} while (0)
 
+/* Picks the shortest encoding: MOV r32, imm32 zero-extends unsigned 32-bit values,
+ * MOV r/m64, imm32 sign-extends negative ones, other values need the 64-bit immediate
+ */
 #define amd64_mov_reg_imm(inst,reg,imm)	\
 	do {	\
-		int _amd64_width_temp = ((size_t)(imm) == (size_t)(int)(size_t)(imm)); \
-        amd64_mov_reg_imm_size ((inst), (reg), (imm), (_amd64_width_temp ? 4 : 8)); \
+		size_t _amd64_imm_temp = (size_t)(imm); \
+		if (_amd64_imm_temp == (size_t)(unsigned int)_amd64_imm_temp) \
+			amd64_mov_reg_imm_size ((inst), (reg), _amd64_imm_temp, 4); \
+		else if (_amd64_imm_temp == (size_t)(int)_amd64_imm_temp) { \
+			amd64_emit_rex(inst, 8, 0, 0, (reg)); \
+			*(inst)++ = (unsigned char)0xc7;	\
+			x86_reg_emit ((inst), 0, (reg));	\
+			x86_imm_emit32 ((inst), (int)_amd64_imm_temp);	\
+		} else amd64_mov_reg_imm_size ((inst), (reg), _amd64_imm_temp, 8); \
 	} while (0)
 
 #define amd64_set_reg_template(inst,reg) amd64_mov_reg_imm_size ((inst),(reg), 0, 8)
@@ -716,7 +728,7 @@ do {     \
 		amd64_emit_rex ((inst),8,(reg),(indexreg),(basereg));\
 		*(inst)++ = (unsigned char)0x0f;        \
 		*(inst)++ = (unsigned char)0x5a;        \
-		x86_memindex_emit ((inst), (reg), (basereg), (disp), (indexreg), (shift));      \
+		x86_memindex_emit ((inst), (reg)&0x7, (basereg)&0x7, (disp), (indexreg)&0x7, (shift));      \
 	} while (0)
 
 #define amd64_sse_movlpd_xreg_memindex(inst,reg,basereg,disp,indexreg,shift)  \
@@ -725,7 +737,7 @@ do {     \
 		amd64_emit_rex ((inst),8,(reg),(indexreg),(basereg));\
 		*(inst)++ = (unsigned char)0x0f;        \
 		*(inst)++ = (unsigned char)0x12;        \
-		x86_memindex_emit ((inst), (reg), (basereg), (disp), (indexreg), (shift));      \
+		x86_memindex_emit ((inst), (reg)&0x7, (basereg)&0x7, (disp), (indexreg)&0x7, (shift));      \
 	} while (0)
 
 #define amd64_sse_movlpd_memindex_xreg(inst,basereg,disp,indexreg,shift,reg)  \
@@ -734,7 +746,7 @@ do {     \
 		amd64_emit_rex ((inst),8,(reg),(indexreg),(basereg));\
 		*(inst)++ = (unsigned char)0x0f;        \
 		*(inst)++ = (unsigned char)0x13;        \
-		x86_memindex_emit ((inst), (reg), (basereg), (disp), (indexreg), (shift));      \
+		x86_memindex_emit ((inst), (reg)&0x7, (basereg)&0x7, (disp), (indexreg)&0x7, (shift));      \
 	} while (0)
 
 #define amd64_sse_movss_memindex_xreg(inst,basereg,disp,indexreg,shift,reg)  \
@@ -743,7 +755,7 @@ do {     \
 		amd64_emit_rex ((inst),8,(reg),(indexreg),(basereg));\
 		*(inst)++ = (unsigned char)0x0f;        \
 		*(inst)++ = (unsigned char)0x11;        \
-		x86_memindex_emit ((inst), (reg), (basereg), (disp), (indexreg), (shift));      \
+		x86_memindex_emit ((inst), (reg)&0x7, (basereg)&0x7, (disp), (indexreg)&0x7, (shift));      \
 	} while (0)
 
 #define amd64_sse_xorpd_reg_mem(inst,reg,mem)  \
@@ -1324,10 +1336,20 @@ do {     \
 
 #define amd64_alu_reg_memindex(inst,op,reg,basereg,disp,indexreg,shift) do { amd64_emit_rex ((inst),/*(size)*/8,(reg),(indexreg),(basereg)); x86_alu_reg_memindex((inst),(op),((reg)&0x7),((basereg)&0x7),(disp),((indexreg)&0x7),(shift)); } while (0)
 
-#define amd64_test_reg_imm_size(inst,reg,imm,size) do { amd64_emit_rex ((inst),(size),0,0,(reg)); x86_test_reg_imm((inst),((reg)&0x7),(imm)); } while (0)
+#define amd64_test_reg_imm_size(inst,reg,imm,size) 	\
+	do {	\
+		amd64_emit_rex ((inst),(size),0,0,(reg));	\
+		if ((reg) == AMD64_RAX) {	\
+			*(inst)++ = (unsigned char)0xa9;	\
+		} else {	\
+			*(inst)++ = (unsigned char)0xf7;	\
+			x86_reg_emit ((inst), 0, ((reg)&0x7));	\
+		}	\
+		x86_imm_emit32 ((inst), (imm));	\
+	} while (0)
 #define amd64_test_mem_imm_size(inst,mem,imm,size) do { amd64_emit_rex ((inst),(size),0,0,0); x86_test_mem_imm((inst),(mem),(imm)); } while (0)
 #define amd64_test_membase_imm_size(inst,basereg,disp,imm,size) do { amd64_emit_rex ((inst),(size),0,0,(basereg)); x86_test_membase_imm((inst),((basereg)&0x7),(disp),(imm)); } while (0)
-#define amd64_test_reg_reg_size(inst,dreg,reg,size) do { amd64_emit_rex ((inst),(size),(dreg),0,(reg)); x86_test_reg_reg((inst),((dreg)&0x7),((reg)&0x7)); } while (0)
+#define amd64_test_reg_reg_size(inst,dreg,reg,size) do { amd64_emit_rex ((inst),(size),(reg),0,(dreg)); x86_test_reg_reg((inst),((dreg)&0x7),((reg)&0x7)); } while (0)
 #define amd64_test_mem_reg_size(inst,mem,reg,size) do { amd64_emit_rex ((inst),(size),0,0,(reg)); x86_test_mem_reg((inst),(mem),((reg)&0x7)); } while (0)
 #define amd64_test_membase_reg_size(inst,basereg,disp,reg,size) do { amd64_emit_rex ((inst),(size),(reg),0,(basereg)); x86_test_membase_reg((inst),((basereg)&0x7),(disp),((reg)&0x7)); } while (0)
 #define amd64_shift_reg_imm_size(inst,opc,reg,imm,size) do { amd64_emit_rex ((inst),(size),0,0,(reg)); x86_shift_reg_imm((inst),(opc),((reg)&0x7),(imm)); } while (0)
@@ -1387,7 +1409,7 @@ do {     \
 //#define amd64_lea_membase_size(inst,reg,basereg,disp,size) do { amd64_emit_rex ((inst),(size),0,0,(basereg)); x86_lea_membase((inst),((reg)&0x7),((basereg)&0x7),(disp)); } while (0)
 //#define amd64_lea_memindex_size(inst,reg,basereg,disp,indexreg,shift,size) do { amd64_emit_rex ((inst),(size),(reg),(indexreg),(basereg)); x86_lea_memindex((inst),((reg)&0x7),((basereg)&0x7),(disp),((indexreg)&0x7),(shift)); } while (0)
 
-#define amd64_lea_memindex_size(inst,reg,basereg,disp,indexreg,shift,size) do { amd64_emit_rex ((inst),(size),(reg),(indexreg),(basereg)); x86_lea_memindex((inst),((reg)&0x7),(basereg),(disp),((indexreg)&0x7),(shift)); } while (0)
+#define amd64_lea_memindex_size(inst,reg,basereg,disp,indexreg,shift,size) do { amd64_emit_rex ((inst),(size),(reg),(indexreg),(basereg)); x86_lea_memindex((inst),((reg)&0x7),((basereg) == X86_NOBASEREG ? X86_NOBASEREG : (basereg)&0x7),(disp),((indexreg)&0x7),(shift)); } while (0)
 
 
 #define amd64_widen_reg_size(inst,dreg,reg,is_signed,is_half,size) do { amd64_emit_rex ((inst),(size),(dreg),0,(reg)); x86_widen_reg((inst),((dreg)&0x7),((reg)&0x7),(is_signed),(is_half)); } while (0)
@@ -1459,10 +1481,10 @@ do {     \
 #define amd64_branch8_size(inst,cond,imm,is_signed,size) do { x86_branch8((inst),(cond),(imm),(is_signed)); } while (0)
 #define amd64_branch32_size(inst,cond,imm,is_signed,size) do { x86_branch32((inst),(cond),(imm),(is_signed)); } while (0)
 #define amd64_branch_size(inst,cond,target,is_signed,size) do { amd64_emit_rex ((inst),(size),0,0,0); x86_branch((inst),(cond),(target),(is_signed)); } while (0)
-#define amd64_branch_disp_size(inst,cond,disp,is_signed,size) do { amd64_emit_rex ((inst),(size),0,0,0); x86_branch_disp((inst),(cond),(disp),(is_signed)); } while (0)
-#define amd64_branch_disp32_size(inst,cond,disp,is_signed,size) do { amd64_emit_rex ((inst),(size),0,0,0); x86_branch_disp32((inst),(cond),(disp),(is_signed)); } while (0)
+#define amd64_branch_disp_size(inst,cond,disp,is_signed,size) do { x86_branch_disp((inst),(cond),(disp),(is_signed)); } while (0)
+#define amd64_branch_disp32_size(inst,cond,disp,is_signed,size) do { x86_branch_disp32((inst),(cond),(disp),(is_signed)); } while (0)
 
-#define amd64_set_reg_size(inst,cond,reg,is_signed,size) do { amd64_emit_rex((inst),1,0,0,(reg)); x86_set_reg((inst),(cond),((reg)&0x7),(is_signed)); } while (0)
+#define amd64_set_reg_size(inst,cond,reg,is_signed,size) do { amd64_emit_rex((inst),(((reg) >= 4) && ((reg) <= 7)) ? 1 : 0,0,0,(reg)); x86_set_reg((inst),(cond),((reg)&0x7),(is_signed)); } while (0)
 #define amd64_set_mem_size(inst,cond,mem,is_signed,size) do { x86_set_mem((inst),(cond),(mem),(is_signed)); } while (0)
 #define amd64_set_membase_size(inst,cond,basereg,disp,is_signed,size) do { amd64_emit_rex ((inst),0,0,0,(basereg)); x86_set_membase((inst),(cond),((basereg)&0x7),(disp),(is_signed)); } while (0)
 #define amd64_call_imm_size(inst,disp,size) do { x86_call_imm((inst),(disp)); } while (0)
@@ -24,19 +24,45 @@
  * RBP      +--------------+
  *          | allocai mem  |
  * RBP - n  +--------------+
- *          | GP registers |
- * RPB - m  +--------------+
- *          | FP registers |
- * RPB - k  +--------------+
  *          | shadow space |
  *          | for arg.regs |
+ * RPB - m  +--------------+
+ *          | GP slots     |
+ * RPB - k  +--------------+
+ *          | FP slots     |
  * RPB - l  +--------------+
+ *
+ * Slots are assigned to spilled registers by jit_assign_stack_slots.
  */
 
-#define GET_GPREG_POS(jit, r) (- ((JIT_REG_ID(r) + 1) * REG_SIZE) - jit_current_func_info(jit)->allocai_mem)
-#define GET_FPREG_POS(jit, r) (- jit_current_func_info(jit)->gp_reg_count * REG_SIZE - (JIT_REG_ID(r) + 1) * sizeof(jit_float) - jit_current_func_info(jit)->allocai_mem)
+#define JIT_ARGS_SPILL_SIZE(info) (((info)->general_arg_cnt + (info)->float_arg_cnt) * REG_SIZE)
 
-#define GET_ARG_SPILL_POS(jit, info, arg) ((- (arg + info->gp_reg_count + info->fp_reg_count) * REG_SIZE) - jit_current_func_info(jit)->allocai_mem)
+#define GET_ARG_SPILL_POS(jit, info, arg) ((- (arg + 1) * REG_SIZE) - (info)->allocai_mem)
+
+static inline int GET_GPREG_POS(struct jit * jit, int r)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	int slot = info->gp_slots[JIT_REG_ID(r)];
+	assert(slot >= 0);
+	return - JIT_ARGS_SPILL_SIZE(info) - (slot + 1) * REG_SIZE - info->allocai_mem;
+}
+
+/**
+ * Returns FP register holding the spilled GP register, or -1 if the register is kept on the stack
+ */
+static inline int GET_GPREG_SPILL_REG(struct jit * jit, int r)
+{
+	if ((JIT_REG_SPEC(r) != JIT_RTYPE_REG) || (JIT_REG_TYPE(r) != JIT_RTYPE_INT)) return -1;
+	return jit_current_func_info(jit)->gp_spill_regs[JIT_REG_ID(r)];
+}
+
+static inline int GET_FPREG_POS(struct jit * jit, int r)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	int slot = info->fp_slots[JIT_REG_ID(r)];
+	assert(slot >= 0);
+	return - JIT_ARGS_SPILL_SIZE(info) - info->gp_slot_count * REG_SIZE - (slot + 1) * sizeof(jit_float) - info->allocai_mem;
+}
 
 static inline int GET_REG_POS(struct jit * jit, int r)
 {
@@ -46,19 +72,69 @@ static inline int GET_REG_POS(struct jit * jit, int r)
 	} else return GET_ARG_SPILL_POS(jit, jit_current_func_info(jit), JIT_REG_ID(r));
 }
 
+/* Frames without the frame pointer:
+ *
+ * If the function does not use R_FP, the frame is addressed through RSP
+ * and RBP is neither saved nor set up. Positions returned by GET_REG_POS
+ * are still RBP-relative (RBP being the address below the return address)
+ * and are converted with GET_FRAME_POS, which takes into account the
+ * size of the frame and all values pushed on the stack since the prolog.
+ *
+ * Leaf functions with a small frame do not allocate the frame at all,
+ * it is placed into the red zone below RSP. The local data are moved
+ * below the scratch area, which is used by operations temporarily storing
+ * values below RSP (transfers, MUL/DIV, shifts, etc.).
+ */
+#ifndef _WIN32
+#define JIT_RED_ZONE_SIZE	(128)
+#else
+#define JIT_RED_ZONE_SIZE	(0)
+#endif
+#define JIT_RED_ZONE_SCRATCH	(4 * REG_SIZE)
+
+static inline int jit_frame_size(struct jit_func_info * info)
+{
+	int stack_mem = info->allocai_mem + JIT_ARGS_SPILL_SIZE(info) + info->gp_slot_count * REG_SIZE + info->fp_slot_count * sizeof(jit_float);
+	return jit_value_align(stack_mem, JIT_STACK_ALIGNMENT); // 16-bytes aligned
+}
+
+static inline int jit_fits_red_zone(struct jit_func_info * info)
+{
+	return jit_frame_size(info) + REG_SIZE + JIT_RED_ZONE_SCRATCH <= JIT_RED_ZONE_SIZE;
+}
+
+#define GET_FRAME_REG(jit) (jit_current_func_info(jit)->sp_relative_frame ? AMD64_RSP : AMD64_RBP)
+
+// registers which the code generator overwrites regardless of register mappings
+// (return values, AL for variadic calls, address of external functions, temporary XMM registers)
+#define JIT_SCRATCH_GP_REGS	((1 << AMD64_RAX) | (1 << AMD64_RCX) | (1 << AMD64_RDX) | (1 << AMD64_R11))
+#define JIT_SCRATCH_FP_REGS	((1 << AMD64_XMM0) | (1 << AMD64_XMM7))
+
+static inline int GET_FRAME_POS(struct jit * jit, int pos)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	if (!info->sp_relative_frame) return pos;
+	if (info->red_zone) {
+		if (pos < 0) pos -= JIT_RED_ZONE_SCRATCH;
+		return pos - REG_SIZE;
+	}
+	return pos + jit_frame_size(info) + jit->push_count * REG_SIZE;
+}
+
 #include "x86-common-stuff.c"
 
 void jit_init_arg_params(struct jit * jit, struct jit_func_info * info, int p, int * phys_reg)
 {
 	struct jit_inp_arg * a = &(info->args[p]);
+	int gp_arg_reg_cnt = jit_gp_arg_reg_cnt(jit->reg_al, info);
 	if (a->type != JIT_FLOAT_NUM) { // normal argument
 		int pos = a->gp_pos;
-		if (pos < jit->reg_al->gp_arg_reg_cnt) {
+		if (pos < gp_arg_reg_cnt) {
 			a->passed_by_reg = 1;
 			a->location.reg = jit->reg_al->gp_arg_regs[pos]->id;
 			a->spill_pos = GET_ARG_SPILL_POS(jit, info, p);
 		} else {
-			int stack_pos = (pos - jit->reg_al->gp_arg_reg_cnt) + MAX(0, (a->fp_pos - jit->reg_al->fp_arg_reg_cnt));
+			int stack_pos = (pos - gp_arg_reg_cnt) + MAX(0, (a->fp_pos - jit->reg_al->fp_arg_reg_cnt));
 
 			a->location.stack_pos = 16 + stack_pos * 8;
 			a->spill_pos = 16 + stack_pos * 8;
@@ -76,7 +152,7 @@ void jit_init_arg_params(struct jit * jit, struct jit_func_info * info, int p, i
 		a->spill_pos = GET_ARG_SPILL_POS(jit, info, p);
 	} else {
 
-		int stack_pos = (pos - jit->reg_al->fp_arg_reg_cnt) + MAX(0, (a->gp_pos - jit->reg_al->gp_arg_reg_cnt));
+		int stack_pos = (pos - jit->reg_al->fp_arg_reg_cnt) + MAX(0, (a->gp_pos - gp_arg_reg_cnt));
 
 		a->location.stack_pos = 16 + stack_pos * 8;
 		a->spill_pos = 16 + stack_pos * 8;
@@ -85,6 +161,17 @@ void jit_init_arg_params(struct jit * jit, struct jit_func_info * info, int p, i
 	a->overflow = 0;
 }
 
+/**
+ * Pushes 64-bit immediate value on the stack without using any scratch
+ * register, since registers may still hold values of other arguments
+ */
+static inline void emit_push_imm(struct jit * jit, uint64_t value)
+{
+	amd64_push_imm(jit->ip, (int32_t) value);
+	if (!amd64_is_imm32((int64_t) value))
+		amd64_mov_membase_imm(jit->ip, AMD64_RSP, 4, (int32_t) (value >> 32), 4);
+}
+
 /**
  * Assigns integer value to register which is used to pass the argument
  */
@@ -95,11 +182,11 @@ static inline void emit_set_arg(struct jit * jit, struct jit_out_arg * arg)
 	jit_value value = arg->value.generic;
 	if (arg->isreg) {
 		if (is_spilled(value, jit->prepared_args.op, &sreg)) {
-			amd64_mov_reg_membase(jit->ip, reg, AMD64_RBP, GET_REG_POS(jit, value), REG_SIZE);
+			amd64_mov_reg_membase(jit->ip, reg, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, value)), REG_SIZE);
 		} else {
 			if (reg != sreg) amd64_mov_reg_reg(jit->ip, reg, sreg, REG_SIZE);
 		}
-	} else amd64_mov_reg_imm_size(jit->ip, reg, value, 8);
+	} else amd64_mov_reg_imm(jit->ip, reg, value);
 }
 
 /**
@@ -112,10 +199,10 @@ static inline void emit_set_fparg(struct jit * jit, struct jit_out_arg * arg)
 	intptr_t value = arg->value.generic;
 	if (arg->isreg) {
 		if (is_spilled(value, jit->prepared_args.op, &sreg)) {
-			int pos = GET_REG_POS(jit, value);
+			int pos = GET_FRAME_POS(jit, GET_REG_POS(jit, value));
 			if (arg->size == sizeof(float))
-				amd64_sse_cvtsd2ss_reg_membase(jit->ip, reg, AMD64_RBP, pos);
-			else amd64_sse_movlpd_xreg_membase(jit->ip, reg, AMD64_RBP, pos);
+				amd64_sse_cvtsd2ss_reg_membase(jit->ip, reg, GET_FRAME_REG(jit), pos);
+			else amd64_sse_movlpd_xreg_membase(jit->ip, reg, GET_FRAME_REG(jit), pos);
 		} else {
 			if (arg->size == sizeof(float))
 				amd64_sse_cvtsd2ss_reg_reg(jit->ip, reg, sreg);
@@ -127,7 +214,6 @@ static inline void emit_set_fparg(struct jit * jit, struct jit_out_arg * arg)
 			unsigned int tmp;
 
 			memcpy(&tmp, &val, sizeof(float));
-			//amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, *(unsigned int *)&val, 4);
 			amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, tmp, 4);
 			amd64_movd_xreg_reg_size(jit->ip, reg, AMD64_RAX, 4);
 		} else {
@@ -145,11 +231,10 @@ static inline void emit_push_arg(struct jit * jit, struct jit_out_arg * arg)
 	int sreg;
 	if (arg->isreg) {
 		if (is_spilled(arg->value.generic, jit->prepared_args.op, &sreg))
-			amd64_push_membase(jit->ip, AMD64_RBP, GET_REG_POS(jit, arg->value.generic));
+			amd64_push_membase(jit->ip, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, arg->value.generic)));
 		else amd64_push_reg(jit->ip, sreg);
 	} else {
-		amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, arg->value.generic, REG_SIZE);
-		amd64_push_reg(jit->ip, AMD64_RAX);
+		emit_push_imm(jit, arg->value.generic);
 	}
 }
 
@@ -162,8 +247,8 @@ static inline void emit_fppush_arg(struct jit * jit, struct jit_out_arg * arg)
 	if (arg->size == sizeof(double)) {
 		if (arg->isreg) {
 			if (is_spilled(arg->value.generic, jit->prepared_args.op, &sreg)) {
-				int pos = GET_FPREG_POS(jit, arg->value.generic);
-				amd64_push_membase(jit->ip, AMD64_RBP, pos);
+				int pos = GET_FRAME_POS(jit, GET_FPREG_POS(jit, arg->value.generic));
+				amd64_push_membase(jit->ip, GET_FRAME_REG(jit), pos);
 			} else {
 				// ``PUSH sreg'' for XMM regs
 				amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, 8);
@@ -173,14 +258,13 @@ static inline void emit_fppush_arg(struct jit * jit, struct jit_out_arg * arg)
 			double b = arg->value.fp;
 			uintptr_t  tmp;
 			memcpy(&tmp, &b, sizeof(double));
-			amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, tmp, 8);
-			amd64_push_reg(jit->ip, AMD64_RAX);
+			emit_push_imm(jit, tmp);
 		}
 
 	} else {
 		if (arg->isreg) {
 			if (is_spilled(arg->value.generic, jit->prepared_args.op, &sreg)) {
-				amd64_sse_cvtsd2ss_reg_membase(jit->ip, AMD64_XMM0, AMD64_RBP, GET_REG_POS(jit, arg->value.generic));
+				amd64_sse_cvtsd2ss_reg_membase(jit->ip, AMD64_XMM0, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, arg->value.generic)));
 			} else {
 				amd64_sse_cvtsd2ss_reg_reg(jit->ip, AMD64_XMM0, sreg);
 			}
@@ -191,21 +275,26 @@ static inline void emit_fppush_arg(struct jit * jit, struct jit_out_arg * arg)
 			uintptr_t  tmp = 0;
 			memcpy(&tmp, &b, sizeof(float));
 
-			amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, tmp, 8);
-			amd64_push_reg(jit->ip, AMD64_RAX);
+			emit_push_imm(jit, tmp);
 		}
 	}
 }
 
-static inline int emit_arguments(struct jit * jit)
+static inline int emit_arguments(struct jit * jit, int tail_call)
 {
 	int stack_correction = 0;
 	struct jit_out_arg * args = jit->prepared_args.args;
+	struct jit_func_info * callee = jit->prepared_args.callee;
+	int private_callee = (callee && callee->private_conv);
 
-	int gp_pushed = MAX(jit->prepared_args.gp_args - jit->reg_al->gp_arg_reg_cnt, 0);
+	int gp_pushed = MAX(jit->prepared_args.gp_args - jit->prepared_args.gp_arg_reg_cnt, 0);
 	int fp_pushed = MAX(jit->prepared_args.fp_args - jit->reg_al->fp_arg_reg_cnt, 0);
 
-	if (jit_current_func_info(jit)->has_prolog) {
+	if (tail_call) {
+		// the frame is released before the jump, the callee gets the stack aligned as the caller
+	} else if (private_callee && !callee->aligned_stack) {
+		// the callee does not call any C function, alignment is not necessary
+	} else if (jit_current_func_info(jit)->has_prolog) {
 		if ((jit->push_count + gp_pushed + fp_pushed) % 2) {
 			amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, 8);
 			stack_correction = 8;
@@ -216,33 +305,161 @@ static inline int emit_arguments(struct jit * jit)
 			stack_correction = 8;
 		}
 	}
+	// spilled values are read relatively to RSP, if there's no frame pointer
+	jit->push_count += stack_correction / REG_SIZE;
 
 	for (int x = jit->prepared_args.count - 1; x >= 0; x --) {
 		struct jit_out_arg * arg = &(args[x]);
 		if (!arg->isfp) {
-			if (arg->argpos < jit->reg_al->gp_arg_reg_cnt) emit_set_arg(jit, arg);
-			else emit_push_arg(jit, arg);
+			if (arg->argpos < jit->prepared_args.gp_arg_reg_cnt) emit_set_arg(jit, arg);
+			else {
+				emit_push_arg(jit, arg);
+				jit->push_count++;
+			}
 		} else {
-			if (arg->argpos < jit->reg_al->fp_arg_reg_cnt) emit_set_fparg(jit, arg);
-			else emit_fppush_arg(jit, arg);
+			if (arg->argpos < jit->reg_al->fp_arg_reg_cnt) {
+				if (arg->isreg) emit_set_fparg(jit, arg);
+			} else {
+				emit_fppush_arg(jit, arg);
+				jit->push_count++;
+			}
 		}
 	}
+	// immediate values are loaded through RAX, which is not an argument register
+	// and may hold other arguments until they are in place
+	for (int x = 0; x < jit->prepared_args.count; x++) {
+		struct jit_out_arg * arg = &(args[x]);
+		if (arg->isfp && !arg->isreg && (arg->argpos < jit->reg_al->fp_arg_reg_cnt)) emit_set_fparg(jit, arg);
+	}
 	/* AL is used to pass the number of floating point arguments passed through the XMM0-XMM7 registers */
+	if (private_callee) return stack_correction;
 	int fp_reg_arg_cnt = MIN(jit->prepared_args.fp_args, jit->reg_al->fp_arg_reg_cnt);
 	if (fp_reg_arg_cnt != 0) amd64_mov_reg_imm(jit->ip, AMD64_RAX, fp_reg_arg_cnt);
 	else amd64_alu_reg_reg_size(jit->ip, X86_XOR, AMD64_RAX, AMD64_RAX, 4);
 	return stack_correction;
 }
 
+/**
+ * Returns the next operation which emits some code
+ */
+static jit_op * next_code_op(jit_op * op)
+{
+	do op = op->next;
+	while (op && ((GET_OP(op) == JIT_COMMENT) || (GET_OP(op) == JIT_MARK)));
+	return op;
+}
+
+/**
+ * Returns 1 if the function allocates memory on the stack or refers to R_FP,
+ * i.e., it may pass a pointer into its stack frame to the callee
+ */
+static int uses_frame_memory(struct jit * jit, struct jit_func_info * info)
+{
+	for (jit_op * op = info->first_op->next; op != NULL && (GET_OP(op) != JIT_PROLOG); op = op->next)
+		if ((GET_OP(op) == JIT_ALLOCA) || uses_fp_reg(jit, op)) return 1;
+	return 0;
+}
+
+/**
+ * Returns 1 if the call is in a tail position, i.e., it is followed only by
+ * the return of the value returned by the callee, and all its arguments are
+ * passed in registers. The frame is released before the jump, hence,
+ * functions which may pass pointers into the frame are excluded.
+ */
+static int is_tail_call(struct jit * jit, jit_op * call)
+{
+	if (!(jit->optimizations & JIT_OPT_TAIL_CALLS)) return 0;
+	if (uses_frame_memory(jit, jit_current_func_info(jit))) return 0;
+	jit_op * retval = next_code_op(call);
+	jit_op * ret = (retval ? next_code_op(retval) : NULL);
+	if (!ret || IS_IMM(ret) || (ret->arg[0] != retval->arg[0])) return 0;
+	if ((GET_OP(retval) == JIT_RETVAL) && (GET_OP(ret) == JIT_RET)) {
+		// ok
+	} else if ((GET_OP(retval) == JIT_FRETVAL) && (GET_OP(ret) == JIT_FRET)) {
+		if (retval->arg_size != ret->arg_size) return 0;
+	} else return 0;
+
+	jit_op * prepare = call;
+	while (GET_OP(prepare) != JIT_PREPARE) prepare = prepare->prev;
+	return (prepare->arg[0] <= jit_gp_arg_reg_cnt(jit->reg_al, called_func_info(call)))
+		&& (prepare->arg[1] <= jit->reg_al->fp_arg_reg_cnt);
+}
+
+/**
+ * Returns 1 if the operation passes the value returned by the call
+ * in a tail position, i.e., it is never reached
+ */
+static int follows_tail_call(struct jit * jit, jit_op * op)
+{
+	for (jit_op * call = op->prev; call != NULL; call = call->prev) {
+		switch (GET_OP(call)) {
+			case JIT_COMMENT: case JIT_MARK: case JIT_RETVAL: case JIT_FRETVAL: break;
+			case JIT_CALL: return is_tail_call(jit, call);
+			default: return 0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Releases the stack frame allocated in the prolog
+ */
+static void emit_release_frame(struct jit * jit)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	if (!info->sp_relative_frame) {
+		amd64_mov_reg_reg(jit->ip, AMD64_RSP, AMD64_RBP, 8);
+		amd64_pop_reg(jit->ip, AMD64_RBP);
+	} else if (!info->red_zone) {
+		amd64_alu_reg_imm(jit->ip, X86_ADD, AMD64_RSP, jit_frame_size(info) + REG_SIZE);
+	}
+}
+
+/**
+ * Emits the call in a tail position as a jump. The stack frame is released
+ * before the jump, hence, the callee returns directly to our caller.
+ */
+static void emit_tail_call(struct jit * jit, struct jit_op * op, int imm)
+{
+	emit_arguments(jit, 1);
+	JIT_FREE(jit->prepared_args.args);
+	jit->push_count -= emit_pop_caller_saved_regs(jit, op);
+
+	// the address has to be kept in a register which is not restored by the epilogue
+	if (!imm) {
+		jit_hw_reg * hreg = rmap_get(op->regmap, op->arg[0]);
+		if (hreg) amd64_mov_reg_reg(jit->ip, AMD64_R11, hreg->id, REG_SIZE);
+		else amd64_mov_reg_membase(jit->ip, AMD64_R11, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, op->arg[0])), REG_SIZE);
+	}
+
+	emit_pop_callee_saved_regs(jit);
+	if (jit_current_func_info(jit)->has_prolog) emit_release_frame(jit);
+
+	if (!imm) amd64_jump_reg(jit->ip, AMD64_R11);
+	else if (jit_is_label(jit, (void *)op->arg[0])) {
+		op->patch_addr = JIT_BUFFER_OFFSET(jit);
+		amd64_jump_disp32(jit->ip, JIT_GET_ADDR(jit, op->arg[0]));
+	} else {
+		amd64_mov_reg_imm(jit->ip, AMD64_R11, op->arg[0]);
+		amd64_jump_reg(jit->ip, AMD64_R11);
+	}
+	jit->stats[JIT_STAT_TAIL_CALLS]++;
+}
+
 static void emit_funcall(struct jit * jit, struct jit_op * op, int imm)
 {
+	if (is_tail_call(jit, op)) {
+		emit_tail_call(jit, op, imm);
+		return;
+	}
+
 	// correctly aligns stack to 16 bytes
-	int stack_correction = emit_arguments(jit);
+	int stack_correction = emit_arguments(jit, 0);
 
 	if (!imm) {
 		jit_hw_reg * hreg = rmap_get(op->regmap, op->arg[0]);
 		if (hreg) amd64_call_reg(jit->ip, hreg->id);
-		else amd64_call_membase(jit->ip, AMD64_RBP, GET_REG_POS(jit, op->arg[0]));
+		else amd64_call_membase(jit->ip, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, op->arg[0])));
 	} else {
 		if (jit_is_label(jit, (void *)op->arg[0])) {
 			op->patch_addr = JIT_BUFFER_OFFSET(jit);
@@ -252,7 +469,7 @@ static void emit_funcall(struct jit * jit, struct jit_op * op, int imm)
 			// even in the place which is not addressable with 32bit wide value
 			// therefore external functions are called using %r11 register
 			// which is caller-saved register and its value should be already on stack
-			amd64_mov_reg_imm_size(jit->ip, AMD64_R11, op->arg[0], 8);
+			amd64_mov_reg_imm(jit->ip, AMD64_R11, op->arg[0]);
 			amd64_call_reg(jit->ip, AMD64_R11);
 		}
 	}
@@ -260,6 +477,7 @@ static void emit_funcall(struct jit * jit, struct jit_op * op, int imm)
 	stack_correction += jit->prepared_args.stack_size;
 	if (stack_correction)
 		amd64_alu_reg_imm(jit->ip, X86_ADD, AMD64_RSP, stack_correction);
+	jit->push_count -= stack_correction / REG_SIZE;
 	JIT_FREE(jit->prepared_args.args);
 
 	jit->push_count -= emit_pop_caller_saved_regs(jit, op);
@@ -277,17 +495,69 @@ static void emit_prolog_op(struct jit * jit, jit_op * op)
 
 	op->patch_addr = JIT_BUFFER_OFFSET(jit);
 	if (prolog) {
-		amd64_push_reg(jit->ip, AMD64_RBP);
-		amd64_mov_reg_reg(jit->ip, AMD64_RBP, AMD64_RSP, 8);
+		if (!info->sp_relative_frame) {
+			amd64_push_reg(jit->ip, AMD64_RBP);
+			amd64_mov_reg_reg(jit->ip, AMD64_RBP, AMD64_RSP, 8);
+			amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, jit_frame_size(info));
+		} else if (!info->red_zone) {
+			// the slot of RBP is kept to preserve alignment of the stack
+			amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, jit_frame_size(info) + REG_SIZE);
+		}
+		jit->stats[JIT_STAT_FRAME_SIZE] += jit_frame_size(info);
 	}
+	jit->push_count = emit_push_callee_saved_regs(jit, op);
+}
+
+/**
+ * Returns position of the argument on the stack if the function is called
+ * with the standard calling convention
+ */
+static int c_arg_stack_pos(struct jit * jit, struct jit_inp_arg * a)
+{
+	struct jit_reg_allocator * al = jit->reg_al;
+	if (a->type != JIT_FLOAT_NUM) return (a->gp_pos - al->gp_arg_reg_cnt) + MAX(0, (a->fp_pos - al->fp_arg_reg_cnt));
+	return (a->fp_pos - al->fp_arg_reg_cnt) + MAX(0, (a->gp_pos - al->gp_arg_reg_cnt));
+}
 
-	int stack_mem = info->allocai_mem + info->gp_reg_count * REG_SIZE + info->fp_reg_count * sizeof(jit_float) + info->general_arg_cnt * REG_SIZE + info->float_arg_cnt * sizeof(jit_float);
+/**
+ * Emits entry point of the function with the private calling convention
+ * which can be called from C code. Arguments which are not passed in the same
+ * place by both conventions are copied, then the function is called.
+ */
+static void emit_c_entry(struct jit * jit, jit_op * prolog)
+{
+	struct jit_reg_allocator * al = jit->reg_al;
+	struct jit_func_info * info = (struct jit_func_info *) prolog->arg[1];
+	int argcount = info->general_arg_cnt + info->float_arg_cnt;
+
+	int stack_args = 0;
+	for (int i = 0; i < argcount; i++)
+		if (!info->args[i].passed_by_reg) stack_args++;
+
+	info->c_entry = JIT_BUFFER_OFFSET(jit);
+
+	// keeps the stack aligned
+	int pushed = (stack_args % 2 == 0);
+	if (pushed) amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, 8);
+
+	for (int pos = stack_args - 1; pos >= 0; pos--) {
+		for (int i = 0; i < argcount; i++) {
+			struct jit_inp_arg * a = &(info->args[i]);
+			if (a->passed_by_reg || (a->location.stack_pos != 16 + pos * 8)) continue;
+			amd64_push_membase(jit->ip, AMD64_RSP, 8 + (c_arg_stack_pos(jit, a) + pushed) * 8);
+			pushed++;
+		}
+	}
 
-	stack_mem = jit_value_align(stack_mem, JIT_STACK_ALIGNMENT); // 16-bytes aligned
+	for (int i = 0; i < argcount; i++) {
+		struct jit_inp_arg * a = &(info->args[i]);
+		if ((a->type == JIT_FLOAT_NUM) || !a->passed_by_reg || (a->gp_pos < al->gp_arg_reg_cnt)) continue;
+		amd64_mov_reg_membase(jit->ip, a->location.reg, AMD64_RSP, 8 + (c_arg_stack_pos(jit, a) + pushed) * 8, REG_SIZE);
+	}
 
-	if (prolog)
-		amd64_alu_reg_imm(jit->ip, X86_SUB, AMD64_RSP, stack_mem);
-	jit->push_count = emit_push_callee_saved_regs(jit, op);
+	amd64_call_imm(jit->ip, ((jit_value)jit->buf + prolog->patch_addr) - (jit_value)jit->ip - 4);
+	amd64_alu_reg_imm(jit->ip, X86_ADD, AMD64_RSP, pushed * 8);
+	amd64_ret(jit->ip);
 }
 
 static void emit_msg_op(struct jit * jit, jit_op * op)
@@ -295,8 +565,8 @@ static void emit_msg_op(struct jit * jit, jit_op * op)
 	emit_save_all_regs(jit, op);
 
 	if (!IS_IMM(op)) amd64_mov_reg_reg_size(jit->ip, AMD64_RSI, op->r_arg[1], 8);
-	amd64_mov_reg_imm_size(jit->ip, AMD64_RDI, op->r_arg[0], 8);
-	amd64_alu_reg_reg(jit->ip, X86_XOR, AMD64_RAX, AMD64_RAX);
+	amd64_mov_reg_imm(jit->ip, AMD64_RDI, op->r_arg[0]);
+	amd64_alu_reg_reg_size(jit->ip, X86_XOR, AMD64_RAX, AMD64_RAX, 4);
 	amd64_mov_reg_imm(jit->ip, AMD64_RDX, printf);
 	amd64_call_reg(jit->ip, AMD64_RDX);
 
@@ -314,8 +584,8 @@ static void emit_fmsg_op(struct jit * jit, jit_op * op)
 	amd64_alu_reg_imm_size(jit->ip, X86_SUB, AMD64_RSP, 16, 8);
 
 	sse_movsd_reg_reg(jit->ip, AMD64_XMM0, op->r_arg[1]);
-	amd64_mov_reg_imm_size(jit->ip, AMD64_RDI, op->r_arg[0], 8);
-	amd64_mov_reg_imm_size(jit->ip, AMD64_RAX, 1, 8);
+	amd64_mov_reg_imm(jit->ip, AMD64_RDI, op->r_arg[0]);
+	amd64_mov_reg_imm(jit->ip, AMD64_RAX, 1);
 	amd64_mov_reg_imm(jit->ip, AMD64_RDX, printf);
 	amd64_call_reg(jit->ip, AMD64_RDX);
 
@@ -342,11 +612,11 @@ static void emit_trace_op(struct jit *jit, jit_op *op)
 	if ((prev_code == JIT_PROLOG) || (prev_code == JIT_LABEL) || (prev_code == JIT_PATCH)) trace |= TRACE_PREV;
 	if ((next_code != JIT_PROLOG) && (next_code != JIT_LABEL) && (next_code != JIT_PATCH)) trace |= TRACE_NEXT;
 
-	amd64_mov_reg_imm_size(jit->ip, AMD64_RDI, jit, 8);
-	amd64_mov_reg_imm_size(jit->ip, AMD64_RSI, op, 8);
+	amd64_mov_reg_imm(jit->ip, AMD64_RDI, jit);
+	amd64_mov_reg_imm(jit->ip, AMD64_RSI, op);
 	amd64_mov_reg_imm_size(jit->ip, AMD64_RDX, op->r_arg[0], 4);
 	amd64_mov_reg_imm_size(jit->ip, AMD64_RCX, trace, 4);
-	amd64_alu_reg_reg_size(jit->ip, X86_XOR, AMD64_RAX, AMD64_RAX, 8);
+	amd64_alu_reg_reg_size(jit->ip, X86_XOR, AMD64_RAX, AMD64_RAX, 4);
 	amd64_mov_reg_imm(jit->ip, AMD64_R8, jit_trace_callback);
 	amd64_call_reg(jit->ip, AMD64_R8);
 
@@ -381,10 +651,7 @@ static void emit_fret_op(struct jit * jit, jit_op * op)
 */
 	// common epilogue
 	jit->push_count -= emit_pop_callee_saved_regs(jit);
-	if (jit_current_func_info(jit)->has_prolog) {
-		common86_mov_reg_reg(jit->ip, COMMON86_SP, COMMON86_BP, 8);
-		common86_pop_reg(jit->ip, COMMON86_BP);
-	}
+	if (jit_current_func_info(jit)->has_prolog) emit_release_frame(jit);
 	common86_ret(jit->ip);
 }
 
@@ -406,7 +673,7 @@ void jit_patch_external_calls(struct jit * jit)
 struct jit_reg_allocator * jit_reg_allocator_create()
 {
 	struct jit_reg_allocator * a = JIT_MALLOC(sizeof(struct jit_reg_allocator));
-	a->gp_reg_cnt = 13;
+	a->gp_reg_cnt = 15;
 
 	a->gp_regs = JIT_MALLOC(sizeof(jit_hw_reg) * a->gp_reg_cnt);
 
@@ -421,23 +688,25 @@ struct jit_reg_allocator * jit_reg_allocator_create()
 	a->gp_regs[8] = (jit_hw_reg) { AMD64_R10, "r10", 0, 0, 9 };
 	a->gp_regs[9] = (jit_hw_reg) { AMD64_R11, "r11", 0, 0, 10 };
 	a->gp_regs[10] = (jit_hw_reg) { AMD64_R12, "r12", 1, 0, 11 };
-	a->gp_regs[11] = (jit_hw_reg) { AMD64_R14, "r14", 1, 0, 13 };
-	a->gp_regs[12] = (jit_hw_reg) { AMD64_R15, "r15", 1, 0, 14 };
-	// R13 has some addressing limitations, therefore it is not used as GPR
-	// since it may lead to unexpected behavior
-//	a->gp_regs[13] = (jit_hw_reg) { AMD64_R13, 0, "r13", 1, 0, 12 };
-
+	a->gp_regs[11] = (jit_hw_reg) { AMD64_R13, "r13", 1, 0, 12 };
+	a->gp_regs[12] = (jit_hw_reg) { AMD64_R14, "r14", 1, 0, 13 };
+	a->gp_regs[13] = (jit_hw_reg) { AMD64_R15, "r15", 1, 0, 14 };
+	// RBP is allocatable only in functions which do not use R_FP (see jit_free_frame_reg)
+	a->gp_regs[14] = (jit_hw_reg) { AMD64_RBP, "rbp", 1, 0, 15 };
+	// R13 and RBP cannot be encoded as a base register without
+	// displacement, codegen emits a zero 8-bit displacement instead
 
 	a->gp_arg_reg_cnt = 6;
 
 	a->fp_reg = AMD64_RBP;
 	a->ret_reg = &(a->gp_regs[0]);
 
-	a->fp_reg_cnt = 10;
+	a->fp_reg_cnt = 16;
 
 	int reg = 0;
 	a->fp_regs = JIT_MALLOC(sizeof(jit_hw_reg) * a->fp_reg_cnt);
 
+	// XMM0-XMM7 are used for arguments, hence they are the last choice
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM0, "xmm0", 0, 1, 99 };
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM1, "xmm1", 0, 1, 98 };
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM2, "xmm2", 0, 1, 97 };
@@ -446,29 +715,28 @@ struct jit_reg_allocator * jit_reg_allocator_create()
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM5, "xmm5", 0, 1, 94 };
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM6, "xmm6", 0, 1, 93 };
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM7, "xmm7", 0, 1, 92 };
-	//a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM11, "xmm11", 0, 1, 3 };
-	//a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM10, "xmm10", 0, 1, 4 };
-	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM13, "xmm13", 0, 1, 1 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM8, "xmm8", 0, 1, 8 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM9, "xmm9", 0, 1, 7 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM10, "xmm10", 0, 1, 6 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM11, "xmm11", 0, 1, 5 };
 	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM12, "xmm12", 0, 1, 2 };
-	/*
-#ifndef JIT_REGISTER_TEST
-	a->fp_regs[reg++] = (jit_hw_reg) { X86_XMM4, "xmm4", 0, 1, 5 };
-	a->fp_regs[reg++] = (jit_hw_reg) { X86_XMM5, "xmm5", 0, 1, 6 };
-	a->fp_regs[reg++] = (jit_hw_reg) { X86_XMM6, "xmm6", 0, 1, 7 };
-	a->fp_regs[reg++] = (jit_hw_reg) { X86_XMM7, "xmm7", 0, 1, 8 };
-#endif
-*/
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM13, "xmm13", 0, 1, 1 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM14, "xmm14", 0, 1, 4 };
+	a->fp_regs[reg++] = (jit_hw_reg) { AMD64_XMM15, "xmm15", 0, 1, 3 };
 
 	a->fpret_reg = &(a->fp_regs[0]);
 
+	// R10 and R11 are used only by the private calling convention
 	a->gp_arg_reg_cnt = 6;
-	a->gp_arg_regs = JIT_MALLOC(sizeof(jit_hw_reg *) * 6);
+	a->gp_arg_regs = JIT_MALLOC(sizeof(jit_hw_reg *) * JIT_PRIVATE_GP_ARG_REG_CNT);
 	a->gp_arg_regs[0] = &(a->gp_regs[5]);
 	a->gp_arg_regs[1] = &(a->gp_regs[4]);
 	a->gp_arg_regs[2] = &(a->gp_regs[3]);
 	a->gp_arg_regs[3] = &(a->gp_regs[2]);
 	a->gp_arg_regs[4] = &(a->gp_regs[6]);
 	a->gp_arg_regs[5] = &(a->gp_regs[7]);
+	a->gp_arg_regs[6] = &(a->gp_regs[8]);
+	a->gp_arg_regs[7] = &(a->gp_regs[9]);
 
 	a->fp_arg_reg_cnt = 8;
 	a->fp_arg_regs = JIT_MALLOC(sizeof(jit_hw_reg *) * 8);
@@ -0,0 +1,199 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Block layout driven by branch probabilities.
+ *
+ * Code which is unlikely to be executed is moved behind the last operation
+ * of the function, hence, the likely path falls through and the hot code is
+ * not interleaved with the cold one:
+ *	bne(L1, ..., ...);	// likely taken
+ *	cold code
+ *	L1:
+ *	...
+ *	ret
+ *	==>
+ *	beq(L2, ..., ...);
+ *	L1:
+ *	...
+ *	ret
+ *	L2:
+ *	cold code
+ *	jmp L1
+ * The target of an unlikely branch which is preceded by an unconditional jump,
+ * e.g., the else branch of a diamond, is moved likewise. Blocks are moved after
+ * the register allocation, thus, register mappings at their boundaries are
+ * kept intact.
+ */
+
+static int blk_inside(jit_op * op, jit_op * end)
+{
+	return (op != end) && jmpthr_precedes(op, end);
+}
+
+/**
+ * Returns 1 if the operations from `first' up to `end' (exclusive) can be
+ * moved, i.e., they cannot be entered from outside except through `first'
+ */
+static int blk_movable(jit_op * first, jit_op * end)
+{
+	if (first == end) return 0;
+	for (jit_op * op = first; op != end; op = op->next) {
+		switch (GET_OP(op)) {
+			case JIT_PROLOG: case JIT_LABEL: case JIT_PATCH: case JIT_CODE_ALIGN: case JIT_REF_CODE: case JIT_REF_DATA:
+			case JIT_DATA_BYTE: case JIT_DATA_BYTES: case JIT_DATA_REF_CODE: case JIT_DATA_REF_DATA:
+				return 0;
+			default: break;
+		}
+		// forward jumps leaving the block have to become backward jumps
+		jit_op * target = op->jmp_addr;
+		if (!target || (GET_OP(target) != JIT_PATCH) || blk_inside(target, end)) continue;
+		if ((op->code != (JIT_JMP | IMM)) && !is_cond_branch_op(op)) return 0;
+		if ((jit_op *) target->arg[0] != op) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Creates a label at the position of the given operation
+ */
+static jit_op * blk_new_label(struct jit * jit, jit_op * pos)
+{
+	jit_label * label = JIT_MALLOC(sizeof(jit_label));
+	label->next = jit->labels;
+	jit->labels = label;
+
+	jit_op * op = jit_op_new(JIT_LABEL, SPEC(IMM, NO, NO), (jit_value) label, 0, 0, 0);
+	op->r_arg[0] = op->arg[0];
+	if (pos->regmap) op->regmap = rmap_clone(pos->regmap);
+	label->op = op;
+	jit_op_prepend(pos, op);
+	return op;
+}
+
+static int blk_falls_through(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_JMP: case JIT_RET: case JIT_FRET: return 0;
+		default: return 1;
+	}
+}
+
+/**
+ * Moves the operations from `first' up to `end' (exclusive) behind
+ * the operation `last'; the moved code continues at `end'
+ */
+static void blk_move(struct jit * jit, jit_op * first, jit_op * end, jit_op * last)
+{
+	for (jit_op * op = first; op != end; op = op->next) {
+		jit_op * target = op->jmp_addr;
+		if (!target || (GET_OP(target) != JIT_PATCH) || blk_inside(target, end)) continue;
+		jit_op * label = blk_new_label(jit, target);
+		jit_op_delete(target);
+		op->arg[0] = label->arg[0];
+		op->r_arg[0] = label->arg[0];
+		op->jmp_addr = label;
+	}
+
+	jit_op * cont = NULL;
+	if (blk_falls_through(end->prev)) {
+		cont = blk_new_label(jit, end);
+		end = cont;
+	}
+	jit_op * block_end = end->prev;
+
+	first->prev->next = end;
+	end->prev = first->prev;
+	block_end->next = last->next;
+	if (last->next) last->next->prev = block_end;
+	last->next = first;
+	first->prev = last;
+
+	if (cont) {
+		jit_op * jmp = jit_op_new(JIT_JMP | IMM, SPEC(IMM, NO, NO), cont->arg[0], 0, 0, 0);
+		jmp->r_arg[0] = jmp->arg[0];
+		jmp->jmp_addr = cont;
+		if (block_end->regmap) jmp->regmap = rmap_clone(block_end->regmap);
+		jit_op_append(block_end, jmp);
+	}
+}
+
+/**
+ * Moves code which follows a likely taken branch; the branch is negated
+ */
+static int blk_move_fallthrough(struct jit * jit, jit_op * op)
+{
+	jit_op * target = op->jmp_addr;
+	if (op->fp || (GET_OP(target) != JIT_PATCH) || ((jit_op *) target->arg[0] != op)) return 0;
+
+	jit_op * last = function_last_op(op);
+	if (blk_falls_through(last) || !blk_movable(op->next, target)) return 0;
+
+	jit_op * first = op->next;
+	blk_move(jit, first, target, last);
+
+	jit_op * patch = jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) op, 0, 0, 0);
+	patch->r_arg[0] = patch->arg[0];
+	jit_op_prepend(first, patch);
+	jit_op_delete(target);
+
+	jit_negate_branch(op);
+	op->arg[0] = (jit_value) patch;
+	op->r_arg[0] = (jit_value) patch;
+	op->jmp_addr = patch;
+	return 1;
+}
+
+/**
+ * Moves code which is the target of an unlikely taken branch and which
+ * cannot be reached by falling through
+ */
+static int blk_move_target(struct jit * jit, jit_op * op)
+{
+	jit_op * target = op->jmp_addr;
+	if ((GET_OP(target) != JIT_PATCH) || ((jit_op *) target->arg[0] != op)) return 0;
+
+	jit_op * jmp = target->prev;
+	if ((jmp->code != (JIT_JMP | IMM)) || !jmp->jmp_addr || !blk_inside(target, jmp->jmp_addr)) return 0;
+
+	// the patch is the only entry of the block
+	jit_op * last = function_last_op(op);
+	if (blk_falls_through(last) || !blk_movable(target->next, jmp->jmp_addr)) return 0;
+
+	blk_move(jit, target, jmp->jmp_addr, last);
+	return 1;
+}
+
+/**
+ * Moves blocks which are unlikely to be executed behind the code of
+ * the function; returns the number of moved blocks
+ */
+static int jit_place_blocks(struct jit * jit)
+{
+	int moved = 0;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (!is_cond_branch_op(op) || !op->jmp_addr || (op->probability < 0)) continue;
+		if (!jmpthr_precedes(op, op->jmp_addr)) continue;
+
+		if (op->probability >= JIT_PROB_LIKELY) moved += blk_move_fallthrough(jit, op);
+		else if (op->probability <= JIT_PROB_UNLIKELY) moved += blk_move_target(jit, op);
+	}
+	jit->stats[JIT_STAT_COLD_BLOCKS] += moved;
+	return moved;
+}
@@ -209,6 +209,14 @@ static int check_register_types(struct jit *jit, jit_op *op, char *msg_buf)
 		case JIT_FLOOR:
 			if (CHECK_ARG_TYPE(op, 1, JIT_RTYPE_INT) && CHECK_ARG_TYPE(op, 2, JIT_RTYPE_FLOAT)) return 0;
 			break;
+		case JIT_FLT: case JIT_FLE: case JIT_FGT:
+		case JIT_FGE: case JIT_FEQ: case JIT_FNE:
+			if (CHECK_ARG_TYPE(op, 1, JIT_RTYPE_INT) && CHECK_ARG_TYPE(op, 2, JIT_RTYPE_FLOAT) && CHECK_ARG_TYPE(op, 3, JIT_RTYPE_FLOAT)) return 0;
+			break;
+		case JIT_FMOVN:
+		case JIT_FMOVZ:
+			if (CHECK_ARG_TYPE(op, 1, JIT_RTYPE_FLOAT) && CHECK_ARG_TYPE(op, 2, JIT_RTYPE_FLOAT) && CHECK_ARG_TYPE(op, 3, JIT_RTYPE_INT)) return 0;
+			break;
 		case JIT_EXT:
 		case JIT_FLD:
 			if (CHECK_ARG_TYPE(op, 1, JIT_RTYPE_FLOAT) && CHECK_ARG_TYPE(op, 2, JIT_RTYPE_INT)) return 0;
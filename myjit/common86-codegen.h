@@ -60,6 +60,7 @@
 
 #define common86_alu_reg_reg(ptr, op, reg1, reg2) 	x86_alu_reg_reg(ptr, op, reg1, reg2)
 #define common86_alu_reg_imm(ptr, op, reg, imm) 	x86_alu_reg_imm(ptr, op, reg, imm)
+#define common86_clear_reg(ptr, reg) 			x86_alu_reg_reg(ptr, X86_XOR, reg, reg)
 #define common86_alu_reg_membase(ptr, op, reg, basereg, disp) 	x86_alu_reg_membase(ptr, op, reg, basereg, disp)
 #define common86_alu_reg_memindex(ptr, op, reg, basereg, disp, indexreg, shift) 	x86_alu_reg_memindex(ptr, op, reg, basereg, disp, indexreg, shift)
 
@@ -71,11 +72,14 @@
 #define common86_cdq(ptr) 				x86_cdq(ptr)
 #define common86_neg_reg(ptr, reg) 			x86_neg_reg(ptr, reg)
 #define common86_not_reg(ptr, reg) 			x86_not_reg(ptr, reg)
+#define common86_inc_reg(ptr, reg) 			x86_inc_reg(ptr, reg)
+#define common86_dec_reg(ptr, reg) 			x86_dec_reg(ptr, reg)
 
 
 #define common86_set_reg(ptr, cond, reg, size) 		x86_set_reg(ptr, cond, reg, size)
 #define common86_test_reg_reg(ptr, reg1, reg2) 		x86_test_reg_reg(ptr, reg1, reg2)
 #define common86_test_reg_imm(ptr, reg, imm) 		x86_test_reg_imm(ptr, reg, imm)
+#define common86_cmov_reg(ptr, cond, sign, dreg, reg)	x86_cmov_reg(ptr, cond, sign, dreg, reg)
 #define common86_branch_disp32(ptr, cond, addr, sign)	x86_branch_disp32(ptr, cond, addr, sign)
 #define common86_branch_disp(ptr, cond, addr, sign)	x86_branch_disp(ptr, cond, addr, sign)
 
@@ -127,7 +131,7 @@
 #define common86_movsx_reg_reg(ptr, reg1, reg2, size) 	amd64_movsx_reg_reg(ptr, reg1, reg2, size)
 #define common86_movzx_reg_reg(ptr, reg1, reg2, size) 	amd64_movzx_reg_reg(ptr, reg1, reg2, size)
 #define common86_mov_reg_imm_size(ptr, reg, imm, size)	amd64_mov_reg_imm_size(ptr, reg, imm, size)
-#define common86_mov_reg_imm(ptr, reg, imm)	amd64_mov_reg_imm_size(ptr, reg, imm, sizeof(void *))
+#define common86_mov_reg_imm(ptr, reg, imm)	amd64_mov_reg_imm(ptr, reg, imm)
 #define common86_mov_reg_mem(ptr, reg, mem, size) 	amd64_mov_reg_mem(ptr, reg, mem, size)
 #define common86_movsx_reg_mem(ptr, reg, mem, size) 	amd64_movsx_reg_mem(ptr, reg, mem, size)
 #define common86_movzx_reg_mem(ptr, reg, mem, size) 	amd64_movzx_reg_mem(ptr, reg, mem, size)
@@ -151,7 +155,10 @@
 #define common86_xchg_reg_reg(ptr, reg1, reg2, size) 	amd64_xchg_reg_reg(ptr, reg1, reg2, size)
 
 #define common86_alu_reg_reg(ptr, op, reg1, reg2) 	amd64_alu_reg_reg(ptr, op, reg1, reg2)
-#define common86_alu_reg_imm(ptr, op, reg, imm) 	amd64_alu_reg_imm(ptr, op, reg, imm)
+// AND with a non-negative immediate clears the upper half anyway, the 32-bit form does not need REX.W
+#define common86_alu_reg_imm(ptr, op, reg, imm) 	amd64_alu_reg_imm_size(ptr, op, reg, imm, (((op) == X86_AND) && ((jit_value)(imm) >= 0)) ? 4 : 8)
+// writes to 32-bit registers are zero-extended
+#define common86_clear_reg(ptr, reg) 			amd64_alu_reg_reg_size(ptr, X86_XOR, reg, reg, 4)
 #define common86_alu_reg_membase(ptr, op, reg, basereg, disp) 	amd64_alu_reg_membase(ptr, op, reg, basereg, disp)
 #define common86_alu_reg_memindex(ptr, op, reg, basereg, disp, indexreg, shift) 	amd64_alu_reg_memindex(ptr, op, reg, basereg, disp, indexreg, shift)
 
@@ -163,11 +170,14 @@
 #define common86_cdq(ptr) 				amd64_cdq(ptr)
 #define common86_neg_reg(ptr, reg) 			amd64_neg_reg(ptr, reg)
 #define common86_not_reg(ptr, reg) 			amd64_not_reg(ptr, reg)
+#define common86_inc_reg(ptr, reg) 			amd64_inc_reg(ptr, reg)
+#define common86_dec_reg(ptr, reg) 			amd64_dec_reg(ptr, reg)
 
 
 #define common86_set_reg(ptr, cond, reg, size) 		amd64_set_reg(ptr, cond, reg, size)
 #define common86_test_reg_reg(ptr, reg1, reg2) 		amd64_test_reg_reg(ptr, reg1, reg2)
-#define common86_test_reg_imm(ptr, reg, imm) 		amd64_test_reg_imm(ptr, reg, imm)
+#define common86_test_reg_imm(ptr, reg, imm) 		amd64_test_reg_imm_size(ptr, reg, imm, ((jit_value)(imm) >= 0) ? 4 : 8)
+#define common86_cmov_reg(ptr, cond, sign, dreg, reg)	amd64_cmov_reg(ptr, cond, sign, dreg, reg)
 #define common86_branch_disp32(ptr, cond, addr, sign)	amd64_branch_disp32(ptr, cond, addr, sign)
 #define common86_branch_disp(ptr, cond, addr, sign)	amd64_branch_disp(ptr, cond, addr, sign)
 
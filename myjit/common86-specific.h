@@ -27,6 +27,7 @@ static int emit_pop_callee_saved_regs(struct jit * jit);
 static int emit_pop_caller_saved_regs(struct jit * jit, jit_op * op);
 static void emit_save_all_regs(struct jit *jit, jit_op *op);
 static void emit_restore_all_regs(struct jit *jit, jit_op *op);
+static int call_clobbers_reg(struct jit * jit, jit_op * op, jit_hw_reg * hreg);
 
 
 static jit_hw_reg * rmap_is_associated(jit_rmap * rmap, int reg_id, int fp, jit_value * virt_reg);
@@ -36,6 +37,17 @@ static jit_hw_reg * rmap_get(jit_rmap * rmap, jit_value reg);
 #define JIT_GET_ADDR(jit, imm) (!jit_is_label(jit, (void *)(imm)) ? (imm) :  \
 		(((jit_value)jit->buf + ((jit_label *)(imm))->pos - (jit_value)jit->ip)))
 
+/**
+ * Emits a conditional jump to the target; labels always lie behind the jump,
+ * hence, the short form is used if they are close enough. Other jumps are
+ * patched later and keep the 32-bit displacement.
+ */
+static void emit_jcc(struct jit * jit, int cond, jit_value target, int sign)
+{
+	if (jit_is_label(jit, (void *)target)) common86_branch_disp(jit->ip, cond, JIT_GET_ADDR(jit, target), sign);
+	else common86_branch_disp32(jit->ip, cond, target, sign);
+}
+
 #include "sse2-specific.h"
 
 #ifdef JIT_ARCH_I386
@@ -84,13 +96,14 @@ static int emit_pop_reg(struct jit * jit, jit_hw_reg * r, int stack_offset)
 
 static int emit_push_callee_saved_regs(struct jit * jit, jit_op * op)
 {
+	struct jit_func_info * info = jit_current_func_info(jit);
 	int stack_offset = 0;
 	for (int i = 0; i < jit->reg_al->gp_reg_cnt; i++) {
 		jit_hw_reg * r = &(jit->reg_al->gp_regs[i]);
 		if (r->callee_saved)
 			for (struct jit_op * o = op->next; o != NULL; o = o->next) {
 				if (GET_OP(o) == JIT_PROLOG) break;
-				if (uses_hw_reg(o, r->id, 0)) {
+				if (uses_saved_reg(jit, info, o, r)) {
 					stack_offset = emit_push_reg(jit, r, stack_offset);
 					break;
 				}
@@ -105,6 +118,7 @@ static int emit_pop_callee_saved_regs(struct jit * jit)
 {
 	int count = 0;
 	struct jit_op * op = jit->current_func;
+	struct jit_func_info * info = jit_current_func_info(jit);
 	jit_hw_reg *active_regs[32];
 
 	for (int i = jit->reg_al->gp_reg_cnt - 1; i >= 0; i--) {
@@ -112,7 +126,7 @@ static int emit_pop_callee_saved_regs(struct jit * jit)
 		if (r->callee_saved)
 			for (struct jit_op * o = op->next; o != NULL; o = o->next) {
 				if (GET_OP(o) == JIT_PROLOG) break;
-				if (uses_hw_reg(o, r->id, 0)) {
+				if (uses_saved_reg(jit, info, o, r)) {
 					active_regs[count] = r;
 					count++;
 					break;
@@ -138,6 +152,10 @@ static int generic_push_caller_saved_regs(struct jit * jit, jit_op * op, int reg
 		if ((regs[i].id == skip_reg_id) || (regs[i].callee_saved)) continue;
 		jit_hw_reg * hreg = rmap_is_associated(op->regmap, regs[i].id, fp, &reg);
 		if (hreg && jit_set_get(op->live_in, reg)) {
+			if (!call_clobbers_reg(jit, op, hreg)) {
+				jit->stats[JIT_STAT_AVOIDED_SAVES]++;
+				continue;
+			}
 			stack_offset = emit_push_reg(jit, hreg, stack_offset);
 		}
 	}
@@ -167,7 +185,7 @@ static int generic_pop_caller_saved_regs(struct jit * jit, jit_op * op, int reg_
 	for (int i = reg_count - 1; i >= 0; i--) {
 		if ((regs[i].id == skip_reg_id) || (regs[i].callee_saved)) continue;
 		jit_hw_reg * hreg = rmap_is_associated(op->regmap, regs[i].id, fp, &reg);
-		if (hreg && jit_set_get(op->live_in, reg)) {
+		if (hreg && jit_set_get(op->live_in, reg) && call_clobbers_reg(jit, op, hreg)) {
 			stack_offset = emit_pop_reg(jit, hreg, stack_offset);
 		}
 	}
@@ -284,10 +302,18 @@ static void emit_restore_all_regs(struct jit *jit, jit_op *op)
  */
 static void emit_lreg(struct jit * jit, int hreg_id, jit_value vreg)
 {
-	int stack_pos = GET_REG_POS(jit, vreg) ;
+#ifdef JIT_ARCH_AMD64
+	int spill_reg = GET_GPREG_SPILL_REG(jit, vreg);
+	if (spill_reg >= 0) {
+		amd64_movd_reg_xreg_size(jit->ip, hreg_id, spill_reg, REG_SIZE);
+		return;
+	}
+#endif
+	int stack_pos = GET_FRAME_POS(jit, GET_REG_POS(jit, vreg));
+	int frame_reg = GET_FRAME_REG(jit);
 
-	if (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT) sse_movlpd_xreg_membase(jit->ip, hreg_id, COMMON86_BP, stack_pos);
-	else common86_mov_reg_membase(jit->ip, hreg_id, COMMON86_BP, stack_pos, REG_SIZE);
+	if (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT) sse_movlpd_xreg_membase(jit->ip, hreg_id, frame_reg, stack_pos);
+	else common86_mov_reg_membase(jit->ip, hreg_id, frame_reg, stack_pos, REG_SIZE);
 }
 
 /**
@@ -298,10 +324,18 @@ static void emit_lreg(struct jit * jit, int hreg_id, jit_value vreg)
  */
 static void emit_ureg(struct jit * jit, jit_value vreg, int hreg_id)
 {
-	int stack_pos = GET_REG_POS(jit, vreg);
+#ifdef JIT_ARCH_AMD64
+	int spill_reg = GET_GPREG_SPILL_REG(jit, vreg);
+	if (spill_reg >= 0) {
+		amd64_movd_xreg_reg_size(jit->ip, spill_reg, hreg_id, REG_SIZE);
+		return;
+	}
+#endif
+	int stack_pos = GET_FRAME_POS(jit, GET_REG_POS(jit, vreg));
+	int frame_reg = GET_FRAME_REG(jit);
 
-	if (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT) sse_movlpd_membase_xreg(jit->ip, hreg_id, COMMON86_BP, stack_pos);
-	else common86_mov_membase_reg(jit->ip, COMMON86_BP, stack_pos, hreg_id, REG_SIZE);
+	if (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT) sse_movlpd_membase_xreg(jit->ip, hreg_id, frame_reg, stack_pos);
+	else common86_mov_membase_reg(jit->ip, frame_reg, stack_pos, hreg_id, REG_SIZE);
 }
 
 static void emit_get_arg_from_stack(struct jit * jit, int type, int size, int dreg, int stack_reg, int stack_pos)
@@ -360,7 +394,7 @@ static void emit_get_arg(struct jit * jit, jit_op * op)
 	}
 
 	if (read_from_stack) {
-		emit_get_arg_from_stack(jit, type, size, dreg, COMMON86_BP, stack_pos);
+		emit_get_arg_from_stack(jit, type, size, dreg, GET_FRAME_REG(jit), GET_FRAME_POS(jit, stack_pos));
 		return;
 	}
 
@@ -472,6 +506,92 @@ static void emit_rsb_op(struct jit * jit, struct jit_op * op, int imm)
 	}
 }
 
+//
+//
+// Register constraints
+//
+//
+
+/**
+ * Returns 1 if the operation is emitted as MUL or DIV instruction,
+ * i.e., it uses the EDX:EAX pair
+ */
+static int uses_ax_dx_pair(jit_op * op)
+{
+	jit_value imm = op->arg[2];
+	switch (GET_OP(op)) {
+		case JIT_MUL:
+			if (!IS_IMM(op)) return 1;
+			return !((imm == 2) || (imm == 3) || (imm == 4) || (imm == 5) || (imm == 8) || (imm == 9));
+		case JIT_HMUL: return 1;
+		case JIT_DIV:
+			if (!IS_IMM(op)) return 1;
+			return !((imm == 2) || (imm == 4) || (imm == 8));
+		case JIT_MOD:
+			if (!IS_IMM(op) || IS_SIGNED(op)) return 1;
+			return !((imm == 2) || (imm == 4) || (imm == 8));
+		default: return 0;
+	}
+}
+
+static int is_variable_shift(jit_op * op)
+{
+	return ((GET_OP(op) == JIT_LSH) || (GET_OP(op) == JIT_RSH)) && !IS_IMM(op);
+}
+
+/**
+ * Returns a mask of hardware registers which are overwritten by the code
+ * of the operation, besides its destination register
+ */
+static int jit_clobbered_regs(jit_op * op)
+{
+	if (uses_ax_dx_pair(op)) return (1 << COMMON86_AX) | (1 << COMMON86_DX);
+	if (is_variable_shift(op)) return (1 << COMMON86_CX);
+	return 0;
+}
+
+/**
+ * Returns a hardware register which suits best the virtual register
+ * used by the operation, or -1 if there is no such register
+ */
+static int jit_preferred_reg(struct jit_reg_allocator * al, jit_op * op, jit_value reg)
+{
+	// arguments of functions with the private calling convention
+	// are computed directly in registers used to pass them
+	if (GET_OP(op) == JIT_PUTARG) {
+		struct jit_func_info * callee = called_func_info(prepared_call(op));
+		int pos = putarg_gp_pos(op);
+		if (callee && callee->private_conv && (pos < jit_gp_arg_reg_cnt(al, callee))) return al->gp_arg_regs[pos]->id;
+	}
+	if (uses_ax_dx_pair(op)) {
+		if (reg == op->arg[0]) return ((GET_OP(op) == JIT_MOD) || (GET_OP(op) == JIT_HMUL)) ? COMMON86_DX : COMMON86_AX;
+		if (reg == op->arg[1]) return COMMON86_AX;
+	}
+	if (is_variable_shift(op) && (reg == op->arg[2])) return COMMON86_CX;
+	return -1;
+}
+
+/**
+ * Returns a mask of hardware registers which should not be associated with
+ * the virtual register used by the operation. Otherwise, the code generator
+ * has to save them on the stack.
+ */
+static int jit_avoided_regs(jit_op * op, jit_value reg)
+{
+#ifdef JIT_ARCH_I386
+	// SETcc cannot store its result into ESI or EDI
+	jit_opcode code = GET_OP(op);
+	if ((reg == op->arg[0]) && (code >= JIT_LT) && (code <= JIT_NE))
+		return (1 << COMMON86_SI) | (1 << COMMON86_DI);
+#endif
+	int clobbered = jit_clobbered_regs(op);
+	if (!clobbered) return 0;
+	if (is_variable_shift(op)) return (reg == op->arg[2]) ? 0 : clobbered;
+	if (reg == op->arg[0]) return 0;
+	if (!IS_IMM(op) && (reg == op->arg[2]) && (GET_OP(op) != JIT_MUL) && (GET_OP(op) != JIT_HMUL)) return clobbered;
+	return jit_set_get(op->live_out, reg) ? clobbered : 0;
+}
+
 /**
  * Emits operations for multiplications
  *
@@ -486,8 +606,8 @@ static void emit_rsb_op(struct jit * jit, struct jit_op * op, int imm)
  * Unfortunately, x86 assembler assumes that the result value of the MUL operation
  * is stored into the EDX:EAX pair, and therefore, if these registers are in use,
  * their value have to be saved on the stack for a while and then returned back.
- * TODO: Register allocator should be aware of this issues and should take care
- * of this.
+ * Register allocator tries to keep values which outlive the operation
+ * out of these registers (see jit_avoided_regs).
  */
 static void emit_mul_op(struct jit * jit, struct jit_op * op, int imm, int sign, int high_bytes)
 {
@@ -519,8 +639,8 @@ static void emit_mul_op(struct jit * jit, struct jit_op * op, int imm, int sign,
 
 
 	// generic multiplication
-	int ax_in_use = jit_reg_in_use(op, COMMON86_AX, 0);
-	int dx_in_use = jit_reg_in_use(op, COMMON86_DX, 0);
+	int ax_in_use = jit_reg_live_out(op, COMMON86_AX, 0);
+	int dx_in_use = jit_reg_live_out(op, COMMON86_DX, 0);
 
 	if ((dest != COMMON86_AX) && ax_in_use) common86_push_reg(jit->ip, COMMON86_AX);
 	if ((dest != COMMON86_DX) && dx_in_use) common86_push_reg(jit->ip, COMMON86_DX);
@@ -548,6 +668,20 @@ static void emit_mul_op(struct jit * jit, struct jit_op * op, int imm, int sign,
 	if ((dest != COMMON86_AX) && ax_in_use) common86_pop_reg(jit->ip, COMMON86_AX);
 }
 
+/**
+ * Returns a register which can hold the constant divisor, i.e., an unused
+ * register other than EAX and EDX. If there is no such register, EBX is returned
+ * and its value has to be saved.
+ */
+static int get_scratch_reg_for_div(struct jit * jit, jit_op * op)
+{
+	for (int i = 0; ; i++) {
+		jit_hw_reg * hreg = jit_get_unused_reg_with_index(jit->reg_al, op, 0, i);
+		if (!hreg) return COMMON86_BX;
+		if ((hreg->id != COMMON86_AX) && (hreg->id != COMMON86_DX)) return hreg->id;
+	}
+}
+
 /**
  * Emits operations for multiplications
  *
@@ -561,8 +695,8 @@ static void emit_mul_op(struct jit * jit, struct jit_op * op, int imm, int sign,
  * Unfortunately, x86 assembler assumes that the dividend of the DIV operation
  * is stored into the EDX:EAX pair, and therefore, if these registers are in use,
  * their value have to be saved on the stack for a while and then returned back.
- * TODO: Register allocator should be aware of this issues and should take care
- * of this.
+ * Register allocator tries to keep values which outlive the operation
+ * out of these registers (see jit_avoided_regs).
  */
 
 static void emit_div_op(struct jit * jit, struct jit_op * op, int imm, int sign, int modulo)
@@ -591,8 +725,8 @@ static void emit_div_op(struct jit * jit, struct jit_op * op, int imm, int sign,
 		}
 	}
 
-	int ax_in_use = jit_reg_in_use(op, COMMON86_AX, 0);
-	int dx_in_use = jit_reg_in_use(op, COMMON86_DX, 0);
+	int ax_in_use = jit_reg_live_out(op, COMMON86_AX, 0);
+	int dx_in_use = jit_reg_live_out(op, COMMON86_DX, 0);
 
 	if ((dest != COMMON86_AX) && ax_in_use) common86_push_reg(jit->ip, COMMON86_AX);
 	if ((dest != COMMON86_DX) && dx_in_use) common86_push_reg(jit->ip, COMMON86_DX);
@@ -600,11 +734,13 @@ static void emit_div_op(struct jit * jit, struct jit_op * op, int imm, int sign,
 	if (imm) {
 		if (dividend != COMMON86_AX) common86_mov_reg_reg(jit->ip, COMMON86_AX, dividend, REG_SIZE);
 		if (sign) common86_cdq(jit->ip);
-		else common86_alu_reg_reg(jit->ip, X86_XOR, COMMON86_DX, COMMON86_DX);
-		if (dest != COMMON86_BX) common86_push_reg(jit->ip, COMMON86_BX);
-		common86_mov_reg_imm_size(jit->ip, COMMON86_BX, divisor, REG_SIZE);
-		common86_div_reg(jit->ip, COMMON86_BX, sign);
-		if (dest != COMMON86_BX) common86_pop_reg(jit->ip, COMMON86_BX);
+		else common86_clear_reg(jit->ip, COMMON86_DX);
+		int tmpreg = get_scratch_reg_for_div(jit, op);
+		int tmp_saved = (tmpreg == COMMON86_BX) && (dest != COMMON86_BX);
+		if (tmp_saved) common86_push_reg(jit->ip, COMMON86_BX);
+		common86_mov_reg_imm(jit->ip, tmpreg, divisor);
+		common86_div_reg(jit->ip, tmpreg, sign);
+		if (tmp_saved) common86_pop_reg(jit->ip, COMMON86_BX);
 	} else {
 		if ((divisor == COMMON86_AX) || (divisor == COMMON86_DX)) {
 			common86_push_reg(jit->ip, divisor);
@@ -613,7 +749,7 @@ static void emit_div_op(struct jit * jit, struct jit_op * op, int imm, int sign,
 		if (dividend != COMMON86_AX) common86_mov_reg_reg(jit->ip, COMMON86_AX, dividend, REG_SIZE);
 
 		if (sign) common86_cdq(jit->ip);
-		else common86_alu_reg_reg(jit->ip, X86_XOR, COMMON86_DX, COMMON86_DX);
+		else common86_clear_reg(jit->ip, COMMON86_DX);
 
 		if ((divisor == COMMON86_AX) || (divisor == COMMON86_DX)) {
 			common86_div_membase(jit->ip, COMMON86_SP, 0, sign);
@@ -650,12 +786,12 @@ static void emit_shift_op(struct jit * jit, struct jit_op * op, int shift_op, in
 
 		if (destreg != COMMON86_CX) {
 
-			int cx_in_use = jit_reg_in_use(op, COMMON86_CX, 0);
+			int cx_in_use = jit_reg_live_out(op, COMMON86_CX, 0) || (valreg == COMMON86_CX);
 
 			if (cx_in_use && (shiftreg != COMMON86_CX)) common86_push_reg(jit->ip, COMMON86_CX);
 			if (shiftreg != COMMON86_CX) common86_mov_reg_reg(jit->ip, COMMON86_CX, shiftreg, REG_SIZE);
 			if (destreg != valreg) {
-				if (valreg != COMMON86_CX) common86_mov_reg_reg(jit->ip, destreg, valreg, REG_SIZE);
+				if ((valreg != COMMON86_CX) || (shiftreg == COMMON86_CX)) common86_mov_reg_reg(jit->ip, destreg, valreg, REG_SIZE);
 				else common86_mov_reg_membase(jit->ip, destreg, COMMON86_SP, 0, REG_SIZE);
 			}
 			common86_shift_reg(jit->ip, shift_op, destreg);
@@ -664,6 +800,8 @@ static void emit_shift_op(struct jit * jit, struct jit_op * op, int shift_op, in
 			// ECX is the destination register
 			jit_hw_reg * tmp = jit_get_unused_reg(jit->reg_al, op, 0);
 			int tmpreg = (tmp ? tmp->id : COMMON86_AX);
+			// the shift count has to be moved to ECX before the value overwrites it
+			if (tmpreg == shiftreg) tmpreg = (shiftreg == COMMON86_AX) ? COMMON86_DX : COMMON86_AX;
 
 			int tmp_in_use = jit_reg_in_use(op, tmpreg, 0);
 
@@ -679,29 +817,294 @@ static void emit_shift_op(struct jit * jit, struct jit_op * op, int shift_op, in
 	}
 }
 
-static void emit_cond_op(struct jit * jit, struct jit_op * op, int amd64_cond, int imm, int sign)
+/**
+ * Returns the conditional move following the comparison if the move is the only
+ * user of the comparison's result. In such a case, the comparison emits only CMP
+ * and the conditional move uses its flags directly.
+ */
+static jit_op * fused_cond_move(jit_op * op)
+{
+	jit_op * next = op->next;
+	if ((GET_OP(op) < JIT_LT) || (GET_OP(op) > JIT_NE) || !next) return NULL;
+	if ((GET_OP(next) != JIT_MOVN) && (GET_OP(next) != JIT_MOVZ)) return NULL;
+	if (next->arg[2] != op->arg[0]) return NULL;
+	if ((next->arg[0] == op->arg[0]) || (next->arg[1] == op->arg[0])) return NULL;
+	if (jit_set_get(next->live_out, op->arg[0])) return NULL;
+	return next;
+}
+
+/**
+ * Returns the floating-point conditional move following the floating-point comparison
+ * if the move is the only user of the comparison's result and an XMM register is free
+ * for the mask. In such a case, the comparison emits nothing and the conditional move
+ * emits CMPSD and a blend.
+ */
+static jit_op * fused_fp_cond_move(struct jit * jit, jit_op * op)
 {
-	if (imm) common86_alu_reg_imm(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2]);
+	jit_op * next = op->next;
+	if ((GET_OP(op) < JIT_FLT) || (GET_OP(op) > JIT_FNE) || !next) return NULL;
+	if ((GET_OP(next) != JIT_FMOVN) && (GET_OP(next) != JIT_FMOVZ)) return NULL;
+	if (next->arg[2] != op->arg[0]) return NULL;
+	if (jit_set_get(next->live_out, op->arg[0])) return NULL;
+	// registers which are not used by the comparison are not used by the move either
+	if (!jit_get_unused_reg(jit->reg_al, op, 1)) return NULL;
+	return next;
+}
+
+/**
+ * Returns the branch following the comparison if the branch only tests whether
+ * the result of the comparison is zero. In such a case, the comparison emits only
+ * CMP and the branch jumps according to its flags.
+ */
+static jit_op * fused_cond_branch(jit_op * op)
+{
+	jit_op * next = op->next;
+	if ((GET_OP(op) < JIT_LT) || (GET_OP(op) > JIT_NE) || !next) return NULL;
+	if (((GET_OP(next) != JIT_BEQ) && (GET_OP(next) != JIT_BNE)) || !IS_IMM(next)) return NULL;
+	if ((next->arg[1] != op->arg[0]) || (next->arg[2] != 0)) return NULL;
+	if (jit_set_get(next->live_out, op->arg[0])) return NULL;
+	return next;
+}
+
+/**
+ * Returns 1 if the last instruction emitted for the operation sets ZF and SF
+ * according to the value of its target register, 2 if all flags are set as
+ * if the register was compared with zero, and 0 otherwise
+ */
+static int sets_result_flags(jit_op * op)
+{
+	jit_value a1 = op->r_arg[0];
+	if (op->fp) return 0;
+	switch (GET_OP(op)) {
+		case JIT_ADD: return (a1 == op->r_arg[1]) || (a1 == op->r_arg[2]);	// otherwise, LEA is used
+		case JIT_SUB: return !IS_IMM(op) || (a1 == op->r_arg[1]);
+		case JIT_NEG: return 1;
+		case JIT_AND: case JIT_OR: case JIT_XOR: return 2;	// clear CF and OF
+		default: return 0;
+	}
+}
+
+/**
+ * If the operation compares a register with zero and the preceding operation
+ * has already set flags according to the register's value, returns a condition
+ * code which can be used without CMP; otherwise, returns -1
+ */
+static int flags_cond(jit_op * op, int cond, int sign)
+{
+	jit_op * prev = op->prev;
+	if (!IS_IMM(op) || (op->r_arg[2] != 0) || !prev || (prev->r_arg[0] != op->r_arg[1])) return -1;
+	int flags = sets_result_flags(prev);
+	if (flags == 2) return cond;
+	if (flags == 0) return -1;
+	switch (cond) {
+		case X86_CC_EQ: return X86_CC_Z;
+		case X86_CC_NE: return X86_CC_NZ;
+		case X86_CC_LT: return sign ? X86_CC_S : -1;
+		case X86_CC_GE: return sign ? X86_CC_NS : -1;
+		default: return -1;
+	}
+}
+
+/**
+ * Emits CMP of the operation's operands unless the flags are already set;
+ * returns the condition code to be used
+ */
+static int emit_cmp(struct jit * jit, jit_op * op, int cond, int sign)
+{
+	int flags_cc = flags_cond(op, cond, sign);
+	if (flags_cc != -1) return flags_cc;
+	// TEST sets the flags in the same way as the comparison with zero and it is shorter
+	if (IS_IMM(op) && (op->r_arg[2] == 0)) common86_test_reg_reg(jit->ip, op->r_arg[1], op->r_arg[1]);
+	else if (IS_IMM(op)) common86_alu_reg_imm(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2]);
+	// the second operand was folded into the comparison as a memory operand
+	else if (op->arg_size) common86_alu_reg_membase(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2], x86_mem_disp(op));
 	else common86_alu_reg_reg(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2]);
-	if ((op->r_arg[0] != COMMON86_SI) && (op->r_arg[0] != COMMON86_DI)) {
-		common86_mov_reg_imm(jit->ip, op->r_arg[0], 0);
-		common86_set_reg(jit->ip, amd64_cond, op->r_arg[0], sign);
-	} else {
-		common86_xchg_reg_reg(jit->ip, COMMON86_AX, op->r_arg[0], REG_SIZE);
+	return cond;
+}
+
+static int cond_op_cc(jit_op * op, int negate)
+{
+	switch (GET_OP(op)) {
+		case JIT_LT: return negate ? X86_CC_GE : X86_CC_LT;
+		case JIT_LE: return negate ? X86_CC_GT : X86_CC_LE;
+		case JIT_GT: return negate ? X86_CC_LE : X86_CC_GT;
+		case JIT_GE: return negate ? X86_CC_LT : X86_CC_GE;
+		case JIT_EQ: return negate ? X86_CC_NE : X86_CC_EQ;
+		case JIT_NE: return negate ? X86_CC_EQ : X86_CC_NE;
+		default: assert(0);
+	}
+}
+
+/**
+ * Returns the condition code used by the conditional move or branch fused
+ * with the comparison
+ */
+static int fused_cond_cc(jit_op * op, int negate)
+{
+	int cond = cond_op_cc(op, negate);
+	int flags_cc = flags_cond(op, cond, IS_SIGNED(op));
+	return (flags_cc != -1) ? flags_cc : cond;
+}
+
+static void emit_cond_op(struct jit * jit, struct jit_op * op, int amd64_cond, int imm, int sign)
+{
+	jit_value a1 = op->r_arg[0];
+	if (fused_cond_move(op) || fused_cond_branch(op)) {
+		emit_cmp(jit, op, amd64_cond, sign);
+		return;
+	}
+#ifdef JIT_ARCH_I386
+	// on i386, SETcc cannot access lower bytes of ESI and EDI
+	if ((a1 == COMMON86_SI) || (a1 == COMMON86_DI)) {
+		int cond = emit_cmp(jit, op, amd64_cond, sign);
+		common86_xchg_reg_reg(jit->ip, COMMON86_AX, a1, REG_SIZE);
 		common86_mov_reg_imm(jit->ip, COMMON86_AX, 0);
-		common86_set_reg(jit->ip, amd64_cond, COMMON86_AX, sign);
-		common86_xchg_reg_reg(jit->ip, COMMON86_AX, op->r_arg[0], REG_SIZE);
+		common86_set_reg(jit->ip, cond, COMMON86_AX, sign);
+		common86_xchg_reg_reg(jit->ip, COMMON86_AX, a1, REG_SIZE);
+		return;
+	}
+#endif
+	// the target register is cleared with XOR in advance, if possible,
+	// otherwise, SETcc would write only to a part of the register
+	int cleared = (flags_cond(op, amd64_cond, sign) == -1) && (a1 != op->r_arg[1]) && (imm || (a1 != op->r_arg[2]));
+	if (cleared) common86_clear_reg(jit->ip, a1);
+	int cond = emit_cmp(jit, op, amd64_cond, sign);
+	common86_set_reg(jit->ip, cond, a1, sign);
+	if (!cleared) common86_movzx_reg_reg(jit->ip, a1, a1, 1);
+}
+
+/**
+ * Emits MOVN and MOVZ operations as CMOVcc
+ *
+ * @param on_zero -- moves the value if the condition is zero
+ */
+static void emit_cond_move_op(struct jit * jit, struct jit_op * op, int on_zero)
+{
+	if (op->prev && (fused_cond_move(op->prev) == op)) {
+		common86_cmov_reg(jit->ip, fused_cond_cc(op->prev, on_zero), IS_SIGNED(op->prev), op->r_arg[0], op->r_arg[1]);
+		return;
+	}
+	common86_test_reg_reg(jit->ip, op->r_arg[2], op->r_arg[2]);
+	common86_cmov_reg(jit->ip, on_zero ? X86_CC_Z : X86_CC_NZ, 0, op->r_arg[0], op->r_arg[1]);
+}
+
+/**
+ * Emits floating-point comparison as CMPSD into a temporary XMM register whose
+ * lowest bit is moved to the target register
+ */
+static void emit_sse_cond_op(struct jit * jit, struct jit_op * op)
+{
+	if (fused_fp_cond_move(jit, op)) return;
+
+	jit_hw_reg * tmp = jit_get_unused_reg(jit->reg_al, op, 1);
+	int tmpreg = (tmp ? tmp->id : COMMON86_XMM0);
+	while ((tmpreg == op->r_arg[1]) || (tmpreg == op->r_arg[2])) tmpreg++;
+
+	// keeps the value of the temporary register in its upper half
+	if (!tmp) sse_alu_pd_reg_reg_imm(jit->ip, X86_SSE_SHUF, tmpreg, tmpreg, 0);
+	emit_sse_cmp_mask(jit, op, tmpreg, 0);
+	sse_movd_reg_xreg(jit->ip, op->r_arg[0], tmpreg);
+	common86_alu_reg_imm(jit->ip, X86_AND, op->r_arg[0], 1);
+	if (!tmp) sse_alu_pd_reg_reg_imm(jit->ip, X86_SSE_SHUF, tmpreg, tmpreg, 1);
+}
+
+/**
+ * Emits FMOVN and FMOVZ operations. If the condition is computed by the preceding
+ * floating-point comparison, the move is translated into CMPSD and a blend without
+ * branches. Otherwise, MOVSD is skipped by a short branch.
+ *
+ * @param on_zero -- moves the value if the condition is zero
+ */
+static void emit_sse_cond_move_op(struct jit * jit, struct jit_op * op, int on_zero)
+{
+	jit_value a1 = op->r_arg[0];
+	jit_value a2 = op->r_arg[1];
+
+	if (op->prev && (fused_fp_cond_move(jit, op->prev) == op)) {
+		// the mask holds the condition under which the target keeps its value
+		int mask = jit_get_unused_reg(jit->reg_al, op->prev, 1)->id;
+		emit_sse_cmp_mask(jit, op->prev, mask, !on_zero);
+		if (a1 != a2) emit_sse_blend(jit, a1, a2, mask);
+		return;
 	}
+	if (a1 == a2) return;
+
+	common86_test_reg_reg(jit->ip, op->r_arg[2], op->r_arg[2]);
+	unsigned char * branch = jit->ip;
+	common86_branch_disp(jit->ip, on_zero ? X86_CC_NZ : X86_CC_Z, 0, 0);
+	sse_movsd_reg_reg(jit->ip, a1, a2);
+	common86_patch(branch, jit->ip);
+}
+
+/**
+ * Emits MIN and MAX operations as MOV, CMP, and CMOVcc
+ *
+ * @param cond -- condition under which the target register is replaced
+ * with the other operand
+ */
+static void emit_minmax_op(struct jit * jit, struct jit_op * op, int cond, int imm, int sign)
+{
+	jit_value a1 = op->r_arg[0];
+	jit_value a2 = op->r_arg[1];
+	jit_value a3 = op->r_arg[2];
+
+	if (!imm && (a1 == a3)) a3 = a2;
+	else if (a1 != a2) {
+		if (imm) {
+			common86_mov_reg_imm(jit->ip, a1, a3);
+			a3 = a2;
+		} else common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE);
+	} else if (imm) {
+		// the immediate value has to be placed into a temporary register
+		jit_hw_reg * tmp = jit_get_unused_reg(jit->reg_al, op, 0);
+		int tmpreg = (tmp ? tmp->id : (a1 == COMMON86_AX ? COMMON86_DX : COMMON86_AX));
+		if (!tmp) common86_push_reg(jit->ip, tmpreg);
+		common86_mov_reg_imm(jit->ip, tmpreg, a3);
+		common86_alu_reg_reg(jit->ip, X86_CMP, a1, tmpreg);
+		common86_cmov_reg(jit->ip, cond, sign, a1, tmpreg);
+		if (!tmp) common86_pop_reg(jit->ip, tmpreg);
+		return;
+	}
+	common86_alu_reg_reg(jit->ip, X86_CMP, a1, a3);
+	common86_cmov_reg(jit->ip, cond, sign, a1, a3);
+}
+
+/**
+ * Emits ABS operation as MOV, NEG, and CMOVS
+ */
+static void emit_abs_op(struct jit * jit, struct jit_op * op)
+{
+	jit_value a1 = op->r_arg[0];
+	jit_value a2 = op->r_arg[1];
+
+	if (a1 != a2) {
+		common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE);
+		common86_neg_reg(jit->ip, a1);
+		common86_cmov_reg(jit->ip, X86_CC_S, 1, a1, a2);
+		return;
+	}
+
+	// the original value has to be kept in a temporary register
+	jit_hw_reg * tmp = jit_get_unused_reg(jit->reg_al, op, 0);
+	int tmpreg = (tmp ? tmp->id : (a1 == COMMON86_AX ? COMMON86_DX : COMMON86_AX));
+	if (!tmp) common86_push_reg(jit->ip, tmpreg);
+	common86_mov_reg_reg(jit->ip, tmpreg, a1, REG_SIZE);
+	common86_neg_reg(jit->ip, a1);
+	common86_cmov_reg(jit->ip, X86_CC_S, 1, a1, tmpreg);
+	if (!tmp) common86_pop_reg(jit->ip, tmpreg);
 }
 
 static void emit_branch_op(struct jit * jit, struct jit_op * op, int cond, int imm, int sign)
 {
-	if (imm) common86_alu_reg_imm(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2]);
-	else common86_alu_reg_reg(jit->ip, X86_CMP, op->r_arg[1], op->r_arg[2]);
+	if (op->prev && (fused_cond_branch(op->prev) == op)) {
+		// the comparison has set the flags, the branch is taken if its result is zero (BEQ) or not (BNE)
+		cond = fused_cond_cc(op->prev, GET_OP(op) == JIT_BEQ);
+		sign = IS_SIGNED(op->prev);
+	} else cond = emit_cmp(jit, op, cond, sign);
 
 	op->patch_addr = JIT_BUFFER_OFFSET(jit);
 
-	common86_branch_disp32(jit->ip, cond, JIT_GET_ADDR(jit, op->r_arg[0]), sign);
+	emit_jcc(jit, cond, op->r_arg[0], sign);
 }
 
 static void emit_branch_mask_op(struct jit * jit, struct jit_op * op, int cond, int imm)
@@ -711,7 +1114,7 @@ static void emit_branch_mask_op(struct jit * jit, struct jit_op * op, int cond,
 
 	op->patch_addr = JIT_BUFFER_OFFSET(jit);
 
-	common86_branch_disp32(jit->ip, cond, JIT_GET_ADDR(jit, op->r_arg[0]), 0);
+	emit_jcc(jit, cond, op->r_arg[0], 0);
 }
 
 static void emit_branch_overflow_op(struct jit * jit, struct jit_op * op, int alu_op, int imm, int negation)
@@ -721,8 +1124,7 @@ static void emit_branch_overflow_op(struct jit * jit, struct jit_op * op, int al
 
 	op->patch_addr = JIT_BUFFER_OFFSET(jit);
 
-	if (!negation) common86_branch_disp32(jit->ip, X86_CC_O, JIT_GET_ADDR(jit, op->r_arg[0]), 0);
-	else common86_branch_disp32(jit->ip, X86_CC_NO, JIT_GET_ADDR(jit, op->r_arg[0]), 0);
+	emit_jcc(jit, negation ? X86_CC_NO : X86_CC_O, op->r_arg[0], 0);
 }
 
 /* determines whether the argument value was spilled out or not,
@@ -780,6 +1182,54 @@ static void emit_ldx_op(struct jit * jit, jit_op * op, jit_value a1, jit_value a
 	}
 }
 
+/**
+ * Emits loads which use the addressing mode [base + index * 2^shift + disp]
+ */
+static void emit_x86_ldxm_op(struct jit * jit, jit_op * op, jit_value a1, jit_value a2, jit_value a3)
+{
+	int size = X86_MEM_SIZE(op);
+	int shift = X86_MEM_SHIFT(op);
+	jit_value disp = x86_mem_disp(op);
+	if (size == REG_SIZE) common86_mov_reg_memindex(jit->ip, a1, a2, disp, a3, shift, size);
+	else if (IS_SIGNED(op)) common86_movsx_reg_memindex(jit->ip, a1, a2, disp, a3, shift, size);
+	else common86_movzx_reg_memindex(jit->ip, a1, a2, disp, a3, shift, size);
+}
+
+/**
+ * Emits ALU operations with the memory operand [base + disp], i.e.,
+ * a1 := a2 op [a3 + disp], or a1 := [a3 + disp] - a2 if reversed
+ */
+static void emit_x86_alu_mem_op(struct jit * jit, jit_op * op, int alu_op, int reversed)
+{
+	jit_value a1 = op->r_arg[0];
+	jit_value a2 = op->r_arg[1];
+	jit_value a3 = op->r_arg[2];
+	jit_value disp = x86_mem_disp(op);
+
+	if (reversed) {
+		if (a1 == a2) {
+			common86_neg_reg(jit->ip, a1);
+			common86_alu_reg_membase(jit->ip, X86_ADD, a1, a3, disp);
+		} else {
+			common86_mov_reg_membase(jit->ip, a1, a3, disp, REG_SIZE);
+			common86_alu_reg_reg(jit->ip, X86_SUB, a1, a2);
+		}
+		return;
+	}
+
+	if ((a1 != a2) && (a1 == a3)) {
+		// the base register is overwritten, hence, the operand is loaded first
+		common86_mov_reg_membase(jit->ip, a1, a3, disp, REG_SIZE);
+		if (alu_op == X86_SUB) {
+			common86_neg_reg(jit->ip, a1);
+			common86_alu_reg_reg(jit->ip, X86_ADD, a1, a2);
+		} else common86_alu_reg_reg(jit->ip, alu_op, a1, a2);
+		return;
+	}
+	if (a1 != a2) common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE);
+	common86_alu_reg_membase(jit->ip, alu_op, a1, a3, disp);
+}
+
 struct transfer_info {
 	int sourcereg;
 	int destreg;
@@ -890,7 +1340,7 @@ static void emit_transfer_op(struct jit *jit, jit_op *op, int alu_op)
 			common86_alu_reg_membase(jit->ip, alu_op, tinf->scrapreg, COMMON86_SP, -REG_SIZE * 2);
 		} else common86_alu_reg_reg(jit->ip, alu_op, tinf->scrapreg, op->r_arg[1]);
 	}
-	else common86_alu_reg_membase(jit->ip, alu_op, tinf->scrapreg, COMMON86_BP, GET_REG_POS(jit, op->arg[1]));
+	else common86_alu_reg_membase(jit->ip, alu_op, tinf->scrapreg, GET_FRAME_REG(jit), GET_FRAME_POS(jit, GET_REG_POS(jit, op->arg[1])));
 
 
 	if (op->arg[0]) emit_transfer_loop(jit, (jit_op *)op->arg[0]);
@@ -954,7 +1404,7 @@ void jit_patch_local_addrs(struct jit *jit)
 		if ((GET_OP(op) == JIT_REF_CODE) || (GET_OP(op) == JIT_REF_DATA)) {
 			unsigned char *buf = jit->buf + (intptr_t) op->patch_addr;
 			jit_value addr = jit_is_label(jit, (void *)op->arg[1]) ? ((jit_label *)op->arg[1])->pos : op->arg[1];
-			common86_mov_reg_imm(buf, op->r_arg[0], jit->buf + addr);
+			common86_mov_reg_imm_size(buf, op->r_arg[0], jit->buf + addr, sizeof(void *));
 		}
 
 
@@ -981,6 +1431,12 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 
 	int found = 1;
 
+#ifdef JIT_ARCH_AMD64
+	// return from the function which has been left by a tail call
+	if ((GET_OP(op) == JIT_RET) || (GET_OP(op) == JIT_FRET) || (GET_OP(op) == JIT_FRETVAL))
+		if (follows_tail_call(jit, op)) return;
+#endif
+
 	switch (GET_OP(op)) {
 		case JIT_ADD:
 			if ((a1 != a2) && (a1 != a3)) {
@@ -999,6 +1455,9 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 				if (a1 != a2) common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE);
 				common86_neg_reg(jit->ip, a1);
 				break;
+		case JIT_MIN: 	emit_minmax_op(jit, op, X86_CC_GT, imm, sign); break;
+		case JIT_MAX: 	emit_minmax_op(jit, op, X86_CC_LT, imm, sign); break;
+		case JIT_ABS: 	emit_abs_op(jit, op); break;
 		case JIT_OR: 	emit_alu_op(jit, op, X86_OR, imm); break;
 		case JIT_XOR: 	emit_alu_op(jit, op, X86_XOR, imm); break;
 		case JIT_AND: 	emit_alu_op(jit, op, X86_AND, imm); break;
@@ -1015,6 +1474,9 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 		case JIT_EQ: 	emit_cond_op(jit, op, X86_CC_EQ, imm, sign); break;
 		case JIT_NE: 	emit_cond_op(jit, op, X86_CC_NE, imm, sign); break;
 
+		case JIT_MOVN: 	emit_cond_move_op(jit, op, 0); break;
+		case JIT_MOVZ: 	emit_cond_move_op(jit, op, 1); break;
+
 		case JIT_BLT: 	emit_branch_op(jit, op, X86_CC_LT, imm, sign); break;
 		case JIT_BLE: 	emit_branch_op(jit, op, X86_CC_LE, imm, sign); break;
 		case JIT_BGT: 	emit_branch_op(jit, op, X86_CC_GT, imm, sign); break;
@@ -1060,16 +1522,15 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 		case JIT_JMP:
 			op->patch_addr = JIT_BUFFER_OFFSET(jit);
 			if (op->code & REG) common86_jump_reg(jit->ip, a1);
-			else common86_jump_disp32(jit->ip, JIT_GET_ADDR(jit, a1));
+			else if (jit_is_label(jit, (void *)a1)) common86_jump_disp(jit->ip, JIT_GET_ADDR(jit, a1));
+			else common86_jump_disp32(jit->ip, a1);
 			break;
 		case JIT_RET:
 			if (!imm && (a1 != COMMON86_AX)) common86_mov_reg_reg(jit->ip, COMMON86_AX, a1, REG_SIZE);
-			if (imm) common86_mov_reg_imm(jit->ip, COMMON86_AX, a1);
+			if (imm && (a1 == 0)) common86_clear_reg(jit->ip, COMMON86_AX);
+			else if (imm) common86_mov_reg_imm(jit->ip, COMMON86_AX, a1);
 			emit_pop_callee_saved_regs(jit);
-			if (jit_current_func_info(jit)->has_prolog) {
-				common86_mov_reg_reg(jit->ip, COMMON86_SP, COMMON86_BP, REG_SIZE);
-				common86_pop_reg(jit->ip, COMMON86_BP);
-			}
+			if (jit_current_func_info(jit)->has_prolog) emit_release_frame(jit);
 			common86_ret(jit->ip);
 			break;
 
@@ -1129,8 +1590,8 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 	switch (op->code) {
 		case (JIT_MOV | REG): if (a1 != a2) common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE); break;
 		case (JIT_MOV | IMM):
-			if (a2 == 0) common86_alu_reg_reg(jit->ip, X86_XOR, a1, a1);
-			else common86_mov_reg_imm_size(jit->ip, a1, a2, 8);
+			if (a2 == 0) common86_clear_reg(jit->ip, a1);
+			else common86_mov_reg_imm(jit->ip, a1, a2);
 			break;
 
 		case JIT_PREPARE: funcall_prepare(jit, op, a1 + a2);
@@ -1154,6 +1615,17 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 		case (JIT_FMUL | REG): emit_sse_alu_op(jit, op, X86_SSE_MUL); break;
 		case (JIT_FDIV | REG): emit_sse_div_op(jit, a1, a2, a3); break;
                 case (JIT_FNEG | REG): emit_sse_neg_op(jit, op, a1, a2); break;
+		case (JIT_FABS | REG): emit_sse_abs_op(jit, op, a1, a2); break;
+		case (JIT_FMIN | REG): emit_sse_minmax_op(jit, X86_SSE_MIN, a1, a2, a3); break;
+		case (JIT_FMAX | REG): emit_sse_minmax_op(jit, X86_SSE_MAX, a1, a2, a3); break;
+		case (JIT_FLT | REG):
+		case (JIT_FLE | REG):
+		case (JIT_FGT | REG):
+		case (JIT_FGE | REG):
+		case (JIT_FEQ | REG):
+		case (JIT_FNE | REG): emit_sse_cond_op(jit, op); break;
+		case (JIT_FMOVN | REG): emit_sse_cond_move_op(jit, op, 0); break;
+		case (JIT_FMOVZ | REG): emit_sse_cond_move_op(jit, op, 1); break;
 		case (JIT_FBLT | REG): emit_sse_branch(jit, op, a1, a2, a3, X86_CC_LT); break;
                 case (JIT_FBGT | REG): emit_sse_branch(jit, op, a1, a2, a3, X86_CC_GT); break;
                 case (JIT_FBGE | REG): emit_sse_branch(jit, op, a1, a2, a3, X86_CC_GE); break;
@@ -1173,7 +1645,10 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 		case (JIT_UREG): emit_ureg(jit, a1, a2); break;
 		case (JIT_LREG): emit_lreg(jit, a1, a2); break;
 		case (JIT_SYNCREG):  emit_ureg(jit, a1, a2); break;
-		case JIT_RENAMEREG: common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE); break;
+		case JIT_RENAMEREG:
+			if (op->fp) sse_movsd_reg_reg(jit->ip, a1, a2);
+			else common86_mov_reg_reg(jit->ip, a1, a2, REG_SIZE);
+			break;
 
 		case JIT_CODESTART: break;
 		case JIT_NOP: break;
@@ -1189,8 +1664,25 @@ void jit_gen_op(struct jit * jit, struct jit_op * op)
 		case (JIT_X86_ADDIMM): {
 			jit_value tmp;
 			memcpy(&tmp, &op->flt_imm, sizeof(jit_value));
-			common86_lea_memindex(jit->ip, a1, a2, tmp, a3, 0); break;
+			common86_lea_memindex(jit->ip, a1, a2, tmp, a3, op->arg_size); break;
 		}
+		case (JIT_X86_LDXM | REG | SIGNED):
+		case (JIT_X86_LDXM | REG | UNSIGNED): emit_x86_ldxm_op(jit, op, a1, a2, a3); break;
+		case (JIT_X86_STXM | REG): common86_mov_memindex_reg(jit->ip, a1, x86_mem_disp(op), a2, X86_MEM_SHIFT(op), a3, X86_MEM_SIZE(op)); break;
+		case (JIT_X86_ADDM): emit_x86_alu_mem_op(jit, op, X86_ADD, 0); break;
+		case (JIT_X86_SUBM): emit_x86_alu_mem_op(jit, op, X86_SUB, 0); break;
+		case (JIT_X86_RSBM): emit_x86_alu_mem_op(jit, op, X86_SUB, 1); break;
+		case (JIT_X86_ANDM): emit_x86_alu_mem_op(jit, op, X86_AND, 0); break;
+		case (JIT_X86_ORM): emit_x86_alu_mem_op(jit, op, X86_OR, 0); break;
+		case (JIT_X86_XORM): emit_x86_alu_mem_op(jit, op, X86_XOR, 0); break;
+		case (JIT_X86_INC):
+			if (a1 != a2) common86_lea_membase(jit->ip, a1, a2, 1);
+			else common86_inc_reg(jit->ip, a1);
+			break;
+		case (JIT_X86_DEC):
+			if (a1 != a2) common86_lea_membase(jit->ip, a1, a2, -1);
+			else common86_dec_reg(jit->ip, a1);
+			break;
 
 		default: printf("common86: unknown operation (opcode: 0x%x)\n", GET_OP(op) >> 3);
 	}
@@ -0,0 +1,391 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Dead store elimination.
+ *
+ * Stores to the stack frame, i.e., to the space allocated with allocai, are
+ * removed if the stored value is overwritten or the function returns before
+ * the value is read. Addresses are tracked using the SSA form; an address is
+ * R_FP, or a register set by addi, subi, or movr from another address.
+ * Memory accesses are described by their offsets and sizes, and the
+ * following rules apply:
+ *	- accesses to disjoint parts of the frame do not alias,
+ *	- accesses through other pointers do not touch the frame.
+ * The second rule holds unless an address in the frame leaves the function
+ * or is mixed with other values; stores of such functions are kept.
+ *
+ * Computations and loads whose results are not used are removed, which may
+ * make other stores dead, and so on. Finally, NOP operations left behind by
+ * this and preceding passes are deleted.
+ */
+
+#define DSE_NO_ACCESS	(0)	// operation does not access the frame
+#define DSE_LOAD	(1)
+#define DSE_STORE	(2)
+
+struct dse_access {
+	char type;
+	int loc;		// accessed location, -1 if the offset is not known
+};
+
+struct dse_loc {
+	jit_value offset;
+	int size;
+};
+
+struct dse_func {
+	struct ssa_func * f;
+	struct dse_access * access;
+	struct dse_loc * locs;
+	int loc_cnt;
+	char * overlaps;	// overlaps[i * loc_cnt + j] is 1 if locations i and j overlap
+	char * covers;		// covers[i * loc_cnt + j] is 1 if location i contains location j
+	char * live_in;		// live locations at the beginning of each block
+	int escaped;
+	int dead_stores;
+};
+
+/**
+ * Returns 1 if the value is an address in the frame and sets its offset
+ * from the frame pointer
+ */
+static int dse_frame_offset(struct ssa_func * f, struct ssa_value * v, jit_value * offset)
+{
+	jit_value off = 0;
+	while (v && v->def) {
+		jit_op * op = v->def;
+		switch (op->code) {
+			case JIT_ADD | IMM: off += op->arg[2]; break;
+			case JIT_SUB | IMM: off -= op->arg[2]; break;
+			case JIT_MOV | REG: break;
+			default: return 0;
+		}
+		if (op->arg[1] == R_FP) {
+			*offset = off;
+			return 1;
+		}
+		struct ssa_use * src = ssa_info(f, op)->uses[1];
+		v = src ? src->value : NULL;
+	}
+	return 0;
+}
+
+static inline int dse_frame_arg(struct ssa_func * f, jit_op * op, int i, jit_value * offset)
+{
+	*offset = 0;
+	if (op->arg[i] == R_FP) return 1;
+	struct ssa_use * u = ssa_info(f, op)->uses[i];
+	return u && dse_frame_offset(f, u->value, offset);
+}
+
+/**
+ * Returns the type of the memory access and sets the mask of arguments
+ * which form the address
+ */
+static int dse_memory_op(jit_op * op, int * address_args)
+{
+	switch (GET_OP(op)) {
+		case JIT_LD: case JIT_FLD:
+			*address_args = 1 << 1;
+			return DSE_LOAD;
+		case JIT_LDX: case JIT_FLDX:
+			*address_args = (1 << 1) | (1 << 2);
+			return DSE_LOAD;
+		case JIT_ST: case JIT_FST:
+			*address_args = 1 << 0;
+			return DSE_STORE;
+		case JIT_STX: case JIT_FSTX:
+			*address_args = (1 << 0) | (1 << 1);
+			return DSE_STORE;
+		default:
+			*address_args = 0;
+			return DSE_NO_ACCESS;
+	}
+}
+
+static int dse_location(struct dse_func * d, jit_value offset, int size)
+{
+	for (int i = 0; i < d->loc_cnt; i++)
+		if ((d->locs[i].offset == offset) && (d->locs[i].size == size)) return i;
+	d->locs = JIT_REALLOC(d->locs, sizeof(struct dse_loc) * (d->loc_cnt + 1));
+	d->locs[d->loc_cnt].offset = offset;
+	d->locs[d->loc_cnt].size = size;
+	return d->loc_cnt++;
+}
+
+/**
+ * Finds out which part of the frame the operation accesses
+ */
+static void dse_classify_op(struct dse_func * d, jit_op * op)
+{
+	struct dse_access * a = &d->access[op->normalized_pos];
+	int address_args;
+	int type = dse_memory_op(op, &address_args);
+
+	a->type = DSE_NO_ACCESS;
+	a->loc = -1;
+	if (type == DSE_NO_ACCESS) return;
+
+	int frame_args = 0, known = 1;
+	jit_value offset = 0;
+	for (int i = 0; i < 3; i++) {
+		if (!(address_args & (1 << i))) continue;
+		jit_value arg_offset;
+		if (ARG_TYPE(op, i + 1) == IMM) offset += op->arg[i];
+		else if (dse_frame_arg(d->f, op, i, &arg_offset)) {
+			offset += arg_offset;
+			frame_args++;
+		} else known = 0;
+	}
+	if (frame_args == 0) return;
+
+	a->type = type;
+	if (known && (frame_args == 1)) a->loc = dse_location(d, offset, op->arg_size);
+}
+
+/**
+ * Returns 1 if an address in the frame may be used by the operation in
+ * another way than for accessing the memory or computing another address
+ */
+static int dse_escapes(struct ssa_func * f, jit_op * op)
+{
+	jit_value offset;
+	int address_args;
+	dse_memory_op(op, &address_args);
+
+	for (int i = 0; i < 3; i++) {
+		if ((ARG_TYPE(op, i + 1) != REG) || !dse_frame_arg(f, op, i, &offset)) continue;
+		if (address_args & (1 << i)) continue;
+		if ((i == 1) && ((op->code == (JIT_ADD | IMM)) || (op->code == (JIT_SUB | IMM)) || (op->code == (JIT_MOV | REG)))) continue;
+		return 1;
+	}
+
+	// conditional moves keep the previous value of the target register
+	struct ssa_use * u = ssa_info(f, op)->uses[SSA_TARGET_USE];
+	return u && dse_frame_offset(f, u->value, &offset);
+}
+
+static int dse_escaping_phi(struct ssa_func * f, struct ssa_block * b)
+{
+	jit_value offset;
+	for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+		for (int j = 0; j < b->pred_cnt; j++)
+			if (phi->args[j].value && dse_frame_offset(f, phi->args[j].value, &offset)) return 1;
+	return 0;
+}
+
+/**
+ * Returns 1 if an address in the frame leaves the function or is mixed
+ * with other values
+ */
+static int dse_frame_escapes(struct ssa_func * f)
+{
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (dse_escaping_phi(f, b)) return 1;
+		for (int j = b->first; j <= b->last; j++)
+			if (dse_escapes(f, f->ops[j].op)) return 1;
+	}
+	return 0;
+}
+
+static void dse_prepare(struct dse_func * d)
+{
+	struct ssa_func * f = d->f;
+	d->access = JIT_MALLOC(sizeof(struct dse_access) * f->op_cnt);
+	for (int i = 0; i < f->op_cnt; i++)
+		dse_classify_op(d, f->ops[i].op);
+	d->escaped = dse_frame_escapes(f);
+
+	int n = d->loc_cnt;
+	d->overlaps = JIT_MALLOC(n * n + 1);
+	d->covers = JIT_MALLOC(n * n + 1);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++) {
+			struct dse_loc * a = &d->locs[i];
+			struct dse_loc * b = &d->locs[j];
+			d->overlaps[i * n + j] = (a->offset < b->offset + b->size) && (b->offset < a->offset + a->size);
+			d->covers[i * n + j] = (a->offset <= b->offset) && (b->offset + b->size <= a->offset + a->size);
+		}
+	d->live_in = JIT_MALLOC(f->block_cnt * n + 1);
+	memset(d->live_in, 0, f->block_cnt * n + 1);
+}
+
+/**
+ * Computes live locations at the beginning of the block from the live
+ * locations at its end; if sweep is set, removes dead stores
+ */
+static void dse_transfer(struct dse_func * d, struct ssa_block * b, char * live, int sweep)
+{
+	struct ssa_func * f = d->f;
+	int n = d->loc_cnt;
+	for (int i = b->last; i >= b->first; i--) {
+		struct dse_access * a = &d->access[i];
+		if (f->ops[i].removed || (a->type == DSE_NO_ACCESS)) continue;
+
+		if (a->type == DSE_LOAD) {
+			for (int j = 0; j < n; j++)
+				if ((a->loc < 0) || d->overlaps[a->loc * n + j]) live[j] = 1;
+			continue;
+		}
+
+		if (a->loc < 0) continue;
+		if (sweep) {
+			int dead = 1;
+			for (int j = 0; j < n; j++)
+				if (live[j] && d->overlaps[a->loc * n + j]) dead = 0;
+			if (dead) {
+				ssa_remove_op(f, f->ops[i].op);
+				d->dead_stores++;
+				continue;
+			}
+		}
+		for (int j = 0; j < n; j++)
+			if (d->covers[a->loc * n + j]) live[j] = 0;
+	}
+}
+
+static void dse_live_out(struct dse_func * d, struct ssa_block * b, char * live)
+{
+	int n = d->loc_cnt;
+	memset(live, 0, n + 1);
+	struct ssa_block * succ[2] = { b->fall, b->target };
+	for (int s = 0; s < 2; s++) {
+		if (!succ[s]) continue;
+		char * in = d->live_in + (succ[s] - d->f->blocks) * n;
+		for (int j = 0; j < n; j++)
+			live[j] |= in[j];
+	}
+}
+
+/**
+ * Removes stores whose values are never read; returns the number of
+ * removed stores
+ */
+static int dse_remove_dead_stores(struct dse_func * d)
+{
+	struct ssa_func * f = d->f;
+	int n = d->loc_cnt;
+	int removed = d->dead_stores;
+	char * live = JIT_MALLOC(n + 1);
+	memset(d->live_in, 0, f->block_cnt * n + 1);
+
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		for (int i = f->rpo_cnt - 1; i >= 0; i--) {
+			struct ssa_block * b = f->rpo[i];
+			dse_live_out(d, b, live);
+			dse_transfer(d, b, live, 0);
+			char * in = d->live_in + (b - f->blocks) * n;
+			if (memcmp(in, live, n)) {
+				memcpy(in, live, n);
+				changed = 1;
+			}
+		}
+	}
+
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		dse_live_out(d, f->rpo[i], live);
+		dse_transfer(d, f->rpo[i], live, 1);
+	}
+	JIT_FREE(live);
+	return d->dead_stores - removed;
+}
+
+static void dse_free(struct dse_func * d)
+{
+	if (d->access) JIT_FREE(d->access);
+	if (d->locs) JIT_FREE(d->locs);
+	if (d->overlaps) JIT_FREE(d->overlaps);
+	if (d->covers) JIT_FREE(d->covers);
+	if (d->live_in) JIT_FREE(d->live_in);
+}
+
+static void dse_optimize_function(struct dse_func * d)
+{
+	struct ssa_func * f = d->f;
+	ssa_mark_reachable(f);
+	dse_prepare(d);
+	do {
+		for (struct ssa_value * v = f->values; v; v = v->next)
+			v->live = 0;
+		ssa_eliminate_dead_code(f);
+	} while (!d->escaped && d->loc_cnt && dse_remove_dead_stores(d));
+}
+
+/**
+ * Deletes NOP operations which are not referred to by other operations
+ */
+static void dse_delete_nops(struct jit * jit)
+{
+	jit_tree * refs = NULL;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (op->jmp_addr) refs = jit_tree_insert(refs, (jit_value) op->jmp_addr, NULL, NULL);
+		if (GET_OP(op) == JIT_PATCH) refs = jit_tree_insert(refs, op->arg[0], NULL, NULL);
+	}
+
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		jit_op * next = op->next;
+		if ((GET_OP(op) == JIT_NOP) && (op != jit->last_op) && !jit_tree_search(refs, (jit_value) op)) jit_op_delete(op);
+		op = next;
+	}
+	jit_tree_free(refs);
+}
+
+/**
+ * Removes dead stores, computations, and loads; returns the number of
+ * removed operations
+ */
+static int jit_eliminate_dead_stores(struct jit * jit)
+{
+	int changes = 0;
+	jit_tree * code_refs = NULL;
+	ssa_collect_code_refs(jit, &code_refs);
+
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		if (GET_OP(op) != JIT_PROLOG) {
+			op = op->next;
+			continue;
+		}
+		jit_op * prolog = op;
+		do op = op->next;
+		while (op && (GET_OP(op) != JIT_PROLOG));
+
+		struct ssa_func f;
+		struct dse_func d;
+		memset(&f, 0, sizeof(struct ssa_func));
+		memset(&d, 0, sizeof(struct dse_func));
+		d.f = &f;
+		if (ssa_build(&f, prolog, code_refs)) {
+			dse_optimize_function(&d);
+			jit->stats[JIT_STAT_DEAD_STORES] += d.dead_stores;
+			jit->stats[JIT_STAT_DEAD_OPS] += f.dead;
+			changes += d.dead_stores + f.dead;
+		}
+		dse_free(&d);
+		ssa_free(&f);
+	}
+	jit_tree_free(code_refs);
+	dse_delete_nops(jit);
+	return changes;
+}
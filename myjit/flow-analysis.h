@@ -29,6 +29,7 @@ static inline void jit_flw_initialize(struct jit * jit)
 		for (int i = 0; i < 3; i++)
 			if (ARG_TYPE(op, i + 1) == REG)
 				jit_set_add(op->live_in, op->arg[i]);
+		if (jit_reads_target_reg(op)) jit_set_add(op->live_in, op->arg[0]);
 
 		if (GET_OP(op) == JIT_PROLOG) {
 			func_info = (struct jit_func_info *)op->arg[1];
@@ -215,6 +216,7 @@ skip:
 
 	for (int i = 0; i < 3; i++)
 		if (ARG_TYPE(op, i + 1) == REG) jit_set_add(op->live_in, op->arg[i]);
+	if (jit_reads_target_reg(op)) jit_set_add(op->live_in, op->arg[0]);
 
 	if (GET_OP(op) == JIT_PROLOG) flw_analyze_prolog(jit, op, func_info);
 
@@ -307,6 +309,10 @@ static void jit_dead_code_analysis(struct jit *jit, int remove_dead_code)
 
 	if (!remove_dead_code) return;
 
+	// patches of removed operations would refer to released memory
+	for (jit_op *op = jit_op_first(jit->ops); op; op = op->next)
+		if ((GET_OP(op) == JIT_PATCH) && !((jit_op *)op->arg[0])->in_use) op->in_use = 0;
+
 	jit_op *op = jit_op_first(jit->ops);
 
 	while (op) {
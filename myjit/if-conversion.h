@@ -0,0 +1,263 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * If-conversion of short forward branches.
+ *
+ * A conditional branch skipping a few operations (a triangle), or choosing
+ * between two short sequences of operations (a diamond), is replaced with
+ * code which computes both arms into unused registers and then copies the
+ * results with conditional moves. Only operations which cannot trap and have
+ * no side effect are executed speculatively.
+ */
+
+#define JIT_IF_CONVERSION_MAX_OPS	(4)	// max. number of operations in both arms
+
+struct jit_hammock_arm {
+	jit_op * ops[JIT_IF_CONVERSION_MAX_OPS];
+	jit_value dests[JIT_IF_CONVERSION_MAX_OPS];	// original target registers of the operations
+	int len;
+	jit_value regs[JIT_IF_CONVERSION_MAX_OPS];	// registers written by the arm
+	jit_value values[JIT_IF_CONVERSION_MAX_OPS];	// registers holding their new values
+	int reg_cnt;
+};
+
+/**
+ * Returns 1 if the operation can be executed even if the original code
+ * would skip it
+ */
+static int ifconv_speculable_op(jit_op * op)
+{
+	if (op->fp || (ARG_TYPE(op, 1) != TREG)) return 0;
+	switch (GET_OP(op)) {
+		case JIT_MOV: case JIT_ADD: case JIT_SUB: case JIT_RSB: case JIT_NEG: case JIT_MUL:
+		case JIT_OR: case JIT_XOR: case JIT_AND: case JIT_LSH: case JIT_RSH: case JIT_NOT:
+		case JIT_LT: case JIT_LE: case JIT_GT: case JIT_GE: case JIT_EQ: case JIT_NE:
+		case JIT_MIN: case JIT_MAX: case JIT_ABS:
+			break;
+		default: return 0;
+	}
+	jit_reg r = (jit_reg) op->arg[0];
+	return (JIT_REG_SPEC(r) == JIT_RTYPE_REG) && (JIT_REG_TYPE(r) == JIT_RTYPE_INT);
+}
+
+/**
+ * Collects operations of the arm starting with the given operation; returns
+ * the first operation which does not belong to the arm
+ */
+static jit_op * ifconv_collect_arm(jit_op * op, struct jit_hammock_arm * arm, int max_len)
+{
+	arm->len = 0;
+	arm->reg_cnt = 0;
+	while (op && ifconv_speculable_op(op)) {
+		if (arm->len == max_len) return NULL;
+		arm->dests[arm->len] = op->arg[0];
+		arm->ops[arm->len++] = op;
+		op = op->next;
+	}
+	return op;
+}
+
+static int ifconv_arm_writes(struct jit_hammock_arm * arm, jit_value reg)
+{
+	for (int i = 0; i < arm->len; i++)
+		if (arm->dests[i] == reg) return 1;
+	return 0;
+}
+
+static jit_value ifconv_arm_value(struct jit_hammock_arm * arm, jit_value reg)
+{
+	for (int i = 0; i < arm->reg_cnt; i++)
+		if (arm->regs[i] == reg) return arm->values[i];
+	return reg;
+}
+
+static void ifconv_set_arm_value(struct jit_hammock_arm * arm, jit_value reg, jit_value value)
+{
+	for (int i = 0; i < arm->reg_cnt; i++)
+		if (arm->regs[i] == reg) {
+			arm->values[i] = value;
+			return;
+		}
+	arm->regs[arm->reg_cnt] = reg;
+	arm->values[arm->reg_cnt++] = value;
+}
+
+/**
+ * Renames registers written by the arm to unused registers. Moves of registers
+ * which are not written by any of the arms are removed and their sources are
+ * used directly.
+ */
+static void ifconv_rename_arm(struct jit_hammock_arm * arm, struct jit_hammock_arm * other, int * reg_base)
+{
+	for (int i = 0; i < arm->len; i++) {
+		jit_op * op = arm->ops[i];
+		for (int j = 1; j < 3; j++)
+			if (ARG_TYPE(op, j + 1) == REG) op->arg[j] = ifconv_arm_value(arm, op->arg[j]);
+
+		if ((op->code == (JIT_MOV | REG)) && !ifconv_arm_writes(arm, op->arg[1]) && !ifconv_arm_writes(other, op->arg[1])) {
+			ifconv_set_arm_value(arm, op->arg[0], op->arg[1]);
+			jit_op_delete(op);
+			continue;
+		}
+		jit_value tmp = R((*reg_base)++);
+		ifconv_set_arm_value(arm, op->arg[0], tmp);
+		op->arg[0] = tmp;
+	}
+}
+
+static jit_op * ifconv_new_op(jit_op * orig, unsigned short code, unsigned char spec, jit_value arg1, jit_value arg2, jit_value arg3)
+{
+	jit_op * op = jit_op_new(code, spec, arg1, arg2, arg3, 0);
+	if (orig->debug_info) {
+		op->debug_info = JIT_MALLOC(sizeof(struct jit_debug_info));
+		*op->debug_info = *orig->debug_info;
+	}
+	return op;
+}
+
+/**
+ * Creates an operation which stores a non-zero value into the given register
+ * if the branch would be taken; returns NULL if the branch is not supported.
+ * If the condition is negated, the register is zero if the branch is taken.
+ */
+static jit_op * ifconv_branch_cond(jit_op * branch, jit_value cond, int * negated)
+{
+	jit_opcode code;
+	*negated = 0;
+	switch (GET_OP(branch)) {
+		case JIT_BLT: code = JIT_LT; break;
+		case JIT_BLE: code = JIT_LE; break;
+		case JIT_BGT: code = JIT_GT; break;
+		case JIT_BGE: code = JIT_GE; break;
+		case JIT_BEQ: code = JIT_EQ; break;
+		case JIT_BNE: code = JIT_NE; break;
+		case JIT_BMS: code = JIT_AND; break;
+		case JIT_BMC: code = JIT_AND; *negated = 1; break;
+		default: return NULL;
+	}
+	return ifconv_new_op(branch, code | GET_OP_SUFFIX(branch), SPEC(TREG, REG, IS_IMM(branch) ? IMM : REG),
+		cond, branch->arg[1], branch->arg[2]);
+}
+
+/**
+ * Returns 1 if the branch is known to be taken almost always or almost never,
+ * i.e., it is well predictable and cheaper than conditional moves
+ */
+static int ifconv_biased_branch(jit_op * op)
+{
+	return (op->probability >= 0) && ((op->probability <= JIT_PROB_UNLIKELY) || (op->probability >= JIT_PROB_LIKELY));
+}
+
+/**
+ * Replaces the branch and its arms with conditional moves; the else arm is
+ * empty for triangles. Returns 1 if the hammock was converted.
+ */
+static int ifconv_convert(jit_op * branch, struct jit_hammock_arm * then_arm, struct jit_hammock_arm * else_arm, jit_op * join, int * reg_base)
+{
+	jit_value cond = R(*reg_base);
+	int negated;
+	jit_op * cmp = ifconv_branch_cond(branch, cond, &negated);
+	if (!cmp) return 0;
+	(*reg_base)++;
+
+	ifconv_rename_arm(then_arm, else_arm, reg_base);
+	ifconv_rename_arm(else_arm, then_arm, reg_base);
+
+	// registers written by both arms get the value of the then arm first;
+	// if possible, before the comparison so that it can be joined with the conditional move
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) jit_op_prepend(join, cmp);
+		for (int i = 0; i < then_arm->reg_cnt; i++) {
+			jit_value reg = then_arm->regs[i];
+			if ((ifconv_arm_value(else_arm, reg) == reg) || (then_arm->values[i] == reg)) continue;
+			int read_by_cmp = (reg == cmp->arg[1]) || ((ARG_TYPE(cmp, 3) == REG) && (reg == cmp->arg[2]));
+			if (read_by_cmp != pass) continue;
+			jit_op_prepend(join, ifconv_new_op(branch, JIT_MOV | REG, SPEC(TREG, REG, NO), reg, then_arm->values[i], 0));
+		}
+	}
+
+	// the then arm is executed if the branch is not taken
+	for (int i = 0; i < then_arm->reg_cnt; i++) {
+		jit_value reg = then_arm->regs[i];
+		if ((then_arm->values[i] == reg) || (ifconv_arm_value(else_arm, reg) != reg)) continue;
+		jit_op_prepend(join, ifconv_new_op(branch, (negated ? JIT_MOVN : JIT_MOVZ) | REG, SPEC(TREG, REG, REG), reg, then_arm->values[i], cond));
+	}
+	for (int i = 0; i < else_arm->reg_cnt; i++) {
+		jit_value reg = else_arm->regs[i];
+		if (else_arm->values[i] == reg) continue;
+		jit_op_prepend(join, ifconv_new_op(branch, (negated ? JIT_MOVZ : JIT_MOVN) | REG, SPEC(TREG, REG, REG), reg, else_arm->values[i], cond));
+	}
+	jit_op_delete(branch);
+	return 1;
+}
+
+/**
+ * Converts short forward branches into conditional moves; returns
+ * the number of removed branches
+ */
+static int jit_convert_ifs(struct jit * jit)
+{
+	int converted = 0;
+	int reg_base = 0;
+
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (GET_OP(op) == JIT_PROLOG) {
+			// the first unused registers of the function
+			int fp_base = 0;
+			reg_base = 0;
+			for (jit_op * o = op->next; o && (GET_OP(o) != JIT_PROLOG); o = o->next)
+				jit_op_count_regs(o, &reg_base, &fp_base);
+			continue;
+		}
+		if (!is_cond_branch_op(op) || op->fp || !op->jmp_addr || ifconv_biased_branch(op)) continue;
+
+		jit_op * target = op->jmp_addr;
+		struct jit_hammock_arm then_arm, else_arm;
+		else_arm.len = 0;
+		else_arm.reg_cnt = 0;
+
+		jit_op * end = ifconv_collect_arm(op->next, &then_arm, JIT_IF_CONVERSION_MAX_OPS);
+		if (!end) continue;
+
+		jit_op * prev = op->prev;
+		if (end == target) {
+			// triangle: the branch skips the arm
+			if (then_arm.len == 0) continue;
+			if (!ifconv_convert(op, &then_arm, &else_arm, target, &reg_base)) continue;
+			if (GET_OP(target) == JIT_PATCH) jit_op_delete(target);
+		} else if ((end->code == (JIT_JMP | IMM)) && (end->next == target) && (GET_OP(target) == JIT_PATCH) && end->jmp_addr) {
+			// diamond: the branch jumps to the else arm, the then arm jumps behind it
+			jit_op * jmp = end;
+			jit_op * join = jmp->jmp_addr;
+			jit_op * else_end = ifconv_collect_arm(target->next, &else_arm, JIT_IF_CONVERSION_MAX_OPS - then_arm.len);
+			if ((else_end != join) || (then_arm.len + else_arm.len == 0)) continue;
+			if (!ifconv_convert(op, &then_arm, &else_arm, join, &reg_base)) continue;
+			jit_op_delete(jmp);
+			jit_op_delete(target);
+			if (GET_OP(join) == JIT_PATCH) jit_op_delete(join);
+		} else continue;
+
+		converted++;
+		op = prev;
+	}
+
+	jit->stats[JIT_STAT_IF_CONVERSIONS] += converted;
+	return converted;
+}
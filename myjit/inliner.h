@@ -0,0 +1,289 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Inlining of small functions generated by the same compiler instance.
+ *
+ * The body of the callee is copied into the place of the prepare-call block,
+ * its registers are renamed into unused registers of the caller, arguments
+ * are passed through registers, and returns are turned into jumps to the
+ * operation following the call.
+ */
+
+#define JIT_INLINE_MAX_OPS	(32)	// max. number of operations of an inlined function
+
+struct jit_inlined_func {
+	jit_op * prolog;	// PROLOG operation of the callee
+	jit_op * last;		// last operation of its body (RET or FRET)
+	int gp_reg_cnt;		// number of GP registers used by the callee
+	int fp_reg_cnt;		// number of FP registers used by the callee
+	int gp_arg_cnt;		// number of GP arguments
+	int fp_arg_cnt;		// number of FP arguments
+	jit_opcode ret_type;	// JIT_RET, or JIT_FRET if the function returns FP value
+};
+
+static inline int jit_op_in_range(jit_op * op, jit_op * first, jit_op * last)
+{
+	for (jit_op * o = first; o != last->next; o = o->next)
+		if (o == op) return 1;
+	return 0;
+}
+
+/**
+ * Checks whether the function starting with the given PROLOG can be inlined
+ * and collects information needed to do so
+ */
+static int inline_analyze_callee(jit_op * prolog, struct jit_inlined_func * f)
+{
+	jit_op * last = prolog;
+	while (last->next && (GET_OP(last->next) != JIT_PROLOG)) last = last->next;
+	// labels preceding the next function
+	while ((last != prolog) && (GET_OP(last) == JIT_LABEL)) last = last->prev;
+
+	if ((GET_OP(last) != JIT_RET) && (GET_OP(last) != JIT_FRET)) return 0;
+
+	struct jit_func_info * info = (struct jit_func_info *) prolog->arg[1];
+	if (info->allocai_mem) return 0;
+
+	f->prolog = prolog;
+	f->last = last;
+	f->gp_reg_cnt = 0;
+	f->fp_reg_cnt = 0;
+	f->gp_arg_cnt = 0;
+	f->fp_arg_cnt = 0;
+	f->ret_type = GET_OP(last);
+
+	int size = 0;
+	for (jit_op * op = prolog->next; op != last->next; op = op->next) {
+		if (++size > JIT_INLINE_MAX_OPS) return 0;
+		switch (GET_OP(op)) {
+			case JIT_LABEL: case JIT_ALLOCA: case JIT_PREPARE: case JIT_PUTARG: case JIT_FPUTARG:
+			case JIT_CALL: case JIT_RETVAL: case JIT_FRETVAL: case JIT_REF_CODE: case JIT_REF_DATA:
+			case JIT_DATA_BYTE: case JIT_DATA_BYTES: case JIT_DATA_REF_CODE: case JIT_DATA_REF_DATA:
+			case JIT_CODE_ALIGN: case JIT_MSG: case JIT_FMSG: case JIT_FORCE_SPILL: case JIT_FORCE_ASSOC:
+			case JIT_TRACE: case JIT_MARK: case JIT_TOUCH:
+				return 0;
+			case JIT_JMP:
+				if (!IS_IMM(op)) return 0;
+				break;
+			case JIT_PATCH:
+				if (!jit_op_in_range((jit_op *) op->arg[0], prolog, last)) return 0;
+				break;
+			case JIT_DECL_ARG:
+				// narrower arguments would have to be converted
+				if ((op->arg[0] == JIT_FLOAT_NUM) && (op->arg[1] != sizeof(double))) return 0;
+				if ((op->arg[0] != JIT_FLOAT_NUM) && (op->arg[1] != sizeof(jit_value))) return 0;
+				if (op->arg[0] == JIT_FLOAT_NUM) f->fp_arg_cnt++;
+				else f->gp_arg_cnt++;
+				break;
+			case JIT_RET:
+			case JIT_FRET:
+				if (GET_OP(op) != f->ret_type) return 0;
+				if ((GET_OP(op) == JIT_FRET) && (op->arg_size != sizeof(double))) return 0;
+				break;
+			default:
+				if ((GET_OP(op) >= JIT_TRANSFER) && (GET_OP(op) <= JIT_TRANSFER_SUBS)) return 0;
+		}
+
+		// only jumps within the function are allowed
+		if ((GET_OP(op) != JIT_PATCH) && op->jmp_addr && !jit_op_in_range(op->jmp_addr, prolog, last)) return 0;
+
+		for (int i = 0; i < 3; i++)
+			if (((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG))
+			&& (JIT_REG_SPEC(op->arg[i]) != JIT_RTYPE_REG)) return 0;
+
+		jit_op_count_regs(op, &f->gp_reg_cnt, &f->fp_reg_cnt);
+	}
+	return 1;
+}
+
+/**
+ * Checks whether arguments passed in the prepare-call block match arguments
+ * declared by the callee
+ */
+static int inline_check_args(jit_op * prepare, jit_op * call, struct jit_inlined_func * f)
+{
+	jit_op * decl = f->prolog->next;
+	for (jit_op * op = prepare->next; op != call; op = op->next) {
+		while ((decl != f->last) && (GET_OP(decl) != JIT_DECL_ARG)) decl = decl->next;
+		if (GET_OP(decl) != JIT_DECL_ARG) return 0;
+
+		if (GET_OP(op) == JIT_PUTARG) {
+			if (decl->arg[0] == JIT_FLOAT_NUM) return 0;
+		} else if (GET_OP(op) == JIT_FPUTARG) {
+			if ((decl->arg[0] != JIT_FLOAT_NUM) || (op->arg_size != sizeof(double))) return 0;
+		} else return 0;
+		decl = decl->next;
+	}
+	while ((decl != f->last) && (GET_OP(decl) != JIT_DECL_ARG)) decl = decl->next;
+	return GET_OP(decl) != JIT_DECL_ARG;
+}
+
+static inline jit_value inline_rename_reg(jit_value r, int gp_base, int fp_base)
+{
+	if (JIT_REG_TYPE(r) == JIT_RTYPE_INT) return R(gp_base + JIT_REG_ID(r));
+	return FR(fp_base + JIT_REG_ID(r));
+}
+
+static inline jit_op * inline_new_op(jit_op * orig, unsigned short code, unsigned char spec, jit_value arg1, jit_value arg2, jit_value arg3)
+{
+	jit_op * op = jit_op_new(code, spec, arg1, arg2, arg3, orig->arg_size);
+	op->fp = orig->fp;
+	op->flt_imm = orig->flt_imm;
+	if (orig->debug_info) {
+		op->debug_info = JIT_MALLOC(sizeof(struct jit_debug_info));
+		*op->debug_info = *orig->debug_info;
+	}
+	return op;
+}
+
+/**
+ * Replaces the prepare-call block with the body of the callee; the value
+ * is returned into the register given by the following RETVAL or FRETVAL
+ */
+static void inline_call(jit_op * prepare, jit_op * call, struct jit_inlined_func * f, int gp_base, int fp_base)
+{
+	jit_op * retval = call->next;
+	if ((GET_OP(retval) != JIT_RETVAL) && (GET_OP(retval) != JIT_FRETVAL)) retval = NULL;
+
+	// arguments are kept in registers following the registers of the callee
+	int argc = 0;
+	jit_value args[JIT_INLINE_MAX_OPS];
+	int gp_args = 0, fp_args = 0;
+	for (jit_op * op = prepare->next; op != call; op = op->next) {
+		jit_op * mov;
+		if (GET_OP(op) == JIT_PUTARG) {
+			args[argc] = R(gp_base + f->gp_reg_cnt + gp_args++);
+			mov = inline_new_op(op, JIT_MOV | GET_OP_SUFFIX(op), SPEC(TREG, IS_IMM(op) ? IMM : REG, NO), args[argc], op->arg[0], 0);
+		} else {
+			args[argc] = FR(fp_base + f->fp_reg_cnt + fp_args++);
+			mov = inline_new_op(op, JIT_FMOV | GET_OP_SUFFIX(op), SPEC(TREG, IS_IMM(op) ? IMM : REG, NO), args[argc], op->arg[0], 0);
+		}
+		mov->fp = (GET_OP(op) == JIT_FPUTARG);
+		mov->arg_size = 0;
+		jit_op_prepend(prepare, mov);
+		argc++;
+	}
+
+	jit_op * orig[JIT_INLINE_MAX_OPS];
+	jit_op * copy[JIT_INLINE_MAX_OPS];
+	jit_op * exits[JIT_INLINE_MAX_OPS];
+	int copied = 0;
+	int exit_cnt = 0;
+
+	for (jit_op * op = f->prolog->next; op != f->last->next; op = op->next) {
+		jit_op * newop;
+		switch (GET_OP(op)) {
+			case JIT_DECL_ARG:
+				continue;
+			case JIT_GETARG: {
+				int fp = (JIT_REG_TYPE(args[op->arg[1]]) == JIT_RTYPE_FLOAT);
+				newop = inline_new_op(op, (fp ? JIT_FMOV : JIT_MOV) | REG, SPEC(TREG, REG, NO),
+					inline_rename_reg(op->arg[0], gp_base, fp_base), args[op->arg[1]], 0);
+				newop->fp = fp;
+				break;
+			}
+			case JIT_RET:
+			case JIT_FRET:
+				if (retval) {
+					jit_value src = IS_IMM(op) ? op->arg[0] : inline_rename_reg(op->arg[0], gp_base, fp_base);
+					newop = inline_new_op(op, (GET_OP(op) == JIT_FRET ? JIT_FMOV : JIT_MOV) | GET_OP_SUFFIX(op),
+						SPEC(TREG, IS_IMM(op) ? IMM : REG, NO), retval->arg[0], src, 0);
+					newop->fp = (GET_OP(op) == JIT_FRET);
+					newop->arg_size = 0;
+					jit_op_prepend(prepare, newop);
+				}
+				if (op == f->last) continue;
+				newop = inline_new_op(op, JIT_JMP | IMM, SPEC(IMM, NO, NO), (jit_value) JIT_FORWARD, 0, 0);
+				newop->fp = 0;
+				exits[exit_cnt++] = newop;
+				break;
+			default:
+				newop = inline_new_op(op, op->code, op->spec, op->arg[0], op->arg[1], op->arg[2]);
+				for (int i = 0; i < 3; i++)
+					if ((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG))
+						newop->arg[i] = inline_rename_reg(op->arg[i], gp_base, fp_base);
+		}
+		orig[copied] = op;
+		copy[copied++] = newop;
+		jit_op_prepend(prepare, newop);
+	}
+
+	// redirects patches to the copied jumps
+	for (int i = 0; i < copied; i++) {
+		if (GET_OP(copy[i]) != JIT_PATCH) continue;
+		for (int j = 0; j < copied; j++)
+			if (orig[j] == (jit_op *) copy[i]->arg[0]) copy[i]->arg[0] = (jit_value) copy[j];
+	}
+
+	for (int i = 0; i < exit_cnt; i++)
+		jit_op_prepend(prepare, jit_op_new(JIT_PATCH | IMM, SPEC(IMM, NO, NO), (jit_value) exits[i], 0, 0, 0));
+
+	if (retval) jit_op_delete(retval);
+	while (prepare->next != call) jit_op_delete(prepare->next);
+	jit_op_delete(call);
+	jit_op_delete(prepare);
+}
+
+/**
+ * Inlines calls of small functions generated by the same compiler; returns
+ * the number of inlined calls
+ */
+static int jit_inline_calls(struct jit * jit)
+{
+	int inlined = 0;
+	jit_op * prolog = NULL;
+	int gp_base = 0, fp_base = 0;
+
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (GET_OP(op) == JIT_PROLOG) {
+			// the first unused registers of the function
+			prolog = op;
+			gp_base = 0;
+			fp_base = 0;
+			for (jit_op * o = op->next; o && (GET_OP(o) != JIT_PROLOG); o = o->next)
+				jit_op_count_regs(o, &gp_base, &fp_base);
+			continue;
+		}
+		if ((GET_OP(op) != JIT_PREPARE) || !prolog) continue;
+
+		jit_op * call = prepared_call(op);
+		struct jit_func_info * callee = call ? called_func_info(call) : NULL;
+		if (!callee || (callee->first_op == prolog)) continue;
+
+		struct jit_inlined_func f;
+		if (!inline_analyze_callee(callee->first_op, &f)) continue;
+		if (!inline_check_args(op, call, &f)) continue;
+
+		jit_op * retval = call->next;
+		if ((GET_OP(retval) == JIT_RETVAL) && (f.ret_type != JIT_RET)) continue;
+		if ((GET_OP(retval) == JIT_FRETVAL) && ((f.ret_type != JIT_FRET) || (retval->arg_size != sizeof(double)))) continue;
+
+		jit_op * prev = op->prev;
+		inline_call(op, call, &f, gp_base, fp_base);
+		op = prev;
+
+		gp_base += f.gp_reg_cnt + f.gp_arg_cnt;
+		fp_base += f.fp_reg_cnt + f.fp_arg_cnt;
+		inlined++;
+	}
+
+	jit->stats[JIT_STAT_INLINED_CALLS] += inlined;
+	return inlined;
+}
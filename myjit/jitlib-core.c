@@ -49,8 +49,17 @@
 #include "jitlib-debug.c"
 #include "code-check.c"
 #include "flow-analysis.h"
+#include "inliner.h"
+#include "if-conversion.h"
+#include "loop-unrolling.h"
 #include "rmap.h"
 #include "reg-allocator.h"
+#include "jump-threading.h"
+#include "block-layout.h"
+#include "ssa.h"
+#include "dead-stores.h"
+#include "redundant-loads.h"
+#include "mem2reg.h"
 
 
 
@@ -93,6 +102,7 @@ struct jit * jit_init()
 	r->ops = jit_op_new(JIT_CODESTART, SPEC(NO, NO, NO), 0, 0, 0, 0);
 	r->last_op = r->ops;
 	r->optimizations = 0;
+	memset(r->stats, 0, sizeof(r->stats));
 
 	r->buf = NULL;
 	r->mmaped_buf = 0;
@@ -116,9 +126,23 @@ jit_op *jit_add_prolog(struct jit * jit, void * func, struct jit_debug_info *deb
         info->allocai_mem = 0;
         info->general_arg_cnt = 0;
         info->float_arg_cnt = 0;
+        info->gp_slots = NULL;
+        info->fp_slots = NULL;
+        info->gp_spill_regs = NULL;
+        info->clobbered_regs[0] = -1;
+        info->clobbered_regs[1] = -1;
+        info->private_conv = 0;
+        info->aligned_stack = 1;
+        info->c_entry = -1;
+        info->free_frame_reg = 0;
 	return op;
 }
 
+void jit_declare_private(struct jit * jit)
+{
+	jit_current_func_info(jit)->private_conv = 1;
+}
+
 jit_label * jit_get_label(struct jit * jit)
 {
         jit_label * r = JIT_MALLOC(sizeof(jit_label));
@@ -365,6 +389,8 @@ static inline void jit_prepare_arguments(struct jit * jit)
 		if (GET_OP(op) == JIT_PROLOG) {
 			info = (struct jit_func_info *)op->arg[1];
 			info->has_prolog = 1;
+			info->sp_relative_frame = 0;
+			info->red_zone = 0;
 			gp_arg_pos = 0;
 			fp_arg_pos = 0;
 			argpos = 0;
@@ -408,6 +434,15 @@ static inline void jit_buf_expand(struct jit * jit)
 void jit_generate_code(struct jit * jit)
 {
 	jit_expand_patches_and_labels(jit);
+	// jumps of the inlined code have to be linked again
+	if ((jit->optimizations & JIT_OPT_INLINE) && jit_inline_calls(jit)) jit_expand_patches_and_labels(jit);
+	if (jit->optimizations & JIT_OPT_IF_CONVERSION) jit_convert_ifs(jit);
+	if ((jit->optimizations & JIT_OPT_UNROLL) && jit_unroll_loops(jit)) jit_expand_patches_and_labels(jit);
+	if (jit->optimizations & JIT_OPT_MEM2REG) jit_promote_frame_slots(jit);
+	if (jit->optimizations & JIT_OPT_SSA) jit_optimize_ssa(jit);
+	if (jit->optimizations & JIT_OPT_REDUNDANT_LOADS) jit_eliminate_redundant_loads(jit);
+	if (jit->optimizations & JIT_OPT_DEAD_STORES) jit_eliminate_dead_stores(jit);
+	if (jit->optimizations & JIT_OPT_JUMP_THREADING) jit_thread_jumps(jit);
 #if JIT_IMM_BITS > 0
 	jit_correct_long_imms(jit);
 #endif
@@ -427,21 +462,25 @@ void jit_generate_code(struct jit * jit)
 
 
 #if defined(JIT_ARCH_I386) || defined(JIT_ARCH_AMD64)
-	int change = 0;
-	jit_optimize_st_ops(jit);
-	if (jit->optimizations & JIT_OPT_JOIN_ADDMUL) {
-		change |= jit_optimize_join_addmul(jit);
-		change |= jit_optimize_join_addimm(jit);
-	}
 	// oops, we have changed the code structure, we have to do the analysis again
-	if (change) jit_flw_analysis(jit);
+	if (jit_select_instructions(jit)) jit_flw_analysis(jit);
 #endif
 	jit_collect_statistics(jit);
+#ifdef JIT_ARCH_COMMON86
+	if (jit->optimizations & JIT_OPT_OMIT_FRAME_PTR) jit_free_frame_reg(jit);
+#endif
 	jit_assign_regs(jit);
+	if (jit->optimizations & JIT_OPT_REMATERIALIZE) jit_rematerialize(jit);
+	if (jit->optimizations & JIT_OPT_REDUNDANT_SPILLS) jit_eliminate_redundant_spills(jit);
+	jit_assign_stack_slots(jit);
 
 #ifdef JIT_ARCH_COMMON86
+	if (jit->optimizations & JIT_OPT_INTERPROC_REGS) jit_collect_clobbered_regs(jit);
 	if (jit->optimizations & JIT_OPT_OMIT_FRAME_PTR) jit_optimize_frame_ptr(jit);
 #endif
+	if (jit->optimizations & JIT_OPT_BLOCK_LAYOUT) jit_place_blocks(jit);
+	// the register allocator adds jumps which may be redundant
+	if (jit->optimizations & JIT_OPT_JUMP_THREADING) jit_thread_jumps(jit);
 
 	jit->buf_capacity = BUF_SIZE;
 	jit->buf = JIT_MALLOC(jit->buf_capacity);
@@ -474,6 +513,15 @@ void jit_generate_code(struct jit * jit)
 			case JIT_MARK:
 			case JIT_TOUCH:
 				break;
+			case JIT_UREG:
+			case JIT_SYNCREG:
+				jit->stats[JIT_STAT_SPILLS]++;
+				jit_gen_op(jit, op);
+				break;
+			case JIT_LREG:
+				jit->stats[JIT_STAT_RELOADS]++;
+				jit_gen_op(jit, op);
+				break;
 			// platform specific opcodes
 			default: jit_gen_op(jit, op);
 		}
@@ -482,8 +530,20 @@ void jit_generate_code(struct jit * jit)
 		op->code_length = offset_2 - offset_1;
 	}
 
+#ifdef JIT_ARCH_AMD64
+	/* functions with the private calling convention need an entry point for C code */
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (GET_OP(op) != JIT_PROLOG) continue;
+		struct jit_func_info * info = (struct jit_func_info *) op->arg[1];
+		if (!op->arg[0] || !info->private_conv || (info->general_arg_cnt <= jit->reg_al->gp_arg_reg_cnt)) continue;
+		if (jit->buf_capacity - (jit->ip - jit->buf) < MINIMAL_BUF_SPACE) jit_buf_expand(jit);
+		emit_c_entry(jit, op);
+	}
+#endif
+
 	/* moves the code to its final destination */
 	int code_size = jit->ip - jit->buf;
+	jit->stats[JIT_STAT_CODE_SIZE] = code_size;
 	//void * mem;
 	//posix_memalign(&mem, sysconf(_SC_PAGE_SIZE), code_size);
 	//mprotect(mem, code_size, PROT_READ | PROT_EXEC | PROT_WRITE);
@@ -503,8 +563,11 @@ void jit_generate_code(struct jit * jit)
 
 	/* assigns functions */
 	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
-		if (GET_OP(op) == JIT_PROLOG)
-			*(void **)(op->arg[0]) = jit->buf + (intptr_t)op->patch_addr;
+		if ((GET_OP(op) == JIT_PROLOG) && op->arg[0]) {
+			struct jit_func_info * info = (struct jit_func_info *) op->arg[1];
+			intptr_t entry = (info->c_entry >= 0 ? info->c_entry : op->patch_addr);
+			*(void **)(op->arg[0]) = jit->buf + entry;
+		}
 	}
 }
 
@@ -546,6 +609,7 @@ static int is_cond_branch_op(jit_op *op)
 	jit_opcode code = GET_OP(op);
 	return (code == JIT_BLT) || (code == JIT_BLE) || (code == JIT_BGT)
 	|| (code == JIT_BGE) || (code == JIT_BEQ) ||  (code == JIT_BNE)
+	|| (code == JIT_BMS) || (code == JIT_BMC)
 	|| (code == JIT_FBLT) || (code == JIT_FBLE) || (code == JIT_FBGT)
 	|| (code == JIT_FBGE) || (code == JIT_FBEQ) ||  (code == JIT_FBNE)
 	|| (code == JIT_BOADD) || (code == JIT_BOSUB) || (code == JIT_BNOADD)
@@ -563,6 +627,44 @@ void jit_disable_optimization(struct jit * jit, int opt)
 	jit->optimizations &= ~opt;
 }
 
+int jit_get_stat(struct jit * jit, enum jit_stat stat)
+{
+	return jit->stats[stat];
+}
+
+/**
+ * Sets the probability (in percents) that the branch is taken
+ */
+jit_op * jit_branch_probability(jit_op * op, int probability)
+{
+	if (probability < 0) probability = 0;
+	if (probability > 100) probability = 100;
+	op->probability = probability;
+	return op;
+}
+
+/**
+ * Sets the probability of the branch according to the measured number
+ * of its executions
+ */
+jit_op * jit_branch_counts(jit_op * op, jit_value taken, jit_value not_taken)
+{
+	if (taken + not_taken <= 0) return op;
+	return jit_branch_probability(op, (int) ((double) taken * 100 / ((double) taken + not_taken) + 0.5));
+}
+
+/**
+ * Sets the unrolling factor of the loop closed by the given backward branch;
+ * factor 1 prevents the loop from being unrolled
+ */
+jit_op * jit_unroll_loop(jit_op * op, int factor)
+{
+	if (factor < 1) factor = 1;
+	if (factor > JIT_UNROLL_MAX_FACTOR) factor = JIT_UNROLL_MAX_FACTOR;
+	op->unroll = factor;
+	return op;
+}
+
 void jit_free(struct jit * jit)
 {
 	jit_reg_allocator_free(jit->reg_al);
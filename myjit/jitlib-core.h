@@ -75,6 +75,7 @@ struct jit_reg_allocator {
 	jit_hw_reg ** gp_arg_regs;		// array of GP registers used to pass arguments (in the given order)
 	jit_hw_reg ** fp_arg_regs;		// array of FP registers used to pass arguments (in the given order)
 	struct jit_func_info * current_func_info; // information on currently processed function
+	struct jit_loop * current_loop;		// innermost loop containing the currently processed operation
 };
 
 typedef struct jit_rmap {
@@ -85,9 +86,19 @@ struct jit_allocator_hint {
 	int last_pos;
 	int should_be_calleesaved;
 	int should_be_eax;
+	int preferred_reg;		// hw. register required by some operation, or -1
+	int avoided_regs;		// mask of hw. registers clobbered by some operations
 	int refs;			// counts number of references to the hint
 };
 
+struct jit_loop {
+	jit_op * header;		// target of the backward jump(s)
+	jit_op * end;			// the last backward jump to the header
+	struct jit_set * used;		// registers used inside the loop
+	int pressure[2];		// max. number of used GP and FP registers alive at once
+	struct jit_loop * parent;	// enclosing loop
+};
+
 typedef struct jit_prepared_args {
 	int count;	// number of arguments to prepare
 	int ready;	// number of arguments that have been prapared
@@ -95,6 +106,8 @@ typedef struct jit_prepared_args {
 	int fp_args;	// number od prepared FP arguments
 	int stack_size; // size of stack occupied by passed arguments
 	jit_op * op;	// corresponding ``PREPARE'' operation
+	struct jit_func_info * callee; // called function if it is generated by the same compiler
+	int gp_arg_reg_cnt; // number of GP registers used to pass arguments to the called function
 	struct jit_out_arg {// array of arguments
 		union {
 			intptr_t generic;
@@ -133,7 +146,19 @@ struct jit_func_info {			// collection of information related to one function
 
 	int gp_reg_count;		// total number of GP registers used in the processed function
 	int fp_reg_count;		// total number of FP registers used in the processed function
+	int gp_slot_count;		// number of stack slots for spilled GP registers
+	int fp_slot_count;		// number of stack slots for spilled FP registers
+	int * gp_slots;			// stack slots assigned to GP registers (-1 if the register is never spilled)
+	int * fp_slots;			// stack slots assigned to FP registers (-1 if the register is never spilled)
+	int * gp_spill_regs;		// FP registers holding spilled GP registers (-1 if the register is spilled on the stack)
+	jit_value clobbered_regs[2];	// GP and FP hw. registers (bit masks) which may be overwritten by the function and its callees
+	int private_conv;		// flag indicating if the function uses the private calling convention
+	int aligned_stack;		// flag indicating if the function (or some of its callees) requires the aligned stack
+	intptr_t c_entry;		// offset of the C-callable entry of a function with the private calling convention (-1 if not generated)
 	int has_prolog;			// flag indicating if the function has a complete prologue and epilogue
+	int sp_relative_frame;		// flag indicating if the frame is addressed through the stack pointer
+	int red_zone;			// flag indicating if the frame is placed into the red zone
+	int free_frame_reg;		// flag indicating if the frame pointer register can be allocated
 	struct jit_op *first_op;	// first operation of the function
 #if defined(JIT_ARCH_ARM32)
 	int gp_callee_saved_regs;	// bit mask describing used callee saved registers
@@ -154,6 +179,7 @@ struct jit {
 	jit_prepared_args prepared_args; // list of arguments passed between PREPARE-CALL
 	int push_count;			// number of values pushed on the stack; used by AMD64
 	unsigned int optimizations;
+	int stats[JIT_STAT_COUNT];	// counters collected by the optimizer
 	unsigned char mmaped_buf;	// indicates that the buffer was allocated with the `mmap' call
 };
 
@@ -170,9 +196,8 @@ void jit_patch_local_addrs(struct jit *jit);
 
 void jit_collect_statistics(struct jit * jit);
 
-void jit_optimize_st_ops(struct jit * jit);
-int jit_optimize_join_addmul(struct jit * jit);
-int jit_optimize_join_addimm(struct jit * jit);
+int jit_select_instructions(struct jit * jit);
+void jit_free_frame_reg(struct jit * jit);
 void jit_optimize_frame_ptr(struct jit * jit);
 void jit_optimize_unused_assignments(struct jit * jit);
 static int is_cond_branch_op(jit_op *op); // FIXME: rename to: jit_op_is_cond_branch
@@ -189,11 +214,16 @@ void jit_init_arg_params(struct jit * jit, struct jit_func_info * info, int argp
 
 /* FIXME: presunout do generic-reg-allocator.h */
 void jit_assign_regs(struct jit * jit);
+void jit_rematerialize(struct jit * jit);
+void jit_eliminate_redundant_spills(struct jit * jit);
+void jit_assign_stack_slots(struct jit * jit);
+void jit_collect_clobbered_regs(struct jit * jit);
 struct jit_reg_allocator * jit_reg_allocator_create();
 void jit_reg_allocator_free(struct jit_reg_allocator * a);
 void jit_gen_op(struct jit * jit, jit_op * op);
 char * jit_reg_allocator_get_hwreg_name(struct jit_reg_allocator * al, int reg);
 int jit_reg_in_use(jit_op * op, int reg, int fp);
+int jit_reg_live_out(jit_op * op, int reg, int fp);
 jit_hw_reg * jit_get_unused_reg(struct jit_reg_allocator * al, jit_op * op, int fp);
 jit_hw_reg * jit_get_unused_reg_with_index(struct jit_reg_allocator * al, jit_op * op, int fp, int index);
 void rmap_free(jit_rmap * regmap);
@@ -217,6 +247,8 @@ static struct jit_op * jit_op_new(unsigned short code, unsigned char spec, intpt
 
 	r->assigned = 0;
 	r->in_use = 1;
+	r->probability = -1;
+	r->unroll = 0;
 	r->arg_size = arg_size;
 	r->next = NULL;
 	r->prev = NULL;
@@ -270,6 +302,9 @@ static inline void jit_free_op(struct jit_op *op)
         if (GET_OP(op) == JIT_PROLOG) {
                 struct jit_func_info * info = (struct jit_func_info *)op->arg[1];
                 JIT_FREE(info->args);
+                if (info->gp_slots) JIT_FREE(info->gp_slots);
+                if (info->fp_slots) JIT_FREE(info->fp_slots);
+                if (info->gp_spill_regs) JIT_FREE(info->gp_spill_regs);
                 JIT_FREE(info);
         }
 
@@ -298,6 +333,116 @@ static inline struct jit_func_info * jit_current_func_info(struct jit * jit)
 	return (struct jit_func_info *)(jit->current_func->arg[1]);
 }
 
+/**
+ * Returns 1 if the operation may keep the original value of its target
+ * register, i.e., the target register is read as well as written
+ */
+static inline int jit_reads_target_reg(jit_op * op)
+{
+	jit_opcode code = GET_OP(op);
+	return (code == JIT_MOVN) || (code == JIT_MOVZ) || (code == JIT_FMOVN) || (code == JIT_FMOVZ);
+}
+
+/**
+ * Replaces the condition of the branch with its negation
+ */
+static inline void jit_negate_branch(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_BEQ: op->code = JIT_BNE | (op->code & 0x7); break;
+		case JIT_BGT: op->code = JIT_BLE | (op->code & 0x7); break;
+		case JIT_BGE: op->code = JIT_BLT | (op->code & 0x7); break;
+		case JIT_BNE: op->code = JIT_BEQ | (op->code & 0x7); break;
+		case JIT_BLT: op->code = JIT_BGE | (op->code & 0x7); break;
+		case JIT_BLE: op->code = JIT_BGT | (op->code & 0x7); break;
+		case JIT_BMS: op->code = JIT_BMC | (op->code & 0x7); break;
+		case JIT_BMC: op->code = JIT_BMS | (op->code & 0x7); break;
+
+		case JIT_BOADD: op->code = JIT_BNOADD | (op->code & 0x7); break;
+		case JIT_BOSUB: op->code = JIT_BNOSUB | (op->code & 0x7); break;
+		case JIT_BNOADD: op->code = JIT_BOADD | (op->code & 0x7); break;
+		case JIT_BNOSUB: op->code = JIT_BOSUB | (op->code & 0x7); break;
+
+		case JIT_FBEQ: op->code = JIT_FBNE | (op->code & 0x7); break;
+		case JIT_FBGT: op->code = JIT_FBLE | (op->code & 0x7); break;
+		case JIT_FBGE: op->code = JIT_FBLT | (op->code & 0x7); break;
+		case JIT_FBNE: op->code = JIT_FBEQ | (op->code & 0x7); break;
+		case JIT_FBLT: op->code = JIT_FBGE | (op->code & 0x7); break;
+		case JIT_FBLE: op->code = JIT_FBGT | (op->code & 0x7); break;
+		default: break;
+	}
+	if (op->probability >= 0) op->probability = 100 - op->probability;
+}
+
+#ifdef JIT_ARCH_AMD64
+#define JIT_PRIVATE_GP_ARG_REG_CNT	(8)
+#endif
+
+/**
+ * Returns information on the function called by the operation if the callee
+ * is a function generated by the same compiler, otherwise returns NULL
+ */
+static inline struct jit_func_info * called_func_info(jit_op * op)
+{
+	if ((GET_OP(op) != JIT_CALL) || !IS_IMM(op) || !op->jmp_addr || (GET_OP(op->jmp_addr) != JIT_LABEL)) return NULL;
+	for (jit_op * o = op->jmp_addr; o != NULL; o = o->next) {
+		switch (GET_OP(o)) {
+			case JIT_LABEL: case JIT_PATCH: case JIT_COMMENT: case JIT_MARK: break;
+			case JIT_PROLOG: return (struct jit_func_info *) o->arg[1];
+			default: return NULL;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Raises the given numbers of GP and FP registers so that they cover
+ * all ordinary registers (i.e., not arguments or special registers)
+ * used by the operation
+ */
+static inline void jit_op_count_regs(jit_op * op, int * gp_cnt, int * fp_cnt)
+{
+	for (int i = 0; i < 3; i++) {
+		if ((ARG_TYPE(op, i + 1) != REG) && (ARG_TYPE(op, i + 1) != TREG)) continue;
+		jit_reg r = (jit_reg) op->arg[i];
+		if (JIT_REG_SPEC(r) != JIT_RTYPE_REG) continue;
+		if ((JIT_REG_TYPE(r) == JIT_RTYPE_INT) && (JIT_REG_ID(r) >= *gp_cnt)) *gp_cnt = JIT_REG_ID(r) + 1;
+		if ((JIT_REG_TYPE(r) == JIT_RTYPE_FLOAT) && (JIT_REG_ID(r) >= *fp_cnt)) *fp_cnt = JIT_REG_ID(r) + 1;
+	}
+}
+
+/**
+ * Returns the CALL operation which terminates the prepare-call block
+ */
+static inline jit_op * prepared_call(jit_op * op)
+{
+	while (op && (GET_OP(op) != JIT_CALL)) op = op->next;
+	return op;
+}
+
+/**
+ * Returns position of the argument passed by the PUTARG operation among
+ * integer arguments of the call
+ */
+static inline int putarg_gp_pos(jit_op * op)
+{
+	int pos = 0;
+	for (op = op->prev; GET_OP(op) != JIT_PREPARE; op = op->prev)
+		if (GET_OP(op) == JIT_PUTARG) pos++;
+	return pos;
+}
+
+/**
+ * Functions with the private calling convention receive more arguments in registers
+ */
+static inline int jit_gp_arg_reg_cnt(struct jit_reg_allocator * al, struct jit_func_info * info)
+{
+#ifdef JIT_ARCH_AMD64
+	if (info && info->private_conv) return JIT_PRIVATE_GP_ARG_REG_CNT;
+#endif
+	return al->gp_arg_reg_cnt;
+}
+
 static inline void funcall_prepare(struct jit * jit, jit_op * op, int count)
 {
 	jit->prepared_args.args = JIT_MALLOC(sizeof(struct jit_out_arg) * count);
@@ -307,6 +452,8 @@ static inline void funcall_prepare(struct jit * jit, jit_op * op, int count)
 	jit->prepared_args.op = op;
 	jit->prepared_args.gp_args = 0;
 	jit->prepared_args.fp_args = 0;
+	jit->prepared_args.callee = called_func_info(prepared_call(op));
+	jit->prepared_args.gp_arg_reg_cnt = jit_gp_arg_reg_cnt(jit->reg_al, jit->prepared_args.callee);
 }
 
 static inline void funcall_put_arg(struct jit * jit, jit_op * op)
@@ -319,7 +466,7 @@ static inline void funcall_put_arg(struct jit * jit, jit_op * op)
 	arg->argpos = jit->prepared_args.gp_args++;
 	jit->prepared_args.ready++;
 
-	if (jit->prepared_args.gp_args > jit->reg_al->gp_arg_reg_cnt) {
+	if (jit->prepared_args.gp_args > jit->prepared_args.gp_arg_reg_cnt) {
 		jit->prepared_args.stack_size += REG_SIZE;
 	}
 }
@@ -222,6 +222,8 @@ char * jit_get_op_name(struct jit_op * op)
 		case JIT_STX:	return "stx";
 		case JIT_MEMCPY:return "memcpy";
 		case JIT_MEMSET:return "memset";
+		case JIT_MOVN:	return "movn";
+		case JIT_MOVZ:	return "movz";
 
 		case JIT_JMP:		return "jmp";
 		case JIT_PATCH:		return ".patch";
@@ -247,6 +249,9 @@ char * jit_get_op_name(struct jit_op * op)
 		case JIT_HMUL:	return "hmul";
 		case JIT_DIV:	return "div";
 		case JIT_MOD:	return "mod";
+		case JIT_MIN:	return "min";
+		case JIT_MAX:	return "max";
+		case JIT_ABS:	return "abs";
 
 		case JIT_OR:	return "or";
 		case JIT_XOR:	return "xor";
@@ -308,12 +313,15 @@ char * jit_get_op_name(struct jit_op * op)
 		case JIT_TRANSFER_SUB: return "transfer_sub";
 
 		case JIT_FMOV:	return "fmov";
+		case JIT_FMOVN:	return "fmovn";
+		case JIT_FMOVZ:	return "fmovz";
 		case JIT_FADD: 	return "fadd";
 		case JIT_FSUB: 	return "fsub";
 		case JIT_FRSB: 	return "frsb";
 		case JIT_FMUL: 	return "fmul";
 		case JIT_FDIV: 	return "fdiv";
 		case JIT_FNEG: 	return "fneg";
+		case JIT_FABS: 	return "fabs";
 		case JIT_FRETVAL: return "fretval";
 		case JIT_FPUTARG: return "fputarg";
 
@@ -322,6 +330,15 @@ char * jit_get_op_name(struct jit_op * op)
 		case JIT_TRUNC: return "trunc";
 		case JIT_FLOOR: return "floor";
 		case JIT_CEIL: 	return "ceil";
+		case JIT_FMIN: 	return "fmin";
+		case JIT_FMAX: 	return "fmax";
+
+		case JIT_FLT: return "flt";
+		case JIT_FLE: return "fle";
+		case JIT_FGT: return "fgt";
+		case JIT_FGE: return "fge";
+		case JIT_FEQ: return "feq";
+		case JIT_FNE: return "fne";
 
 		case JIT_FBLT: return "fblt";
 		case JIT_FBLE: return "fble";
@@ -336,6 +353,21 @@ char * jit_get_op_name(struct jit_op * op)
 		case JIT_FSTX:	return "fstx";
 
 		case JIT_FRET: return "fret";
+
+		case JIT_X86_STI:	return "x86_st";
+		case JIT_X86_STXI:	return "x86_stx";
+		case JIT_X86_ADDMUL:	return "x86_addmul";
+		case JIT_X86_ADDIMM:	return "x86_addimm";
+		case JIT_X86_LDXM:	return "x86_ldxm";
+		case JIT_X86_STXM:	return "x86_stxm";
+		case JIT_X86_ADDM:	return "x86_addm";
+		case JIT_X86_SUBM:	return "x86_subm";
+		case JIT_X86_RSBM:	return "x86_rsbm";
+		case JIT_X86_ANDM:	return "x86_andm";
+		case JIT_X86_ORM:	return "x86_orm";
+		case JIT_X86_XORM:	return "x86_xorm";
+		case JIT_X86_INC:	return "x86_inc";
+		case JIT_X86_DEC:	return "x86_dec";
 		default: return "(unknown)";
 	}
 }
@@ -459,6 +491,27 @@ static void print_args(struct jit_disasm *disasm, struct output_buf *linebuf, ji
 	}
 }
 
+#if defined(JIT_ARCH_I386) || defined(JIT_ARCH_AMD64)
+/**
+ * Prints the scale and displacement of memory operands created by the x86 optimizer
+ */
+static void print_x86_mem_operand(struct jit_disasm *disasm, struct output_buf *linebuf, jit_op *op)
+{
+	switch (GET_OP(op)) {
+		case JIT_X86_LDXM: case JIT_X86_STXM:
+			ob_printf(linebuf, ", scale %i", 1 << X86_MEM_SHIFT(op));
+			break;
+		case JIT_X86_ADDM: case JIT_X86_SUBM: case JIT_X86_RSBM:
+		case JIT_X86_ANDM: case JIT_X86_ORM: case JIT_X86_XORM:
+			break;
+		default:
+			if (!is_int_comparison(op) || !op->arg_size) return;
+	}
+	ob_append(linebuf, ", disp ");
+	ob_printf(linebuf, disasm->generic_value_template, x86_mem_disp(op));
+}
+#endif
+
 void print_full_op_name(struct output_buf *linebuf, jit_op *op)
 {
 	char *op_name = jit_get_op_name(op);
@@ -489,8 +542,9 @@ static int print_load_op(struct jit_disasm *disasm, struct output_buf *linebuf,
 			ob_append(linebuf, rbuf);
 			return 1;
 		case JIT_RENAMEREG: {
-				jit_value reg;
-				rmap_is_associated(op->prev->regmap, op->arg[1], 0, &reg);
+				jit_value reg = op->arg[2];
+				// reloads replaced with moves carry the virtual register along
+				if (ARG_TYPE(op, 3) != IMM) rmap_is_associated(op->prev->regmap, op->arg[1], 0, &reg);
 				ob_append(linebuf, disasm->indent_template);
 				ob_append(linebuf, jit_get_op_name(op));
 				ob_append(linebuf, " ");
@@ -621,6 +675,9 @@ int print_op(FILE *f, struct jit_disasm * disasm, struct jit_op *op, jit_tree *l
 		default:
 			print_args(disasm, linebuf, op, labels);
 	}
+#if defined(JIT_ARCH_I386) || defined(JIT_ARCH_AMD64)
+	print_x86_mem_operand(disasm, linebuf, op);
+#endif
 print:
 	fprintf(f, "%s", linebuf->buf);
 	int len = strlen(linebuf->buf);
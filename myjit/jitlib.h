@@ -62,6 +62,8 @@ typedef struct jit_op {
         unsigned char assigned;
         unsigned char fp;               // FP if it's a floating-point operation
 	unsigned char in_use;		// used be dead-code analyzer
+	signed char probability;	// probability (in %) that the branch is taken, -1 if unknown
+	unsigned char unroll;		// unrolling factor of the loop closed by the branch, 0 if not given
         double flt_imm;                 // floating point immediate value
         jit_value arg[3];               // arguments passed by user
         jit_value r_arg[3];             // arguments transformed by register allocator
@@ -159,6 +161,8 @@ typedef enum {
 	JIT_STX		= (0x24 << 3),
 	JIT_MEMCPY	= (0x25 << 3),
 	JIT_MEMSET	= (0x26 << 3),
+	JIT_MOVN	= (0x27 << 3),
+	JIT_MOVZ	= (0x28 << 3),
 
 	JIT_JMP 	= (0x30 << 3),
 	JIT_PREPARE 	= (0x31 << 3),
@@ -182,6 +186,9 @@ typedef enum {
 	JIT_HMUL	= (0x49 << 3),
 	JIT_DIV		= (0x4a << 3),
 	JIT_MOD		= (0x4b << 3),
+	JIT_MIN		= (0x4c << 3),
+	JIT_MAX		= (0x4d << 3),
+	JIT_ABS		= (0x4e << 3),
 
 	JIT_OR	 	= (0x50 << 3),
 	JIT_XOR 	= (0x51 << 3),
@@ -217,12 +224,15 @@ typedef enum {
 	JIT_FMUL	= (0x84 << 3),
 	JIT_FDIV	= (0x85 << 3),
 	JIT_FNEG	= (0x86 << 3),
+	JIT_FABS	= (0x87 << 3),
 
 	JIT_EXT		= (0x89 << 3),
 	JIT_ROUND	= (0x8a << 3),
 	JIT_TRUNC	= (0x8b << 3),
 	JIT_FLOOR	= (0x8c << 3),
 	JIT_CEIL	= (0x8d << 3),
+	JIT_FMIN	= (0x8e << 3),
+	JIT_FMAX	= (0x8f << 3),
 
 	JIT_FBLT 	= (0x90 << 3),
 	JIT_FBLE	= (0x91 << 3),
@@ -230,6 +240,14 @@ typedef enum {
 	JIT_FBGE	= (0x93 << 3),
 	JIT_FBEQ	= (0x94 << 3),
 	JIT_FBNE	= (0x95 << 3),
+	JIT_FMOVN	= (0x96 << 3),
+	JIT_FMOVZ	= (0x97 << 3),
+	JIT_FLT		= (0x98 << 3),
+	JIT_FLE		= (0x99 << 3),
+	JIT_FGT		= (0x9a << 3),
+	JIT_FGE		= (0x9b << 3),
+	JIT_FEQ		= (0x9c << 3),
+	JIT_FNE		= (0x9d << 3),
 
 	JIT_FLD		= (0xa0 << 3),
 	JIT_FLDX	= (0xa1 << 3),
@@ -266,6 +284,16 @@ typedef enum {
 	JIT_X86_STXI    = (0x0101 << 3),
 	JIT_X86_ADDMUL  = (0x0102 << 3),
 	JIT_X86_ADDIMM  = (0x0103 << 3),
+	JIT_X86_LDXM    = (0x0104 << 3),
+	JIT_X86_STXM    = (0x0105 << 3),
+	JIT_X86_ADDM    = (0x0106 << 3),
+	JIT_X86_SUBM    = (0x0107 << 3),
+	JIT_X86_RSBM    = (0x0108 << 3),
+	JIT_X86_ANDM    = (0x0109 << 3),
+	JIT_X86_ORM     = (0x010a << 3),
+	JIT_X86_XORM    = (0x010b << 3),
+	JIT_X86_INC     = (0x010c << 3),
+	JIT_X86_DEC     = (0x010d << 3),
 
 	// opcodes for testing and debugging purposes only
 	JIT_FORCE_SPILL	= (0x0200 << 3),
@@ -282,6 +310,36 @@ enum jit_inp_type {
 	JIT_PTR
 };
 
+enum jit_stat {
+	JIT_STAT_AVOIDED_SPILLS,	// spills of rematerializable values which were omitted
+	JIT_STAT_AVOIDED_RELOADS,	// reloads which were replaced with rematerialization
+	JIT_STAT_SPILLS,		// values stored from hw. registers on the stack
+	JIT_STAT_RELOADS,		// values loaded from the stack into hw. registers
+	JIT_STAT_FRAME_SIZE,		// total size of stack frames (in bytes)
+	JIT_STAT_REDUNDANT_SPILLS,	// spills of values which were already on the stack
+	JIT_STAT_REDUNDANT_RELOADS,	// reloads of values which were already in a hw. register
+	JIT_STAT_SPILLS_TO_FP_REGS,	// spilled GP registers kept in unused FP registers
+	JIT_STAT_AVOIDED_SAVES,		// caller-saved registers which were not saved since the callee does not use them
+	JIT_STAT_TAIL_CALLS,		// calls in a tail position replaced with jumps
+	JIT_STAT_INLINED_CALLS,		// calls replaced with the body of the callee
+	JIT_STAT_IF_CONVERSIONS,	// conditional branches replaced with conditional moves
+	JIT_STAT_ELIMINATED_JUMPS,	// jumps removed or bypassed by jump threading
+	JIT_STAT_COLD_BLOCKS,		// unlikely executed blocks moved behind the code of the function
+	JIT_STAT_UNROLLED_LOOPS,	// loops whose body was replicated
+	JIT_STAT_FOLDED_OPS,		// operations simplified by the constant propagation
+	JIT_STAT_DEAD_OPS,		// operations removed since their results were not used
+	JIT_STAT_DEAD_STORES,		// stores to the frame removed since the stored values were not read
+	JIT_STAT_FORWARDED_LOADS,	// loads replaced with the value stored before
+	JIT_STAT_REDUNDANT_LOADS,	// loads replaced with the value loaded before
+	JIT_STAT_PROMOTED_SLOTS,	// stack slots replaced with registers
+	JIT_STAT_FOLDED_LOADS,		// loads merged into ALU operations and comparisons as memory operands
+	JIT_STAT_COMBINED_ADDRESSES,	// address computations merged into addressing modes of loads, stores, and LEA
+	JIT_STAT_FUSED_TESTS,		// AND operations merged into conditional branches as TEST
+	JIT_STAT_INC_DEC,		// additions and subtractions of one replaced with INC or DEC
+	JIT_STAT_CODE_SIZE,		// size of the generated code (in bytes)
+	JIT_STAT_COUNT
+};
+
 enum jit_warning {
 	JIT_WARN_DEAD_CODE 		= 0x00000001,
 	JIT_WARN_OP_WITHOUT_EFFECT 	= 0x00000002,
@@ -314,7 +372,23 @@ enum jit_warning {
 #define JIT_OPT_OMIT_UNUSED_ASSIGNEMENTS        (0x02)
 #define JIT_OPT_JOIN_ADDMUL                     (0x04)
 #define JIT_OPT_DEAD_CODE			(0x08)
-#define JIT_OPT_ALL                             (0xff)
+#define JIT_OPT_REMATERIALIZE			(0x10)
+#define JIT_OPT_REDUNDANT_SPILLS		(0x20)
+#define JIT_OPT_SPILLS_TO_FP_REGS		(0x40)
+#define JIT_OPT_INTERPROC_REGS			(0x80)
+#define JIT_OPT_TAIL_CALLS			(0x100)
+#define JIT_OPT_INLINE				(0x200)
+#define JIT_OPT_IF_CONVERSION			(0x400)
+#define JIT_OPT_JUMP_THREADING			(0x800)
+#define JIT_OPT_BLOCK_LAYOUT			(0x1000)
+#define JIT_OPT_UNROLL				(0x2000)
+#define JIT_OPT_SSA				(0x4000)
+#define JIT_OPT_DEAD_STORES			(0x8000)
+#define JIT_OPT_REDUNDANT_LOADS			(0x10000)
+#define JIT_OPT_MEM2REG				(0x20000)
+#define JIT_OPT_MEMORY_OPERANDS			(0x40000)
+#define JIT_OPT_COMPACT_OPS			(0x80000)
+#define JIT_OPT_ALL                             (0xfffff)
 
 struct jit * jit_init();
 struct jit_op * jit_add_op(struct jit * jit, unsigned short code, unsigned char spec, jit_value arg1, jit_value arg2, jit_value arg3, unsigned char arg_sizee, struct jit_debug_info *debug_info);
@@ -329,6 +403,19 @@ void jit_trace(struct jit *jit, int verbosity);
 
 void jit_enable_optimization(struct jit * jit, int opt);
 void jit_disable_optimization(struct jit * jit, int opt);
+int jit_get_stat(struct jit * jit, enum jit_stat stat);
+
+#define JIT_PROB_LIKELY		(90)
+#define JIT_PROB_UNLIKELY	(10)
+
+jit_op * jit_branch_probability(jit_op * op, int probability);
+jit_op * jit_branch_counts(jit_op * op, jit_value taken, jit_value not_taken);
+#define jit_likely(op) jit_branch_probability(op, JIT_PROB_LIKELY)
+#define jit_unlikely(op) jit_branch_probability(op, JIT_PROB_UNLIKELY)
+
+#define JIT_UNROLL_MAX_FACTOR	(16)
+
+jit_op * jit_unroll_loop(jit_op * op, int factor);
 
 #define NO  0x00
 #define REG 0x01
@@ -341,11 +428,14 @@ void jit_disable_optimization(struct jit * jit, int opt);
 jit_op * jit_add_prolog(struct jit *, void *, struct jit_debug_info *);
 jit_label * jit_get_label(struct jit * jit);
 int jit_allocai(struct jit * jit, int size);
+void jit_declare_private(struct jit * jit);
 
 
 #define jit_prolog(jit, _func) jit_add_prolog(jit, _func, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_movr(jit, a, b) jit_add_op(jit, JIT_MOV | REG, SPEC(TREG, REG, NO), a, b, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_movi(jit, a, b) jit_add_op(jit, JIT_MOV | IMM, SPEC(TREG, IMM, NO), a, (jit_value)(b), 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_movnr(jit, a, b, c) jit_add_op(jit, JIT_MOVN | REG, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_movzr(jit, a, b, c) jit_add_op(jit, JIT_MOVZ | REG, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 
 /* functions, call, jumps, etc. */
 
@@ -408,6 +498,18 @@ int jit_allocai(struct jit * jit, int size);
 #define jit_modr_u(jit, a, b, c) jit_add_op(jit, JIT_MOD | REG | UNSIGNED, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_modi_u(jit, a, b, c) jit_add_op(jit, JIT_MOD | IMM | UNSIGNED, SPEC(TREG, REG, IMM), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 
+#define jit_minr(jit, a, b, c) jit_add_op(jit, JIT_MIN | REG | SIGNED, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_mini(jit, a, b, c) jit_add_op(jit, JIT_MIN | IMM | SIGNED, SPEC(TREG, REG, IMM), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_minr_u(jit, a, b, c) jit_add_op(jit, JIT_MIN | REG | UNSIGNED, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_mini_u(jit, a, b, c) jit_add_op(jit, JIT_MIN | IMM | UNSIGNED, SPEC(TREG, REG, IMM), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_maxr(jit, a, b, c) jit_add_op(jit, JIT_MAX | REG | SIGNED, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_maxi(jit, a, b, c) jit_add_op(jit, JIT_MAX | IMM | SIGNED, SPEC(TREG, REG, IMM), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_maxr_u(jit, a, b, c) jit_add_op(jit, JIT_MAX | REG | UNSIGNED, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_maxi_u(jit, a, b, c) jit_add_op(jit, JIT_MAX | IMM | UNSIGNED, SPEC(TREG, REG, IMM), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_absr(jit, a, b) jit_add_op(jit, JIT_ABS, SPEC(TREG, REG, NO), a, b, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
 /* bitwise arithmetics */
 
 #define jit_orr(jit, a, b, c) jit_add_op(jit, JIT_OR | REG, SPEC(TREG, REG, REG), a, b, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
@@ -565,7 +667,13 @@ int jit_allocai(struct jit * jit, int size);
 #define jit_fdivr(jit, a, b, c) jit_add_fop(jit, JIT_FDIV | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_fdivi(jit, a, b, c) jit_add_fop(jit, JIT_FDIV | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 
+#define jit_fminr(jit, a, b, c) jit_add_fop(jit, JIT_FMIN | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fmini(jit, a, b, c) jit_add_fop(jit, JIT_FMIN | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fmaxr(jit, a, b, c) jit_add_fop(jit, JIT_FMAX | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fmaxi(jit, a, b, c) jit_add_fop(jit, JIT_FMAX | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
 #define jit_fnegr(jit, a, b) jit_add_fop(jit, JIT_FNEG | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fabsr(jit, a, b) jit_add_fop(jit, JIT_FABS | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 
 #define jit_extr(jit, a, b) jit_add_fop(jit, JIT_EXT | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_truncr(jit, a, b) jit_add_fop(jit, JIT_TRUNC | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
@@ -573,6 +681,27 @@ int jit_allocai(struct jit * jit, int size);
 #define jit_ceilr(jit, a, b) jit_add_fop(jit, JIT_CEIL | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_roundr(jit, a, b) jit_add_fop(jit, JIT_ROUND | REG, SPEC(TREG, REG, NO), a, b, 0, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 
+#define jit_fltr(jit, a, b, c) jit_add_fop(jit, JIT_FLT | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_flti(jit, a, b, c) jit_add_fop(jit, JIT_FLT | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_fler(jit, a, b, c) jit_add_fop(jit, JIT_FLE | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_flei(jit, a, b, c) jit_add_fop(jit, JIT_FLE | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_fgtr(jit, a, b, c) jit_add_fop(jit, JIT_FGT | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fgti(jit, a, b, c) jit_add_fop(jit, JIT_FGT | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_fger(jit, a, b, c) jit_add_fop(jit, JIT_FGE | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fgei(jit, a, b, c) jit_add_fop(jit, JIT_FGE | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_feqr(jit, a, b, c) jit_add_fop(jit, JIT_FEQ | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_feqi(jit, a, b, c) jit_add_fop(jit, JIT_FEQ | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_fner(jit, a, b, c) jit_add_fop(jit, JIT_FNE | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fnei(jit, a, b, c) jit_add_fop(jit, JIT_FNE | IMM, SPEC(TREG, REG, IMM), a, b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
+#define jit_fmovnr(jit, a, b, c) jit_add_fop(jit, JIT_FMOVN | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+#define jit_fmovzr(jit, a, b, c) jit_add_fop(jit, JIT_FMOVZ | REG, SPEC(TREG, REG, REG), a, b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
+
 #define jit_fbltr(jit, a, b, c) jit_add_fop(jit, JIT_FBLT | REG, SPEC(IMM, REG, REG), (jit_value)(a), b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_fblti(jit, a, b, c) jit_add_fop(jit, JIT_FBLT | IMM, SPEC(IMM, REG, IMM), (jit_value)(a), b, 0, c, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
 #define jit_fbgtr(jit, a, b, c) jit_add_fop(jit, JIT_FBGT | REG, SPEC(IMM, REG, REG), (jit_value)(a), b, c, 0, 0, jit_debug_info_new(__FILE__, __func__, __LINE__))
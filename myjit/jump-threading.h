@@ -0,0 +1,215 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Jump threading.
+ *
+ * Jumps whose destination is another jump are redirected to the final
+ * destination, jumps to the operation which follows them are removed, and
+ * conditional branches jumping over an unconditional jump are negated:
+ *	blt(L1, ..., ...);
+ *	jmp L2
+ *	L1:
+ *	==>
+ *	bge(L2, ..., ...);
+ *	L1:
+ * Labels and patches emit no code, therefore, empty blocks between them
+ * are skipped. The pass runs before the register allocation and once again
+ * before the code generation since the allocator introduces new jumps.
+ */
+
+#define JIT_JUMP_THREADING_MAX_CHAIN	(8)	// max. number of jumps followed at once and of passes
+
+static int jmpthr_no_code_op(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_LABEL: case JIT_PATCH: case JIT_COMMENT: case JIT_MARK: return 1;
+		default: return 0;
+	}
+}
+
+/**
+ * Returns the first operation emitting code at the given position
+ */
+static jit_op * jmpthr_skip_no_code(jit_op * op)
+{
+	while (op && jmpthr_no_code_op(op)) op = op->next;
+	return op;
+}
+
+/**
+ * Returns 1 if the target can be reached from the operation without
+ * emitting any code
+ */
+static int jmpthr_reaches(jit_op * op, jit_op * target)
+{
+	for (; op && jmpthr_no_code_op(op); op = op->next)
+		if (op == target) return 1;
+	return 0;
+}
+
+/**
+ * Returns 1 if the operation a precedes the operation b; both lists are
+ * walked at once so that the cost depends on the distance of the operations
+ */
+static int jmpthr_precedes(jit_op * a, jit_op * b)
+{
+	jit_op * x = a;
+	jit_op * y = b;
+	while (x || y) {
+		if (x == b) return 1;
+		if (y == a) return 0;
+		if (x) x = x->next;
+		if (y) y = y->next;
+	}
+	return 0;
+}
+
+/**
+ * Returns 1 if the jump has no other effect than the jump itself
+ */
+static int jmpthr_plain_jump(jit_op * op)
+{
+	if (op->code == (JIT_JMP | IMM)) return 1;
+	switch (GET_OP(op)) {
+		case JIT_BOADD: case JIT_BOSUB: case JIT_BNOADD: case JIT_BNOSUB: return 0;
+		default: return is_cond_branch_op(op);
+	}
+}
+
+/**
+ * Returns 1 if the branch b is taken whenever the branch a is taken
+ * and there is no code between them
+ */
+static int jmpthr_same_branch(jit_op * a, jit_op * b)
+{
+	if (!is_cond_branch_op(a) || !jmpthr_plain_jump(b) || (a->code != b->code)) return 0;
+	if (a->fp && IS_IMM(a) && (a->flt_imm != b->flt_imm)) return 0;
+	// branches comparing with a memory operand (x86) keep the displacement in flt_imm
+	if ((a->arg_size != b->arg_size) || (a->arg_size && memcmp(&a->flt_imm, &b->flt_imm, sizeof(double)))) return 0;
+	for (int i = 1; i < 3; i++)
+		if ((a->arg[i] != b->arg[i]) || (a->r_arg[i] != b->r_arg[i])) return 0;
+	return 1;
+}
+
+/**
+ * Removes the patch which sets the address of the forward jump
+ */
+static void jmpthr_remove_patch(jit_op * op)
+{
+	jit_op * patch = op->jmp_addr;
+	if ((GET_OP(patch) == JIT_PATCH) && ((jit_op *) patch->arg[0] == op)) jit_op_delete(patch);
+}
+
+/**
+ * Redirects the jump to the position of the given label or patch; returns 0
+ * if it is not possible
+ */
+static int jmpthr_retarget(jit_op * op, jit_op * dest)
+{
+	if (jmpthr_precedes(dest, op)) {
+		// backward jumps need a label
+		if (GET_OP(dest) != JIT_LABEL) return 0;
+		jmpthr_remove_patch(op);
+		op->arg[0] = dest->arg[0];
+		op->r_arg[0] = dest->arg[0];
+		op->jmp_addr = dest;
+		return 1;
+	}
+
+	jit_op * patch = jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) op, 0, 0, 0);
+	patch->r_arg[0] = patch->arg[0];
+	if (dest->regmap) patch->regmap = rmap_clone(dest->regmap);
+	if (dest->live_in) patch->live_in = jit_set_clone(dest->live_in);
+	if (dest->live_out) patch->live_out = jit_set_clone(dest->live_out);
+	jit_op_prepend(dest, patch);
+
+	jmpthr_remove_patch(op);
+	op->arg[0] = (jit_value) patch;
+	op->r_arg[0] = (jit_value) patch;
+	op->jmp_addr = patch;
+	return 1;
+}
+
+/**
+ * Redirects the jump behind the jumps it leads to; returns the number
+ * of bypassed jumps
+ */
+static int jmpthr_thread(jit_op * op)
+{
+	int bypassed = 0;
+	for (int i = 0; i < JIT_JUMP_THREADING_MAX_CHAIN; i++) {
+		jit_op * next = jmpthr_skip_no_code(op->jmp_addr);
+		if (!next || (next == op) || !next->jmp_addr || (next->jmp_addr == op->jmp_addr)) break;
+		if ((next->code != (JIT_JMP | IMM)) && !jmpthr_same_branch(op, next)) break;
+		if (!jmpthr_retarget(op, next->jmp_addr)) break;
+		bypassed++;
+	}
+	return bypassed;
+}
+
+static int jmpthr_pass(struct jit * jit)
+{
+	int eliminated = 0;
+
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if ((op->code != (JIT_JMP | IMM)) && !is_cond_branch_op(op)) continue;
+		if (!op->jmp_addr) continue;
+
+		eliminated += jmpthr_thread(op);
+
+		// jump to the next operation
+		if (jmpthr_plain_jump(op) && jmpthr_reaches(op->next, op->jmp_addr)) {
+			jit_op * prev = op->prev;
+			jmpthr_remove_patch(op);
+			jit_op_delete(op);
+			eliminated++;
+			op = prev;
+			continue;
+		}
+
+		// conditional branch over an unconditional jump
+		jit_op * jmp = op->next;
+		if (is_cond_branch_op(op) && !op->fp && jmp && (jmp->code == (JIT_JMP | IMM)) && jmp->jmp_addr
+		&& jmpthr_reaches(jmp->next, op->jmp_addr) && jmpthr_retarget(op, jmp->jmp_addr)) {
+			jit_negate_branch(op);
+			jmpthr_remove_patch(jmp);
+			jit_op_delete(jmp);
+			eliminated++;
+		}
+	}
+	return eliminated;
+}
+
+/**
+ * Threads jumps and removes jumps to the following operations; returns
+ * the number of removed or bypassed jumps
+ */
+static int jit_thread_jumps(struct jit * jit)
+{
+	int eliminated = 0;
+	// each change may enable other ones
+	for (int i = 0; i < JIT_JUMP_THREADING_MAX_CHAIN; i++) {
+		int changes = jmpthr_pass(jit);
+		if (!changes) break;
+		eliminated += changes;
+	}
+	jit->stats[JIT_STAT_ELIMINATED_JUMPS] += eliminated;
+	return eliminated;
+}
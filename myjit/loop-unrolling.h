@@ -0,0 +1,298 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Unrolling of counted loops.
+ *
+ * Loops consisting of a label, a straight-line body which adds a constant
+ * to the induction variable exactly once, and a backward branch comparing
+ * the induction variable with a loop invariant bound are unrolled N times:
+ *	L:				if !(i < n) goto R
+ *	body(i)				t = n - i
+ *	i += step		==>	if !(t >u (N - 1) * step) goto R
+ *	if (i < n) goto L		U:
+ *					body(i); body(i1); ...; body(iN-1)
+ *					if !(i < n) goto E
+ *					t = n - i
+ *					if (t >u (N - 1) * step) goto U
+ *					R:
+ *					L:
+ *					original loop
+ *					E:
+ * The k-th copy of the body uses its own induction variable i + k * step
+ * which is computed directly from the induction variable, hence, copies
+ * do not depend on each other through it. Registers which are written
+ * before they are read in the body get new names in all copies but the last
+ * one. The original loop handles the remaining iterations. The unrolled
+ * loop is entered only if the distance between the induction variable and
+ * the bound, which is computed as an unsigned number, covers all copies;
+ * hence, neither the test nor the copies of the induction variable can wrap
+ * around, even for bounds near the limits of signed or unsigned numbers.
+ */
+
+#define JIT_UNROLL_FACTOR	(4)	// unrolling factor used if none is given
+#define JIT_UNROLL_MAX_OPS	(64)	// max. number of operations in all copies of the body
+#define JIT_UNROLL_MAX_STEP	(0xffff)	// max. absolute value of the step
+
+struct jit_unrolled_loop {
+	jit_op * header;	// label the loop starts with
+	jit_op * branch;	// backward branch closing the loop
+	jit_op * step_op;	// operation which increments the induction variable
+	jit_value iv;		// induction variable
+	jit_value step;		// its increment in one iteration
+	int size;		// number of operations in the body
+	int local_cnt;		// number of registers written before they are read
+	jit_value locals[JIT_UNROLL_MAX_OPS * 3 / 2];
+};
+
+/**
+ * Returns 1 if the operation may appear in the body of an unrolled loop
+ */
+static int unroll_body_op(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_MOV: case JIT_MOVN: case JIT_MOVZ: case JIT_LD: case JIT_LDX: case JIT_ST: case JIT_STX:
+		case JIT_ADD: case JIT_ADDC: case JIT_ADDX: case JIT_SUB: case JIT_SUBC: case JIT_SUBX: case JIT_RSB:
+		case JIT_NEG: case JIT_MUL: case JIT_HMUL: case JIT_DIV: case JIT_MOD: case JIT_MIN: case JIT_MAX:
+		case JIT_ABS: case JIT_OR: case JIT_XOR: case JIT_AND: case JIT_LSH: case JIT_RSH: case JIT_NOT:
+		case JIT_LT: case JIT_LE: case JIT_GT: case JIT_GE: case JIT_EQ: case JIT_NE:
+		case JIT_FMOV: case JIT_FADD: case JIT_FSUB: case JIT_FRSB: case JIT_FMUL: case JIT_FDIV:
+		case JIT_FNEG: case JIT_FABS: case JIT_EXT: case JIT_ROUND: case JIT_TRUNC: case JIT_FLOOR:
+		case JIT_CEIL: case JIT_FMIN: case JIT_FMAX: case JIT_FLD: case JIT_FLDX: case JIT_FST: case JIT_FSTX:
+		case JIT_FMOVN: case JIT_FMOVZ: case JIT_FLT: case JIT_FLE: case JIT_FGT: case JIT_FGE: case JIT_FEQ: case JIT_FNE:
+		case JIT_COMMENT:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static inline int unroll_reg_arg(jit_op * op, int i)
+{
+	if ((ARG_TYPE(op, i + 1) != REG) && (ARG_TYPE(op, i + 1) != TREG)) return 0;
+	return JIT_REG_SPEC(op->arg[i]) == JIT_RTYPE_REG;
+}
+
+static inline int unroll_writes(jit_op * op, jit_value reg)
+{
+	return (ARG_TYPE(op, 1) == TREG) && (op->arg[0] == reg);
+}
+
+static int unroll_find_reg(jit_value * regs, int cnt, jit_value reg)
+{
+	for (int i = 0; i < cnt; i++)
+		if (regs[i] == reg) return i;
+	return -1;
+}
+
+/**
+ * Collects registers which are written before they are read; their values
+ * do not pass from one iteration to another
+ */
+static void unroll_collect_locals(struct jit_unrolled_loop * l)
+{
+	jit_value seen[JIT_UNROLL_MAX_OPS * 3 / 2];
+	int seen_cnt = 0;
+	l->local_cnt = 0;
+	for (jit_op * op = l->header->next; op != l->branch; op = op->next) {
+		if (op == l->step_op) continue;
+		for (int i = 0; i < 3; i++) {
+			if (!unroll_reg_arg(op, i)) continue;
+			if ((ARG_TYPE(op, i + 1) == TREG) && !jit_reads_target_reg(op)) continue;
+			if (unroll_find_reg(seen, seen_cnt, op->arg[i]) < 0) seen[seen_cnt++] = op->arg[i];
+		}
+		if (!unroll_reg_arg(op, 0) || (ARG_TYPE(op, 1) != TREG)) continue;
+		if ((op->arg[0] == l->iv) || (unroll_find_reg(seen, seen_cnt, op->arg[0]) >= 0)) continue;
+		seen[seen_cnt++] = op->arg[0];
+		l->locals[l->local_cnt++] = op->arg[0];
+	}
+}
+
+/**
+ * Checks whether the loop closed by the given branch can be unrolled
+ */
+static int unroll_analyze(jit_op * branch, struct jit_unrolled_loop * l)
+{
+	if (!is_cond_branch_op(branch) || branch->fp || !unroll_reg_arg(branch, 1)) return 0;
+	if (JIT_REG_TYPE(branch->arg[1]) != JIT_RTYPE_INT) return 0;
+	int cond = GET_OP(branch);
+	if ((cond != JIT_BLT) && (cond != JIT_BLE) && (cond != JIT_BGT) && (cond != JIT_BGE)) return 0;
+
+	jit_op * header = branch->jmp_addr;
+	if (!header || (GET_OP(header) != JIT_LABEL)) return 0;
+
+	l->header = header;
+	l->branch = branch;
+	l->step_op = NULL;
+	l->iv = branch->arg[1];
+	l->size = 0;
+
+	for (jit_op * op = header->next; op != branch; op = op->next) {
+		if (!op || (++l->size > JIT_UNROLL_MAX_OPS / 2) || !unroll_body_op(op)) return 0;
+		if (!IS_IMM(branch) && unroll_writes(op, branch->arg[2])) return 0;
+		if (!unroll_writes(op, l->iv)) continue;
+
+		if (l->step_op || (op->arg[1] != l->iv)) return 0;
+		if ((op->code != (JIT_ADD | IMM)) && (op->code != (JIT_SUB | IMM))) return 0;
+		l->step_op = op;
+		l->step = (GET_OP(op) == JIT_ADD) ? op->arg[2] : -op->arg[2];
+	}
+	if (!l->step_op || (l->step == 0) || (l->step > JIT_UNROLL_MAX_STEP) || (l->step < -JIT_UNROLL_MAX_STEP)) return 0;
+
+	// the induction variable has to approach the bound
+	if (((cond == JIT_BLT) || (cond == JIT_BLE)) && (l->step < 0)) return 0;
+	if (((cond == JIT_BGT) || (cond == JIT_BGE)) && (l->step > 0)) return 0;
+
+	// the loop can be entered only from above
+	for (jit_op * op = header->next; op != NULL; op = op->next)
+		if ((op->jmp_addr == header) && (op != branch)) return 0;
+
+	unroll_collect_locals(l);
+	return 1;
+}
+
+static inline jit_value unroll_new_reg(jit_value r, int * gp_cnt, int * fp_cnt)
+{
+	if (JIT_REG_TYPE(r) == JIT_RTYPE_INT) return R((*gp_cnt)++);
+	return FR((*fp_cnt)++);
+}
+
+static jit_label * unroll_new_label(struct jit * jit, jit_op * pos)
+{
+	jit_label * label = JIT_MALLOC(sizeof(jit_label));
+	label->next = jit->labels;
+	jit->labels = label;
+	jit_op_prepend(pos, jit_op_new(JIT_LABEL, SPEC(IMM, NO, NO), (jit_value) label, 0, 0, 0));
+	return label;
+}
+
+/**
+ * Emits a copy of the branch comparing the induction variable with the bound
+ */
+static jit_op * unroll_branch(struct jit_unrolled_loop * l, jit_op * pos, jit_value target, int negate)
+{
+	jit_op * op = inline_new_op(l->branch, l->branch->code, l->branch->spec, target, l->iv, l->branch->arg[2]);
+	if (negate) jit_negate_branch(op);
+	jit_op_prepend(pos, op);
+	return op;
+}
+
+/**
+ * Emits a branch which is taken if the distance between the induction
+ * variable and the bound allows another round of the unrolled loop;
+ * the induction variable has to be on the right side of the bound
+ */
+static jit_op * unroll_distance_branch(struct jit_unrolled_loop * l, jit_op * pos, jit_value target, jit_value t, int factor, int negate)
+{
+	jit_op * b = l->branch;
+	if (l->step > 0) {
+		if (IS_IMM(b)) jit_op_prepend(pos, inline_new_op(b, JIT_RSB | IMM, SPEC(TREG, REG, IMM), t, l->iv, b->arg[2]));
+		else jit_op_prepend(pos, inline_new_op(b, JIT_SUB | REG, SPEC(TREG, REG, REG), t, b->arg[2], l->iv));
+	} else {
+		if (IS_IMM(b)) jit_op_prepend(pos, inline_new_op(b, JIT_SUB | IMM, SPEC(TREG, REG, IMM), t, l->iv, b->arg[2]));
+		else jit_op_prepend(pos, inline_new_op(b, JIT_SUB | REG, SPEC(TREG, REG, REG), t, l->iv, b->arg[2]));
+	}
+
+	jit_value span = (factor - 1) * (l->step > 0 ? l->step : -l->step);
+	int strict = (GET_OP(b) == JIT_BLT) || (GET_OP(b) == JIT_BGT);
+	jit_op * op = inline_new_op(b, (strict ? JIT_BGT : JIT_BGE) | IMM | UNSIGNED, SPEC(IMM, REG, IMM), target, t, span);
+	if (negate) jit_negate_branch(op);
+	jit_op_prepend(pos, op);
+	return op;
+}
+
+static void unroll_loop(struct jit * jit, struct jit_unrolled_loop * l, int factor, int * gp_cnt, int * fp_cnt)
+{
+	jit_op * pos = l->header;
+	jit_value t = R((*gp_cnt)++);
+
+	jit_value ivs[JIT_UNROLL_MAX_OPS];
+	ivs[0] = l->iv;
+	for (int k = 1; k < factor; k++) ivs[k] = R((*gp_cnt)++);
+	ivs[factor] = l->iv;
+
+	// enough iterations for the unrolled loop
+	jit_op * guard = unroll_branch(l, pos, (jit_value) JIT_FORWARD, 1);
+	jit_op * distance_guard = unroll_distance_branch(l, pos, (jit_value) JIT_FORWARD, t, factor, 1);
+	jit_label * unrolled = unroll_new_label(jit, pos);
+
+	jit_value renamed[JIT_UNROLL_MAX_OPS * 3 / 2];
+	for (int k = 0; k < factor; k++) {
+		for (int j = 0; j < l->local_cnt; j++)
+			renamed[j] = (k < factor - 1) ? unroll_new_reg(l->locals[j], gp_cnt, fp_cnt) : l->locals[j];
+
+		jit_value iv = ivs[k];
+		for (jit_op * op = l->header->next; op != l->branch; op = op->next) {
+			if (op == l->step_op) {
+				// the induction variable itself is incremented by the last copy
+				jit_op_prepend(pos, inline_new_op(op, JIT_ADD | IMM, SPEC(TREG, REG, IMM), ivs[k + 1], l->iv, (k + 1) * l->step));
+				iv = ivs[k + 1];
+				continue;
+			}
+			jit_op * newop = inline_new_op(op, op->code, op->spec, op->arg[0], op->arg[1], op->arg[2]);
+			for (int i = 0; i < 3; i++) {
+				if (!unroll_reg_arg(op, i)) continue;
+				if (op->arg[i] == l->iv) newop->arg[i] = iv;
+				int idx = unroll_find_reg(l->locals, l->local_cnt, op->arg[i]);
+				if (idx >= 0) newop->arg[i] = renamed[idx];
+			}
+			jit_op_prepend(pos, newop);
+		}
+	}
+
+	// the exit, next round of the unrolled loop, or remaining iterations
+	jit_op * exit = unroll_branch(l, pos, (jit_value) JIT_FORWARD, 1);
+	unroll_distance_branch(l, pos, (jit_value) unrolled, t, factor, 0);
+	jit_op_prepend(pos, jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) guard, 0, 0, 0));
+	jit_op_prepend(pos, jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) distance_guard, 0, 0, 0));
+	jit_op_append(l->branch, jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) exit, 0, 0, 0));
+}
+
+/**
+ * Unrolls counted loops; returns the number of unrolled loops
+ */
+static int jit_unroll_loops(struct jit * jit)
+{
+	int unrolled = 0;
+	int gp_cnt = 0, fp_cnt = 0;
+
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (GET_OP(op) == JIT_PROLOG) {
+			// new registers follow the registers of the function
+			gp_cnt = 0;
+			fp_cnt = 0;
+			for (jit_op * o = op->next; o && (GET_OP(o) != JIT_PROLOG); o = o->next)
+				jit_op_count_regs(o, &gp_cnt, &fp_cnt);
+			continue;
+		}
+		if (!is_cond_branch_op(op) || (op->unroll == 1)) continue;
+
+		struct jit_unrolled_loop l;
+		if (!unroll_analyze(op, &l)) continue;
+
+		int factor = op->unroll ? op->unroll : JIT_UNROLL_FACTOR;
+		while (factor * l.size > JIT_UNROLL_MAX_OPS) factor--;
+		if (factor < 2) continue;
+
+		unroll_loop(jit, &l, factor, &gp_cnt, &fp_cnt);
+		unrolled++;
+	}
+	jit->stats[JIT_STAT_UNROLLED_LOOPS] += unrolled;
+	return unrolled;
+}
@@ -0,0 +1,356 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Promotion of stack slots to registers.
+ *
+ * Slots in the space allocated with allocai are replaced with new
+ * registers if the address of the frame does not leave the function and
+ * each access to the slot loads or stores the whole register, i.e., all
+ * accesses use the same offset and the size of jit_value or double.
+ * Loads of the slot become movr from its register and stores become
+ * movr to its register. Accesses with an offset computed at run time may
+ * touch any slot of the block allocated by allocai, slots of such blocks
+ * are not promoted.
+ *
+ * Blocks whose slots were all promoted are released and the remaining
+ * blocks are moved closer to the frame pointer. Offsets are adjusted in
+ * operations which take the address from R_FP, which requires each access
+ * to stay in the block of this address.
+ */
+
+struct m2r_block {
+	jit_op * alloca;
+	jit_value start;		// offset of the block from R_FP
+	jit_value size;
+	jit_value shift;		// distance by which the block moves towards the frame pointer
+	char unknown;			// block is accessed with an offset which is not known
+	char released;			// all slots of the block were promoted
+};
+
+struct m2r_slot {
+	jit_value offset;
+	int size;
+	char fp;
+	char promotable;
+	int block;
+	jit_value reg;
+};
+
+/**
+ * Operation taking the address of the frame from R_FP, with the offset
+ * which has to be adjusted if the frame shrinks
+ */
+struct m2r_root {
+	jit_op * op;
+	int arg;			// argument with the offset, -1 if there is none
+	int block;
+};
+
+struct m2r_func {
+	struct ssa_func * f;
+	struct jit_func_info * info;
+	struct m2r_block * blocks;
+	int block_cnt;
+	struct m2r_slot * slots;
+	int slot_cnt;
+	int * access_slot;		// slot accessed by each operation, -1 if none
+	struct m2r_root * roots;
+	int root_cnt;
+	int shrinkable;
+	int promoted;
+};
+
+static int m2r_block_of(struct m2r_func * m, jit_value offset, int size)
+{
+	for (int i = 0; i < m->block_cnt; i++)
+		if ((m->blocks[i].start <= offset) && (offset + size <= m->blocks[i].start + m->blocks[i].size)) return i;
+	return -1;
+}
+
+/**
+ * Finds the operation which takes the address from R_FP; sets the offset
+ * of the address from the frame pointer and the offset of the root
+ */
+static jit_op * m2r_frame_root(struct ssa_func * f, jit_op * op, int i, jit_value * offset, jit_value * root_offset)
+{
+	*offset = 0;
+	if (op->arg[i] == R_FP) return op;
+
+	struct ssa_use * u = ssa_info(f, op)->uses[i];
+	struct ssa_value * v = u ? u->value : NULL;
+	while (v && v->def) {
+		jit_op * def = v->def;
+		jit_value off;
+		switch (def->code) {
+			case JIT_ADD | IMM: off = def->arg[2]; break;
+			case JIT_SUB | IMM: off = -def->arg[2]; break;
+			case JIT_MOV | REG: off = 0; break;
+			default: return NULL;
+		}
+		*offset += off;
+		if (def->arg[1] == R_FP) {
+			*root_offset = off;
+			return def;
+		}
+		u = ssa_info(f, def)->uses[1];
+		v = u ? u->value : NULL;
+	}
+	return NULL;
+}
+
+static void m2r_add_root(struct m2r_func * m, jit_op * op, int arg, int block)
+{
+	for (int i = 0; i < m->root_cnt; i++) {
+		if (m->roots[i].op != op) continue;
+		if (m->roots[i].block != block) m->shrinkable = 0;
+		return;
+	}
+	m->roots = JIT_REALLOC(m->roots, sizeof(struct m2r_root) * (m->root_cnt + 1));
+	m->roots[m->root_cnt].op = op;
+	m->roots[m->root_cnt].arg = arg;
+	m->roots[m->root_cnt].block = block;
+	m->root_cnt++;
+}
+
+static int m2r_slot(struct m2r_func * m, jit_value offset, int size, int fp)
+{
+	for (int i = 0; i < m->slot_cnt; i++)
+		if ((m->slots[i].offset == offset) && (m->slots[i].size == size) && (m->slots[i].fp == fp)) return i;
+	m->slots = JIT_REALLOC(m->slots, sizeof(struct m2r_slot) * (m->slot_cnt + 1));
+	struct m2r_slot * s = &m->slots[m->slot_cnt];
+	s->offset = offset;
+	s->size = size;
+	s->fp = fp;
+	s->promotable = 1;
+	s->block = m2r_block_of(m, offset, size);
+	return m->slot_cnt++;
+}
+
+/**
+ * Finds the slot accessed by the operation and the root of its address;
+ * returns 0 if the accesses to the frame cannot be analyzed
+ */
+static int m2r_analyze_access(struct m2r_func * m, jit_op * op)
+{
+	int address_args;
+	if (dse_memory_op(op, &address_args) == DSE_NO_ACCESS) return 1;
+
+	jit_value offset = 0, root_offset = 0;
+	jit_op * root = NULL;
+	int root_arg = -1, frame_args = 0, known = 1;
+	for (int i = 0; i < 3; i++) {
+		if (!(address_args & (1 << i))) continue;
+		if (ARG_TYPE(op, i + 1) == IMM) {
+			offset += op->arg[i];
+			root_arg = i;
+			continue;
+		}
+		jit_value arg_offset, arg_root_offset = 0;
+		jit_op * arg_root = m2r_frame_root(m->f, op, i, &arg_offset, &arg_root_offset);
+		if (arg_root) {
+			offset += arg_offset;
+			root_offset += arg_root_offset;
+			root = arg_root;
+			frame_args++;
+		} else known = 0;
+	}
+	if (frame_args == 0) return 1;
+	if (frame_args > 1) return 0;
+
+	// offset of the operation accessing the memory directly is its immediate argument
+	if (root == op) root_offset = offset;
+	int block = m2r_block_of(m, offset, known ? op->arg_size : 1);
+	int root_block = m2r_block_of(m, root_offset, 1);
+	m2r_add_root(m, root, (root == op) ? root_arg : -1, root_block);
+	if (block != root_block) m->shrinkable = 0;
+
+	if (!known) {
+		if (block < 0) return 0;
+		m->blocks[block].unknown = 1;
+		return 1;
+	}
+	int fp = (GET_OP(op) == JIT_FLD) || (GET_OP(op) == JIT_FLDX) || (GET_OP(op) == JIT_FST) || (GET_OP(op) == JIT_FSTX);
+	m->access_slot[op->normalized_pos] = m2r_slot(m, offset, op->arg_size, fp);
+	return 1;
+}
+
+/**
+ * Collects the blocks of the frame; returns 0 if they do not match the
+ * frame of the function
+ */
+static int m2r_collect_blocks(struct m2r_func * m)
+{
+	struct ssa_func * f = m->f;
+	jit_value size = 0;
+	for (int i = 0; i < f->op_cnt; i++) {
+		jit_op * op = f->ops[i].op;
+		if (GET_OP(op) != JIT_ALLOCA) continue;
+		m->blocks = JIT_REALLOC(m->blocks, sizeof(struct m2r_block) * (m->block_cnt + 1));
+		struct m2r_block * b = &m->blocks[m->block_cnt++];
+		memset(b, 0, sizeof(struct m2r_block));
+		size += op->arg[0];
+		b->alloca = op;
+		b->start = -size;
+		b->size = op->arg[0];
+	}
+	return m->block_cnt && (size == m->info->allocai_mem);
+}
+
+static int m2r_analyze(struct m2r_func * m)
+{
+	struct ssa_func * f = m->f;
+	if (!m2r_collect_blocks(m) || dse_frame_escapes(f)) return 0;
+
+	m->shrinkable = 1;
+	m->access_slot = JIT_MALLOC(sizeof(int) * f->op_cnt);
+	for (int i = 0; i < f->op_cnt; i++)
+		m->access_slot[i] = -1;
+
+	for (int i = 0; i < f->op_cnt; i++) {
+		jit_op * op = f->ops[i].op;
+		if (!m2r_analyze_access(m, op)) return 0;
+
+		// addresses which are not used by any access are adjusted as well
+		if (op->arg[1] != R_FP) continue;
+		if (op->code == (JIT_ADD | IMM)) m2r_add_root(m, op, -1, m2r_block_of(m, op->arg[2], 1));
+		if (op->code == (JIT_SUB | IMM)) m2r_add_root(m, op, -1, m2r_block_of(m, -op->arg[2], 1));
+	}
+
+	for (int i = 0; i < m->slot_cnt; i++) {
+		struct m2r_slot * s = &m->slots[i];
+		if ((s->block < 0) || m->blocks[s->block].unknown) s->promotable = 0;
+		if (s->size != (s->fp ? sizeof(double) : sizeof(jit_value))) s->promotable = 0;
+		for (int j = 0; j < m->slot_cnt; j++) {
+			struct m2r_slot * t = &m->slots[j];
+			if ((i != j) && (s->offset < t->offset + t->size) && (t->offset < s->offset + s->size)) s->promotable = 0;
+		}
+	}
+	return 1;
+}
+
+static void m2r_promote_slots(struct m2r_func * m)
+{
+	struct ssa_func * f = m->f;
+	for (int i = 0; i < m->slot_cnt; i++) {
+		struct m2r_slot * s = &m->slots[i];
+		if (!s->promotable) continue;
+		s->reg = s->fp ? FR(f->fp_cnt++) : R(f->gp_cnt++);
+		m->promoted++;
+	}
+
+	for (int i = 0; i < f->op_cnt; i++) {
+		if (m->access_slot[i] < 0) continue;
+		struct m2r_slot * s = &m->slots[m->access_slot[i]];
+		if (!s->promotable) continue;
+
+		jit_op * op = f->ops[i].op;
+		int load = (GET_OP(op) == JIT_LD) || (GET_OP(op) == JIT_LDX) || (GET_OP(op) == JIT_FLD) || (GET_OP(op) == JIT_FLDX);
+		if (load) op->arg[1] = s->reg;
+		else {
+			op->arg[1] = ((GET_OP(op) == JIT_ST) || (GET_OP(op) == JIT_FST)) ? op->arg[1] : op->arg[2];
+			op->arg[0] = s->reg;
+		}
+		op->code = s->fp ? JIT_FMOV | REG : JIT_MOV | REG;
+		op->spec = SPEC(TREG, REG, NO);
+		op->arg[2] = 0;
+		op->fp = s->fp;
+	}
+}
+
+/**
+ * Releases blocks whose slots were all promoted and moves the remaining
+ * ones towards the frame pointer
+ */
+static void m2r_shrink_frame(struct m2r_func * m)
+{
+	for (int i = 0; i < m->block_cnt; i++)
+		m->blocks[i].released = !m->blocks[i].unknown;
+	for (int i = 0; i < m->slot_cnt; i++)
+		if (!m->slots[i].promotable && (m->slots[i].block >= 0)) m->blocks[m->slots[i].block].released = 0;
+
+	// blocks allocated later lie farther from the frame pointer
+	jit_value released = 0;
+	for (int i = 0; i < m->block_cnt; i++) {
+		struct m2r_block * b = &m->blocks[i];
+		b->shift = released;
+		if (b->released) released += b->size;
+	}
+	if (!released) return;
+
+	for (int i = 0; i < m->root_cnt; i++) {
+		struct m2r_root * r = &m->roots[i];
+		if ((r->block < 0) || m->blocks[r->block].released || !m->blocks[r->block].shift) continue;
+		jit_op * op = r->op;
+		jit_value shift = m->blocks[r->block].shift;
+		if (r->arg >= 0) op->arg[r->arg] += shift;
+		else if (op->code == (JIT_ADD | IMM)) op->arg[2] += shift;
+		else if (op->code == (JIT_SUB | IMM)) op->arg[2] -= shift;
+	}
+
+	for (int i = 0; i < m->block_cnt; i++)
+		if (m->blocks[i].released) jit_op_delete(m->blocks[i].alloca);
+	m->info->allocai_mem -= released;
+}
+
+static void m2r_free(struct m2r_func * m)
+{
+	if (m->blocks) JIT_FREE(m->blocks);
+	if (m->slots) JIT_FREE(m->slots);
+	if (m->access_slot) JIT_FREE(m->access_slot);
+	if (m->roots) JIT_FREE(m->roots);
+}
+
+/**
+ * Replaces stack slots with registers; returns the number of promoted slots
+ */
+static int jit_promote_frame_slots(struct jit * jit)
+{
+	int changes = 0;
+	jit_tree * code_refs = NULL;
+	ssa_collect_code_refs(jit, &code_refs);
+
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		if (GET_OP(op) != JIT_PROLOG) {
+			op = op->next;
+			continue;
+		}
+		jit_op * prolog = op;
+		do op = op->next;
+		while (op && (GET_OP(op) != JIT_PROLOG));
+
+		struct ssa_func f;
+		struct m2r_func m;
+		memset(&f, 0, sizeof(struct ssa_func));
+		memset(&m, 0, sizeof(struct m2r_func));
+		m.f = &f;
+		m.info = (struct jit_func_info *) prolog->arg[1];
+		if (m.info->allocai_mem && ssa_build(&f, prolog, code_refs) && m2r_analyze(&m)) {
+			m2r_promote_slots(&m);
+			if (m.shrinkable) m2r_shrink_frame(&m);
+			jit->stats[JIT_STAT_PROMOTED_SLOTS] += m.promoted;
+			changes += m.promoted;
+		}
+		m2r_free(&m);
+		ssa_free(&f);
+	}
+	jit_tree_free(code_refs);
+	return changes;
+}
@@ -0,0 +1,309 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Redundant load elimination.
+ *
+ * Values loaded from or stored to the memory are remembered and the
+ * following loads of the same address are replaced with copies of these
+ * values. An address consists of a base, i.e., R_FP, an SSA value, or
+ * nothing for absolute addresses, and of a constant offset; values set by
+ * addi, subi, and movr are followed to their origin. Remembered values are
+ * forgotten if they may be overwritten:
+ *	- accesses to the same base with disjoint offsets are independent,
+ *	- accesses to the frame and through other pointers are independent
+ *	  unless an address in the frame leaves the function,
+ *	- calls and block operations overwrite all memory except the frame.
+ * Values are passed along the edges to blocks with a single predecessor,
+ * i.e., through the extended basic blocks. Copies are propagated in the SSA
+ * form, which ensures that the copied values are still available.
+ */
+
+#define RLE_MAX_ENTRIES	(32)
+
+struct rle_address {
+	struct ssa_value * base;	// origin of the base register, NULL for the frame and absolute addresses
+	jit_value offset;
+	char frame;
+	char known;			// the address consists of the base and the offset only
+};
+
+struct rle_entry {
+	struct rle_address addr;
+	int size;
+	int kind;			// JIT_LD or JIT_FLD, and the sign of the load
+	char stored;			// the value was stored by a store
+	struct ssa_value * value;
+};
+
+struct rle_table {
+	struct rle_entry entries[RLE_MAX_ENTRIES];
+	int cnt;
+};
+
+struct rle_func {
+	struct ssa_func * f;
+	struct rle_table * tables;	// values available at the end of each block
+	int escaped;
+	int forwarded;
+	int redundant;
+};
+
+/**
+ * Returns the origin of the address and adds the offsets of addi and subi
+ * to the offset
+ */
+static struct ssa_value * rle_base(struct ssa_func * f, struct ssa_value * v, jit_value * offset, char * frame)
+{
+	while (v && v->def) {
+		jit_op * op = v->def;
+		jit_value off;
+		switch (op->code) {
+			case JIT_ADD | IMM: off = op->arg[2]; break;
+			case JIT_SUB | IMM: off = -op->arg[2]; break;
+			case JIT_MOV | REG: off = 0; break;
+			default: return v;
+		}
+		if (op->arg[1] == R_FP) {
+			*offset += off;
+			*frame = 1;
+			return NULL;
+		}
+		struct ssa_use * src = ssa_info(f, op)->uses[1];
+		if (!src) return v;
+		*offset += off;
+		v = src->value;
+	}
+	return v;
+}
+
+static void rle_address(struct ssa_func * f, jit_op * op, int address_args, struct rle_address * addr)
+{
+	int regs = 0;
+	addr->base = NULL;
+	addr->offset = 0;
+	addr->frame = 0;
+	addr->known = 1;
+	for (int i = 0; i < 3; i++) {
+		if (!(address_args & (1 << i))) continue;
+		if (ARG_TYPE(op, i + 1) == IMM) {
+			addr->offset += op->arg[i];
+			continue;
+		}
+		regs++;
+		struct ssa_use * u = ssa_info(f, op)->uses[i];
+		if (op->arg[i] == R_FP) addr->frame = 1;
+		else if (u) addr->base = rle_base(f, u->value, &addr->offset, &addr->frame);
+		else addr->known = 0;
+	}
+	if (regs > 1) addr->known = 0;
+}
+
+static inline int rle_kind(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_FLD: case JIT_FLDX: case JIT_FST: case JIT_FSTX: return JIT_FLD;
+		default: return (op->arg_size < sizeof(jit_value)) ? JIT_LD | (op->code & UNSIGNED) : JIT_LD;
+	}
+}
+
+/**
+ * Returns 1 if the stored value equals the value loaded by loads of the
+ * same size, i.e., the store does not truncate the value
+ */
+static inline int rle_full_store(jit_op * op)
+{
+	return op->arg_size == ((rle_kind(op) == JIT_FLD) ? sizeof(double) : sizeof(jit_value));
+}
+
+static inline int rle_same_address(struct rle_address * a, struct rle_address * b)
+{
+	return (a->base == b->base) && (a->frame == b->frame) && (a->offset == b->offset);
+}
+
+/**
+ * Returns 1 if the store to the given address may overwrite the entry
+ */
+static int rle_may_alias(struct rle_func * r, struct rle_address * addr, int size, struct rle_entry * e)
+{
+	if (!r->escaped && (addr->frame != e->addr.frame)) return 0;
+	if (!addr->known || (addr->base != e->addr.base) || (addr->frame != e->addr.frame)) return 1;
+	return (addr->offset < e->addr.offset + e->size) && (e->addr.offset < addr->offset + size);
+}
+
+static void rle_forget(struct rle_func * r, struct rle_table * t, struct rle_address * addr, int size)
+{
+	int cnt = 0;
+	for (int i = 0; i < t->cnt; i++)
+		if (!rle_may_alias(r, addr, size, &t->entries[i])) t->entries[cnt++] = t->entries[i];
+	t->cnt = cnt;
+}
+
+/**
+ * Forgets values which may be overwritten by a call or a block operation
+ */
+static void rle_forget_memory(struct rle_func * r, struct rle_table * t)
+{
+	int cnt = 0;
+	for (int i = 0; i < t->cnt; i++)
+		if (!r->escaped && t->entries[i].addr.frame) t->entries[cnt++] = t->entries[i];
+	t->cnt = cnt;
+}
+
+static void rle_remember(struct rle_table * t, struct rle_address * addr, jit_op * op, struct ssa_value * value, int stored)
+{
+	if (!value || (t->cnt == RLE_MAX_ENTRIES)) return;
+	value = ssa_origin(value);
+	if (!ssa_copyable(value)) return;
+
+	struct rle_entry * e = &t->entries[t->cnt++];
+	e->addr = *addr;
+	e->size = op->arg_size;
+	e->kind = rle_kind(op);
+	e->stored = stored;
+	e->value = value;
+}
+
+static struct rle_entry * rle_lookup(struct rle_table * t, struct rle_address * addr, jit_op * load)
+{
+	for (int i = t->cnt - 1; i >= 0; i--) {
+		struct rle_entry * e = &t->entries[i];
+		if (rle_same_address(&e->addr, addr) && (e->size == load->arg_size) && (e->kind == rle_kind(load))) return e;
+	}
+	return NULL;
+}
+
+/**
+ * Replaces the load with a copy of the value
+ */
+static void rle_replace_load(struct ssa_func * f, jit_op * op, struct ssa_value * value)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	int fp = JIT_REG_TYPE(op->arg[0]) == JIT_RTYPE_FLOAT;
+	op->code = fp ? JIT_FMOV | REG : JIT_MOV | REG;
+	op->spec = SPEC(TREG, REG, NO);
+	op->arg[1] = f->regs[value->reg];
+	op->arg[2] = 0;
+	op->fp = fp;
+
+	// def-use chains are not used any more, only the operands are updated
+	ssa_drop_uses(info);
+	info->uses[1] = ssa_init_use(&info->use_slots[1], op);
+	info->uses[1]->value = value;
+	info->def->copy_of = value;
+}
+
+static void rle_block(struct rle_func * r, struct ssa_block * b)
+{
+	struct ssa_func * f = r->f;
+	struct rle_table * t = &r->tables[b - f->blocks];
+	t->cnt = 0;
+	if ((b->pred_cnt == 1) && (b->preds[0]->rpo >= 0) && (b->preds[0]->rpo < b->rpo))
+		*t = r->tables[b->preds[0] - f->blocks];
+
+	for (int i = b->first; i <= b->last; i++) {
+		struct ssa_op * info = &f->ops[i];
+		jit_op * op = info->op;
+		if (info->removed) continue;
+
+		if ((GET_OP(op) == JIT_CALL) || (GET_OP(op) == JIT_MEMCPY) || (GET_OP(op) == JIT_MEMSET)) {
+			rle_forget_memory(r, t);
+			continue;
+		}
+
+		int address_args;
+		int type = dse_memory_op(op, &address_args);
+		if (type == DSE_NO_ACCESS) continue;
+
+		struct rle_address addr;
+		rle_address(f, op, address_args, &addr);
+
+		if (type == DSE_STORE) {
+			rle_forget(r, t, &addr, op->arg_size);
+			int value_arg = ((GET_OP(op) == JIT_ST) || (GET_OP(op) == JIT_FST)) ? 1 : 2;
+			if (addr.known && rle_full_store(op) && info->uses[value_arg])
+				rle_remember(t, &addr, op, info->uses[value_arg]->value, 1);
+			continue;
+		}
+
+		if (!addr.known || !info->def) continue;
+		struct rle_entry * e = rle_lookup(t, &addr, op);
+		if (e) {
+			rle_replace_load(f, op, e->value);
+			if (e->stored) r->forwarded++;
+			else r->redundant++;
+		} else rle_remember(t, &addr, op, info->def, 0);
+	}
+}
+
+static void rle_optimize_function(struct rle_func * r)
+{
+	struct ssa_func * f = r->f;
+	ssa_mark_reachable(f);
+	r->escaped = dse_frame_escapes(f);
+	r->tables = JIT_MALLOC(sizeof(struct rle_table) * f->block_cnt);
+
+	for (int i = 0; i < f->rpo_cnt; i++)
+		rle_block(r, f->rpo[i]);
+	JIT_FREE(r->tables);
+	if (!r->forwarded && !r->redundant) return;
+
+	for (int i = 0; i < f->rpo_cnt; i++)
+		for (int j = f->rpo[i]->first; j <= f->rpo[i]->last; j++)
+			if (!f->ops[j].removed) ssa_use_copies(f, f->ops[j].op);
+	ssa_eliminate_dead_code(f);
+	ssa_translate(f);
+}
+
+/**
+ * Replaces loads of values which were loaded or stored before; returns
+ * the number of replaced loads
+ */
+static int jit_eliminate_redundant_loads(struct jit * jit)
+{
+	int changes = 0;
+	jit_tree * code_refs = NULL;
+	ssa_collect_code_refs(jit, &code_refs);
+
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		if (GET_OP(op) != JIT_PROLOG) {
+			op = op->next;
+			continue;
+		}
+		jit_op * prolog = op;
+		do op = op->next;
+		while (op && (GET_OP(op) != JIT_PROLOG));
+
+		struct ssa_func f;
+		struct rle_func r;
+		memset(&f, 0, sizeof(struct ssa_func));
+		memset(&r, 0, sizeof(struct rle_func));
+		r.f = &f;
+		if (ssa_build(&f, prolog, code_refs)) {
+			rle_optimize_function(&r);
+			jit->stats[JIT_STAT_FORWARDED_LOADS] += r.forwarded;
+			jit->stats[JIT_STAT_REDUNDANT_LOADS] += r.redundant;
+			changes += r.forwarded + r.redundant;
+		}
+		ssa_free(&f);
+	}
+	jit_tree_free(code_refs);
+	return changes;
+}
@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 //
@@ -83,9 +84,10 @@ static void assign_regs_for_args(struct jit_reg_allocator * al, jit_op * op)
 
 	int assoc_gp_regs = 0;
 	int assoc_fp_regs = 0;
+	int gp_arg_reg_cnt = jit_gp_arg_reg_cnt(al, info);
 	for (int i = 0; i < info->general_arg_cnt + info->float_arg_cnt; i++) {
 		int isfp_arg = (info->args[i].type == JIT_FLOAT_NUM);
-		if (!isfp_arg && (assoc_gp_regs < al->gp_arg_reg_cnt)) {
+		if (!isfp_arg && (assoc_gp_regs < gp_arg_reg_cnt)) {
 			rmap_assoc(op->regmap, jit_mkreg(JIT_RTYPE_INT, JIT_RTYPE_ARG, i), al->gp_arg_regs[assoc_gp_regs]);
 			assoc_gp_regs++;
 		}
@@ -167,6 +169,21 @@ static void assign_regs_for_args(struct jit_reg_allocator * al, jit_op * op)
 }
 #endif
 
+#ifdef JIT_ARCH_AMD64
+/**
+ * Checks whether the value is passed as the given integer argument,
+ * i.e., it already resides in the register used to pass it
+ */
+static int is_passed_in_place(jit_op * prepare, jit_value reg, int pos)
+{
+	for (jit_op * op = prepare->next; GET_OP(op) != JIT_CALL; op = op->next) {
+		if ((GET_OP(op) == JIT_PUTARG) && (pos-- == 0))
+			return !IS_IMM(op) && (op->arg[0] == reg);
+	}
+	return 0;
+}
+#endif
+
 static void prepare_registers_for_call(struct jit_reg_allocator * al, jit_op * op)
 {
 	jit_value r, reg;
@@ -203,9 +220,13 @@ skip:
 
 	// spills registers which are used to pass the arguments
 	// FIXME: duplicities
-	int args = MIN(op->arg[0], al->gp_arg_reg_cnt);
+	struct jit_func_info * callee = called_func_info(prepared_call(op));
+	int args = MIN(op->arg[0], jit_gp_arg_reg_cnt(al, callee));
 	for (int q = 0; q < args; q++) {
 		jit_hw_reg * hreg = rmap_is_associated(op->regmap, al->gp_arg_regs[q]->id, 0, &reg);
+#ifdef JIT_ARCH_AMD64
+		if (hreg && callee && callee->private_conv && is_passed_in_place(op, reg, q)) continue;
+#endif
 		if (hreg) {
 			if (jit_set_get(op->live_out, reg)) unload_reg(op, hreg, reg);
 			rmap_unassoc(op->regmap, reg);
@@ -459,6 +480,38 @@ static void assign_regs(struct jit * jit, struct jit_op * op)
 	}
 }
 
+#ifdef JIT_ARCH_COMMON86
+static void mark_clobbered_regs(jit_tree * hint, jit_op * op, int clobbered)
+{
+	if (hint == NULL) return;
+	struct jit_allocator_hint * h = (struct jit_allocator_hint *) hint->value;
+	jit_value reg = (jit_value) hint->key;
+	if ((reg != op->arg[0]) && jit_set_get(op->live_out, reg)) h->avoided_regs |= clobbered;
+
+	mark_clobbered_regs(hint->left, op, clobbered);
+	mark_clobbered_regs(hint->right, op, clobbered);
+}
+
+/**
+ * Values alive across the call of a function with the private calling
+ * convention avoid registers used to pass arguments, except for the register
+ * used to pass the value itself
+ */
+static void mark_private_arg_regs(jit_tree * hint, jit_op * op, int arg_regs)
+{
+	if (hint == NULL) return;
+	struct jit_allocator_hint * h = (struct jit_allocator_hint *) hint->value;
+	jit_value reg = (jit_value) hint->key;
+	if (jit_set_get(op->live_out, reg)) {
+		int own = (h->preferred_reg >= 0) ? (1 << h->preferred_reg) : 0;
+		h->avoided_regs |= arg_regs & ~own;
+	}
+
+	mark_private_arg_regs(hint->left, op, arg_regs);
+	mark_private_arg_regs(hint->right, op, arg_regs);
+}
+#endif
+
 static void mark_calleesaved_regs(jit_tree * hint, jit_op * op)
 {
 	if (hint == NULL) return;
@@ -512,6 +565,8 @@ void jit_collect_statistics(struct jit * jit)
 				new_hint->last_pos = 0;
 				new_hint->should_be_calleesaved = 0;
 				new_hint->should_be_eax = 0;
+				new_hint->preferred_reg = -1;
+				new_hint->avoided_regs = 0;
 			}
 			new_hint->refs = 0;
 
@@ -520,10 +575,28 @@ void jit_collect_statistics(struct jit * jit)
 			if ((GET_OP(op) == JIT_RETVAL) || (GET_OP(op) == JIT_RET)) 
 				new_hint->should_be_eax++;
 #endif 
+#ifdef JIT_ARCH_COMMON86
+			int preferred = jit_preferred_reg(jit->reg_al, op, reg);
+			if (preferred >= 0) new_hint->preferred_reg = preferred;
+			new_hint->avoided_regs |= jit_avoided_regs(op, reg);
+#endif
 			new_hints = jit_tree_insert(new_hints, reg, new_hint, NULL);
 		}
 #if defined (JIT_ARCH_COMMON86) || defined (JIT_ARCH_ARM32)
 		if (GET_OP(op) == JIT_CALL) mark_calleesaved_regs(new_hints, op);
+#endif
+#ifdef JIT_ARCH_COMMON86
+		int clobbered = jit_clobbered_regs(op);
+		if (clobbered) mark_clobbered_regs(new_hints, op, clobbered);
+		if (GET_OP(op) == JIT_PREPARE) {
+			struct jit_func_info * callee = called_func_info(prepared_call(op));
+			if (callee && callee->private_conv) {
+				int arg_regs = 0;
+				for (int q = 0; q < MIN(op->arg[0], jit_gp_arg_reg_cnt(jit->reg_al, callee)); q++)
+					arg_regs |= (1 << jit->reg_al->gp_arg_regs[q]->id);
+				mark_private_arg_regs(new_hints, op, arg_regs);
+			}
+		}
 #endif
 		hints_refcount_inc(new_hints);
 		op->allocator_hints = new_hints;
@@ -557,6 +630,176 @@ void jit_allocator_hints_free(jit_tree * hints)
 
 	JIT_FREE(hints);
 }
+
+//////////////////////////////////////////////////////////////////
+//
+// Loops
+//
+
+static inline int is_backward_jump(jit_op * op)
+{
+	if (!is_cond_branch_op(op) && (op->code != (JIT_JMP | IMM))) return 0;
+	return op->jmp_addr && (op->jmp_addr->normalized_pos > op->normalized_pos);
+}
+
+struct loop_pressure {
+	struct jit_loop * loop;
+	jit_set * skipped;
+	int count[2];
+};
+
+static void count_loop_reg(jit_tree_key key, jit_tree_value value, void * thunk)
+{
+	struct loop_pressure * p = (struct loop_pressure *) thunk;
+	if (p->skipped && jit_set_get(p->skipped, key)) return;
+	if (jit_set_get(p->loop->used, key)) p->count[JIT_REG_TYPE(key)]++;
+}
+
+/**
+ * Counts registers used in the loop which are alive at the beginning
+ * or at the end of the operation
+ */
+static void update_loop_pressure(struct jit_loop * loop, jit_op * op)
+{
+	struct loop_pressure p = { loop, NULL, { 0, 0 } };
+	jit_tree_walk(op->live_in->root, count_loop_reg, &p);
+	p.skipped = op->live_in;
+	jit_tree_walk(op->live_out->root, count_loop_reg, &p);
+	for (int i = 0; i < 2; i++)
+		if (p.count[i] > loop->pressure[i]) loop->pressure[i] = p.count[i];
+}
+
+/**
+ * Collects registers used inside the loop and estimates how many of them
+ * are alive at once
+ */
+static void analyze_loop(jit_tree_key key, jit_tree_value value, void * thunk)
+{
+	struct jit_loop * loop = (struct jit_loop *) value;
+	for (jit_op * op = loop->header; ; op = op->next) {
+		for (int i = 0; i < 3; i++)
+			if ((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG))
+				jit_set_add(loop->used, op->arg[i]);
+		if (op == loop->end) break;
+	}
+
+	for (jit_op * op = loop->header; ; op = op->next) {
+		update_loop_pressure(loop, op);
+		if (op == loop->end) break;
+	}
+}
+
+/**
+ * Finds loops, i.e., code between a target of a backward jump and the jump itself.
+ * Loops are indexed by their headers.
+ */
+static jit_tree * collect_loops(struct jit * jit)
+{
+	jit_tree * loops = NULL;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (!is_backward_jump(op)) continue;
+
+		jit_tree * found = jit_tree_search(loops, (jit_tree_key) op->jmp_addr);
+		struct jit_loop * loop;
+		if (found) loop = (struct jit_loop *) found->value;
+		else {
+			loop = JIT_MALLOC(sizeof(struct jit_loop));
+			loop->header = op->jmp_addr;
+			loop->used = jit_set_new();
+			loop->pressure[0] = 0;
+			loop->pressure[1] = 0;
+			loop->parent = NULL;
+			loops = jit_tree_insert(loops, (jit_tree_key) op->jmp_addr, loop, NULL);
+		}
+		loop->end = op;
+	}
+	jit_tree_walk(loops, analyze_loop, NULL);
+	return loops;
+}
+
+static void free_loop(jit_tree_key key, jit_tree_value value, void * thunk)
+{
+	struct jit_loop * loop = (struct jit_loop *) value;
+	jit_set_free(loop->used);
+	JIT_FREE(loop);
+}
+
+static void free_loops(jit_tree * loops)
+{
+	jit_tree_walk(loops, free_loop, NULL);
+	jit_tree_free(loops);
+}
+
+/**
+ * Returns the innermost loop containing the operation `op'. Loops which
+ * are not properly nested in the enclosing loop are ignored.
+ */
+static struct jit_loop * enter_loop(jit_tree * loops, struct jit_loop * current, jit_op * op)
+{
+	if (GET_OP(op) == JIT_PROLOG) current = NULL;
+
+	jit_tree * found = jit_tree_search(loops, (jit_tree_key) op);
+	if (!found) return current;
+
+	struct jit_loop * loop = (struct jit_loop *) found->value;
+	if (current && (loop->end->normalized_pos < current->end->normalized_pos)) return current;
+	loop->parent = current;
+	return loop;
+}
+
+static struct jit_loop * leave_loop(struct jit_loop * current, jit_op * op)
+{
+	while (current && (current->end == op))
+		current = current->parent;
+	return current;
+}
+
+/**
+ * If registers used inside the loop do not fit into the hardware registers
+ * together with values which are alive throughout the loop but not used in it,
+ * the latter ones are spilled before the loop is entered. Otherwise, they would
+ * be spilled inside the loop and reloaded in front of each backward jump.
+ */
+static void evict_loop_invariants(struct jit_reg_allocator * al, jit_op * op, struct jit_loop * loop)
+{
+	for (int fp = 0; fp < 2; fp++) {
+		jit_hw_reg * regs = fp ? al->fp_regs : al->gp_regs;
+		int reg_count = fp ? al->fp_reg_cnt : al->gp_reg_cnt;
+
+		int available = 0;
+		int unused = 0;
+		for (int i = 0; i < reg_count; i++) {
+			jit_value x;
+			if (is_allocatable_reg(al, &(regs[i]))) available++;
+			if (rmap_is_associated(op->regmap, regs[i].id, fp, &x)
+			&& jit_set_get(op->live_in, x) && !jit_set_get(loop->used, x)) unused++;
+		}
+
+		for (int excess = loop->pressure[fp] + unused - available; excess > 0; excess--) {
+			// spills the value which is used as late as possible
+			jit_hw_reg * victim = NULL;
+			jit_value victim_reg = 0;
+			int victim_pos = INT_MAX;
+			for (int i = 0; i < reg_count; i++) {
+				jit_value x;
+				if (!rmap_is_associated(op->regmap, regs[i].id, fp, &x)) continue;
+				if (!jit_set_get(op->live_in, x) || jit_set_get(loop->used, x)) continue;
+
+				jit_tree * hint_node = jit_tree_search(op->allocator_hints, x);
+				int pos = hint_node ? ((struct jit_allocator_hint *) hint_node->value)->last_pos : -1;
+				if (pos < victim_pos) {
+					victim = &(regs[i]);
+					victim_reg = x;
+					victim_pos = pos;
+				}
+			}
+			if (!victim) break;
+			unload_reg(op, victim, victim_reg);
+			rmap_unassoc(op->regmap, victim_reg);
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////
 
 /**
@@ -575,6 +818,69 @@ static inline void jump_adjustment(struct jit * jit, jit_op * op)
 	}
 }
 
+static jit_op * function_last_op(jit_op * op)
+{
+	while (op->next && (GET_OP(op->next) != JIT_PROLOG)) op = op->next;
+	return op;
+}
+
+/**
+ * Jumps leaving the loop are taken at most once per loop execution,
+ * hence, the register reorganization is moved to the end of the function
+ * and the loop body is not affected:
+ *	beq(exit, ..., ...);
+ *	==>
+ *	beq(stub, ..., ...);
+ *	...
+ *	stub:
+ *	register reorganization
+ *	jmp exit
+ * Returns 0 if the jump cannot be handled this way.
+ */
+static int sink_loop_exit_adjustment(struct jit * jit, jit_op * op, struct jit_loop * loop)
+{
+	if (!loop) return 0;
+
+	jit_op * target = op->jmp_addr;
+	if ((GET_OP(target) != JIT_PATCH) && (GET_OP(target) != JIT_LABEL)) return 0;
+	if ((target->normalized_pos <= loop->header->normalized_pos)
+	&& (target->normalized_pos >= loop->end->normalized_pos)) return 0;
+
+	// the stub can be placed only behind an operation which does not fall through
+	jit_op * last = function_last_op(op);
+	if ((GET_OP(last) != JIT_RET) && (GET_OP(last) != JIT_FRET) && (GET_OP(last) != JIT_JMP)) return 0;
+
+	// forward jump becomes a backward jump, thus, it needs a label
+	if (GET_OP(target) == JIT_PATCH) {
+		jit_label * label = JIT_MALLOC(sizeof(jit_label));
+		label->op = target;
+		label->next = jit->labels;
+		jit->labels = label;
+
+		target->code = JIT_LABEL;
+		target->spec = SPEC(IMM, NO, NO);
+		target->arg[0] = (jit_value) label;
+		target->r_arg[0] = target->arg[0];
+	}
+
+	jit_op * o2 = jit_op_new(JIT_PATCH, SPEC(IMM, NO, NO), (jit_value) op, 0, 0, 0);
+	o2->r_arg[0] = o2->arg[0];
+	jit_op_append(last, o2);
+
+	jit_op * o = jit_op_new(JIT_JMP | IMM, SPEC(IMM, NO, NO), target->arg[0], 0, 0, 0);
+	o->r_arg[0] = o->arg[0];
+	o->regmap = rmap_clone(op->regmap);
+	o->live_in = jit_set_clone(op->live_in);
+	o->live_out = jit_set_clone(op->live_out);
+	o->jmp_addr = target;
+	jit_op_append(o2, o);
+
+	op->arg[0] = (jit_value) o2;
+	op->r_arg[0] = (jit_value) o2;
+	op->jmp_addr = o2;
+	return 1;
+}
+
 /**
  * There must be same register mappings at both ends of the conditional jump.
  * If this condition is not met, contents of registers have to be moved
@@ -589,38 +895,20 @@ static inline void jump_adjustment(struct jit * jit, jit_op * op)
  *	jmp succ
  *	fail:
  */
-static inline void branch_adjustment(struct jit * jit, jit_op * op)
+static inline void branch_adjustment(struct jit * jit, jit_op * op, struct jit_loop * loop)
 {
 	if (!is_cond_branch_op(op)) return;
 	jit_rmap * cur_regmap = op->regmap;
 	jit_rmap * tgt_regmap = op->jmp_addr->regmap;
 
 	if (!rmap_equal(op, cur_regmap, tgt_regmap)) {
+		if (sink_loop_exit_adjustment(jit, op, loop)) return;
+
         // under normal circumstances the "subset" should be sufficient condition
         // however, linear-scan allocator we use handles branch ops as a common
         // operations and is unable to assign correct register maps to target ops
 	//if (!rmap_subset(op, tgt_regmap->map, cur_regmap->map)) {
-		switch (GET_OP(op)) {
-			case JIT_BEQ: op->code = JIT_BNE | (op->code & 0x7); break;
-			case JIT_BGT: op->code = JIT_BLE | (op->code & 0x7); break;
-			case JIT_BGE: op->code = JIT_BLT | (op->code & 0x7); break;
-			case JIT_BNE: op->code = JIT_BEQ | (op->code & 0x7); break;
-			case JIT_BLT: op->code = JIT_BGE | (op->code & 0x7); break;
-			case JIT_BLE: op->code = JIT_BGT | (op->code & 0x7); break;
-
-			case JIT_BOADD: op->code = JIT_BNOADD | (op->code & 0x7); break;
-			case JIT_BOSUB: op->code = JIT_BNOSUB | (op->code & 0x7); break;
-			case JIT_BNOADD: op->code = JIT_BOADD | (op->code & 0x7); break;
-			case JIT_BNOSUB: op->code = JIT_BOSUB | (op->code & 0x7); break;
-
-			case JIT_FBEQ: op->code = JIT_FBNE | (op->code & 0x7); break;
-			case JIT_FBGT: op->code = JIT_FBLE | (op->code & 0x7); break;
-			case JIT_FBGE: op->code = JIT_FBLT | (op->code & 0x7); break;
-			case JIT_FBNE: op->code = JIT_FBEQ | (op->code & 0x7); break;
-			case JIT_FBLT: op->code = JIT_FBGE | (op->code & 0x7); break;
-			case JIT_FBLE: op->code = JIT_FBGT | (op->code & 0x7); break;
-			default: break;
-		}
+		jit_negate_branch(op);
 	
 		jit_op * o = jit_op_new(JIT_JMP | IMM, SPEC(IMM, NO, NO), op->arg[0], 0, 0, 0);		
 		o->r_arg[0] = op->r_arg[0];
@@ -650,19 +938,792 @@ static inline void branch_adjustment(struct jit * jit, jit_op * op)
 
 void jit_assign_regs(struct jit * jit)
 {
+	struct jit_reg_allocator * al = jit->reg_al;
+	jit_tree * loops = collect_loops(jit);
+
 	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
 		op->regmap = rmap_init();
 
-	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
+	al->current_loop = NULL;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		al->current_loop = enter_loop(loops, al->current_loop, op);
 		assign_regs(jit, op);
 
-	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
-		branch_adjustment(jit, op);
+		struct jit_loop * loop = al->current_loop;
+		if (loop && (loop->header == op) && (GET_OP(op) == JIT_LABEL)) evict_loop_invariants(al, op, loop);
+		al->current_loop = leave_loop(al->current_loop, op);
+	}
+
+	struct jit_loop * loop = NULL;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		loop = enter_loop(loops, loop, op);
+		branch_adjustment(jit, op, loop);
+		loop = leave_loop(loop, op);
+	}
+	al->current_loop = NULL;
+	free_loops(loops);
 
 	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
 		jump_adjustment(jit, op);
 }
 
+//////////////////////////////////////////////////////////////////
+//
+// Rematerialization
+//
+
+/**
+ * Returns 1 if the operation computes a value which does not depend
+ * on the state of the program, i.e., it can be recomputed at any point
+ * of the function instead of being spilled and reloaded
+ */
+static int is_rematerializable_op(struct jit * jit, jit_op * op)
+{
+	if (!op->in_use) return 0;
+	if (op->code == (JIT_MOV | IMM)) return 1;
+	if ((op->code == (JIT_ADD | IMM)) && (op->arg[1] == R_FP)) return 1;
+	// references to forward patches are resolved during the code emission,
+	// hence, only references to labels can be safely duplicated
+	if (((GET_OP(op) == JIT_REF_CODE) || (GET_OP(op) == JIT_REF_DATA))
+	&& jit_is_label(jit, (void *)op->arg[1])) return 1;
+	return 0;
+}
+
+static jit_op remat_excluded;
+
+/**
+ * Returns 1 if the code generator may read the value of the register
+ * directly from its stack slot, i.e., the register has to be spilled
+ */
+static int reads_spilled_regs(jit_op * op)
+{
+	jit_opcode code = GET_OP(op);
+	return (code == JIT_PUTARG) || (code == JIT_FPUTARG) || (code == JIT_CALL) || is_transfer_op(op);
+}
+
+static int is_carry_op(jit_op * op)
+{
+	jit_opcode code = GET_OP(op);
+	return (code == JIT_ADDC) || (code == JIT_ADDX) || (code == JIT_SUBC) || (code == JIT_SUBX);
+}
+
+/**
+ * Excludes registers reloaded between an operation setting the carry flag
+ * and the ADDX/SUBX operation consuming it. The rematerialized operation
+ * (e.g., XOR clearing the register) may overwrite the flag, hence,
+ * these registers have to be reloaded from their stack slots.
+ */
+static jit_tree * exclude_carry_chain_reloads(jit_tree * defs, jit_op * consumer)
+{
+	for (jit_op * op = consumer->prev; op != NULL; op = op->prev) {
+		if (is_carry_op(op) || (GET_OP(op) == JIT_LABEL) || (GET_OP(op) == JIT_PATCH) || (GET_OP(op) == JIT_PROLOG)) break;
+		if (GET_OP(op) == JIT_LREG)
+			defs = jit_tree_insert(defs, op->arg[1], &remat_excluded, NULL);
+	}
+	return defs;
+}
+
+/**
+ * Collects registers of the function which are defined exactly once and
+ * their definition is rematerializable. Maps such registers to their
+ * defining operations.
+ */
+static jit_tree * collect_rematerializable_regs(struct jit * jit, jit_op * prolog)
+{
+	jit_tree * defs = NULL;
+	for (jit_op * op = prolog->next; op != NULL && (GET_OP(op) != JIT_PROLOG); op = op->next) {
+		if ((GET_OP(op) == JIT_ADDX) || (GET_OP(op) == JIT_SUBX))
+			defs = exclude_carry_chain_reloads(defs, op);
+		for (int i = 0; i < 3; i++) {
+			jit_value reg = op->arg[i];
+			if (ARG_TYPE(op, i + 1) == TREG) {
+				jit_op * def = (jit_tree_search(defs, reg) ? &remat_excluded : op);
+				defs = jit_tree_insert(defs, reg, def, NULL);
+			}
+			if ((ARG_TYPE(op, i + 1) == REG) && reads_spilled_regs(op))
+				defs = jit_tree_insert(defs, reg, &remat_excluded, NULL);
+		}
+	}
+	return defs;
+}
+
+static jit_op * rematerializable_def(struct jit * jit, jit_tree * defs, jit_value reg)
+{
+	if (JIT_REG_SPEC(reg) == JIT_RTYPE_ARG) return NULL;
+
+	jit_tree * found = jit_tree_search(defs, reg);
+	if (!found) return NULL;
+
+	jit_op * def = (jit_op *) found->value;
+	if ((def == &remat_excluded) || !is_rematerializable_op(jit, def)) return NULL;
+	return def;
+}
+
+/**
+ * Turns the LREG operation into a copy of the defining operation
+ */
+static void rematerialize_reg(struct jit * jit, jit_op * lreg, jit_op * def)
+{
+	jit_value hreg = lreg->arg[0];
+
+	lreg->code = def->code;
+	lreg->spec = def->spec;
+	lreg->fp = def->fp;
+	lreg->arg_size = def->arg_size;
+	for (int i = 0; i < 3; i++) {
+		lreg->arg[i] = def->arg[i];
+		lreg->r_arg[i] = def->r_arg[i];
+	}
+	lreg->r_arg[0] = hreg;
+}
+
+/**
+ * Values which are cheap to recompute (constants, addresses relative to
+ * the frame pointer, and references to labels) are not spilled out at all.
+ * Their UREG and SYNCREG operations are dropped and LREG operations
+ * are replaced with the operation which computes the value.
+ */
+void jit_rematerialize(struct jit * jit)
+{
+	jit_tree * defs = NULL;
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		jit_op * next = op->next;
+		switch (GET_OP(op)) {
+			case JIT_PROLOG:
+				jit_tree_free(defs);
+				defs = collect_rematerializable_regs(jit, op);
+				break;
+			case JIT_UREG:
+			case JIT_SYNCREG:
+				if (rematerializable_def(jit, defs, op->arg[0])) {
+					jit_op_delete(op);
+					jit->stats[JIT_STAT_AVOIDED_SPILLS]++;
+				}
+				break;
+			case JIT_LREG: {
+				jit_op * def = rematerializable_def(jit, defs, op->arg[1]);
+				if (def) {
+					rematerialize_reg(jit, op, def);
+					jit->stats[JIT_STAT_AVOIDED_RELOADS]++;
+				}
+				break;
+			}
+			default: break;
+		}
+		op = next;
+	}
+	jit_tree_free(defs);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+// Redundant spills and reloads
+//
+
+#define JIT_MAX_HW_REGS	(64)
+
+struct jit_spill_state {
+	jit_value gp_regs[JIT_MAX_HW_REGS];	// virtual registers whose values hw. registers hold
+	jit_value fp_regs[JIT_MAX_HW_REGS];
+	jit_set * in_memory;			// virtual registers whose stack slots are up to date
+};
+
+static void spill_state_reset_regs(struct jit_spill_state * st)
+{
+	for (int i = 0; i < JIT_MAX_HW_REGS; i++) {
+		st->gp_regs[i] = -1;
+		st->fp_regs[i] = -1;
+	}
+}
+
+static inline jit_value * spill_state_regs(struct jit_spill_state * st, jit_value vreg)
+{
+	return (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT) ? st->fp_regs : st->gp_regs;
+}
+
+static int spill_state_find(struct jit_spill_state * st, jit_value vreg)
+{
+	jit_value * regs = spill_state_regs(st, vreg);
+	for (int i = 0; i < JIT_MAX_HW_REGS; i++)
+		if (regs[i] == vreg) return i;
+	return -1;
+}
+
+static void spill_state_define(struct jit_spill_state * st, jit_value vreg, int hreg)
+{
+	jit_value * regs = spill_state_regs(st, vreg);
+	for (int i = 0; i < JIT_MAX_HW_REGS; i++)
+		if (regs[i] == vreg) regs[i] = -1;
+	jit_set_remove(st->in_memory, vreg);
+	if ((hreg >= 0) && (hreg < JIT_MAX_HW_REGS)) regs[hreg] = vreg;
+}
+
+/**
+ * Hardware registers keep values of virtual registers across the operation
+ * only if these are associated with them, unassociated registers may be
+ * used by the code generator as temporaries. (Operations without the register
+ * map were inserted by the allocator or by the rematerialization and they
+ * modify their output register only.)
+ */
+static void spill_state_filter(struct jit_spill_state * st, jit_op * op)
+{
+	if (!op->regmap) return;
+	for (int i = 0; i < JIT_MAX_HW_REGS; i++) {
+		if (st->gp_regs[i] != -1) {
+			jit_hw_reg * hreg = rmap_get(op->regmap, st->gp_regs[i]);
+			if (!hreg || (hreg->id != i)) st->gp_regs[i] = -1;
+		}
+		if (st->fp_regs[i] != -1) {
+			jit_hw_reg * hreg = rmap_get(op->regmap, st->fp_regs[i]);
+			if (!hreg || (hreg->id != i)) st->fp_regs[i] = -1;
+		}
+	}
+}
+
+static inline int is_spill_flow_edge(jit_op * op)
+{
+	return is_cond_branch_op(op) || (GET_OP(op) == JIT_JMP);
+}
+
+/**
+ * Collects destinations of jumps. Each destination is associated with the set
+ * of registers which are up to date on the stack whenever the destination
+ * is reached by a jump (NULL stands for a destination which has not been
+ * reached yet). Code reached through addresses (JMPR) starts with an empty
+ * set.
+ */
+static jit_tree * collect_jump_targets(jit_op * first)
+{
+	jit_tree * targets = NULL;
+	for (jit_op * op = first; op != NULL; op = op->next) {
+		if (!op->jmp_addr || (GET_OP(op) == JIT_CALL)) continue;
+		jit_value key = (jit_value) op->jmp_addr;
+		if (!jit_tree_search(targets, key)) targets = jit_tree_insert(targets, key, NULL, NULL);
+
+		jit_tree * target = jit_tree_search(targets, key);
+		if (!is_spill_flow_edge(op) && !target->value) target->value = jit_set_new();
+	}
+	return targets;
+}
+
+static void free_jump_target(jit_tree_key key, jit_tree_value value, void * thunk)
+{
+	if (value) jit_set_free((jit_set *) value);
+}
+
+static void spill_state_transfer(struct jit * jit, struct jit_spill_state * st, jit_op * op, int rewrite)
+{
+	switch (GET_OP(op)) {
+		case JIT_UREG:
+		case JIT_SYNCREG: {
+			jit_value vreg = op->arg[0];
+			spill_state_regs(st, vreg)[op->arg[1]] = vreg;
+			if (!jit_set_get(st->in_memory, vreg)) jit_set_add(st->in_memory, vreg);
+			else if (rewrite) {
+				jit_op_delete(op);
+				jit->stats[JIT_STAT_REDUNDANT_SPILLS]++;
+			}
+			break;
+		}
+		case JIT_LREG: {
+			jit_value vreg = op->arg[1];
+			int hreg = op->arg[0];
+			int src = spill_state_find(st, vreg);
+			spill_state_regs(st, vreg)[hreg] = vreg;
+			jit_set_add(st->in_memory, vreg);
+
+			if (!rewrite || (src < 0)) break;
+			if (src == hreg) jit_op_delete(op);
+			else {
+				// value is moved from another register
+				op->code = JIT_RENAMEREG;
+				op->spec = SPEC(IMM, IMM, IMM);
+				op->fp = (JIT_REG_TYPE(vreg) == JIT_RTYPE_FLOAT);
+				op->arg[1] = op->r_arg[1] = src;
+				op->arg[2] = op->r_arg[2] = vreg;
+			}
+			jit->stats[JIT_STAT_REDUNDANT_RELOADS]++;
+			break;
+		}
+		case JIT_RENAMEREG: {
+			jit_value * regs = (op->fp ? st->fp_regs : st->gp_regs);
+			regs[op->arg[0]] = regs[op->arg[1]];
+			break;
+		}
+		default:
+			spill_state_filter(st, op);
+			for (int i = 0; i < 3; i++)
+				if (ARG_TYPE(op, i + 1) == TREG) spill_state_define(st, op->arg[i], op->r_arg[i]);
+	}
+}
+
+/**
+ * Walks through the code and propagates the state of the stack along
+ * the control flow. Returns 1 if any of the jump targets has changed its state.
+ */
+static int spill_state_walk(struct jit * jit, jit_tree * targets, int rewrite)
+{
+	struct jit_spill_state st;
+	st.in_memory = jit_set_new();
+	spill_state_reset_regs(&st);
+
+	int changed = 0;
+	int reachable = 0;
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		jit_op * next = op->next;
+		jit_opcode code = GET_OP(op);
+
+		jit_tree * target = jit_tree_search(targets, (jit_value) op);
+		if ((code == JIT_PROLOG) || target || !reachable) {
+			spill_state_reset_regs(&st);
+			jit_set * entry = (target ? target->value : NULL);
+			if ((code == JIT_PROLOG) || (!reachable && !entry)) {
+				jit_set_free(st.in_memory);
+				st.in_memory = jit_set_new();
+			} else if (!reachable) {
+				jit_set_free(st.in_memory);
+				st.in_memory = jit_set_clone(entry);
+			} else if (entry) jit_set_retainall(st.in_memory, entry);
+		}
+
+		// the operation may be deleted by the transfer function
+		jit_op * jmp_addr = (is_spill_flow_edge(op) ? op->jmp_addr : NULL);
+		spill_state_transfer(jit, &st, op, rewrite);
+
+		if (jmp_addr) {
+			jit_tree * t = jit_tree_search(targets, (jit_value) jmp_addr);
+			if (!t->value) {
+				t->value = jit_set_clone(st.in_memory);
+				changed = 1;
+			} else changed |= jit_set_retainall(t->value, st.in_memory);
+		}
+		reachable = (code != JIT_JMP) && (code != JIT_RET) && (code != JIT_FRET);
+		op = next;
+	}
+	jit_set_free(st.in_memory);
+	return changed;
+}
+
+/**
+ * Drops stores of values which are already on the stack and reloads of values
+ * which are still in the hw. register. If the value is in another register,
+ * reload is replaced with the register move.
+ *
+ * Registers whose stack slots are up to date are tracked across jumps
+ * (the state at the jump target is the intersection of states of all its
+ * predecessors), contents of hw. registers are tracked within basic blocks
+ * only.
+ */
+void jit_eliminate_redundant_spills(struct jit * jit)
+{
+	jit_tree * targets = collect_jump_targets(jit_op_first(jit->ops));
+	while (spill_state_walk(jit, targets, 0)) ;
+	spill_state_walk(jit, targets, 1);
+
+	jit_tree_walk(targets, free_jump_target, NULL);
+	jit_tree_free(targets);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+// Stack slots
+//
+
+struct jit_slot_interval {
+	jit_value reg;		// spilled register
+	int start;		// position of the first operation the register is live at
+	int end;		// position of the last operation the register is live at
+	int uses;		// number of spills and reloads of the register
+	int direct;		// indicates whether the code generator reads the stack slot directly
+	int slot;
+	int fp_reg;		// FP register holding the value instead of the slot, or -1
+};
+
+struct jit_slot_context {
+	jit_tree * intervals;	// maps registers to their intervals
+	int pos;		// position of the current operation
+};
+
+static int is_spillable_reg(jit_value reg)
+{
+	return JIT_REG_SPEC(reg) == JIT_RTYPE_REG;
+}
+
+static jit_tree * add_spilled_reg(jit_tree * intervals, jit_value reg, int pos, int uses, int direct)
+{
+	if (!is_spillable_reg(reg)) return intervals;
+	jit_tree * found = jit_tree_search(intervals, reg);
+	struct jit_slot_interval * i;
+	if (found) i = (struct jit_slot_interval *) found->value;
+	else {
+		i = JIT_MALLOC(sizeof(struct jit_slot_interval));
+		i->reg = reg;
+		i->start = pos;
+		i->end = pos;
+		i->uses = 0;
+		i->direct = 0;
+		i->slot = -1;
+		i->fp_reg = -1;
+		intervals = jit_tree_insert(intervals, reg, i, NULL);
+	}
+	i->uses += uses;
+	i->direct |= direct;
+	return intervals;
+}
+
+static void extend_interval(jit_tree * intervals, jit_value reg, int pos)
+{
+	jit_tree * found = jit_tree_search(intervals, reg);
+	if (!found) return;
+	struct jit_slot_interval * i = (struct jit_slot_interval *) found->value;
+	if (pos < i->start) i->start = pos;
+	if (pos > i->end) i->end = pos;
+}
+
+static void extend_live_interval(jit_tree_key reg, jit_tree_value value, void * thunk)
+{
+	struct jit_slot_context * ctx = (struct jit_slot_context *) thunk;
+	extend_interval(ctx->intervals, reg, ctx->pos);
+}
+
+static void collect_interval(jit_tree_key reg, jit_tree_value value, void * thunk)
+{
+	struct jit_slot_interval *** top = (struct jit_slot_interval ***) thunk;
+	**top = (struct jit_slot_interval *) value;
+	(*top)++;
+}
+
+static int interval_cmp(const void * a, const void * b)
+{
+	struct jit_slot_interval * i1 = *(struct jit_slot_interval **) a;
+	struct jit_slot_interval * i2 = *(struct jit_slot_interval **) b;
+	if (i1->start != i2->start) return i1->start - i2->start;
+	return (i1->reg < i2->reg) ? -1 : (i1->reg > i2->reg);
+}
+
+/**
+ * Assigns slots to intervals of one register type; intervals which do not
+ * overlap share the same slot. Slots are ordered by the number of uses,
+ * hence, the most frequently used slots are adjacent.
+ */
+static int color_slots(struct jit_slot_interval ** intervals, int count, int fp, int * slots, int max_slots)
+{
+	int slot_count = 0;
+	int * slot_end = JIT_MALLOC(sizeof(int) * (count + 1));
+	int * slot_uses = JIT_MALLOC(sizeof(int) * (count + 1));
+	for (int i = 0; i < count; i++) {
+		struct jit_slot_interval * in = intervals[i];
+		if ((JIT_REG_TYPE(in->reg) == JIT_RTYPE_FLOAT) != fp) continue;
+		if (in->fp_reg >= 0) continue;
+		int s = 0;
+		while ((s < slot_count) && (slot_end[s] >= in->start)) s++;
+		if (s == slot_count) {
+			slot_uses[slot_count] = 0;
+			slot_count++;
+		}
+		slot_end[s] = in->end;
+		slot_uses[s] += in->uses;
+		in->slot = s;
+	}
+
+	// hot slots first
+	int * order = JIT_MALLOC(sizeof(int) * (count + 1));
+	for (int i = 0; i < slot_count; i++) {
+		int j = i;
+		while ((j > 0) && (slot_uses[order[j - 1]] < slot_uses[i])) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	int * rank = slot_end;
+	for (int i = 0; i < slot_count; i++)
+		rank[order[i]] = i;
+
+	for (int i = 0; i < max_slots; i++)
+		slots[i] = -1;
+	for (int i = 0; i < count; i++) {
+		struct jit_slot_interval * in = intervals[i];
+		if ((JIT_REG_TYPE(in->reg) == JIT_RTYPE_FLOAT) != fp) continue;
+		if (in->fp_reg >= 0) continue;
+		slots[JIT_REG_ID(in->reg)] = rank[in->slot];
+	}
+
+	JIT_FREE(order);
+	JIT_FREE(slot_uses);
+	JIT_FREE(slot_end);
+	return slot_count;
+}
+
+/**
+ * Returns 1 if the operation calls some function, i.e., it clobbers all FP registers
+ */
+static int clobbers_fp_regs(jit_op * op)
+{
+	jit_opcode code = GET_OP(op);
+	return (code == JIT_CALL) || (code == JIT_MSG) || (code == JIT_FMSG) || (code == JIT_TRACE);
+}
+
+static int fp_regs_mask(jit_tree * map)
+{
+	if (map == NULL) return 0;
+	jit_hw_reg * hreg = (jit_hw_reg *) map->value;
+	int mask = (hreg->fp ? (1 << hreg->id) : 0);
+	return mask | fp_regs_mask(map->left) | fp_regs_mask(map->right);
+}
+
+#ifdef JIT_ARCH_AMD64
+static int interval_uses_cmp(const void * a, const void * b)
+{
+	struct jit_slot_interval * i1 = *(struct jit_slot_interval **) a;
+	struct jit_slot_interval * i2 = *(struct jit_slot_interval **) b;
+	if (i1->uses != i2->uses) return i2->uses - i1->uses;
+	return interval_cmp(a, b);
+}
+
+static int is_fp_arg_reg(struct jit_reg_allocator * al, jit_hw_reg * hreg)
+{
+	for (int i = 0; i < al->fp_arg_reg_cnt; i++)
+		if (al->fp_arg_regs[i] == hreg) return 1;
+	return 0;
+}
+
+/**
+ * Spilled GP registers are kept in FP registers which are not used by the function,
+ * hence, spills and reloads are register-to-register moves which do not touch memory.
+ * This is possible only if the value is not alive across a function call
+ * (all FP registers are caller-saved) and the code generator does not read
+ * the value directly from the stack. FP registers used to pass arguments are
+ * also used as temporary registers, hence, they are left out. The most frequently
+ * used registers are handled first. Returns number of registers kept in FP registers.
+ */
+static int assign_spill_fp_regs(struct jit_reg_allocator * al, struct jit_slot_interval ** intervals, int count, int * clobbers, int used_fp_regs, int * spill_regs)
+{
+	int candidate_count = 0;
+	struct jit_slot_interval ** candidates = JIT_MALLOC(sizeof(struct jit_slot_interval *) * (count + 1));
+	for (int i = 0; i < count; i++) {
+		struct jit_slot_interval * in = intervals[i];
+		if ((JIT_REG_TYPE(in->reg) != JIT_RTYPE_INT) || in->direct) continue;
+		if (clobbers[in->end + 1] != clobbers[in->start]) continue;
+		candidates[candidate_count++] = in;
+	}
+	qsort(candidates, candidate_count, sizeof(struct jit_slot_interval *), interval_uses_cmp);
+
+	int assigned = 0;
+	for (int i = 0; i < candidate_count; i++) {
+		struct jit_slot_interval * in = candidates[i];
+		for (int r = 0; r < al->fp_reg_cnt; r++) {
+			jit_hw_reg * hreg = &(al->fp_regs[r]);
+			if ((used_fp_regs & (1 << hreg->id)) || is_fp_arg_reg(al, hreg)) continue;
+
+			int overlaps = 0;
+			for (int j = 0; j < i; j++)
+				if ((candidates[j]->fp_reg == hreg->id) && (candidates[j]->start <= in->end) && (in->start <= candidates[j]->end)) {
+					overlaps = 1;
+					break;
+				}
+			if (overlaps) continue;
+
+			in->fp_reg = hreg->id;
+			spill_regs[JIT_REG_ID(in->reg)] = hreg->id;
+			assigned++;
+			break;
+		}
+	}
+	JIT_FREE(candidates);
+	return assigned;
+}
+#endif
+
+static void assign_func_stack_slots(struct jit * jit, jit_op * prolog)
+{
+	struct jit_func_info * info = (struct jit_func_info *) prolog->arg[1];
+	jit_tree * intervals = NULL;
+
+	// registers which can be read from the stack
+	int pos = 0;
+	for (jit_op * op = prolog->next; op != NULL && (GET_OP(op) != JIT_PROLOG); op = op->next, pos++) {
+		switch (GET_OP(op)) {
+			case JIT_UREG:
+			case JIT_SYNCREG: intervals = add_spilled_reg(intervals, op->arg[0], pos, 1, 0); break;
+			case JIT_LREG: intervals = add_spilled_reg(intervals, op->arg[1], pos, 1, 0); break;
+			default:
+				if (reads_spilled_regs(op))
+					for (int i = 0; i < 3; i++)
+						if (ARG_TYPE(op, i + 1) == REG)
+							intervals = add_spilled_reg(intervals, op->arg[i], pos, 0, 1);
+		}
+	}
+	int op_count = pos;
+
+	// live ranges of these registers, FP registers used by the function,
+	// and operations clobbering FP registers
+	struct jit_slot_context ctx;
+	ctx.intervals = intervals;
+	ctx.pos = 0;
+	int used_fp_regs = 0;
+	int * clobbers = JIT_MALLOC(sizeof(int) * (op_count + 1));
+	clobbers[0] = 0;
+	for (jit_op * op = prolog->next; op != NULL && (GET_OP(op) != JIT_PROLOG); op = op->next, ctx.pos++) {
+		clobbers[ctx.pos + 1] = clobbers[ctx.pos] + clobbers_fp_regs(op);
+		if (!intervals) continue;
+		if (op->regmap) used_fp_regs |= fp_regs_mask(op->regmap->map);
+		if (op->live_in) jit_tree_walk(op->live_in->root, extend_live_interval, &ctx);
+		for (int i = 0; i < 3; i++)
+			if ((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG))
+				extend_interval(intervals, op->arg[i], ctx.pos);
+	}
+
+	int count = jit_tree_size(intervals);
+	struct jit_slot_interval ** sorted = JIT_MALLOC(sizeof(struct jit_slot_interval *) * (count + 1));
+	struct jit_slot_interval ** top = sorted;
+	jit_tree_walk(intervals, collect_interval, &top);
+	qsort(sorted, count, sizeof(struct jit_slot_interval *), interval_cmp);
+
+	if (info->gp_spill_regs) JIT_FREE(info->gp_spill_regs);
+	info->gp_spill_regs = JIT_MALLOC(sizeof(int) * (info->gp_reg_count + 1));
+	for (int i = 0; i <= info->gp_reg_count; i++)
+		info->gp_spill_regs[i] = -1;
+#ifdef JIT_ARCH_AMD64
+	if (jit->optimizations & JIT_OPT_SPILLS_TO_FP_REGS)
+		jit->stats[JIT_STAT_SPILLS_TO_FP_REGS] += assign_spill_fp_regs(jit->reg_al, sorted, count, clobbers, used_fp_regs, info->gp_spill_regs);
+#endif
+	JIT_FREE(clobbers);
+
+	if (info->gp_slots) JIT_FREE(info->gp_slots);
+	if (info->fp_slots) JIT_FREE(info->fp_slots);
+	info->gp_slots = JIT_MALLOC(sizeof(int) * (info->gp_reg_count + 1));
+	info->fp_slots = JIT_MALLOC(sizeof(int) * (info->fp_reg_count + 1));
+	info->gp_slot_count = color_slots(sorted, count, 0, info->gp_slots, info->gp_reg_count);
+	info->fp_slot_count = color_slots(sorted, count, 1, info->fp_slots, info->fp_reg_count);
+
+	for (int i = 0; i < count; i++)
+		JIT_FREE(sorted[i]);
+	JIT_FREE(sorted);
+	jit_tree_free(intervals);
+}
+
+/**
+ * Assigns stack slots to spilled registers. Registers which are never
+ * alive at the same time share one slot, therefore, the size of the stack
+ * frame does not depend on the number of registers used by the function.
+ */
+void jit_assign_stack_slots(struct jit * jit)
+{
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
+		if (GET_OP(op) == JIT_PROLOG) assign_func_stack_slots(jit, op);
+}
+
+#ifdef JIT_ARCH_COMMON86
+/**
+ * Returns 1 if the hw. register may be overwritten by the function called by the operation
+ */
+static int call_clobbers_reg(struct jit * jit, jit_op * op, jit_hw_reg * hreg)
+{
+	struct jit_func_info * callee = called_func_info(op);
+	if (!callee) return 1;
+	return (callee->clobbered_regs[(int) hreg->fp] >> hreg->id) & 1;
+}
+
+static void add_clobbered_regs(jit_tree * map, jit_value * regs)
+{
+	if (map == NULL) return;
+	jit_hw_reg * hreg = (jit_hw_reg *) map->value;
+	if (!hreg->callee_saved) regs[(int) hreg->fp] |= (jit_value) 1 << hreg->id;
+	add_clobbered_regs(map->left, regs);
+	add_clobbered_regs(map->right, regs);
+}
+
+/**
+ * Collects caller-saved registers used by the function itself, i.e., registers
+ * associated with virtual registers, registers holding spilled values, and
+ * registers which the code generator uses as temporary registers.
+ * Calls of unknown functions may overwrite all registers. Also checks whether
+ * the function calls a function which expects the stack aligned by the caller.
+ */
+static void collect_func_clobbered_regs(struct jit * jit, jit_op * prolog)
+{
+	struct jit_reg_allocator * al = jit->reg_al;
+	struct jit_func_info * info = (struct jit_func_info *) prolog->arg[1];
+	jit_value * regs = info->clobbered_regs;
+	regs[0] = JIT_SCRATCH_GP_REGS;
+	regs[1] = JIT_SCRATCH_FP_REGS;
+	info->aligned_stack = 0;
+
+	for (jit_op * op = prolog; op != NULL; op = op->next) {
+		if ((op != prolog) && (GET_OP(op) == JIT_PROLOG)) break;
+		if (!op->regmap) continue;
+		add_clobbered_regs(op->regmap->map, regs);
+
+		// get_scratch_reg_for_div may skip two unused registers
+		for (int i = 0; i < 3; i++) {
+			jit_hw_reg * hreg = jit_get_unused_reg_with_index(al, op, 0, i);
+			if (hreg) regs[0] |= (jit_value) 1 << hreg->id;
+		}
+
+		switch (GET_OP(op)) {
+			case JIT_PREPARE:
+				for (int i = 0; i < jit_gp_arg_reg_cnt(al, called_func_info(prepared_call(op))); i++)
+					regs[0] |= (jit_value) 1 << al->gp_arg_regs[i]->id;
+				for (int i = 0; i < al->fp_arg_reg_cnt; i++)
+					regs[1] |= (jit_value) 1 << al->fp_arg_regs[i]->id;
+				break;
+			case JIT_CALL:
+			case JIT_MSG: case JIT_FMSG: case JIT_TRACE: {
+				struct jit_func_info * callee = called_func_info(op);
+				if (!callee || !callee->private_conv) info->aligned_stack = 1;
+				if (callee) break;
+				regs[0] = -1;
+				regs[1] = -1;
+				break;
+			}
+			default: break;
+		}
+	}
+
+	for (int i = 0; i <= info->gp_reg_count; i++)
+		if (info->gp_spill_regs[i] >= 0) regs[1] |= (jit_value) 1 << info->gp_spill_regs[i];
+}
+
+/**
+ * Computes sets of registers which may be overwritten by functions and
+ * their callees. The sets are propagated from callees to callers until
+ * they do not change, which also handles (mutually) recursive functions.
+ * Calls of these functions save only registers the callee actually uses.
+ * Similarly, functions with the private calling convention which never
+ * call a C function do not need the stack aligned.
+ */
+void jit_collect_clobbered_regs(struct jit * jit)
+{
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
+		if (GET_OP(op) == JIT_PROLOG) collect_func_clobbered_regs(jit, op);
+
+	int change = 1;
+	while (change) {
+		change = 0;
+		struct jit_func_info * info = NULL;
+		for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+			if (GET_OP(op) == JIT_PROLOG) info = (struct jit_func_info *) op->arg[1];
+			struct jit_func_info * callee = called_func_info(op);
+			if (!info || !callee) continue;
+			for (int fp = 0; fp < 2; fp++) {
+				jit_value regs = info->clobbered_regs[fp] | callee->clobbered_regs[fp];
+				if (regs != info->clobbered_regs[fp]) {
+					info->clobbered_regs[fp] = regs;
+					change = 1;
+				}
+			}
+			if (callee->aligned_stack && !info->aligned_stack) {
+				info->aligned_stack = 1;
+				change = 1;
+			}
+		}
+	}
+}
+#endif
+
 void jit_reg_allocator_free(struct jit_reg_allocator * a)
 {
 	if (a->fp_regs) JIT_FREE(a->fp_regs);
@@ -683,6 +1744,16 @@ int jit_reg_in_use(jit_op * op, int reg, int fp)
 	else return 0;
 }
 
+/**
+ * returns 1 if the given hw. register holds a value which is used after
+ * the operation, i.e., the value has to be preserved if the register is overwritten
+ */
+int jit_reg_live_out(jit_op * op, int reg, int fp)
+{
+	jit_value virt_reg;
+	return rmap_is_associated(op->regmap, reg, fp, &virt_reg) && jit_set_get(op->live_out, virt_reg);
+}
+
 /**
  * returns a register which is unused, otherwise returns NULL
  * index -- indicates the position in the list of unused register (0 -- first unused register, 1 -- second, etc.) 
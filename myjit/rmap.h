@@ -151,7 +151,16 @@ static void rmap_sync(jit_op * op, jit_rmap * current, jit_rmap * target, int mo
 	rmap_sync_aux(current->map, target->map, op, mode);
 }
 
-static int candidate_score(jit_op * op, jit_value virtreg, jit_hw_reg * hreg, int * spill, jit_value * associated_virtreg)
+/**
+ * Returns 1 if the register can be used in the currently processed function;
+ * the frame pointer is allocatable only if the function does not need it
+ */
+static inline int is_allocatable_reg(struct jit_reg_allocator * al, jit_hw_reg * hreg)
+{
+	return hreg->fp || (hreg->id != al->fp_reg) || al->current_func_info->free_frame_reg;
+}
+
+static int candidate_score(jit_op * op, struct jit_loop * loop, jit_value virtreg, jit_hw_reg * hreg, int * spill, jit_value * associated_virtreg)
 {
 	int score = 0;
 	score -= hreg->priority;
@@ -174,12 +183,20 @@ static int candidate_score(jit_op * op, jit_value virtreg, jit_hw_reg * hreg, in
 		*associated_virtreg = x;
 
 		jit_tree * hint_node = jit_tree_search(op->allocator_hints, x);
-		int is_to_be_used = (hint_node != NULL);
+		int used_in_steps = -1;
+		if (hint_node) {
+			struct jit_allocator_hint * hint = (struct jit_allocator_hint *)hint_node->value;
+			used_in_steps = -(hint->last_pos - op->normalized_pos);
+		}
+
+		// registers used in the loop are going to be used again after the backward jump
+		if (loop && jit_set_get(loop->used, x)) {
+			int to_loop_end = op->normalized_pos - loop->end->normalized_pos + 1;
+			if ((used_in_steps < 0) || (to_loop_end < used_in_steps)) used_in_steps = to_loop_end;
+		}
 
-		if (!is_to_be_used) score += 50000; // if it's not to be used it is not so bad candidate
+		if (used_in_steps < 0) score += 50000; // if it's not to be used it is not so bad candidate
 		else {
-			struct jit_allocator_hint * hint = (struct jit_allocator_hint *)hint_node->value;
-			int used_in_steps = -(hint->last_pos - op->normalized_pos);
 			if (hw_associated && (used_in_steps == 0)) return INT_MIN; // register is used in the current function (it's not a good candidate for spilling)
 			else score += (used_in_steps * 5);
 		}
@@ -195,6 +212,10 @@ static int candidate_score(jit_op * op, jit_value virtreg, jit_hw_reg * hreg, in
 			score += hint->should_be_eax * 5;
 		}
 		if (hreg->callee_saved) score += (hint->should_be_calleesaved - 1) * 15;
+		if (hreg->fp == 0) {
+			if (hint->preferred_reg == hreg->id) score += 20;
+			if (hint->avoided_regs & (1 << hreg->id)) score -= 40;
+		}
 	}
 #endif
 	return score;
@@ -226,8 +247,9 @@ static jit_hw_reg * rmap_spill_candidate(struct jit_reg_allocator * al, jit_op *
 	int sp = 0;
 	for (int i = 0; i < reg_count; i++) {
 		if (callee_saved && !regs[i].callee_saved) continue;
+		if (!is_allocatable_reg(al, &(regs[i]))) continue;
 		jit_value assoc = 0;
-		int score = candidate_score(op, virtreg, &(regs[i]), &sp, &assoc);
+		int score = candidate_score(op, al->current_loop, virtreg, &(regs[i]), &sp, &assoc);
 		if (score > best_score) {
 			if (sp) {
 				*reg_to_spill = assoc;
@@ -93,4 +93,26 @@ static inline void jit_set_to_array(jit_set *s, jit_value *dest)
 	t.index = 0;
 	jit_tree_walk(s->root, copy_reg_to_array, &t);
 }
+
+/**
+ * Removes items which are not in the set s from the target set.
+ * Returns 1 if the target set has changed.
+ */
+static inline int jit_set_retainall(jit_set * target, jit_set * s)
+{
+	int size = jit_set_size(target);
+	if (size == 0) return 0;
+
+	int changed = 0;
+	jit_value * items = JIT_MALLOC(sizeof(jit_value) * size);
+	jit_set_to_array(target, items);
+	for (int i = 0; i < size; i++) {
+		if (!jit_set_get(s, items[i])) {
+			jit_set_remove(target, items[i]);
+			changed = 1;
+		}
+	}
+	JIT_FREE(items);
+	return changed;
+}
 #endif
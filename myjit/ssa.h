@@ -0,0 +1,1406 @@
+/*
+ * MyJIT
+ * Copyright (C) 2010, 2015 Petr Krajca, <petr.krajca@upol.cz>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * SSA form.
+ *
+ * Each function is split into basic blocks, its dominator tree is computed
+ * (Cooper, Harvey, Kennedy) and so are the dominance frontiers. Phi nodes
+ * are placed at the iterated dominance frontiers of registers which are used
+ * in other blocks than where they are set, and registers are renamed: each
+ * definition gets its own value and each use is linked with the value
+ * reaching it; values keep lists of their uses (def-use chains).
+ *
+ * Operations stay in the list and keep their registers, the SSA form is an
+ * overlay built on top of them. Passes working on the SSA form rewrite the
+ * operations in place:
+ *	- sparse conditional constant propagation folds operations with constant
+ *	  results, turns constant operands into immediate values, and resolves
+ *	  branches with constant conditions,
+ *	- copy propagation replaces uses of copies (movr, fmovr, and phis whose
+ *	  arguments are the same value) with the original values,
+ *	- dead code elimination removes operations whose results are not used.
+ *
+ * The translation out of the SSA form walks the dominator tree and checks
+ * that each use still finds its value in the register it names. If the
+ * register was overwritten in the meantime, which may happen once copies are
+ * propagated, the value is copied into a new register right after its
+ * definition. The register allocator then processes the code as usual.
+ */
+
+#define SSA_TOP		(0)	// value which has not been computed yet
+#define SSA_CONST	(1)
+#define SSA_BOTTOM	(2)	// value which is not constant
+
+#define SSA_TARGET_USE	(3)	// index of the use of the target register of movn and movz
+
+struct ssa_block;
+struct ssa_phi;
+
+struct ssa_value {
+	int reg;			// index of the register in the function
+	struct ssa_block * block;	// block containing the definition
+	jit_op * def;			// defining operation, NULL for phis and values at the entry
+	struct ssa_phi * phi;		// defining phi node
+	struct ssa_use * uses;		// def-use chain
+	struct ssa_value * copy_of;	// value copied by the definition
+	struct ssa_value * shadowed;	// value of the register before the definition
+	struct ssa_value * next;	// list of all values of the function
+	jit_value copy;			// register with the copy made by the translation out of SSA
+	jit_value constant;
+	char lattice;			// SSA_TOP, SSA_CONST, or SSA_BOTTOM
+	char queued;
+	char live;
+	char copied;
+};
+
+struct ssa_use {
+	struct ssa_value * value;
+	jit_op * op;			// using operation, NULL for arguments of phis
+	struct ssa_phi * phi;
+	struct ssa_use * next;		// next use of the same value
+};
+
+struct ssa_phi {
+	struct ssa_value * value;
+	struct ssa_use * args;		// one argument for each predecessor of the block
+	struct ssa_phi * next;
+};
+
+struct ssa_block {
+	int first;			// index of the first operation
+	int last;			// index of the last operation
+	struct ssa_block * fall;	// block reached by falling through
+	struct ssa_block * target;	// block reached by the jump or the branch
+	struct ssa_block ** preds;
+	char * executable_edges;	// one flag for each predecessor
+	int pred_cnt;
+	int rpo;			// position in the reverse postorder, -1 if unreachable
+	struct ssa_block * idom;
+	struct ssa_block * child;	// first child in the dominator tree
+	struct ssa_block * sibling;
+	struct ssa_block * walk;	// next child visited by the walk of the dominator tree
+	struct ssa_block ** frontier;
+	int frontier_cnt;
+	int frontier_cap;
+	struct ssa_phi * phis;
+	int phi_mark;			// register which has the phi node in the block
+	int work_mark;			// register whose definitions were propagated to the block
+	char executable;
+};
+
+struct ssa_op {
+	jit_op * op;
+	struct ssa_block * block;
+	struct ssa_value * def;
+	struct ssa_use * uses[4];	// uses of registers in the arguments and of the target register
+	struct ssa_use use_slots[4];
+	char def_arg;			// argument defining the value
+	char removed;
+};
+
+struct ssa_stack {
+	void ** items;
+	int cnt;
+	int cap;
+};
+
+struct ssa_func {
+	struct ssa_op * ops;
+	int op_cnt;
+	struct ssa_block * blocks;
+	int block_cnt;
+	struct ssa_block ** rpo;
+	int rpo_cnt;
+	jit_tree * reg_index;		// index of each register + 1
+	jit_value * regs;
+	int reg_cnt;
+	int gp_cnt;			// number of registers, new registers follow them
+	int fp_cnt;
+	struct ssa_value ** current;	// value of each register during the renaming
+	struct ssa_value * values;
+	struct ssa_stack value_work;
+	struct ssa_stack block_work;
+	int folded;
+	int dead;
+};
+
+static void ssa_push(struct ssa_stack * s, void * item)
+{
+	if (s->cnt == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 32;
+		s->items = JIT_REALLOC(s->items, s->cap * sizeof(void *));
+	}
+	s->items[s->cnt++] = item;
+}
+
+static inline struct ssa_op * ssa_info(struct ssa_func * f, jit_op * op)
+{
+	return &f->ops[op->normalized_pos];
+}
+
+static inline int ssa_reg(jit_value r)
+{
+	return JIT_REG_SPEC(r) == JIT_RTYPE_REG;
+}
+
+static inline int ssa_ends_block(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_JMP: case JIT_RET: case JIT_FRET: return 1;
+		default: return is_cond_branch_op(op);
+	}
+}
+
+static inline int ssa_overflow_branch(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_BOADD: case JIT_BOSUB: case JIT_BNOADD: case JIT_BNOSUB: return 1;
+		default: return 0;
+	}
+}
+
+/**
+ * Returns 1 if the use is bound to the definition by the same operation,
+ * i.e., the operation modifies the register in place
+ */
+static inline int ssa_tied_use(jit_op * op, int i)
+{
+	return (i == SSA_TARGET_USE) || ((i == 1) && ssa_overflow_branch(op));
+}
+
+//
+//
+// Control flow graph and dominators
+//
+//
+
+/**
+ * Returns 0 if the function contains operations which prevent the CFG from
+ * being built, i.e., indirect jumps, references to the code, and block transfers
+ */
+static int ssa_supported_op(jit_op * op, jit_tree * code_refs)
+{
+	if (jit_tree_search(code_refs, (jit_value) op)) return 0;
+	if (op->code == (JIT_JMP | REG)) return 0;
+	if ((GET_OP(op) == JIT_REF_CODE) || (GET_OP(op) == JIT_DATA_REF_CODE)) return 0;
+	if ((GET_OP(op) >= JIT_TRANSFER) && (GET_OP(op) <= JIT_TRANSFER_SUBS)) return 0;
+	if (((GET_OP(op) == JIT_JMP) || is_cond_branch_op(op)) && !op->jmp_addr) return 0;
+	return 1;
+}
+
+static inline int ssa_in_function(struct ssa_func * f, jit_op * op)
+{
+	return (op->normalized_pos >= 0) && (op->normalized_pos < f->op_cnt) && (f->ops[op->normalized_pos].op == op);
+}
+
+static struct ssa_block * ssa_new_block(struct ssa_func * f, int first)
+{
+	struct ssa_block * b = &f->blocks[f->block_cnt++];
+	memset(b, 0, sizeof(struct ssa_block));
+	b->first = first;
+	b->rpo = -1;
+	b->phi_mark = -1;
+	b->work_mark = -1;
+	return b;
+}
+
+static inline int ssa_leader(jit_op * op, jit_op * prev)
+{
+	if (!prev || ssa_ends_block(prev)) return 1;
+	int label = (GET_OP(op) == JIT_LABEL) || (GET_OP(op) == JIT_PATCH);
+	int prev_label = (GET_OP(prev) == JIT_LABEL) || (GET_OP(prev) == JIT_PATCH);
+	return label && !prev_label;
+}
+
+static void ssa_add_pred(struct ssa_block * b, struct ssa_block * pred)
+{
+	b->preds[b->pred_cnt++] = pred;
+}
+
+/**
+ * Splits the function into basic blocks and links them; returns 0 if the
+ * function is not supported
+ */
+static int ssa_build_cfg(struct ssa_func * f)
+{
+	for (int i = 0; i < f->op_cnt; i++) {
+		jit_op * op = f->ops[i].op;
+		if (ssa_leader(op, i ? f->ops[i - 1].op : NULL)) ssa_new_block(f, i);
+		f->ops[i].block = &f->blocks[f->block_cnt - 1];
+		f->ops[i].block->last = i;
+	}
+
+	for (int i = 0; i < f->block_cnt; i++) {
+		struct ssa_block * b = &f->blocks[i];
+		jit_op * last = f->ops[b->last].op;
+		if ((GET_OP(last) == JIT_JMP) || is_cond_branch_op(last)) {
+			if (!ssa_in_function(f, last->jmp_addr)) return 0;
+			b->target = ssa_info(f, last->jmp_addr)->block;
+		}
+		if ((GET_OP(last) != JIT_JMP) && (GET_OP(last) != JIT_RET) && (GET_OP(last) != JIT_FRET) && (i + 1 < f->block_cnt))
+			b->fall = &f->blocks[i + 1];
+		if (b->fall) b->fall->pred_cnt++;
+		if (b->target) b->target->pred_cnt++;
+	}
+
+	for (int i = 0; i < f->block_cnt; i++) {
+		struct ssa_block * b = &f->blocks[i];
+		b->preds = JIT_MALLOC(sizeof(struct ssa_block *) * (b->pred_cnt + 1));
+		b->executable_edges = JIT_MALLOC(b->pred_cnt + 1);
+		memset(b->executable_edges, 0, b->pred_cnt + 1);
+		b->pred_cnt = 0;
+	}
+	for (int i = 0; i < f->block_cnt; i++) {
+		struct ssa_block * b = &f->blocks[i];
+		if (b->fall) ssa_add_pred(b->fall, b);
+		if (b->target) ssa_add_pred(b->target, b);
+	}
+	return 1;
+}
+
+/**
+ * Numbers blocks reachable from the entry in the reverse postorder
+ */
+static void ssa_number_blocks(struct ssa_func * f)
+{
+	struct ssa_block ** stack = JIT_MALLOC(sizeof(struct ssa_block *) * f->block_cnt);
+	char * state = JIT_MALLOC(f->block_cnt);
+	memset(state, 0, f->block_cnt);
+	int postorder = f->block_cnt;
+	int sp = 0;
+
+	stack[sp++] = &f->blocks[0];
+	state[0] = 1;
+	while (sp > 0) {
+		struct ssa_block * b = stack[sp - 1];
+		struct ssa_block * next = NULL;
+		if (b->fall && !state[b->fall - f->blocks]) next = b->fall;
+		else if (b->target && !state[b->target - f->blocks]) next = b->target;
+
+		if (next) {
+			state[next - f->blocks] = 1;
+			stack[sp++] = next;
+			continue;
+		}
+		f->rpo[--postorder] = b;
+		sp--;
+	}
+
+	// blocks which are not reachable are skipped
+	f->rpo_cnt = f->block_cnt - postorder;
+	memmove(f->rpo, f->rpo + postorder, sizeof(struct ssa_block *) * f->rpo_cnt);
+	for (int i = 0; i < f->rpo_cnt; i++)
+		f->rpo[i]->rpo = i;
+	JIT_FREE(stack);
+	JIT_FREE(state);
+}
+
+static struct ssa_block * ssa_intersect(struct ssa_block * a, struct ssa_block * b)
+{
+	while (a != b) {
+		while (a->rpo > b->rpo) a = a->idom;
+		while (b->rpo > a->rpo) b = b->idom;
+	}
+	return a;
+}
+
+static void ssa_add_frontier(struct ssa_block * b, struct ssa_block * join)
+{
+	// the join block is processed at once, thus, duplicates are adjacent
+	if (b->frontier_cnt && (b->frontier[b->frontier_cnt - 1] == join)) return;
+	if (b->frontier_cnt == b->frontier_cap) {
+		b->frontier_cap = b->frontier_cap ? b->frontier_cap * 2 : 4;
+		b->frontier = JIT_REALLOC(b->frontier, sizeof(struct ssa_block *) * b->frontier_cap);
+	}
+	b->frontier[b->frontier_cnt++] = join;
+}
+
+/**
+ * Computes immediate dominators, the dominator tree, and dominance frontiers
+ */
+static void ssa_dominators(struct ssa_func * f)
+{
+	struct ssa_block * entry = f->rpo[0];
+	entry->idom = entry;
+
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		for (int i = 1; i < f->rpo_cnt; i++) {
+			struct ssa_block * b = f->rpo[i];
+			struct ssa_block * idom = NULL;
+			for (int j = 0; j < b->pred_cnt; j++) {
+				struct ssa_block * p = b->preds[j];
+				if (!p->idom) continue;
+				idom = idom ? ssa_intersect(p, idom) : p;
+			}
+			if (b->idom != idom) {
+				b->idom = idom;
+				changed = 1;
+			}
+		}
+	}
+
+	for (int i = f->rpo_cnt - 1; i > 0; i--) {
+		struct ssa_block * b = f->rpo[i];
+		b->sibling = b->idom->child;
+		b->idom->child = b;
+	}
+
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (b->pred_cnt < 2) continue;
+		for (int j = 0; j < b->pred_cnt; j++) {
+			struct ssa_block * runner = b->preds[j];
+			if (runner->rpo < 0) continue;
+			while (runner != b->idom) {
+				ssa_add_frontier(runner, b);
+				runner = runner->idom;
+			}
+		}
+	}
+}
+
+/**
+ * Walks the dominator tree; the enter function may return 0 to skip the
+ * subtree of the block, the leave function is called then neither
+ */
+static void ssa_walk(struct ssa_func * f, int (* enter)(struct ssa_func *, struct ssa_block *),
+	void (* leave)(struct ssa_func *, struct ssa_block *))
+{
+	struct ssa_block * entry = f->rpo[0];
+	struct ssa_block * b = entry;
+	if (!enter(f, b)) return;
+	b->walk = b->child;
+	while (b) {
+		if (b->walk) {
+			struct ssa_block * child = b->walk;
+			b->walk = child->sibling;
+			if (!enter(f, child)) continue;
+			child->walk = child->child;
+			b = child;
+			continue;
+		}
+		leave(f, b);
+		b = (b == entry) ? NULL : b->idom;
+	}
+}
+
+//
+//
+// Construction of the SSA form
+//
+//
+
+static int ssa_reg_index(struct ssa_func * f, jit_value r)
+{
+	jit_tree * node = jit_tree_search(f->reg_index, r);
+	return node ? (int)(intptr_t) node->value - 1 : -1;
+}
+
+static void ssa_collect_reg(struct ssa_func * f, jit_value r)
+{
+	if (!ssa_reg(r) || (ssa_reg_index(f, r) >= 0)) return;
+	f->regs = JIT_REALLOC(f->regs, sizeof(jit_value) * (f->reg_cnt + 1));
+	f->regs[f->reg_cnt++] = r;
+	f->reg_index = jit_tree_insert(f->reg_index, r, (void *)(intptr_t) f->reg_cnt, NULL);
+}
+
+static struct ssa_value * ssa_new_value(struct ssa_func * f, int reg, struct ssa_block * block)
+{
+	struct ssa_value * v = JIT_MALLOC(sizeof(struct ssa_value));
+	memset(v, 0, sizeof(struct ssa_value));
+	v->reg = reg;
+	v->block = block;
+	v->next = f->values;
+	f->values = v;
+	return v;
+}
+
+static struct ssa_use * ssa_init_use(struct ssa_use * u, jit_op * op)
+{
+	u->value = NULL;
+	u->op = op;
+	u->phi = NULL;
+	u->next = NULL;
+	return u;
+}
+
+static void ssa_link_use(struct ssa_use * u, struct ssa_value * v)
+{
+	u->value = v;
+	u->next = v->uses;
+	v->uses = u;
+}
+
+/**
+ * Prepares records of registers used and defined by the operation
+ */
+static void ssa_prepare_op(struct ssa_func * f, struct ssa_op * info)
+{
+	jit_op * op = info->op;
+	for (int i = 0; i < 3; i++)
+		if ((ARG_TYPE(op, i + 1) == REG) && ssa_reg(op->arg[i])) info->uses[i] = ssa_init_use(&info->use_slots[i], op);
+	if (jit_reads_target_reg(op) && ssa_reg(op->arg[0])) info->uses[SSA_TARGET_USE] = ssa_init_use(&info->use_slots[SSA_TARGET_USE], op);
+
+	info->def_arg = -1;
+	if ((ARG_TYPE(op, 1) == TREG) && ssa_reg(op->arg[0])) info->def_arg = 0;
+	if (ssa_overflow_branch(op) && info->uses[1]) info->def_arg = 1;
+}
+
+static inline int ssa_use_index(struct ssa_func * f, struct ssa_op * info, int i)
+{
+	return ssa_reg_index(f, info->op->arg[i == SSA_TARGET_USE ? 0 : i]);
+}
+
+/**
+ * Places phi nodes at the iterated dominance frontiers of registers which
+ * are alive in more than one block
+ */
+static void ssa_place_phis(struct ssa_func * f)
+{
+	struct ssa_stack * defs = JIT_MALLOC(sizeof(struct ssa_stack) * f->reg_cnt);
+	char * global = JIT_MALLOC(f->reg_cnt);
+	int * killed = JIT_MALLOC(sizeof(int) * f->reg_cnt);
+	memset(defs, 0, sizeof(struct ssa_stack) * f->reg_cnt);
+	memset(global, 0, f->reg_cnt);
+	for (int r = 0; r < f->reg_cnt; r++)
+		killed[r] = -1;
+
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		for (int j = b->first; j <= b->last; j++) {
+			struct ssa_op * info = &f->ops[j];
+			for (int k = 0; k < 4; k++) {
+				if (!info->uses[k]) continue;
+				int r = ssa_use_index(f, info, k);
+				if (killed[r] != i) global[r] = 1;
+			}
+			if (info->def_arg < 0) continue;
+			int r = ssa_reg_index(f, info->op->arg[(int) info->def_arg]);
+			killed[r] = i;
+			struct ssa_stack * d = &defs[r];
+			if (!d->cnt || (d->items[d->cnt - 1] != b)) ssa_push(d, b);
+		}
+	}
+
+	struct ssa_stack work = { NULL, 0, 0 };
+	for (int r = 0; r < f->reg_cnt; r++) {
+		if (global[r]) {
+			for (int i = 0; i < defs[r].cnt; i++) {
+				struct ssa_block * b = defs[r].items[i];
+				b->work_mark = r;
+				ssa_push(&work, b);
+			}
+			while (work.cnt) {
+				struct ssa_block * b = work.items[--work.cnt];
+				for (int i = 0; i < b->frontier_cnt; i++) {
+					struct ssa_block * join = b->frontier[i];
+					if (join->phi_mark == r) continue;
+					join->phi_mark = r;
+
+					struct ssa_phi * phi = JIT_MALLOC(sizeof(struct ssa_phi));
+					phi->value = ssa_new_value(f, r, join);
+					phi->value->phi = phi;
+					phi->args = JIT_MALLOC(sizeof(struct ssa_use) * (join->pred_cnt + 1));
+					for (int j = 0; j < join->pred_cnt; j++) {
+						phi->args[j].value = NULL;
+						phi->args[j].op = NULL;
+						phi->args[j].phi = phi;
+						phi->args[j].next = NULL;
+					}
+					phi->next = join->phis;
+					join->phis = phi;
+
+					if (join->work_mark != r) {
+						join->work_mark = r;
+						ssa_push(&work, join);
+					}
+				}
+			}
+		}
+		if (defs[r].items) JIT_FREE(defs[r].items);
+	}
+	if (work.items) JIT_FREE(work.items);
+	JIT_FREE(defs);
+	JIT_FREE(global);
+	JIT_FREE(killed);
+}
+
+static inline void ssa_define(struct ssa_func * f, struct ssa_value * v)
+{
+	v->shadowed = f->current[v->reg];
+	f->current[v->reg] = v;
+}
+
+static int ssa_rename_block(struct ssa_func * f, struct ssa_block * b)
+{
+	for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+		ssa_define(f, phi->value);
+
+	for (int i = b->first; i <= b->last; i++) {
+		struct ssa_op * info = &f->ops[i];
+		for (int k = 0; k < 4; k++)
+			if (info->uses[k]) ssa_link_use(info->uses[k], f->current[ssa_use_index(f, info, k)]);
+
+		if (info->def_arg < 0) continue;
+		info->def = ssa_new_value(f, ssa_reg_index(f, info->op->arg[(int) info->def_arg]), b);
+		info->def->def = info->op;
+		ssa_define(f, info->def);
+	}
+
+	struct ssa_block * succ[2] = { b->fall, b->target };
+	for (int s = 0; s < 2; s++) {
+		if (!succ[s] || ((s == 1) && (succ[1] == succ[0]))) continue;
+		for (int j = 0; j < succ[s]->pred_cnt; j++) {
+			if (succ[s]->preds[j] != b) continue;
+			for (struct ssa_phi * phi = succ[s]->phis; phi; phi = phi->next)
+				ssa_link_use(&phi->args[j], f->current[phi->value->reg]);
+		}
+	}
+	return 1;
+}
+
+static void ssa_rename_block_leave(struct ssa_func * f, struct ssa_block * b)
+{
+	for (int i = b->last; i >= b->first; i--)
+		if (f->ops[i].def) f->current[f->ops[i].def->reg] = f->ops[i].def->shadowed;
+	for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+		f->current[phi->value->reg] = phi->value->shadowed;
+}
+
+/**
+ * Builds the SSA form of the function which starts with the given prolog;
+ * returns 0 if the function is not supported
+ */
+static int ssa_build(struct ssa_func * f, jit_op * prolog, jit_tree * code_refs)
+{
+	f->op_cnt = 0;
+	for (jit_op * op = prolog; op && ((op == prolog) || (GET_OP(op) != JIT_PROLOG)); op = op->next) {
+		if (!ssa_supported_op(op, code_refs)) return 0;
+		jit_op_count_regs(op, &f->gp_cnt, &f->fp_cnt);
+		f->op_cnt++;
+	}
+
+	f->ops = JIT_MALLOC(sizeof(struct ssa_op) * f->op_cnt);
+	memset(f->ops, 0, sizeof(struct ssa_op) * f->op_cnt);
+	jit_op * op = prolog;
+	for (int i = 0; i < f->op_cnt; i++, op = op->next) {
+		op->normalized_pos = i;
+		f->ops[i].op = op;
+		for (int j = 0; j < 3; j++)
+			if ((ARG_TYPE(op, j + 1) == REG) || (ARG_TYPE(op, j + 1) == TREG)) ssa_collect_reg(f, op->arg[j]);
+	}
+
+	f->blocks = JIT_MALLOC(sizeof(struct ssa_block) * f->op_cnt);
+	f->block_cnt = 0;
+	if (!ssa_build_cfg(f)) return 0;
+
+	f->rpo = JIT_MALLOC(sizeof(struct ssa_block *) * f->block_cnt);
+	ssa_number_blocks(f);
+	ssa_dominators(f);
+
+	for (int i = 0; i < f->op_cnt; i++)
+		ssa_prepare_op(f, &f->ops[i]);
+	ssa_place_phis(f);
+
+	// registers which are read before they are set have undefined values
+	f->current = JIT_MALLOC(sizeof(struct ssa_value *) * (f->reg_cnt + 1));
+	for (int r = 0; r < f->reg_cnt; r++) {
+		f->current[r] = ssa_new_value(f, r, f->rpo[0]);
+		f->current[r]->lattice = SSA_BOTTOM;
+	}
+	ssa_walk(f, ssa_rename_block, ssa_rename_block_leave);
+	return 1;
+}
+
+static void ssa_free(struct ssa_func * f)
+{
+	for (int i = 0; i < f->block_cnt; i++) {
+		struct ssa_block * b = &f->blocks[i];
+		struct ssa_phi * phi = b->phis;
+		while (phi) {
+			struct ssa_phi * next = phi->next;
+			JIT_FREE(phi->args);
+			JIT_FREE(phi);
+			phi = next;
+		}
+		JIT_FREE(b->preds);
+		JIT_FREE(b->executable_edges);
+		if (b->frontier) JIT_FREE(b->frontier);
+	}
+
+	struct ssa_value * v = f->values;
+	while (v) {
+		struct ssa_value * next = v->next;
+		JIT_FREE(v);
+		v = next;
+	}
+
+	if (f->ops) JIT_FREE(f->ops);
+	if (f->blocks) JIT_FREE(f->blocks);
+	if (f->rpo) JIT_FREE(f->rpo);
+	if (f->regs) JIT_FREE(f->regs);
+	if (f->current) JIT_FREE(f->current);
+	if (f->value_work.items) JIT_FREE(f->value_work.items);
+	if (f->block_work.items) JIT_FREE(f->block_work.items);
+	jit_tree_free(f->reg_index);
+}
+
+//
+//
+// Sparse conditional constant propagation
+//
+//
+
+/**
+ * Returns 1 if the result of the operation can be computed from its operands
+ */
+static int ssa_foldable_op(jit_op * op)
+{
+	if (op->fp) return 0;
+	switch (GET_OP(op)) {
+		case JIT_MOV: case JIT_ADD: case JIT_SUB: case JIT_RSB: case JIT_NEG: case JIT_MUL:
+		case JIT_DIV: case JIT_MOD: case JIT_MIN: case JIT_MAX: case JIT_ABS:
+		case JIT_OR: case JIT_XOR: case JIT_AND: case JIT_LSH: case JIT_RSH: case JIT_NOT:
+		case JIT_LT: case JIT_LE: case JIT_GT: case JIT_GE: case JIT_EQ: case JIT_NE:
+			return 1;
+		default: return 0;
+	}
+}
+
+static int ssa_foldable_branch(jit_op * op)
+{
+	if (op->fp) return 0;
+	switch (GET_OP(op)) {
+		case JIT_BLT: case JIT_BLE: case JIT_BGT: case JIT_BGE: case JIT_BEQ: case JIT_BNE:
+		case JIT_BMS: case JIT_BMC:
+			return 1;
+		default: return 0;
+	}
+}
+
+static int ssa_condition(jit_opcode code, int sign, jit_value a, jit_value b)
+{
+	jit_unsigned_value ua = a, ub = b;
+	switch (code) {
+		case JIT_LT: case JIT_BLT: return sign ? a < b : ua < ub;
+		case JIT_LE: case JIT_BLE: return sign ? a <= b : ua <= ub;
+		case JIT_GT: case JIT_BGT: return sign ? a > b : ua > ub;
+		case JIT_GE: case JIT_BGE: return sign ? a >= b : ua >= ub;
+		case JIT_EQ: case JIT_BEQ: return a == b;
+		case JIT_NE: case JIT_BNE: return a != b;
+		case JIT_BMS: return (a & b) != 0;
+		case JIT_BMC: return (a & b) == 0;
+		default: assert(0);
+	}
+	return 0;
+}
+
+/**
+ * Computes the result of the operation; returns 0 if it is not possible,
+ * e.g., in case of division by zero
+ */
+static int ssa_fold(jit_op * op, jit_value a, jit_value b, jit_value * result)
+{
+	jit_unsigned_value ua = a, ub = b;
+	int bits = sizeof(jit_value) * 8;
+	int sign = IS_SIGNED(op);
+	jit_value min = (jit_value)((jit_unsigned_value) 1 << (bits - 1));
+
+	switch (GET_OP(op)) {
+		case JIT_MOV: *result = a; break;
+		case JIT_ADD: *result = ua + ub; break;
+		case JIT_SUB: *result = ua - ub; break;
+		case JIT_RSB: *result = ub - ua; break;
+		case JIT_NEG: *result = -ua; break;
+		case JIT_MUL: *result = ua * ub; break;
+		case JIT_ABS: *result = (a < 0) ? -ua : ua; break;
+		case JIT_OR: *result = ua | ub; break;
+		case JIT_XOR: *result = ua ^ ub; break;
+		case JIT_AND: *result = ua & ub; break;
+		case JIT_NOT: *result = ~ua; break;
+		case JIT_LSH:
+			if ((b < 0) || (b >= bits)) return 0;
+			*result = ua << b;
+			break;
+		case JIT_RSH:
+			if ((b < 0) || (b >= bits)) return 0;
+			*result = sign ? (a >> b) : (jit_value)(ua >> b);
+			break;
+		case JIT_DIV:
+		case JIT_MOD:
+			if ((b == 0) || (sign && (a == min) && (b == -1))) return 0;
+			if (GET_OP(op) == JIT_DIV) *result = sign ? a / b : (jit_value)(ua / ub);
+			else *result = sign ? a % b : (jit_value)(ua % ub);
+			break;
+		case JIT_MIN: *result = ssa_condition(JIT_LT, sign, a, b) ? a : b; break;
+		case JIT_MAX: *result = ssa_condition(JIT_GT, sign, a, b) ? a : b; break;
+		default: *result = ssa_condition(GET_OP(op), sign, a, b);
+	}
+	return 1;
+}
+
+/**
+ * Returns the lattice state of the argument and its value if it is constant
+ */
+static int ssa_operand(struct ssa_func * f, jit_op * op, int i, jit_value * value)
+{
+	*value = 0;
+	if (ARG_TYPE(op, i + 1) == NO) return SSA_CONST;
+	if (ARG_TYPE(op, i + 1) == IMM) {
+		*value = op->arg[i];
+		return SSA_CONST;
+	}
+	struct ssa_use * u = ssa_info(f, op)->uses[i];
+	if (!u || !u->value) return SSA_BOTTOM;
+	*value = u->value->constant;
+	return u->value->lattice;
+}
+
+static int ssa_meet(int state, jit_value * value, int state2, jit_value value2)
+{
+	if (state == SSA_TOP) {
+		*value = value2;
+		return state2;
+	}
+	if ((state2 == SSA_TOP) || (state == SSA_BOTTOM)) return state;
+	if ((state2 == SSA_BOTTOM) || (*value != value2)) return SSA_BOTTOM;
+	return SSA_CONST;
+}
+
+static int ssa_eval_def(struct ssa_func * f, jit_op * op, jit_value * result)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	if ((info->def_arg != 0) || (JIT_REG_TYPE(op->arg[0]) != JIT_RTYPE_INT)) return SSA_BOTTOM;
+
+	jit_value a, b;
+	if (jit_reads_target_reg(op)) {
+		if (op->fp) return SSA_BOTTOM;
+		int cond = ssa_operand(f, op, 2, &b);
+		if (cond == SSA_TOP) return SSA_TOP;
+		struct ssa_value * old = info->uses[SSA_TARGET_USE]->value;
+		int state = ssa_operand(f, op, 1, &a);
+		if (cond == SSA_CONST) {
+			if ((b != 0) == (GET_OP(op) == JIT_MOVN)) {
+				*result = a;
+				return state;
+			}
+			*result = old->constant;
+			return old->lattice;
+		}
+		*result = a;
+		return ssa_meet(state, result, old->lattice, old->constant);
+	}
+
+	if (!ssa_foldable_op(op)) return SSA_BOTTOM;
+	int s1 = ssa_operand(f, op, 1, &a);
+	int s2 = ssa_operand(f, op, 2, &b);
+	if ((s1 == SSA_BOTTOM) || (s2 == SSA_BOTTOM)) return SSA_BOTTOM;
+	if ((s1 == SSA_TOP) || (s2 == SSA_TOP)) return SSA_TOP;
+	return ssa_fold(op, a, b, result) ? SSA_CONST : SSA_BOTTOM;
+}
+
+/**
+ * Evaluates the condition of the branch; if it is constant, returns SSA_CONST
+ * and sets whether the branch is taken
+ */
+static int ssa_eval_branch(struct ssa_func * f, jit_op * op, int * taken)
+{
+	if (!ssa_foldable_branch(op)) return SSA_BOTTOM;
+	jit_value a, b;
+	int s1 = ssa_operand(f, op, 1, &a);
+	int s2 = ssa_operand(f, op, 2, &b);
+	if ((s1 == SSA_BOTTOM) || (s2 == SSA_BOTTOM)) return SSA_BOTTOM;
+	if ((s1 == SSA_TOP) || (s2 == SSA_TOP)) return SSA_TOP;
+	*taken = ssa_condition(GET_OP(op), IS_SIGNED(op), a, b);
+	return SSA_CONST;
+}
+
+static void ssa_lower(struct ssa_func * f, struct ssa_value * v, int state, jit_value value)
+{
+	if ((state == SSA_TOP) || (v->lattice == SSA_BOTTOM)) return;
+	if (v->lattice == SSA_CONST) {
+		if ((state == SSA_CONST) && (value == v->constant)) return;
+		state = SSA_BOTTOM;
+	}
+	v->lattice = state;
+	v->constant = value;
+	if (!v->queued) {
+		v->queued = 1;
+		ssa_push(&f->value_work, v);
+	}
+}
+
+static void ssa_eval_phi(struct ssa_func * f, struct ssa_phi * phi)
+{
+	struct ssa_block * b = phi->value->block;
+	int state = SSA_TOP;
+	jit_value value = 0;
+	for (int j = 0; j < b->pred_cnt; j++) {
+		if (!b->executable_edges[j]) continue;
+		struct ssa_value * arg = phi->args[j].value;
+		state = ssa_meet(state, &value, arg->lattice, arg->constant);
+	}
+	ssa_lower(f, phi->value, state, value);
+}
+
+static void ssa_mark_edge(struct ssa_func * f, struct ssa_block * from, struct ssa_block * to)
+{
+	int changed = 0;
+	for (int j = 0; j < to->pred_cnt; j++) {
+		if ((to->preds[j] != from) || to->executable_edges[j]) continue;
+		to->executable_edges[j] = 1;
+		changed = 1;
+	}
+	if (!changed) return;
+
+	if (!to->executable) {
+		to->executable = 1;
+		ssa_push(&f->block_work, to);
+		return;
+	}
+	for (struct ssa_phi * phi = to->phis; phi; phi = phi->next)
+		ssa_eval_phi(f, phi);
+}
+
+static void ssa_eval_op(struct ssa_func * f, jit_op * op)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	if (info->def) {
+		jit_value value = 0;
+		int state = ssa_eval_def(f, op, &value);
+		ssa_lower(f, info->def, state, value);
+	}
+
+	struct ssa_block * b = info->block;
+	if (op != f->ops[b->last].op) return;
+	if (GET_OP(op) == JIT_JMP) ssa_mark_edge(f, b, b->target);
+	else if (is_cond_branch_op(op)) {
+		int taken = 0;
+		int state = ssa_eval_branch(f, op, &taken);
+		if (state == SSA_TOP) return;
+		if ((state == SSA_BOTTOM) || taken) ssa_mark_edge(f, b, b->target);
+		if (((state == SSA_BOTTOM) || !taken) && b->fall) ssa_mark_edge(f, b, b->fall);
+	} else if (b->fall) ssa_mark_edge(f, b, b->fall);
+}
+
+static void ssa_propagate_constants(struct ssa_func * f)
+{
+	struct ssa_block * entry = f->rpo[0];
+	entry->executable = 1;
+	ssa_push(&f->block_work, entry);
+
+	while (f->block_work.cnt || f->value_work.cnt) {
+		while (f->block_work.cnt) {
+			struct ssa_block * b = f->block_work.items[--f->block_work.cnt];
+			for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+				ssa_eval_phi(f, phi);
+			for (int i = b->first; i <= b->last; i++)
+				ssa_eval_op(f, f->ops[i].op);
+		}
+		while (f->value_work.cnt) {
+			struct ssa_value * v = f->value_work.items[--f->value_work.cnt];
+			v->queued = 0;
+			for (struct ssa_use * u = v->uses; u; u = u->next) {
+				if (u->op) {
+					if (ssa_info(f, u->op)->block->executable) ssa_eval_op(f, u->op);
+				} else if (u->phi->value->block->executable) ssa_eval_phi(f, u->phi);
+			}
+		}
+	}
+}
+
+//
+//
+// Rewriting of operations
+//
+//
+
+/**
+ * Returns 1 if the value can be copied right after its definition
+ */
+static inline int ssa_copyable(struct ssa_value * v)
+{
+	if (v->phi) return 1;
+	return v->def && !ssa_ends_block(v->def);
+}
+
+static inline struct ssa_value * ssa_origin(struct ssa_value * v)
+{
+	while (v->copy_of) v = v->copy_of;
+	return v;
+}
+
+/**
+ * Finds values which are copies of other values
+ */
+static void ssa_find_copies(struct ssa_func * f)
+{
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (!b->executable) continue;
+
+		// phi nodes whose arguments are the same value
+		for (struct ssa_phi * phi = b->phis; phi; phi = phi->next) {
+			struct ssa_value * origin = NULL;
+			for (int j = 0; j < b->pred_cnt; j++) {
+				if (!b->executable_edges[j]) continue;
+				struct ssa_value * arg = ssa_origin(phi->args[j].value);
+				if (arg == phi->value) continue;
+				if (origin && (origin != arg)) {
+					origin = NULL;
+					break;
+				}
+				origin = arg;
+			}
+			if (origin && ssa_copyable(origin)) phi->value->copy_of = origin;
+		}
+
+		for (int j = b->first; j <= b->last; j++) {
+			jit_op * op = f->ops[j].op;
+			struct ssa_use * src = f->ops[j].uses[1];
+			if (((op->code != (JIT_MOV | REG)) && (op->code != (JIT_FMOV | REG))) || !f->ops[j].def || !src) continue;
+			struct ssa_value * origin = ssa_origin(src->value);
+			if (ssa_copyable(origin) && (origin != f->ops[j].def)) f->ops[j].def->copy_of = origin;
+		}
+	}
+}
+
+static void ssa_drop_uses(struct ssa_op * info)
+{
+	for (int k = 0; k < 4; k++)
+		info->uses[k] = NULL;
+}
+
+static void ssa_remove_op(struct ssa_func * f, jit_op * op)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	op->code = JIT_NOP;
+	op->spec = SPEC(NO, NO, NO);
+	ssa_drop_uses(info);
+	info->removed = 1;
+}
+
+/**
+ * Replaces the branch whose condition is constant with a jump or removes it
+ */
+static void ssa_resolve_branch(struct ssa_func * f, jit_op * op, int taken)
+{
+	if (taken) {
+		op->code = JIT_JMP | IMM;
+		op->spec = SPEC(IMM, NO, NO);
+		op->arg[1] = 0;
+		op->arg[2] = 0;
+		op->probability = -1;
+		ssa_drop_uses(ssa_info(f, op));
+		return;
+	}
+	jit_op * patch = op->jmp_addr;
+	if ((GET_OP(patch) == JIT_PATCH) && ((jit_op *) patch->arg[0] == op)) ssa_remove_op(f, patch);
+	ssa_remove_op(f, op);
+}
+
+/**
+ * Turns the i-th argument of the operation into an immediate value
+ */
+static void ssa_set_imm(struct ssa_func * f, jit_op * op, int i, jit_value value)
+{
+	op->code = (op->code & ~0x3) | IMM;
+	op->spec = (op->spec & ~(0x3 << (2 * i))) | (IMM << (2 * i));
+	op->arg[i] = value;
+	ssa_info(f, op)->uses[i] = NULL;
+}
+
+static void ssa_swap_args(struct ssa_func * f, jit_op * op, int i, int j)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	jit_value a = op->arg[i];
+	op->arg[i] = op->arg[j];
+	op->arg[j] = a;
+	struct ssa_use * u = info->uses[i];
+	info->uses[i] = info->uses[j];
+	info->uses[j] = u;
+}
+
+static inline int ssa_const_use(struct ssa_func * f, jit_op * op, int i, jit_value * value)
+{
+	struct ssa_use * u = ssa_info(f, op)->uses[i];
+	if (!u || ssa_tied_use(op, i) || (u->value->lattice != SSA_CONST)) return 0;
+	*value = u->value->constant;
+	return 1;
+}
+
+/**
+ * Returns the operation which computes the same value with swapped operands,
+ * or 0 if there is no such operation
+ */
+static jit_opcode ssa_swapped_op(jit_opcode code)
+{
+	switch (code) {
+		case JIT_ADD: case JIT_MUL: case JIT_HMUL: case JIT_MIN: case JIT_MAX:
+		case JIT_OR: case JIT_XOR: case JIT_AND: case JIT_EQ: case JIT_NE:
+		case JIT_BEQ: case JIT_BNE: case JIT_BMS: case JIT_BMC: case JIT_LDX:
+			return code;
+		case JIT_SUB: return JIT_RSB;
+		case JIT_RSB: return JIT_SUB;
+		case JIT_LT: return JIT_GT;
+		case JIT_GT: return JIT_LT;
+		case JIT_LE: return JIT_GE;
+		case JIT_GE: return JIT_LE;
+		case JIT_BLT: return JIT_BGT;
+		case JIT_BGT: return JIT_BLT;
+		case JIT_BLE: return JIT_BGE;
+		case JIT_BGE: return JIT_BLE;
+		default: return 0;
+	}
+}
+
+/**
+ * Returns 1 if the operation has a variant with the immediate value as the
+ * third argument which is equal to the given one
+ */
+static int ssa_imm_variant(jit_op * op, jit_value value)
+{
+	switch (GET_OP(op)) {
+		case JIT_ADD: case JIT_ADDC: case JIT_ADDX: case JIT_SUB: case JIT_SUBC: case JIT_SUBX:
+		case JIT_RSB: case JIT_MUL: case JIT_HMUL: case JIT_MIN: case JIT_MAX:
+		case JIT_OR: case JIT_XOR: case JIT_AND:
+		case JIT_LT: case JIT_LE: case JIT_GT: case JIT_GE: case JIT_EQ: case JIT_NE:
+		case JIT_BLT: case JIT_BLE: case JIT_BGT: case JIT_BGE: case JIT_BEQ: case JIT_BNE:
+		case JIT_BMS: case JIT_BMC: case JIT_BOADD: case JIT_BOSUB: case JIT_BNOADD: case JIT_BNOSUB:
+		case JIT_LDX: case JIT_FLDX:
+			return 1;
+		case JIT_DIV: case JIT_MOD: return value != 0;
+		case JIT_LSH: case JIT_RSH: return (value >= 0) && (value < (jit_value) (sizeof(jit_value) * 8));
+		default: return 0;
+	}
+}
+
+/**
+ * Replaces constant operands of the operation with immediate values;
+ * returns 1 if the operation was changed
+ */
+static int ssa_use_constants(struct ssa_func * f, jit_op * op)
+{
+	jit_value value;
+	if (op->fp && (GET_OP(op) != JIT_FLDX)) return 0;
+
+	switch (GET_OP(op)) {
+		case JIT_MOV: case JIT_LD: case JIT_FLD:
+			if (!ssa_const_use(f, op, 1, &value)) return 0;
+			ssa_set_imm(f, op, 1, value);
+			return 1;
+		case JIT_PUTARG: case JIT_RET: case JIT_ST: case JIT_FST:
+			if (!ssa_const_use(f, op, 0, &value)) return 0;
+			ssa_set_imm(f, op, 0, value);
+			return 1;
+		case JIT_STX: case JIT_FSTX:
+			if (IS_IMM(op)) return 0;
+			if (ssa_const_use(f, op, 1, &value)) ssa_swap_args(f, op, 0, 1);
+			else if (!ssa_const_use(f, op, 0, &value)) return 0;
+			ssa_set_imm(f, op, 0, value);
+			return 1;
+		default: break;
+	}
+
+	if ((ARG_TYPE(op, 3) != REG) || ((ARG_TYPE(op, 1) != TREG) && !is_cond_branch_op(op))) return 0;
+	if (ssa_const_use(f, op, 2, &value) && ssa_imm_variant(op, value)) {
+		ssa_set_imm(f, op, 2, value);
+		return 1;
+	}
+
+	jit_opcode swapped = ssa_swapped_op(GET_OP(op));
+	if (!swapped || !ssa_const_use(f, op, 1, &value) || !ssa_imm_variant(op, value)) return 0;
+	op->code = swapped | (op->code & UNSIGNED);
+	ssa_swap_args(f, op, 1, 2);
+	ssa_set_imm(f, op, 2, value);
+	return 1;
+}
+
+/**
+ * Replaces uses of copies with the original values
+ */
+static void ssa_use_copies(struct ssa_func * f, jit_op * op)
+{
+	struct ssa_op * info = ssa_info(f, op);
+	for (int i = 0; i < 3; i++) {
+		struct ssa_use * u = info->uses[i];
+		if (!u || ssa_tied_use(op, i) || !u->value->copy_of) continue;
+		u->value = ssa_origin(u->value);
+		op->arg[i] = f->regs[u->value->reg];
+	}
+}
+
+/**
+ * Operations whose operands are given explicitly by the front end
+ */
+static inline int ssa_fixed_operands(jit_op * op)
+{
+	switch (GET_OP(op)) {
+		case JIT_FORCE_SPILL: case JIT_FORCE_ASSOC: case JIT_TOUCH: return 1;
+		default: return 0;
+	}
+}
+
+static void ssa_rewrite(struct ssa_func * f)
+{
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (!b->executable) continue;
+		for (int j = b->first; j <= b->last; j++) {
+			struct ssa_op * info = &f->ops[j];
+			jit_op * op = info->op;
+			if (info->removed || ssa_fixed_operands(op)) continue;
+
+			if (info->def && (info->def->lattice == SSA_CONST) && (ssa_foldable_op(op) || jit_reads_target_reg(op))) {
+				jit_value value = info->def->constant;
+				if ((op->code == (JIT_MOV | IMM)) && (op->arg[1] == value)) continue;
+				op->code = JIT_MOV | IMM;
+				op->spec = SPEC(TREG, IMM, NO);
+				op->arg[1] = value;
+				op->arg[2] = 0;
+				ssa_drop_uses(info);
+				f->folded++;
+				continue;
+			}
+
+			int taken;
+			if (is_cond_branch_op(op) && (ssa_eval_branch(f, op, &taken) == SSA_CONST)) {
+				ssa_resolve_branch(f, op, taken);
+				f->folded++;
+				continue;
+			}
+
+			f->folded += ssa_use_constants(f, op);
+			ssa_use_copies(f, op);
+		}
+	}
+}
+
+//
+//
+// Dead code elimination
+//
+//
+
+/**
+ * Returns 1 if the operation has no other effect than setting its target
+ * register
+ */
+static int ssa_removable(struct ssa_op * info)
+{
+	if (!info->def || (info->def_arg != 0) || ssa_fixed_operands(info->op)) return 0;
+	switch (GET_OP(info->op)) {
+		// carry flag is used by the following operation
+		case JIT_ADDC: case JIT_ADDX: case JIT_SUBC: case JIT_SUBX:
+		case JIT_RETVAL: case JIT_FRETVAL: case JIT_TOUCH:
+			return 0;
+		default: return 1;
+	}
+}
+
+static void ssa_mark_value(struct ssa_func * f, struct ssa_value * v)
+{
+	if (!v || v->live) return;
+	v->live = 1;
+	ssa_push(&f->value_work, v);
+}
+
+static void ssa_mark_uses(struct ssa_func * f, struct ssa_op * info)
+{
+	for (int k = 0; k < 4; k++)
+		if (info->uses[k]) ssa_mark_value(f, info->uses[k]->value);
+}
+
+/**
+ * Marks all reachable blocks and edges executable; used by passes which
+ * run without the constant propagation
+ */
+static void ssa_mark_reachable(struct ssa_func * f)
+{
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		b->executable = 1;
+		for (int j = 0; j < b->pred_cnt; j++)
+			b->executable_edges[j] = (b->preds[j]->rpo >= 0);
+	}
+}
+
+static void ssa_eliminate_dead_code(struct ssa_func * f)
+{
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (!b->executable) continue;
+		for (int j = b->first; j <= b->last; j++)
+			if (!f->ops[j].removed && !ssa_removable(&f->ops[j])) ssa_mark_uses(f, &f->ops[j]);
+	}
+
+	while (f->value_work.cnt) {
+		struct ssa_value * v = f->value_work.items[--f->value_work.cnt];
+		if (v->def) ssa_mark_uses(f, ssa_info(f, v->def));
+		if (!v->phi) continue;
+		for (int j = 0; j < v->block->pred_cnt; j++)
+			if (v->block->executable_edges[j]) ssa_mark_value(f, v->phi->args[j].value);
+	}
+
+	for (int i = 0; i < f->rpo_cnt; i++) {
+		struct ssa_block * b = f->rpo[i];
+		if (!b->executable) continue;
+		for (int j = b->first; j <= b->last; j++) {
+			struct ssa_op * info = &f->ops[j];
+			if (info->removed || !ssa_removable(info) || info->def->live) continue;
+			ssa_remove_op(f, info->op);
+			f->dead++;
+		}
+	}
+}
+
+//
+//
+// Translation out of the SSA form
+//
+//
+
+/**
+ * Copies the value into a new register right after its definition
+ */
+static jit_value ssa_copy_value(struct ssa_func * f, struct ssa_value * v)
+{
+	if (v->copied) return v->copy;
+
+	jit_value reg = f->regs[v->reg];
+	int fp = JIT_REG_TYPE(reg) == JIT_RTYPE_FLOAT;
+	v->copy = fp ? FR(f->fp_cnt++) : R(f->gp_cnt++);
+	v->copied = 1;
+
+	jit_op * copy = jit_op_new(fp ? JIT_FMOV | REG : JIT_MOV | REG, SPEC(TREG, REG, NO), v->copy, reg, 0, 0);
+	copy->fp = fp;
+	if (v->def) {
+		jit_op_append(v->def, copy);
+		return v->copy;
+	}
+
+	// the value of a phi node is copied behind labels starting the block
+	// and behind patches of removed branches
+	int pos = v->block->first;
+	while ((pos < v->block->last) && (f->ops[pos].removed || jmpthr_no_code_op(f->ops[pos].op))) pos++;
+	if (f->ops[pos].removed || jmpthr_no_code_op(f->ops[pos].op)) jit_op_append(f->ops[pos].op, copy);
+	else jit_op_prepend(f->ops[pos].op, copy);
+	return v->copy;
+}
+
+/**
+ * Returns 1 if the register of the value still holds the value or its copy
+ */
+static int ssa_available(struct ssa_func * f, struct ssa_value * v)
+{
+	struct ssa_value * current = f->current[v->reg];
+	if (current == v) return 1;
+	// phi nodes which are not used have no copies on the incoming edges
+	return current && (!current->phi || current->live) && (ssa_origin(current) == v);
+}
+
+static int ssa_translate_block(struct ssa_func * f, struct ssa_block * b)
+{
+	// the code dominated by unreachable code is not reachable either
+	if (!b->executable) return 0;
+
+	for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+		ssa_define(f, phi->value);
+
+	for (int i = b->first; i <= b->last; i++) {
+		struct ssa_op * info = &f->ops[i];
+		if (info->removed) continue;
+		for (int k = 0; k < 3; k++) {
+			struct ssa_use * u = info->uses[k];
+			if (u && !ssa_available(f, u->value)) info->op->arg[k] = ssa_copy_value(f, u->value);
+		}
+		if (info->def) ssa_define(f, info->def);
+	}
+	return 1;
+}
+
+static void ssa_translate_block_leave(struct ssa_func * f, struct ssa_block * b)
+{
+	for (int i = b->last; i >= b->first; i--)
+		if (f->ops[i].def && !f->ops[i].removed) f->current[f->ops[i].def->reg] = f->ops[i].def->shadowed;
+	for (struct ssa_phi * phi = b->phis; phi; phi = phi->next)
+		f->current[phi->value->reg] = phi->value->shadowed;
+}
+
+/**
+ * Copies values whose registers are overwritten before the values are used;
+ * the renaming left values at the entry of the function as the current ones
+ */
+static void ssa_translate(struct ssa_func * f)
+{
+	ssa_walk(f, ssa_translate_block, ssa_translate_block_leave);
+}
+
+static void ssa_optimize_function(struct ssa_func * f)
+{
+	ssa_propagate_constants(f);
+	ssa_find_copies(f);
+	ssa_rewrite(f);
+	ssa_eliminate_dead_code(f);
+	ssa_translate(f);
+}
+
+static void ssa_collect_code_refs(struct jit * jit, jit_tree ** code_refs)
+{
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
+		if (((GET_OP(op) == JIT_REF_CODE) || (GET_OP(op) == JIT_DATA_REF_CODE)) && op->jmp_addr)
+			*code_refs = jit_tree_insert(*code_refs, (jit_value) op->jmp_addr, NULL, NULL);
+}
+
+/**
+ * Optimizes functions in the SSA form; returns the number of folded and
+ * removed operations
+ */
+static int jit_optimize_ssa(struct jit * jit)
+{
+	int changes = 0;
+	jit_tree * code_refs = NULL;
+	ssa_collect_code_refs(jit, &code_refs);
+
+	jit_op * op = jit_op_first(jit->ops);
+	while (op) {
+		if (GET_OP(op) != JIT_PROLOG) {
+			op = op->next;
+			continue;
+		}
+		jit_op * prolog = op;
+		do op = op->next;
+		while (op && (GET_OP(op) != JIT_PROLOG));
+
+		struct ssa_func f;
+		memset(&f, 0, sizeof(struct ssa_func));
+		if (ssa_build(&f, prolog, code_refs)) {
+			ssa_optimize_function(&f);
+			jit->stats[JIT_STAT_FOLDED_OPS] += f.folded;
+			jit->stats[JIT_STAT_DEAD_OPS] += f.dead;
+			changes += f.folded + f.dead;
+		}
+		ssa_free(&f);
+	}
+	jit_tree_free(code_refs);
+	return changes;
+}
@@ -41,6 +41,7 @@
 #define sse_movlpd_memindex_xreg(ip, basereg, disp, indexreg, shift, reg)  x86_movlpd_memindex_xreg(ip, reg, basereg, disp, indexreg, shift)
 
 #define sse_alu_sd_reg_reg(ip, op, r1, r2) 		x86_sse_alu_sd_reg_reg(ip, op, r1, r2)
+#define sse_alu_sd_reg_reg_imm(ip, op, r1, r2, imm) 	x86_sse_alu_sd_reg_reg_imm(ip, op, r1, r2, imm)
 #define sse_mov_reg_safeimm(jit, xop, reg, imm)		x86_movsd_reg_mem(jit->ip, reg, imm)
 #define sse_alu_sd_reg_safeimm(jit, xop, op, reg, imm) 	x86_sse_alu_sd_reg_mem(jit->ip, op, reg, imm)
 
@@ -49,6 +50,7 @@
 #define sse_alu_pd_reg_safeimm(jit, xop, op, reg, imm) 	x86_sse_alu_pd_reg_mem(jit->ip, op, reg, imm)
 
 #define sse_comisd_reg_reg(ip, r1, r2)			x86_sse_alu_pd_reg_reg(ip, X86_SSE_COMI, r1, r2)
+#define sse_movd_reg_xreg(ip, r1, r2)			x86_movd_reg_xreg(ip, r1, r2)
 
 #define sse_cvttsd2si_reg_reg(ip, r1, r2) 		x86_cvttsd2si(ip, r1, r2)
 #define sse_cvtsi2sd_reg_reg(ip, r1, r2) 		x86_cvtsi2sd(ip, r1, r2)
@@ -86,6 +88,8 @@
 
 #define sse_comisd_reg_reg(ip, r1, r2)                  amd64_sse_comisd_reg_reg(ip, r1, r2)
 #define sse_alu_pd_reg_reg_imm(ip, op, r1, r2, imm)     amd64_sse_alu_pd_reg_reg_imm(ip, op, r1, r2, imm)
+#define sse_alu_sd_reg_reg_imm(ip, op, r1, r2, imm)     amd64_sse_alu_sd_reg_reg_imm(ip, op, r1, r2, imm)
+#define sse_movd_reg_xreg(ip, r1, r2)                   amd64_movd_reg_xreg_size(ip, r1, r2, 4)
 
 #define sse_cvttsd2si_reg_reg(ip, r1, r2) 		amd64_sse_cvttsd2si_reg_reg(ip, r1, r2)
 #define sse_cvtsi2sd_reg_reg(ip, r1, r2) 		amd64_sse_cvtsi2sd_reg_reg(ip, r1, r2)
@@ -189,6 +193,18 @@ static unsigned char * emit_sse_get_sign_mask()
 	return buf;
 }
 
+static unsigned char * emit_sse_get_abs_mask()
+{
+	static unsigned char bufx[32];
+	unsigned char * buf = bufx + 1;
+	while ((intptr_t)buf % 16) buf++;
+	uint64_t * bit_mask = (uint64_t *)buf;
+
+	// clears 64th (sign) bit
+	*bit_mask = ~((uint64_t)1 << 63);
+	return buf;
+}
+
 static void emit_sse_alu_op(struct jit * jit, jit_op * op, int sse_op)
 {
 	if (op->r_arg[0] == op->r_arg[1]) {
@@ -239,17 +255,91 @@ static void emit_sse_div_op(struct jit * jit, intptr_t a1, intptr_t a2, intptr_t
 	}
 }
 
+/**
+ * Emits MINSD or MAXSD. Their result does not depend on the order of operands only
+ * if both are ordered and distinct; otherwise (NaN, or +0 and -0), the second
+ * operand is returned. Hence, the operands are never swapped and O1 := O2 < O3 ? O2 : O3
+ * (O1 := O2 > O3 ? O2 : O3, respectively) holds for all values.
+ */
+static void emit_sse_minmax_op(struct jit * jit, int sse_op, intptr_t a1, intptr_t a2, intptr_t a3)
+{
+	if (a1 == a2) {
+		sse_alu_sd_reg_reg(jit->ip, sse_op, a1, a3);
+	} else if (a1 == a3) {
+		// creates a copy of the a2 into high bits of a2
+		sse_alu_pd_reg_reg_imm(jit->ip, X86_SSE_SHUF, a2, a2, 0);
+
+		sse_alu_sd_reg_reg(jit->ip, sse_op, a2, a3);
+		sse_movsd_reg_reg(jit->ip, a1, a2);
+
+		// returns the the value of a2
+		sse_alu_pd_reg_reg_imm(jit->ip, X86_SSE_SHUF, a2, a2, 1);
+	} else {
+		sse_movsd_reg_reg(jit->ip, a1, a2);
+		sse_alu_sd_reg_reg(jit->ip, sse_op, a1, a3);
+	}
+}
+
 static void emit_sse_neg_op(struct jit * jit, jit_op * op, intptr_t a1, intptr_t a2)
 {
 	if (a1 != a2) sse_movsd_reg_reg(jit->ip, a1, a2);
 	emit_sse_change_sign(jit, op, a1);
 }
 
+static void emit_sse_abs_op(struct jit * jit, jit_op * op, intptr_t a1, intptr_t a2)
+{
+	if (a1 != a2) sse_movsd_reg_reg(jit->ip, a1, a2);
+	sse_alu_pd_reg_safeimm(jit, op, X86_SSE_AND, a1, (double *)emit_sse_get_abs_mask());
+}
+
 static void emit_sse_branch(struct jit * jit, jit_op * op, intptr_t a1, intptr_t a2, intptr_t a3, int x86_cond)
 {
         sse_alu_pd_reg_reg(jit->ip, X86_SSE_COMI, a2, a3);
         op->patch_addr = JIT_BUFFER_OFFSET(jit);
-        x86_branch_disp32(jit->ip, x86_cond, JIT_GET_ADDR(jit, a1), 0);
+        emit_jcc(jit, x86_cond, a1, 0);
+}
+
+/**
+ * Emits CMPSD which sets all bits of the register if the floating-point comparison
+ * holds and clears them otherwise. Any comparison involving NaN is false, except
+ * for the inequality.
+ *
+ * @param negate -- sets the bits if the comparison does not hold
+ */
+static void emit_sse_cmp_mask(struct jit * jit, jit_op * op, jit_value reg, int negate)
+{
+	jit_value a2 = op->r_arg[1];
+	jit_value a3 = op->r_arg[2];
+	int pred;
+
+	switch (GET_OP(op)) {
+		case JIT_FLT: pred = X86_SSE_CMP_LT; break;
+		case JIT_FLE: pred = X86_SSE_CMP_LE; break;
+		// O2 > O3 and O2 >= O3 are evaluated as O3 < O2 and O3 <= O2
+		case JIT_FGT: pred = X86_SSE_CMP_LT; a2 = op->r_arg[2]; a3 = op->r_arg[1]; break;
+		case JIT_FGE: pred = X86_SSE_CMP_LE; a2 = op->r_arg[2]; a3 = op->r_arg[1]; break;
+		case JIT_FEQ: pred = X86_SSE_CMP_EQ; break;
+		case JIT_FNE: pred = X86_SSE_CMP_NEQ; break;
+		default: assert(0);
+	}
+
+	// NLT, NLE, and NEQ are negations of LT, LE, and EQ, including NaNs
+	if (negate) pred ^= X86_SSE_CMP_NEQ;
+
+	if (reg != a2) sse_movsd_reg_reg(jit->ip, reg, a2);
+	sse_alu_sd_reg_reg_imm(jit->ip, X86_SSE_COMP, reg, a3, pred);
+}
+
+/**
+ * Emits the floating-point conditional move as a blend of the target and the source
+ * register, i.e., O1 := (O1 & ~mask) | (O2 & mask), where the mask register holds
+ * the negated condition.
+ */
+static void emit_sse_blend(struct jit * jit, jit_value a1, jit_value a2, jit_value mask)
+{
+	sse_alu_pd_reg_reg(jit->ip, X86_SSE_AND, a1, mask);
+	sse_alu_pd_reg_reg(jit->ip, X86_SSE_ANDN, mask, a2);
+	sse_alu_pd_reg_reg(jit->ip, X86_SSE_OR, a1, mask);
 }
 
 static void emit_sse_round(struct jit * jit, jit_op * op, jit_value a1, jit_value a2)
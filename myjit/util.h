@@ -33,7 +33,7 @@ static inline int _bit_pop(unsigned int x) {
 
 static int uses_hw_reg(struct jit_op * op, jit_value reg, int fp)
 {
-	if ((GET_OP(op) == JIT_RENAMEREG) && (op->r_arg[0] == reg)) return 1; // not a regular operation
+	if ((GET_OP(op) == JIT_RENAMEREG) && (op->fp == fp) && (op->r_arg[0] == reg)) return 1; // not a regular operation
 	for (int i = 0; i < 3; i++)
 		if ((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG)) {
 			if (fp && (JIT_REG_TYPE(op->arg[i]) == JIT_RTYPE_INT)) continue;
@@ -19,6 +19,24 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+/*
+ * The instruction selection (jit_select_instructions) is a greedy peephole
+ * pass driven by the table x86_rules, not a cost-driven cover of a tree or
+ * DAG. Its limits:
+ *
+ * - a rule covers at most two operations, an operation and the following
+ *   operation which is the last one using its result; longer patterns,
+ *   e.g., addressing modes, are built step by step as the merged operation
+ *   is visited again;
+ * - operations are visited once in their order and a rule which has been
+ *   applied is never reconsidered, hence, the result depends on the order
+ *   and it is not the cheapest cover in general;
+ * - the cost of a rule is a fixed number of saved instructions which is 1
+ *   for almost all rules; it only decides between rules matching the same
+ *   operations, ties are resolved by the order of the table;
+ * - an operation whose result has several uses is never merged.
+ */
+
 #include <stdint.h>
 #define IS_32BIT_VALUE(x) ((((intptr_t)(x)) >= INT32_MIN) && (((intptr_t)(x)) <= INT32_MAX))
 
@@ -27,69 +45,98 @@
 // Optimizations
 //
 //
-void jit_optimize_st_ops(struct jit * jit)
+/**
+ * Returns 1 if the operation uses the callee-saved register, i.e., the register
+ * has to be saved by the function. R_FP is mapped to the frame pointer which
+ * is saved by the prolog.
+ */
+static int uses_saved_reg(struct jit * jit, struct jit_func_info * info, jit_op * op, jit_hw_reg * r)
 {
-	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
-		if ((GET_OP(op) == JIT_ST)
-		&& (op->prev)
-		&& (op->prev->code == (JIT_MOV | IMM))
-		&& (op->arg[1] == op->prev->arg[0])
-		&& (IS_32BIT_VALUE(op->prev->arg[1]))
-		&& (!jit_set_get(op->live_out, op->arg[1])))
-		{
-			if (!IS_IMM(op)) {
-				op->code = JIT_X86_STI | REG;
-				op->spec = SPEC(REG, IMM, NO);
-			} else {
-				op->code = JIT_X86_STI | IMM;
-				op->spec = SPEC(IMM, IMM, NO);
-			}
-			op->arg[1] = op->prev->arg[1];
-			op->prev->code = JIT_NOP;
-			op->prev->spec = SPEC(NO, NO, NO);
-		}
+	if (!r->callee_saved) return 0;
+	if ((r->id == jit->reg_al->fp_reg) && !info->free_frame_reg) return 0;
+	return uses_hw_reg(op, r->id, 0);
+}
 
-		if ((GET_OP(op) == JIT_STX)
-		&& (op->prev)
-		&& (op->prev->code == (JIT_MOV | IMM))
-		&& (op->arg[2] == op->prev->arg[0])
-		&& (IS_32BIT_VALUE(op->prev->arg[1]))
-		&& (!jit_set_get(op->live_out, op->arg[2])))
-		{
-			if (!IS_IMM(op)) {
-				op->code = JIT_X86_STXI | REG;
-				op->spec = SPEC(REG, REG, IMM);
-			} else {
-				op->code = JIT_X86_STXI | IMM;
-				op->spec = SPEC(IMM, REG, IMM);
-			}
-			op->arg[2] = op->prev->arg[1];
-			op->prev->code = JIT_NOP;
-			op->prev->spec = SPEC(NO, NO, NO);
-		}
+static int uses_callee_saved_reg(struct jit * jit, struct jit_func_info * info, jit_op * op)
+{
+	for (int i = 0; i < jit->reg_al->gp_reg_cnt; i++)
+		if (uses_saved_reg(jit, info, op, &(jit->reg_al->gp_regs[i]))) return 1;
+	return 0;
+}
 
+static int uses_fp_reg(struct jit * jit, jit_op * op)
+{
+	for (int i = 0; i < 3; i++)
+		if (((ARG_TYPE(op, i + 1) == REG) || (ARG_TYPE(op, i + 1) == TREG)) && (op->arg[i] == R_FP)) return 1;
+	return 0;
+}
+
+/**
+ * On AMD64, functions which do not use R_FP address their frame through RSP
+ * (see jit_optimize_frame_ptr), hence, RBP can be allocated as a callee-saved
+ * register. Has to be called before the register allocation.
+ */
+void jit_free_frame_reg(struct jit * jit)
+{
+#ifdef JIT_ARCH_AMD64
+	struct jit_func_info * info = NULL;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
+		if (GET_OP(op) == JIT_PROLOG) {
+			info = (struct jit_func_info *) op->arg[1];
+			info->free_frame_reg = 1;
+		}
+		if (info && ((GET_OP(op) == JIT_ALLOCA) || uses_fp_reg(jit, op))) info->free_frame_reg = 0;
 	}
+#endif
 }
 
+/**
+ * Omits the frame pointer where it's possible
+ *
+ * Functions which do not use the stack at all do not need a prolog. On AMD64,
+ * functions which do not use R_FP address their frame through RSP and leaf
+ * functions with a small frame use the red zone instead of allocating the frame.
+ */
 void jit_optimize_frame_ptr(struct jit * jit)
 {
 	if (!(jit->optimizations & JIT_OPT_OMIT_FRAME_PTR)) return;
 
 	struct jit_func_info * info = NULL;
 	int uses_frame_ptr = 0;
+	int uses_stack = 0;
+	int is_leaf = 1;
 	for (jit_op * op = jit_op_first(jit->ops); ; op = op->next) {
 		if (!op || GET_OP(op) == JIT_PROLOG) {
-			if (info && !uses_frame_ptr) {
-				info->has_prolog = 0;
-				uses_frame_ptr = 0;
+			if (info && !uses_frame_ptr && !uses_stack) info->has_prolog = 0;
+#ifdef JIT_ARCH_AMD64
+			else if (info && !uses_frame_ptr) {
+				info->sp_relative_frame = 1;
+				info->red_zone = is_leaf && jit_fits_red_zone(info);
 			}
+#endif
+			uses_frame_ptr = 0;
+			uses_stack = 0;
+			is_leaf = 1;
 
 			if (op) info = (struct jit_func_info *) op->arg[1];
 		}
 		if (!op) break;
-		if ((GET_OP(op) == JIT_ALLOCA) || (GET_OP(op) == JIT_UREG) || (GET_OP(op) == JIT_LREG) || (GET_OP(op) == JIT_SYNCREG)) {
-			uses_frame_ptr |= 1;
+		switch (GET_OP(op)) {
+			case JIT_ALLOCA:
+				uses_frame_ptr = 1;
+				break;
+			case JIT_UREG: case JIT_LREG: case JIT_SYNCREG:
+				uses_stack = 1;
+				break;
+			case JIT_PREPARE: case JIT_CALL:
+			case JIT_MSG: case JIT_FMSG: case JIT_TRACE:
+				is_leaf = 0;
+				break;
+			default: break;
 		}
+		if (uses_fp_reg(jit, op)) uses_frame_ptr = 1;
+		// callee-saved registers are pushed on the stack
+		if (info && uses_callee_saved_reg(jit, info, op)) is_leaf = 0;
 	}
 }
 
@@ -121,30 +168,32 @@ static inline void make_nop(jit_op * op)
 	op->spec = SPEC(NO, NO, NO);
 }
 
-static jit_op * get_related_op(jit_op * op, int result_reg)
-{
-	jit_op * nextop = op->next;
-
-	if ((nextop->arg[0] != result_reg) && (jit_set_get(nextop->live_out, result_reg))) return NULL;
-
-	int used = 0;
-	for (int i = 0; i < 3; i++)
-		if ((ARG_TYPE(nextop, i + 1) == REG) && (nextop->arg[i])) {
-			used = 1;
-			break;
-		}
-	if (used) return nextop;
-	return NULL;
-}
-
-static int join_2ops(jit_op * op, int opcode1, int opcode2, int (* joinfn)(jit_op *, jit_op *))
+// combines:
+// movi r1, imm
+// str r2, r1 (or sti, stxi, stxr)
+// -->
+// sti r2, imm	... mov [reg], imm
+static int join_movi_st(jit_op * op, jit_op * nextop)
 {
-	if (op->code == opcode1) {
-		jit_value result_reg = op->arg[0];
-		jit_op * nextop = get_related_op(op, result_reg);
-		if (nextop && (nextop->code == opcode2)) return joinfn(op, nextop);
+	if (!IS_32BIT_VALUE(op->arg[1])) return 0;
+
+	jit_value reg = op->arg[0];
+	int value_arg = (GET_OP(nextop) == JIT_ST) ? 1 : 2;
+	if (nextop->arg[value_arg] != reg) return 0;
+	// the register cannot be used in the address
+	for (int i = 0; i < value_arg; i++)
+		if ((ARG_TYPE(nextop, i + 1) == REG) && (nextop->arg[i] == reg)) return 0;
+
+	switch (nextop->code) {
+		case (JIT_ST | IMM): nextop->code = JIT_X86_STI | IMM; nextop->spec = SPEC(IMM, IMM, NO); break;
+		case (JIT_ST | REG): nextop->code = JIT_X86_STI | REG; nextop->spec = SPEC(REG, IMM, NO); break;
+		case (JIT_STX | IMM): nextop->code = JIT_X86_STXI | IMM; nextop->spec = SPEC(IMM, REG, IMM); break;
+		case (JIT_STX | REG): nextop->code = JIT_X86_STXI | REG; nextop->spec = SPEC(REG, REG, IMM); break;
+		default: return 0;
 	}
-	return 0;
+	nextop->arg[value_arg] = op->arg[1];
+	make_nop(op);
+	return 1;
 }
 
 static int shift_index(int arg)
@@ -230,20 +279,6 @@ static int join_muli_addr(jit_op * op, jit_op * nextop)
 	return 1;
 }
 
-int jit_optimize_join_addmul(struct jit * jit)
-{
-	int change = 0;
-	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
-		change |= join_2ops(op, JIT_MUL | IMM, JIT_ADD | IMM, join_muli_addi);
-		change |= join_2ops(op, JIT_LSH | IMM, JIT_ADD | IMM, join_muli_addi);
-		change |= join_2ops(op, JIT_MUL | IMM, JIT_ADD | REG, join_muli_addr);
-		change |= join_2ops(op, JIT_LSH | IMM, JIT_ADD | REG, join_muli_addr);
-		change |= join_2ops(op, JIT_MUL | IMM, JIT_OR | IMM, join_muli_ori);
-		change |= join_2ops(op, JIT_LSH | IMM, JIT_OR | IMM, join_muli_ori);
-	}
-	return change;
-}
-
 // combines:
 // addr r1, r2, r3
 // addi r4, r1, imm
@@ -251,7 +286,9 @@ int jit_optimize_join_addmul(struct jit * jit)
 // addimm r4, r2, r3, imm  i.e., r4 := r2 + r3 + imm
 static int join_addr_addi(jit_op * op, jit_op * nextop)
 {
-	if (!IS_32BIT_VALUE(nextop->arg[2])) return 0;
+	jit_value imm = (GET_OP(nextop) == JIT_SUB) ? -nextop->arg[2] : nextop->arg[2];
+	if (!IS_32BIT_VALUE(imm)) return 0;
+	nextop->arg[2] = imm;
 	make_nop(op);
 
 	nextop->code = JIT_X86_ADDIMM;
@@ -290,14 +327,503 @@ static int join_addi_addr(jit_op * op, jit_op * nextop)
 	return 1;
 }
 
-int jit_optimize_join_addimm(struct jit * jit)
+//
+//
+// Optimizations merging address computations and loads into memory operands
+//
+//
+
+#define X86_MEM_SIZE(op) ((op)->arg_size & 0x0f)
+#define X86_MEM_SHIFT(op) ((op)->arg_size >> 4)
+
+/**
+ * Memory operand of the form [base + index * 2^shift + disp]
+ */
+struct x86_addr {
+	int has_base;
+	int has_index;
+	jit_value base;
+	jit_value index;
+	int shift;
+	jit_value disp;
+};
+
+static inline jit_value x86_mem_disp(jit_op * op)
 {
-	int change = 0;
-	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next) {
-		change |= join_2ops(op, JIT_ADD | REG, JIT_ADD | IMM, join_addr_addi);
-		change |= join_2ops(op, JIT_ADD | REG, JIT_SUB | IMM, join_addr_addi);
-		change |= join_2ops(op, JIT_ADD | IMM, JIT_ADD | REG, join_addi_addr);
-		change |= join_2ops(op, JIT_SUB | IMM, JIT_ADD | REG, join_addi_addr);
+	jit_value disp;
+	memcpy(&disp, &op->flt_imm, sizeof(jit_value));
+	return disp;
+}
+
+static inline void set_x86_mem_disp(jit_op * op, jit_value disp)
+{
+	memcpy(&op->flt_imm, &disp, sizeof(jit_value));
+}
+
+/**
+ * Returns the operation following the given one if the register is not used
+ * after this operation (or it is overwritten by the operation)
+ */
+static jit_op * next_last_use(jit_op * op, jit_value reg)
+{
+	jit_op * nextop = op->next;
+	while (nextop && (nextop->code == JIT_NOP)) nextop = nextop->next;
+	if (!nextop) return NULL;
+
+	int overwritten = (ARG_TYPE(nextop, 1) == TREG) && (nextop->arg[0] == reg);
+	if (!overwritten && jit_set_get(nextop->live_out, reg)) return NULL;
+	return nextop;
+}
+
+/**
+ * Describes the address computed by the operation; returns 0 if the operation
+ * cannot be a part of an addressing mode
+ */
+static int address_of(jit_op * op, struct x86_addr * a)
+{
+	a->has_base = 1;
+	a->has_index = 0;
+	a->shift = 0;
+	a->disp = 0;
+	switch (op->code) {
+		case (JIT_ADD | IMM):
+		case (JIT_SUB | IMM):
+			a->base = op->arg[1];
+			a->disp = (GET_OP(op) == JIT_SUB) ? -op->arg[2] : op->arg[2];
+			return IS_32BIT_VALUE(a->disp);
+		case (JIT_ADD | REG):
+		case (JIT_X86_ADDMUL | REG):
+		case JIT_X86_ADDIMM:
+			a->base = op->arg[1];
+			a->index = op->arg[2];
+			a->has_index = 1;
+			if (GET_OP(op) != JIT_ADD) a->shift = op->arg_size;
+			if (GET_OP(op) == JIT_X86_ADDIMM) a->disp = x86_mem_disp(op);
+			return 1;
+		case (JIT_X86_ADDMUL | IMM):
+			a->has_base = 0;
+			a->index = op->arg[1];
+			a->has_index = 1;
+			a->shift = op->arg_size;
+			a->disp = op->arg[2];
+			return 1;
+		case (JIT_MUL | IMM):
+		case (JIT_LSH | IMM):
+			if (!is_suitable_mul(op)) return 0;
+			a->has_base = 0;
+			a->index = op->arg[1];
+			a->has_index = 1;
+			a->shift = (GET_OP(op) == JIT_MUL) ? shift_index(op->arg[2]) : op->arg[2];
+			return 1;
+		default: return 0;
+	}
+}
+
+/**
+ * Describes the address used by the load, store, or address computation which
+ * uses the register as its base; returns 0 if the register is used otherwise
+ * or the operation does not access the memory
+ */
+static int address_used_by(jit_op * op, jit_value reg, struct x86_addr * a)
+{
+	jit_value value = 0;
+	int store = 0;
+	a->has_base = 1;
+	a->has_index = 0;
+	a->shift = 0;
+	a->disp = 0;
+	switch (op->code) {
+		case (JIT_LD | REG | SIGNED):
+		case (JIT_LD | REG | UNSIGNED):
+			a->base = op->arg[1];
+			break;
+		case (JIT_LDX | IMM | SIGNED):
+		case (JIT_LDX | IMM | UNSIGNED):
+		case (JIT_ADD | IMM):
+		case (JIT_SUB | IMM):
+			a->base = op->arg[1];
+			a->disp = (GET_OP(op) == JIT_SUB) ? -op->arg[2] : op->arg[2];
+			break;
+		case (JIT_ADD | REG):
+		case (JIT_LDX | REG | SIGNED):
+		case (JIT_LDX | REG | UNSIGNED):
+		case (JIT_X86_LDXM | REG | SIGNED):
+		case (JIT_X86_LDXM | REG | UNSIGNED):
+		case (JIT_X86_ADDMUL | REG):
+		case JIT_X86_ADDIMM:
+			a->base = op->arg[1];
+			a->index = op->arg[2];
+			a->has_index = 1;
+			if (GET_OP(op) == JIT_X86_LDXM) a->shift = X86_MEM_SHIFT(op);
+			if (GET_OP(op) == JIT_X86_ADDMUL) a->shift = op->arg_size;
+			if (GET_OP(op) == JIT_X86_ADDIMM) a->shift = op->arg_size;
+			if ((GET_OP(op) == JIT_X86_LDXM) || (GET_OP(op) == JIT_X86_ADDIMM)) a->disp = x86_mem_disp(op);
+			break;
+		case (JIT_ST | REG):
+			a->base = op->arg[0];
+			value = op->arg[1];
+			store = 1;
+			break;
+		case (JIT_STX | IMM):
+			a->base = op->arg[1];
+			a->disp = op->arg[0];
+			value = op->arg[2];
+			store = 1;
+			break;
+		case (JIT_STX | REG):
+		case (JIT_X86_STXM | REG):
+			a->base = op->arg[0];
+			a->index = op->arg[1];
+			a->has_index = 1;
+			if (GET_OP(op) == JIT_X86_STXM) {
+				a->shift = X86_MEM_SHIFT(op);
+				a->disp = x86_mem_disp(op);
+			}
+			value = op->arg[2];
+			store = 1;
+			break;
+		default: return 0;
+	}
+	if (store && (value == reg)) return 0;
+	if (!IS_32BIT_VALUE(a->disp)) return 0;
+	if (a->has_index && (a->index == reg)) {
+		if ((a->base == reg) || (a->shift != 0)) return 0;
+		a->index = a->base;
+		a->base = reg;
+	}
+	return a->base == reg;
+}
+
+/**
+ * Replaces the address of the load, store, or address computation with the
+ * given one; uses the simplest operation which can express the address
+ */
+static void set_address(jit_op * op, struct x86_addr * a)
+{
+	int simple = !a->has_index || ((a->shift == 0) && (a->disp == 0));
+	int sign = op->code & UNSIGNED;
+	int size = (GET_OP(op) == JIT_X86_LDXM) || (GET_OP(op) == JIT_X86_STXM) ? X86_MEM_SIZE(op) : op->arg_size;
+
+	switch (GET_OP(op)) {
+		case JIT_LD: case JIT_LDX: case JIT_X86_LDXM:
+			op->arg[1] = a->base;
+			op->arg_size = size;
+			if (!a->has_index) {
+				op->code = JIT_LDX | IMM | sign;
+				op->spec = SPEC(TREG, REG, IMM);
+				op->arg[2] = a->disp;
+			} else {
+				op->code = (simple ? JIT_LDX : JIT_X86_LDXM) | REG | sign;
+				op->spec = SPEC(TREG, REG, REG);
+				op->arg[2] = a->index;
+			}
+			break;
+		case JIT_ST: case JIT_STX: case JIT_X86_STXM:
+			if (GET_OP(op) == JIT_ST) op->arg[2] = op->arg[1];
+			op->arg_size = size;
+			if (!a->has_index) {
+				op->code = JIT_STX | IMM;
+				op->spec = SPEC(IMM, REG, REG);
+				op->arg[0] = a->disp;
+				op->arg[1] = a->base;
+			} else {
+				op->code = (simple ? JIT_STX : JIT_X86_STXM) | REG;
+				op->spec = SPEC(REG, REG, REG);
+				op->arg[0] = a->base;
+				op->arg[1] = a->index;
+			}
+			break;
+		default:
+			op->arg[1] = a->base;
+			op->arg_size = a->shift;
+			if (!a->has_index) {
+				op->code = JIT_ADD | IMM;
+				op->spec = SPEC(TREG, REG, IMM);
+				op->arg[2] = a->disp;
+				return;
+			}
+			op->spec = SPEC(TREG, REG, REG);
+			op->arg[2] = a->index;
+			if (simple) op->code = JIT_ADD | REG;
+			else if (a->disp == 0) op->code = JIT_X86_ADDMUL | REG;
+			else op->code = JIT_X86_ADDIMM;
+			break;
+	}
+	if (!simple) {
+		set_x86_mem_disp(op, a->disp);
+		if ((GET_OP(op) == JIT_X86_LDXM) || (GET_OP(op) == JIT_X86_STXM)) op->arg_size |= a->shift << 4;
+	}
+}
+
+/**
+ * Merges the address computed by the first operation into the address which
+ * uses it as its base; returns 0 if there is no such addressing mode
+ */
+static int merge_addresses(struct x86_addr * a, struct x86_addr * b, struct x86_addr * res)
+{
+	*res = *a;
+	res->disp = a->disp + b->disp;
+	if (b->has_index) {
+		if (!a->has_index) {
+			res->has_index = 1;
+			res->index = b->index;
+			res->shift = b->shift;
+		} else if (!a->has_base && (b->shift == 0)) {
+			res->has_base = 1;
+			res->base = b->index;
+		} else return 0;
+	}
+	return res->has_base && IS_32BIT_VALUE(res->disp);
+}
+
+// combines:
+// addi r1, r2, imm1 (or addr, muli, lshi, addmul, addimm)
+// ldxi r3, r1, imm2 (or other load, store, or address computation)
+// -->
+// ldxi r3, r2, imm1 + imm2
+//
+// or, e.g.:
+// addmul r1, r2, r3*size
+// ldxi r4, r1, imm
+// -->
+// ldxm r4, r2, r3*size, imm	... mov reg, [reg + reg*size + imm]
+static int join_address(jit_op * op, jit_op * nextop)
+{
+	struct x86_addr a, b, res;
+	if (!address_of(op, &a)) return 0;
+	if (!address_used_by(nextop, op->arg[0], &b)) return 0;
+	if (!merge_addresses(&a, &b, &res)) return 0;
+
+	set_address(nextop, &res);
+	make_nop(op);
+	return 1;
+}
+
+static int alu_mem_opcode(jit_op * op, int load_first)
+{
+	switch (op->code) {
+		case (JIT_ADD | REG): return JIT_X86_ADDM;
+		case (JIT_SUB | REG): return load_first ? JIT_X86_RSBM : JIT_X86_SUBM;
+		case (JIT_AND | REG): return JIT_X86_ANDM;
+		case (JIT_OR | REG): return JIT_X86_ORM;
+		case (JIT_XOR | REG): return JIT_X86_XORM;
+		default: return 0;
 	}
+}
+
+static inline int is_int_comparison(jit_op * op)
+{
+	if (op->fp || !(GET_OP_SUFFIX(op) & REG)) return 0;
+	return ((GET_OP(op) >= JIT_LT) && (GET_OP(op) <= JIT_NE)) || ((GET_OP(op) >= JIT_BLT) && (GET_OP(op) <= JIT_BNE));
+}
+
+// combines:
+// ldxi r1, r2, imm (or ldr r1, r2), which loads the whole register
+// addr r3, r4, r1 (or subr, andr, orr, xorr, comparison, or conditional branch)
+// -->
+// addm r3, r4, r2, imm	... add reg, [reg + imm]
+static int fold_load(jit_op * op, jit_op * nextop)
+{
+	jit_value disp;
+	int code = op->code & ~UNSIGNED;
+	if (code == (JIT_LD | REG)) disp = 0;
+	else if (code == (JIT_LDX | IMM)) disp = op->arg[2];
+	else return 0;
+	if ((op->arg_size != REG_SIZE) || !IS_32BIT_VALUE(disp)) return 0;
+
+	jit_value reg = op->arg[0];
+	jit_value base = op->arg[1];
+	if ((ARG_TYPE(nextop, 2) != REG) || (ARG_TYPE(nextop, 3) != REG) || nextop->arg_size) return 0;
+
+	jit_value x1 = nextop->arg[1];
+	jit_value x2 = nextop->arg[2];
+	if ((x1 == x2) || ((x1 != reg) && (x2 != reg))) return 0;
+	int load_first = (x1 == reg);
+	jit_value other = load_first ? x2 : x1;
+
+	int opcode = alu_mem_opcode(nextop, load_first);
+	if (opcode) {
+		// [reg + imm] - reg cannot be computed in the base register
+		if ((opcode == JIT_X86_RSBM) && (other == base)) return 0;
+		nextop->code = opcode;
+	} else if (is_int_comparison(nextop)) {
+		// the memory operand has to be the second operand of CMP
+		if (load_first && (GET_OP(nextop) != JIT_EQ) && (GET_OP(nextop) != JIT_NE)
+		&& (GET_OP(nextop) != JIT_BEQ) && (GET_OP(nextop) != JIT_BNE)) nextop->code ^= (0x02 << 3);
+		nextop->arg_size = REG_SIZE;
+	} else return 0;
+
+	nextop->arg[1] = other;
+	nextop->arg[2] = base;
+	set_x86_mem_disp(nextop, disp);
+	make_nop(op);
+	return 1;
+}
+
+
+//
+//
+// Operations covered by compact x86 instructions
+//
+//
+
+// combines:
+// andi r1, r2, imm (or andr r1, r2, r3)
+// beqi label, r1, 0 (or bnei)
+// -->
+// bmci label, r2, imm	... test reg, imm; jz label
+static int join_and_branch(jit_op * op, jit_op * nextop)
+{
+	if ((nextop->arg[1] != op->arg[0]) || (nextop->arg[2] != 0)) return 0;
+	if (IS_IMM(op) && !IS_32BIT_VALUE(op->arg[2])) return 0;
+
+	int code = (GET_OP(nextop) == JIT_BEQ) ? JIT_BMC : JIT_BMS;
+	nextop->code = code | (IS_IMM(op) ? IMM : REG);
+	nextop->spec = SPEC(IMM, REG, IS_IMM(op) ? IMM : REG);
+	nextop->arg[1] = op->arg[1];
+	nextop->arg[2] = op->arg[2];
+	make_nop(op);
+	return 1;
+}
+
+// replaces:
+// addi r1, r1, 1 (or subi r1, r1, -1)
+// -->
+// inc r1
+static int make_inc_dec(jit_op * op, jit_op * nextop)
+{
+	if (op->arg[0] != op->arg[1]) return 0;
+	jit_value imm = (GET_OP(op) == JIT_SUB) ? -op->arg[2] : op->arg[2];
+	if ((imm != 1) && (imm != -1)) return 0;
+
+	op->code = (imm == 1) ? JIT_X86_INC : JIT_X86_DEC;
+	op->spec = SPEC(TREG, REG, NO);
+	op->arg[2] = 0;
+	return 1;
+}
+
+//
+//
+// Instruction selection
+//
+//
+
+#define X86_ANY_OP	(-1)
+
+/**
+ * Rule of the instruction selector covering the operation and the following
+ * operation which is the last one using its result
+ */
+struct x86_rule {
+	int code;		// opcode of the operation
+	int next_code;		// opcode of the following operation; 0 if the rule covers only one operation
+	int opts;		// optimization enabling the rule; 0 if the rule is always used
+	int cost;		// number of x86 instructions saved
+	int stat;		// statistics counting uses of the rule; -1 if there is none
+	int (* apply)(jit_op * op, jit_op * nextop);	// rewrites the operations; returns 0 if their operands do not match
+};
+
+static struct x86_rule x86_rules[] = {
+	{ JIT_MOV | IMM, JIT_ST | IMM, 0, 1, -1, join_movi_st },
+	{ JIT_MOV | IMM, JIT_ST | REG, 0, 1, -1, join_movi_st },
+	{ JIT_MOV | IMM, JIT_STX | IMM, 0, 1, -1, join_movi_st },
+	{ JIT_MOV | IMM, JIT_STX | REG, 0, 1, -1, join_movi_st },
+
+	{ JIT_MUL | IMM, JIT_ADD | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_addi },
+	{ JIT_LSH | IMM, JIT_ADD | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_addi },
+	{ JIT_MUL | IMM, JIT_ADD | REG, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_addr },
+	{ JIT_LSH | IMM, JIT_ADD | REG, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_addr },
+	{ JIT_MUL | IMM, JIT_OR | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_ori },
+	{ JIT_LSH | IMM, JIT_OR | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_muli_ori },
+	{ JIT_ADD | REG, JIT_ADD | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_addr_addi },
+	{ JIT_ADD | REG, JIT_SUB | IMM, JIT_OPT_JOIN_ADDMUL, 1, -1, join_addr_addi },
+	{ JIT_ADD | IMM, JIT_ADD | REG, JIT_OPT_JOIN_ADDMUL, 1, -1, join_addi_addr },
+	{ JIT_SUB | IMM, JIT_ADD | REG, JIT_OPT_JOIN_ADDMUL, 1, -1, join_addi_addr },
+
+	{ JIT_ADD | IMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_SUB | IMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_ADD | REG, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_MUL | IMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_LSH | IMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_X86_ADDMUL | REG, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_X86_ADDMUL | IMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_X86_ADDIMM, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_COMBINED_ADDRESSES, join_address },
+	{ JIT_LD | REG | SIGNED, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_FOLDED_LOADS, fold_load },
+	{ JIT_LD | REG | UNSIGNED, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_FOLDED_LOADS, fold_load },
+	{ JIT_LDX | IMM | SIGNED, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_FOLDED_LOADS, fold_load },
+	{ JIT_LDX | IMM | UNSIGNED, X86_ANY_OP, JIT_OPT_MEMORY_OPERANDS, 1, JIT_STAT_FOLDED_LOADS, fold_load },
+
+	{ JIT_AND | IMM, JIT_BEQ | IMM, JIT_OPT_COMPACT_OPS, 1, JIT_STAT_FUSED_TESTS, join_and_branch },
+	{ JIT_AND | IMM, JIT_BNE | IMM, JIT_OPT_COMPACT_OPS, 1, JIT_STAT_FUSED_TESTS, join_and_branch },
+	{ JIT_AND | REG, JIT_BEQ | IMM, JIT_OPT_COMPACT_OPS, 1, JIT_STAT_FUSED_TESTS, join_and_branch },
+	{ JIT_AND | REG, JIT_BNE | IMM, JIT_OPT_COMPACT_OPS, 1, JIT_STAT_FUSED_TESTS, join_and_branch },
+	// INC and DEC save one byte of the encoding
+	{ JIT_ADD | IMM, 0, JIT_OPT_COMPACT_OPS, 0, JIT_STAT_INC_DEC, make_inc_dec },
+	{ JIT_SUB | IMM, 0, JIT_OPT_COMPACT_OPS, 0, JIT_STAT_INC_DEC, make_inc_dec },
+};
+
+#define X86_RULE_COUNT	((int) (sizeof(x86_rules) / sizeof(struct x86_rule)))
+
+static inline int reads_reg(jit_op * op, jit_value reg)
+{
+	for (int i = 0; i < 3; i++)
+		if ((ARG_TYPE(op, i + 1) == REG) && (op->arg[i] == reg)) return 1;
+	return 0;
+}
+
+static inline int rule_matches(struct jit * jit, struct x86_rule * rule, jit_op * op, jit_op * nextop)
+{
+	if (rule->opts && !(jit->optimizations & rule->opts)) return 0;
+	if (rule->code != op->code) return 0;
+	if (rule->next_code == 0) return 1;
+	return nextop && ((rule->next_code == X86_ANY_OP) || (rule->next_code == nextop->code));
+}
+
+/**
+ * Covers the operation, and possibly the following one, with the matching rule
+ * which saves the most instructions (the first one in the table if there are
+ * more such rules); if the rule does not apply, the next best one is tried;
+ * returns 0 if no rule applies
+ */
+static int select_rule(struct jit * jit, jit_op * op)
+{
+	jit_op * nextop = NULL;
+	if (ARG_TYPE(op, 1) == TREG) {
+		nextop = next_last_use(op, op->arg[0]);
+		if (nextop && !reads_reg(nextop, op->arg[0])) nextop = NULL;
+	}
+
+	char tried[X86_RULE_COUNT];
+	memset(tried, 0, sizeof(tried));
+	while (1) {
+		struct x86_rule * best = NULL;
+		for (int i = 0; i < X86_RULE_COUNT; i++) {
+			struct x86_rule * rule = &x86_rules[i];
+			if (tried[i] || !rule_matches(jit, rule, op, nextop)) continue;
+			if (!best || (rule->cost > best->cost)) best = rule;
+		}
+		if (!best) return 0;
+
+		tried[best - x86_rules] = 1;
+		if (best->apply(op, best->next_code ? nextop : NULL)) {
+			if (best->stat >= 0) jit->stats[best->stat]++;
+			return 1;
+		}
+	}
+}
+
+/**
+ * Selects x86 instructions covering short sequences of operations
+ *
+ * Operations are visited in their order; an operation whose result is used
+ * only by the following operation may be merged into it. Since the merged
+ * operation is visited later, longer sequences, e.g., an address computation
+ * consisting of several operations, are covered step by step.
+ */
+int jit_select_instructions(struct jit * jit)
+{
+	int change = 0;
+	for (jit_op * op = jit_op_first(jit->ops); op != NULL; op = op->next)
+		change |= select_rule(jit, op);
 	return change;
 }
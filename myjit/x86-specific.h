@@ -17,8 +17,21 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-#define GET_GPREG_POS(jit, r) (- ((JIT_REG_ID(r) + 1) * REG_SIZE) - jit_current_func_info(jit)->allocai_mem)
-#define GET_FPREG_POS(jit, r) (- jit_current_func_info(jit)->gp_reg_count * REG_SIZE - (JIT_REG_ID(r) + 1) * sizeof(jit_float) - jit_current_func_info(jit)->allocai_mem)
+static inline int GET_GPREG_POS(struct jit * jit, int r)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	int slot = info->gp_slots[JIT_REG_ID(r)];
+	assert(slot >= 0);
+	return - (slot + 1) * REG_SIZE - info->allocai_mem;
+}
+
+static inline int GET_FPREG_POS(struct jit * jit, int r)
+{
+	struct jit_func_info * info = jit_current_func_info(jit);
+	int slot = info->fp_slots[JIT_REG_ID(r)];
+	assert(slot >= 0);
+	return - info->gp_slot_count * REG_SIZE - (slot + 1) * sizeof(jit_float) - info->allocai_mem;
+}
 
 static inline int GET_REG_POS(struct jit * jit, int r)
 {
@@ -28,6 +41,14 @@ static inline int GET_REG_POS(struct jit * jit, int r)
 	} else assert(0);
 }
 
+// on i386, the frame is always addressed through the frame pointer
+#define GET_FRAME_REG(jit) (X86_EBP)
+#define GET_FRAME_POS(jit, pos) (pos)
+
+// registers which the code generator overwrites regardless of register mappings
+#define JIT_SCRATCH_GP_REGS	((1 << X86_EAX) | (1 << X86_ECX) | (1 << X86_EDX))
+#define JIT_SCRATCH_FP_REGS	((1 << X86_XMM0) | (1 << X86_XMM7))
+
 #include "x86-common-stuff.c"
 
 void jit_init_arg_params(struct jit * jit, struct jit_func_info * info, int p, int * phys_reg)
@@ -153,6 +174,15 @@ void jit_patch_external_calls(struct jit * jit)
 	}
 }
 
+/**
+ * Releases the stack frame allocated in the prolog
+ */
+static void emit_release_frame(struct jit * jit)
+{
+	x86_mov_reg_reg(jit->ip, X86_ESP, X86_EBP, 4);
+	x86_pop_reg(jit->ip, X86_EBP);
+}
+
 static void emit_prolog_op(struct jit * jit, jit_op * op)
 {
 	jit->current_func = op;
@@ -166,13 +196,15 @@ static void emit_prolog_op(struct jit * jit, jit_op * op)
 		x86_push_reg(jit->ip, X86_EBP);
 		x86_mov_reg_reg(jit->ip, X86_EBP, X86_ESP, 4);
 	}
-	int stack_mem = info->allocai_mem + info->gp_reg_count * REG_SIZE + info->fp_reg_count * sizeof(double);
+	int stack_mem = info->allocai_mem + info->gp_slot_count * REG_SIZE + info->fp_slot_count * sizeof(double);
 
 #ifdef __APPLE__
 	stack_mem = jit_value_align(stack_mem, 16);
 #endif
-	if (prolog)
+	if (prolog) {
 		x86_alu_reg_imm(jit->ip, X86_SUB, X86_ESP, stack_mem);
+		jit->stats[JIT_STAT_FRAME_SIZE] += stack_mem;
+	}
 	jit->push_count = emit_push_callee_saved_regs(jit, op);
 }
 
@@ -222,10 +254,7 @@ static void emit_fret_op(struct jit * jit, jit_op * op)
 
 	// common epilogue
 	jit->push_count -= emit_pop_callee_saved_regs(jit);
-	if (jit_current_func_info(jit)->has_prolog) {
-		x86_mov_reg_reg(jit->ip, X86_ESP, X86_EBP, 4);
-		x86_pop_reg(jit->ip, X86_EBP);
-	}
+	if (jit_current_func_info(jit)->has_prolog) emit_release_frame(jit);
 	x86_ret(jit->ip);
 }
 
@@ -9,6 +9,10 @@
 ./t008
 ./t009
 ./t010
+./t011
+./t012
+./t013
+./t014
 ./t101
 ./t102
 ./t103
@@ -22,6 +26,25 @@
 ./t202
 ./t301
 ./t302
+./t303
+./t304
+./t305
+./t306
+./t307
+./t308
+./t309
+./t310
+./t311
+./t312
+./t313
+./t314
+./t315
+./t316
+./t317
+./t318
+./t319
+./t320
+./t321
 ./t401
 ./t402
 ./t501
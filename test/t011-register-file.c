@@ -0,0 +1,166 @@
+#include "tests.h"
+
+#define PTR_REGS	(14)
+
+// all pointers are alive at once, hence each hw. register (including R13
+// on AMD64) is used as a base register without displacement
+DEFINE_TEST(test10)
+{
+	plfv f1;
+	static jit_value x[PTR_REGS];
+	for (int i = 0; i < PTR_REGS; i++)
+		x[i] = i * 10;
+
+	jit_prolog(p, &f1);
+	for (int i = 0; i < PTR_REGS; i++)
+		jit_movi(p, R(i), &x[i]);
+
+	for (int i = 0; i < PTR_REGS; i++) {
+		jit_ldr(p, R(PTR_REGS), R(i), sizeof(jit_value));
+		jit_addi(p, R(PTR_REGS), R(PTR_REGS), 1);
+		jit_str(p, R(i), R(PTR_REGS), sizeof(jit_value));
+	}
+
+	jit_movi(p, R(PTR_REGS + 1), 0);
+	for (int i = 0; i < PTR_REGS; i++) {
+		jit_ldr(p, R(PTR_REGS), R(i), sizeof(jit_value));
+		jit_addr(p, R(PTR_REGS + 1), R(PTR_REGS + 1), R(PTR_REGS));
+	}
+	jit_retr(p, R(PTR_REGS + 1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(924, f1());
+	for (int i = 0; i < PTR_REGS; i++)
+		ASSERT_EQ(i * 10 + 1, x[i]);
+	return 0;
+}
+
+// base and index registers
+DEFINE_TEST(test11)
+{
+	plfv f1;
+	static jit_value x[PTR_REGS];
+	static float y[PTR_REGS];
+	for (int i = 0; i < PTR_REGS; i++) {
+		x[i] = i * 10;
+		y[i] = i * 0.5;
+	}
+
+	jit_prolog(p, &f1);
+	for (int i = 0; i < PTR_REGS; i++) {
+		jit_movi(p, R(i), &x[i]);
+		jit_movi(p, R(PTR_REGS + i), &y[i]);
+	}
+	jit_movi(p, R(40), 0);
+	jit_fmovi(p, FR(0), 0.0);
+
+	for (int i = 0; i < PTR_REGS; i++) {
+		jit_ldxr(p, R(41), R(i), R(40), sizeof(jit_value));
+		jit_stxr(p, R(40), R(i), R(41), sizeof(jit_value));
+		jit_fldxr(p, FR(1), R(PTR_REGS + i), R(40), sizeof(float));
+		jit_faddr(p, FR(0), FR(0), FR(1));
+		jit_fldxr(p, FR(1), R(40), R(PTR_REGS + i), sizeof(float));
+		jit_faddr(p, FR(0), FR(0), FR(1));
+	}
+	jit_movi(p, R(42), 0);
+	for (int i = 0; i < PTR_REGS; i++) {
+		jit_ldxr(p, R(41), R(40), R(i), sizeof(jit_value));
+		jit_addr(p, R(42), R(42), R(41));
+	}
+	jit_truncr(p, R(41), FR(0));
+	jit_addr(p, R(42), R(42), R(41));
+	jit_retr(p, R(42));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(910 + 91, f1());
+	return 0;
+}
+
+// 16 floating-point values alive in a loop
+DEFINE_TEST(test12)
+{
+	pdfv f1;
+	jit_prolog(p, &f1);
+	for (int i = 0; i < 14; i++)
+		jit_fmovi(p, FR(i), i + 1);
+	jit_fmovi(p, FR(14), 0.0);
+	jit_movi(p, R(0), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_fmovi(p, FR(15), 0.0);
+	for (int i = 0; i < 14; i++)
+		jit_faddr(p, FR(15), FR(15), FR(i));
+	jit_faddr(p, FR(14), FR(14), FR(15));
+	jit_addi(p, R(0), R(0), 1);
+	jit_blti(p, loop, R(0), 10);
+
+	jit_fretr(p, FR(14), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(1050.0, f1());
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_SPILLS));
+#endif
+	return 0;
+}
+
+// 15 integer values alive in a loop; RBP is allocatable on AMD64 only if
+// the function does not use R_FP
+static void generate_loop(struct jit * p, plfl * f1, int use_frame)
+{
+	// unrolling would raise the pressure and the slot would be promoted to a register
+	jit_disable_optimization(p, JIT_OPT_UNROLL | JIT_OPT_MEM2REG);
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(15), 0);
+	for (int i = 0; i < 13; i++)
+		jit_addi(p, R(i), R(15), i);
+	if (use_frame) {
+		int slot = jit_allocai(p, sizeof(jit_value));
+		jit_stxi(p, slot, R_FP, R(15), sizeof(jit_value));
+	}
+	jit_movi(p, R(13), 0);
+	jit_movi(p, R(14), 0);
+
+	jit_label * loop = jit_get_label(p);
+	for (int i = 0; i < 13; i++)
+		jit_addr(p, R(13), R(13), R(i));
+	jit_addi(p, R(14), R(14), 1);
+	jit_blti(p, loop, R(14), 10);
+
+	jit_retr(p, R(13));
+}
+
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	generate_loop(p, &f1, 0);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(10 * (13 * 5 + 78), f1(5));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_SPILLS));
+#endif
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	generate_loop(p, &f1, 1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(10 * (13 * 5 + 78), f1(5));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_SPILLS) > 0);
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,145 @@
+#include "tests.h"
+
+typedef jit_value (*plf8)(jit_value, jit_value, jit_value, jit_value, jit_value, jit_value, jit_value, jit_value);
+
+static jit_value sum8(jit_value a1, jit_value a2, jit_value a3, jit_value a4, jit_value a5, jit_value a6, jit_value a7, jit_value a8)
+{
+	return a1 + 2 * a2 + 3 * a3 + 4 * a4 + 5 * a5 + 6 * a6 + 7 * a7 + 8 * a8;
+}
+
+static void declare_args(struct jit * p, int count)
+{
+	for (int i = 0; i < count; i++)
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+}
+
+// leaf function with spilled values and arguments passed on the stack
+DEFINE_TEST(test10)
+{
+	plf8 f1;
+	jit_prolog(p, &f1);
+	declare_args(p, 8);
+	for (int i = 0; i < 8; i++) {
+		jit_getarg(p, R(i), i);
+		jit_force_spill(p, R(i));
+	}
+	jit_divr(p, R(8), R(7), R(6));
+	jit_modr(p, R(9), R(7), R(5));
+	jit_lshr(p, R(10), R(1), R(0));
+
+	jit_movi(p, R(11), 0);
+	for (int i = 0; i < 11; i++)
+		jit_addr(p, R(11), R(11), R(i));
+	jit_retr(p, R(11));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(1 + 2 + 3 + 4 + 5 + 6 + 7 + 80 + 80 / 7 + 80 % 6 + (2 << 1), f1(1, 2, 3, 4, 5, 6, 7, 80));
+	return 0;
+}
+
+// spilled values are passed to a function on the stack
+DEFINE_TEST(test11)
+{
+	plf8 f1;
+	jit_prolog(p, &f1);
+	declare_args(p, 8);
+	for (int i = 0; i < 8; i++) {
+		jit_getarg(p, R(i), i);
+		jit_addi(p, R(i), R(i), 1);
+		jit_force_spill(p, R(i));
+	}
+	jit_prepare(p);
+	for (int i = 0; i < 8; i++)
+		jit_putargr(p, R(7 - i));
+	jit_call(p, sum8);
+	jit_retval(p, R(8));
+	jit_force_spill(p, R(8));
+
+	// the second call has an odd number of arguments on the stack
+	jit_prepare(p);
+	for (int i = 0; i < 7; i++)
+		jit_putargr(p, R(i));
+	jit_putargr(p, R(8));
+	jit_call(p, sum8);
+	jit_retval(p, R(9));
+
+	jit_getarg(p, R(10), 7);
+	jit_addr(p, R(9), R(9), R(10));
+	jit_retr(p, R(9));
+	JIT_GENERATE_CODE(p);
+
+	jit_value r = sum8(8, 7, 6, 5, 4, 3, 2, 1);
+	ASSERT_EQ(sum8(1, 2, 3, 4, 5, 6, 7, r) + 7, f1(0, 1, 2, 3, 4, 5, 6, 7));
+	return 0;
+}
+
+// frame which does not fit into the red zone
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	declare_args(p, 1);
+	for (int i = 0; i < 30; i++) {
+		jit_getarg(p, R(i), 0);
+		jit_addi(p, R(i), R(i), i);
+		jit_force_spill(p, R(i));
+	}
+	jit_movi(p, R(30), 0);
+	for (int i = 0; i < 30; i++)
+		jit_addr(p, R(30), R(30), R(i));
+	jit_retr(p, R(30));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30 * 10 + 435, f1(10));
+	return 0;
+}
+
+// functions using R_FP keep the frame pointer
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	declare_args(p, 1);
+	int i = jit_allocai(p, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_force_spill(p, R(0));
+	jit_stxi(p, i, R_FP, R(0), sizeof(jit_value));
+	jit_ldxi(p, R(1), R_FP, i, sizeof(jit_value));
+	jit_addr(p, R(1), R(1), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(84, f1(42));
+	return 0;
+}
+
+// registers which are not alive at the same time share stack slots
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	declare_args(p, 1);
+	jit_movi(p, R(100), 0);
+	for (int i = 0; i < 100; i++) {
+		jit_getarg(p, R(i), 0);
+		jit_addi(p, R(i), R(i), i);
+		jit_force_spill(p, R(i));
+		jit_addr(p, R(100), R(100), R(i));
+	}
+	jit_retr(p, R(100));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(100 * 10 + 4950, f1(10));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_FRAME_SIZE) <= 32);
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
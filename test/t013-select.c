@@ -0,0 +1,468 @@
+#include "tests.h"
+
+// conditional moves depending on a register
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 10);
+	jit_movi(p, R(3), 20);
+	jit_movi(p, R(4), 1);
+	jit_movi(p, R(5), 2);
+	jit_movnr(p, R(4), R(2), R(0));
+	jit_movzr(p, R(5), R(3), R(1));
+	jit_muli(p, R(4), R(4), 100);
+	jit_addr(p, R(4), R(4), R(5));
+	jit_retr(p, R(4));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(102, f1(0, 1));
+	ASSERT_EQ(1002, f1(5, -1));
+	ASSERT_EQ(120, f1(0, 0));
+	ASSERT_EQ(1020, f1(-3, 0));
+	return 0;
+}
+
+// comparisons used only by the conditional move
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+	jit_movi(p, R(4), 1);
+
+	jit_ltr(p, R(3), R(0), R(1));
+	jit_movnr(p, R(2), R(4), R(3));
+	jit_lshi(p, R(4), R(4), 1);
+
+	jit_ltr_u(p, R(3), R(0), R(1));
+	jit_movzr(p, R(2), R(4), R(3));
+	jit_lshi(p, R(4), R(4), 1);
+
+	jit_movi(p, R(5), 0);
+	jit_gei(p, R(3), R(0), 5);
+	jit_movnr(p, R(5), R(4), R(3));
+	jit_movzr(p, R(5), R(3), R(3));
+	jit_orr(p, R(2), R(2), R(5));
+	jit_lshi(p, R(4), R(4), 1);
+
+	jit_eqr(p, R(3), R(0), R(1));
+	jit_movzr(p, R(2), R(4), R(3));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_value r = (a < b ? 1 : 0);
+			if ((jit_unsigned_value)a >= (jit_unsigned_value)b) r = 2;
+			r |= (a >= 5 ? 4 : 0);
+			if (a != b) r = 8;
+			ASSERT_EQ(r, f1(a, b));
+		}
+	return 0;
+}
+
+// the result of the comparison is used after the conditional move
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_gtr(p, R(2), R(0), R(1));
+	jit_movzr(p, R(0), R(1), R(2));
+	jit_muli(p, R(0), R(0), 10);
+	jit_addr(p, R(0), R(0), R(2));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(71, f1(7, 3));
+	ASSERT_EQ(70, f1(3, 7));
+	ASSERT_EQ(-30, f1(-3, -3));
+	return 0;
+}
+
+// integer minimum and maximum
+DEFINE_TEST(test13)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_minr(p, R(2), R(0), R(1));
+	jit_maxr(p, R(3), R(1), R(0));
+	jit_minr_u(p, R(4), R(0), R(1));
+	jit_maxr_u(p, R(5), R(0), R(1));
+	jit_mini(p, R(6), R(0), 10);
+	jit_maxi(p, R(7), R(0), -10);
+	jit_maxi_u(p, R(8), R(1), 10);
+
+	// clamps the first argument in place
+	jit_maxi(p, R(0), R(0), -50);
+	jit_mini(p, R(0), R(0), 50);
+	jit_mini_u(p, R(1), R(1), 1000);
+
+	jit_movi(p, R(9), 0);
+	for (int i = 0; i < 9; i++) {
+		jit_muli(p, R(9), R(9), 3);
+		jit_xorr(p, R(9), R(9), R(i));
+	}
+	jit_retr(p, R(9));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_unsigned_value ua = a, ub = b;
+			jit_value r[9];
+			r[0] = (a < -50 ? -50 : (a > 50 ? 50 : a));
+			r[1] = (ub < 1000 ? ub : 1000);
+			r[2] = (a < b ? a : b);
+			r[3] = (a > b ? a : b);
+			r[4] = (ua < ub ? ua : ub);
+			r[5] = (ua > ub ? ua : ub);
+			r[6] = (a < 10 ? a : 10);
+			r[7] = (a > -10 ? a : -10);
+			r[8] = (ub > 10 ? ub : 10);
+
+			jit_value expected = 0;
+			for (int k = 0; k < 9; k++)
+				expected = (expected * 3) ^ r[k];
+			ASSERT_EQ(expected, f1(a, b));
+		}
+	return 0;
+}
+
+// absolute values
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_absr(p, R(1), R(0));
+	jit_subi(p, R(0), R(0), 3);
+	jit_absr(p, R(0), R(0));
+	jit_muli(p, R(0), R(0), 1000);
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(3000, f1(0));
+	ASSERT_EQ(1000 + 4, f1(4));
+	ASSERT_EQ(8000 + 5, f1(-5));
+	ASSERT_EQ(0 + 3, f1(3));
+	return 0;
+}
+
+// minimum, maximum, and absolute values of floating-point numbers
+DEFINE_TEST(test15)
+{
+	pdfd f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_fabsr(p, FR(1), FR(0));
+	jit_fmini(p, FR(2), FR(0), 2.5);
+	jit_fmaxi(p, FR(3), FR(0), -1.5);
+	jit_fminr(p, FR(4), FR(2), FR(3));
+	jit_fmaxr(p, FR(5), FR(2), FR(3));
+	jit_fabsr(p, FR(0), FR(0));
+	jit_fmuli(p, FR(0), FR(0), 1000.0);
+	jit_fmuli(p, FR(1), FR(1), 100.0);
+	jit_fmuli(p, FR(4), FR(4), 10.0);
+	jit_faddr(p, FR(0), FR(0), FR(1));
+	jit_faddr(p, FR(0), FR(0), FR(4));
+	jit_faddr(p, FR(0), FR(0), FR(5));
+	jit_fretr(p, FR(0), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(1100.0 * 4.0 + 25.0 + 4.0, f1(4.0));
+	ASSERT_EQ_DOUBLE(1100.0 * 4.0 - 40.0 - 1.5, f1(-4.0));
+	ASSERT_EQ_DOUBLE(1100.0 * 0.5 + 5.0 + 0.5, f1(0.5));
+	ASSERT_EQ_DOUBLE(1100.0 * 0.5 - 5.0 - 0.5, f1(-0.5));
+	return 0;
+}
+
+typedef double (*pdfdd)(double, double);
+
+static int same_double(double x, double y)
+{
+	return !memcmp(&x, &y, sizeof(double));
+}
+
+// operands of fmin and fmax are never swapped, not even if the target is the second operand
+DEFINE_TEST(test16)
+{
+	pdfdd f1, f2, f3, f4;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fminr(p, FR(1), FR(0), FR(1));
+	jit_fretr(p, FR(1), sizeof(double));
+
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fmaxr(p, FR(1), FR(0), FR(1));
+	jit_fretr(p, FR(1), sizeof(double));
+
+	jit_prolog(p, &f3);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fminr(p, FR(0), FR(0), FR(1));
+	jit_fretr(p, FR(0), sizeof(double));
+
+	jit_prolog(p, &f4);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fmaxr(p, FR(2), FR(0), FR(1));
+	jit_fretr(p, FR(2), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	double values[] = { 1.0, -2.5, 0.0, -0.0, NAN };
+	int cnt = sizeof(values) / sizeof(double);
+	for (int i = 0; i < cnt; i++)
+		for (int j = 0; j < cnt; j++) {
+			double a = values[i];
+			double b = values[j];
+			ASSERT_EQ(1, same_double(a < b ? a : b, f1(a, b)));
+			ASSERT_EQ(1, same_double(a > b ? a : b, f2(a, b)));
+			ASSERT_EQ(1, same_double(a < b ? a : b, f3(a, b)));
+			ASSERT_EQ(1, same_double(a > b ? a : b, f4(a, b)));
+		}
+	return 0;
+}
+
+typedef jit_value (*plfdd)(double, double);
+
+// floating-point comparisons
+DEFINE_TEST(test17)
+{
+	plfdd f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fltr(p, R(0), FR(0), FR(1));
+	jit_fler(p, R(1), FR(0), FR(1));
+	jit_fgtr(p, R(2), FR(0), FR(1));
+	jit_fger(p, R(3), FR(0), FR(1));
+	jit_feqr(p, R(4), FR(0), FR(1));
+	jit_fner(p, R(5), FR(0), FR(1));
+	jit_flti(p, R(6), FR(0), 1.0);
+	jit_fgei(p, R(7), FR(0), -2.5);
+	jit_feqi(p, R(8), FR(1), 0.0);
+
+	jit_movi(p, R(9), 0);
+	for (int i = 0; i < 9; i++) {
+		jit_lshi(p, R(9), R(9), 1);
+		jit_orr(p, R(9), R(9), R(i));
+	}
+	jit_retr(p, R(9));
+	JIT_GENERATE_CODE(p);
+
+	double values[] = { 1.0, -2.5, 0.0, -0.0, NAN, 3.25 };
+	int cnt = sizeof(values) / sizeof(double);
+	for (int i = 0; i < cnt; i++)
+		for (int j = 0; j < cnt; j++) {
+			double a = values[i];
+			double b = values[j];
+			int r[] = { a < b, a <= b, a > b, a >= b, a == b, a != b, a < 1.0, a >= -2.5, b == 0.0 };
+			jit_value expected = 0;
+			for (int k = 0; k < 9; k++)
+				expected = (expected << 1) | r[k];
+			ASSERT_EQ(expected, f1(a, b));
+		}
+	return 0;
+}
+
+// floating-point comparisons followed by conditional moves
+DEFINE_TEST(test18)
+{
+	pdfdd f1, f2;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+
+	// compare-and-select: FR(2) := (a < b) ? a : b * 2
+	jit_fmuli(p, FR(2), FR(1), 2.0);
+	jit_fltr(p, R(0), FR(0), FR(1));
+	jit_fmovnr(p, FR(2), FR(0), R(0));
+
+	// FR(3) := (a != b) ? a : 100, FR(6) := (a == b) ? a : -1
+	jit_fmovi(p, FR(3), 100.0);
+	jit_fmovi(p, FR(6), -1.0);
+	jit_fner(p, R(0), FR(0), FR(1));
+	jit_fmovzr(p, FR(6), FR(0), R(0));
+	jit_fmovnr(p, FR(3), FR(0), R(0));
+
+	// FR(4) := (b >= 0.5) ? b : 0, the result of the comparison is used afterwards
+	jit_fmovi(p, FR(4), 0.0);
+	jit_fgei(p, R(1), FR(1), 0.5);
+	jit_fmovnr(p, FR(4), FR(1), R(1));
+	jit_extr(p, FR(5), R(1));
+
+	jit_fmuli(p, FR(3), FR(3), 10.0);
+	jit_fmuli(p, FR(4), FR(4), 100.0);
+	jit_fmuli(p, FR(5), FR(5), 1000.0);
+	jit_faddr(p, FR(2), FR(2), FR(3));
+	jit_faddr(p, FR(2), FR(2), FR(4));
+	jit_faddr(p, FR(2), FR(2), FR(5));
+	jit_faddr(p, FR(2), FR(2), FR(6));
+	jit_fretr(p, FR(2), sizeof(double));
+
+	// selections depending on comparisons involving NaN
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_fmovi(p, FR(2), 1.0);
+	for (int i = 0; i < 6; i++) {
+		if (i % 2) jit_fmovi(p, FR(3 + i), 0.0);
+		else jit_fmovr(p, FR(3 + i), FR(2));
+		switch (i) {
+			case 0: jit_fltr(p, R(0), FR(0), FR(1)); break;
+			case 1: jit_fler(p, R(0), FR(0), FR(1)); break;
+			case 2: jit_fgtr(p, R(0), FR(0), FR(1)); break;
+			case 3: jit_fger(p, R(0), FR(0), FR(1)); break;
+			case 4: jit_feqr(p, R(0), FR(0), FR(1)); break;
+			case 5: jit_fner(p, R(0), FR(0), FR(1)); break;
+		}
+		if (i % 2) jit_fmovnr(p, FR(3 + i), FR(2), R(0));
+		else {
+			jit_fmovzr(p, FR(3 + i), FR(0), R(0));
+			jit_fsubr(p, FR(3 + i), FR(2), FR(3 + i));
+			jit_fmovzr(p, FR(3 + i), FR(2), R(0));
+			jit_fsubr(p, FR(3 + i), FR(2), FR(3 + i));
+		}
+	}
+	jit_fmovi(p, FR(9), 0.0);
+	for (int i = 0; i < 6; i++) {
+		jit_fmuli(p, FR(9), FR(9), 2.0);
+		jit_faddr(p, FR(9), FR(9), FR(3 + i));
+	}
+	jit_fretr(p, FR(9), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	double values[] = { 1.0, -2.5, 0.0, 3.25 };
+	int cnt = sizeof(values) / sizeof(double);
+	for (int i = 0; i < cnt; i++)
+		for (int j = 0; j < cnt; j++) {
+			double a = values[i];
+			double b = values[j];
+			double r = (a < b ? a : b * 2);
+			r += (a != b ? a : 100.0) * 10.0;
+			r += (b >= 0.5 ? b : 0.0) * 100.0;
+			r += (b >= 0.5 ? 1000.0 : 0.0);
+			r += (a == b ? a : -1.0);
+			ASSERT_EQ_DOUBLE(r, f1(a, b));
+		}
+
+	double nan_values[] = { 1.0, -0.0, 0.0, NAN };
+	cnt = sizeof(nan_values) / sizeof(double);
+	for (int i = 0; i < cnt; i++)
+		for (int j = 0; j < cnt; j++) {
+			double a = nan_values[i];
+			double b = nan_values[j];
+			int r[] = { a < b, a <= b, a > b, a >= b, a == b, a != b };
+			double expected = 0;
+			for (int k = 0; k < 6; k++)
+				expected = expected * 2 + r[k];
+			ASSERT_EQ_DOUBLE(expected, f2(a, b));
+		}
+	return 0;
+}
+
+// conditional moves of floating-point values depending on an integer register
+DEFINE_TEST(test19)
+{
+	pdfd f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_truncr(p, R(0), FR(0));
+	jit_andi(p, R(0), R(0), 1);
+	jit_fmovi(p, FR(1), 1.5);
+	jit_fmovi(p, FR(2), 2.5);
+	jit_fmovnr(p, FR(1), FR(0), R(0));
+	jit_fmovzr(p, FR(2), FR(0), R(0));
+	jit_fmulr(p, FR(1), FR(1), FR(2));
+	jit_fretr(p, FR(1), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(3.0 * 2.5, f1(3.0));
+	ASSERT_EQ_DOUBLE(1.5 * 4.0, f1(4.0));
+	ASSERT_EQ_DOUBLE(-7.0 * 2.5, f1(-7.0));
+	return 0;
+}
+
+// floating-point comparisons and conditional moves if all XMM registers are in use
+DEFINE_TEST(test20)
+{
+	pdfd f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	for (int i = 1; i < 16; i++)
+		jit_faddi(p, FR(i), FR(i - 1), 1.0);
+
+	jit_fgti(p, R(0), FR(0), 0.0);
+	jit_fmovnr(p, FR(1), FR(0), R(0));
+	jit_fltr(p, R(1), FR(2), FR(3));
+	jit_addr(p, R(0), R(0), R(1));
+	jit_extr(p, FR(16), R(0));
+
+	for (int i = 0; i < 16; i++)
+		jit_faddr(p, FR(16), FR(16), FR(i));
+	jit_fretr(p, FR(16), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	// x + (x + 1) + ... + (x + 15) with the second term replaced by x if x > 0
+	ASSERT_EQ_DOUBLE(16 * 5.0 + 120.0 - 1.0 + 2.0, f1(5.0));
+	ASSERT_EQ_DOUBLE(16 * -5.0 + 120.0 + 1.0, f1(-5.0));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+	SETUP_TEST(test16);
+	SETUP_TEST(test17);
+	SETUP_TEST(test18);
+	SETUP_TEST(test19);
+	SETUP_TEST(test20);
+}
@@ -0,0 +1,112 @@
+#include "tests.h"
+
+#define REGS	(12)
+
+static jit_value imms[] = {
+	0, 1, 127, -128, 0x7fffffff, -1, (jit_value) -0x7fffffff - 1,
+#ifdef JIT_ARCH_AMD64
+	0x80000000, 0xffffffff, -0x80000001L, 0x100000000L, 0x123456789abcdefL,
+#endif
+};
+
+#define IMMS	(sizeof(imms) / sizeof(jit_value))
+
+// immediate values of all widths are loaded into registers
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; i < IMMS; i++)
+		jit_movi(p, R(i + 1), imms[i]);
+	for (int i = 0; i < IMMS; i++) {
+		jit_op * skip = jit_bner(p, JIT_FORWARD, R(0), R(i + 1));
+		jit_reti(p, i);
+		jit_patch(p, skip);
+	}
+	jit_reti(p, -1);
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < IMMS; i++)
+		ASSERT_EQ(i, f1(imms[i]));
+	ASSERT_EQ(-1, f1(2));
+	return 0;
+}
+
+static unsigned char bytes[2 * REGS];
+
+// narrow loads and results of comparisons are placed into all registers
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	for (int i = 0; i < 2 * REGS; i++)
+		bytes[i] = (i * 73) ^ 0xa5;
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; i < REGS; i++)
+		jit_ldxi_u(p, R(1 + i), R(0), i, 1);
+	for (int i = 0; i < REGS; i++)
+		jit_ldxi_u(p, R(1 + REGS + i), R(0), 2 * i, 2);
+	for (int i = 0; i < REGS; i++)
+		jit_ltr(p, R(1 + 2 * REGS + i), R(1 + i), R(1 + REGS + i));
+
+	jit_movi(p, R(0), 0);
+	for (int i = 0; i < 3 * REGS; i++) {
+		jit_muli(p, R(0), R(0), 3);
+		jit_addr(p, R(0), R(0), R(1 + i));
+	}
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	jit_value expected = 0;
+	jit_value value[3 * REGS];
+	for (int i = 0; i < REGS; i++) {
+		value[i] = bytes[i];
+		value[REGS + i] = bytes[2 * i] | (bytes[2 * i + 1] << 8);
+		value[2 * REGS + i] = value[i] < value[REGS + i];
+	}
+	for (int i = 0; i < 3 * REGS; i++)
+		expected = expected * 3 + value[i];
+	ASSERT_EQ(expected, f1((jit_value) bytes));
+	return 0;
+}
+
+static jit_value movi_code_size(jit_value imm)
+{
+	plfv f1;
+	struct jit * q = jit_init();
+	// the value is neither propagated nor moved into another register
+	jit_disable_optimization(q, JIT_OPT_ALL);
+	jit_prolog(q, &f1);
+	jit_movi(q, R(0), imm);
+	jit_retr(q, R(0));
+	jit_generate_code(q);
+	jit_value size = jit_get_stat(q, JIT_STAT_CODE_SIZE);
+	jit_free(q);
+	return size;
+}
+
+// immediate values use the shortest MOV instruction
+DEFINE_TEST(test12)
+{
+	jit_value size = movi_code_size(1);
+	ASSERT_EQ(1, size > 0);
+	ASSERT_EQ(size - 3, movi_code_size(0));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(size, movi_code_size(0xffffffff));
+	ASSERT_EQ(size + 2, movi_code_size(-1));
+	ASSERT_EQ(size + 5, movi_code_size(0x100000000L));
+#endif
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+}
@@ -149,6 +149,41 @@ DEFINE_TEST(test35)
 	return 0;
 }
 
+DEFINE_TEST(test36)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(2), 0);
+	jit_getarg(p, R(3), 1);
+	jit_movi(p, R(4), 100);
+	jit_addr(p, R(1), R(2), R(3));
+	jit_addi(p, R(1), R(4), 1);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(101, f1(10, 20));
+	return 0;
+}
+
+DEFINE_TEST(test37)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(2), 0);
+	jit_getarg(p, R(3), 1);
+	jit_addr(p, R(1), R(2), R(3));
+	jit_subi(p, R(4), R(1), 5);
+	jit_retr(p, R(4));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(25, f1(10, 20));
+	return 0;
+}
+
 void test_setup() 
 {
 	test_filename = __FILE__;
@@ -162,4 +197,6 @@ void test_setup()
 	SETUP_TEST(test33);
 	SETUP_TEST(test34);
 	SETUP_TEST(test35);
+	SETUP_TEST(test36);
+	SETUP_TEST(test37);
 }
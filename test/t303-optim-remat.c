@@ -0,0 +1,131 @@
+#include "tests.h"
+
+#define CONST_REGS	(20)
+
+DEFINE_TEST(test10)
+{
+	plfv f1;
+	jit_enable_optimization(p, JIT_OPT_REMATERIALIZE);
+	jit_prolog(p, &f1);
+	for (int i = 0; i < CONST_REGS; i++)
+		jit_movi(p, R(i), i * 3 + 1);
+
+	jit_movi(p, R(CONST_REGS), 0);		// sum
+	jit_movi(p, R(CONST_REGS + 1), 0);	// counter
+	jit_label * loop = jit_get_label(p);
+	for (int i = 0; i < CONST_REGS; i++)
+		jit_addr(p, R(CONST_REGS), R(CONST_REGS), R(i));
+	jit_addi(p, R(CONST_REGS + 1), R(CONST_REGS + 1), 1);
+	jit_blti(p, loop, R(CONST_REGS + 1), 10);
+
+	jit_retr(p, R(CONST_REGS));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(5900, f1());
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_AVOIDED_RELOADS) > 0);
+	return 0;
+}
+
+DEFINE_TEST(test11)
+{
+	plfv f1;
+	jit_enable_optimization(p, JIT_OPT_REMATERIALIZE);
+	jit_prolog(p, &f1);
+	int i = jit_allocai(p, 2 * sizeof(jit_value));
+	jit_addi(p, R(1), R_FP, i);
+	jit_addi(p, R(2), R_FP, i + sizeof(jit_value));
+	jit_movi(p, R(3), 10);
+	jit_str(p, R(1), R(3), sizeof(jit_value));
+	jit_movi(p, R(3), 20);
+	jit_str(p, R(2), R(3), sizeof(jit_value));
+
+	jit_force_spill(p, R(1));
+	jit_force_spill(p, R(2));
+
+	jit_ldr(p, R(4), R(1), sizeof(jit_value));
+	jit_ldr(p, R(5), R(2), sizeof(jit_value));
+	jit_addr(p, R(0), R(4), R(5));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30, f1());
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_AVOIDED_SPILLS));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_AVOIDED_RELOADS));
+	return 0;
+}
+
+DEFINE_TEST(test12)
+{
+	plfv f1;
+	jit_enable_optimization(p, JIT_OPT_REMATERIALIZE);
+	jit_prolog(p, &f1);
+	jit_op * skip = jit_jmpi(p, JIT_FORWARD);
+	jit_label * data = jit_get_label(p);
+	jit_data_qword(p, 42);
+	jit_code_align(p, 16);
+	jit_patch(p, skip);
+
+	jit_ref_data(p, R(1), data);
+	jit_force_spill(p, R(1));
+	jit_ldr(p, R(0), R(1), sizeof(jit_value));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(42, f1());
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_AVOIDED_SPILLS));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_AVOIDED_RELOADS));
+	return 0;
+}
+
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_REMATERIALIZE);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 100);
+	jit_force_spill(p, R(1));
+	jit_movi(p, R(1), 200);		// R(1) is defined twice, hence it has to be spilled
+	jit_force_spill(p, R(1));
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(205, f1(5));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_AVOIDED_SPILLS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_AVOIDED_RELOADS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_REMATERIALIZE);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(2), 0);
+	jit_getarg(p, R(3), 1);
+	jit_movi(p, R(1), 0);
+	jit_force_spill(p, R(1));
+	jit_addcr(p, R(4), R(2), R(3));
+	jit_addxr(p, R(5), R(1), R(1));	// R(1) is reloaded between ADDC and ADDX
+	jit_retr(p, R(5));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(1, f1(-1, 1));
+	ASSERT_EQ(0, f1(1, 1));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_AVOIDED_RELOADS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,96 @@
+#include "tests.h"
+
+#define LIVE_REGS	(8)
+
+// values living across DIV, MOD and variable shifts must survive
+// regardless of the registers the allocator assigns to them
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i + 1), R(0), i + 1);
+
+	jit_divr(p, R(10), R(0), R(3));
+	jit_modr(p, R(11), R(0), R(2));
+	jit_lshr(p, R(12), R(1), R(2));
+	jit_rshr(p, R(13), R(8), R(1));
+	jit_divi(p, R(14), R(0), 7);
+	jit_modi_u(p, R(15), R(0), 8);
+
+	jit_movi(p, R(20), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(20), R(20), R(i + 1));
+	for (int i = 10; i < 16; i++)
+		jit_addr(p, R(20), R(20), R(i));
+	jit_retr(p, R(20));
+	JIT_GENERATE_CODE(p);
+
+	jit_value x = 5;
+	jit_value expected = 8 * x + 36;
+	expected += x / (x + 3) + x % (x + 2) + ((x + 1) << (x + 2)) + ((x + 8) >> (x + 1));
+	expected += x / 7 + x % 8;
+	ASSERT_EQ(expected, f1(x));
+	return 0;
+}
+
+// the result of the division feeds the loop, the divisor, dividend
+// and counter are carried across iterations
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);		// sum
+	jit_movi(p, R(2), 1);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_divr(p, R(3), R(0), R(2));
+	jit_modr(p, R(4), R(0), R(2));
+	jit_lshr(p, R(5), R(4), R(2));
+	jit_addr(p, R(1), R(1), R(3));
+	jit_addr(p, R(1), R(1), R(5));
+	jit_addi(p, R(2), R(2), 1);
+	jit_blei(p, loop, R(2), 10);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	jit_value x = 1000, expected = 0;
+	for (jit_value i = 1; i <= 10; i++)
+		expected += x / i + ((x % i) << i);
+	ASSERT_EQ(expected, f1(x));
+	return 0;
+}
+
+// conditions assigned to registers with and without 8-bit subregisters
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; i < 12; i++)
+		jit_lti(p, R(i + 1), R(0), i * 2);
+
+	jit_movi(p, R(20), 0);
+	for (int i = 0; i < 12; i++) {
+		jit_lshi(p, R(20), R(20), 1);
+		jit_orr(p, R(20), R(20), R(i + 1));
+	}
+	jit_retr(p, R(20));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(0x1f, f1(13));
+	ASSERT_EQ(0xfff, f1(-1));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+}
@@ -0,0 +1,153 @@
+#include "tests.h"
+
+#define LIVE_REGS	(20)
+#define ITERATIONS	(8)
+
+static jit_value expected_sum(jit_value arg)
+{
+	jit_value sum = 0;
+	for (int c = 0; c < ITERATIONS; c++)
+		for (int i = 0; i < LIVE_REGS; i++)
+			if (c & (1 << (i % 3))) sum += (arg + i) + (arg + LIVE_REGS - 1 - i);
+	for (int i = 0; i < LIVE_REGS; i++)
+		sum += arg + i;
+	return sum;
+}
+
+// values alive across the loop do not fit into registers, they are moved
+// between registers and the stack at each branch
+static void generate_int_loop(struct jit * p, plfl * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(LIVE_REGS + 2), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(LIVE_REGS + 2), i);
+	jit_movi(p, R(LIVE_REGS), 0);		// sum
+	jit_movi(p, R(LIVE_REGS + 1), 0);	// counter
+
+	jit_label * loop = jit_get_label(p);
+	for (int i = 0; i < LIVE_REGS; i++) {
+		jit_op * skip = jit_bmci(p, JIT_FORWARD, R(LIVE_REGS + 1), 1 << (i % 3));
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(i));
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(LIVE_REGS - 1 - i));
+		jit_patch(p, skip);
+	}
+	jit_addi(p, R(LIVE_REGS + 1), R(LIVE_REGS + 1), 1);
+	jit_blti(p, loop, R(LIVE_REGS + 1), ITERATIONS);
+
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(i));
+	jit_retr(p, R(LIVE_REGS));
+}
+
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_SPILLS);
+	generate_int_loop(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(expected_sum(10), f1(10));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_REDUNDANT_SPILLS) > 0);
+	return 0;
+}
+
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_REDUNDANT_SPILLS);
+	generate_int_loop(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(expected_sum(10), f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_REDUNDANT_SPILLS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_REDUNDANT_RELOADS));
+	return 0;
+}
+
+DEFINE_TEST(test12)
+{
+	pdfd f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_SPILLS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(LIVE_REGS + 1), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_faddi(p, FR(i), FR(LIVE_REGS + 1), i);
+	jit_fmovi(p, FR(LIVE_REGS), 0);
+	jit_movi(p, R(2), 0);
+
+	jit_label * loop = jit_get_label(p);
+	for (int i = 0; i < LIVE_REGS; i++) {
+		jit_op * skip = jit_bmci(p, JIT_FORWARD, R(2), 1 << (i % 3));
+		jit_faddr(p, FR(LIVE_REGS), FR(LIVE_REGS), FR(i));
+		jit_faddr(p, FR(LIVE_REGS), FR(LIVE_REGS), FR(LIVE_REGS - 1 - i));
+		jit_patch(p, skip);
+	}
+	jit_addi(p, R(2), R(2), 1);
+	jit_blti(p, loop, R(2), ITERATIONS);
+
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_faddr(p, FR(LIVE_REGS), FR(LIVE_REGS), FR(i));
+	jit_fretr(p, FR(LIVE_REGS), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE((double)expected_sum(10), f1(10.0));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_REDUNDANT_SPILLS) > 0);
+	return 0;
+}
+
+// spilled values are kept in unused FP registers
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SPILLS_TO_FP_REGS);
+	generate_int_loop(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(expected_sum(10), f1(10));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_SPILLS_TO_FP_REGS) > 0);
+#endif
+	return 0;
+}
+
+static jit_value negate(jit_value x)
+{
+	return -x;
+}
+
+// values alive across a call stay on the stack
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SPILLS_TO_FP_REGS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(LIVE_REGS + 1), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(LIVE_REGS + 1), i);
+	jit_prepare(p);
+	jit_putargr(p, R(LIVE_REGS + 1));
+	jit_call(p, negate);
+	jit_retval(p, R(LIVE_REGS));
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(i));
+	jit_retr(p, R(LIVE_REGS));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(19 * 10 + 190, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_SPILLS_TO_FP_REGS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,144 @@
+#include "tests.h"
+
+#define LIVE_REGS	(16)
+#define ITERATIONS	(10)
+
+// values alive across the loop but not used in it are spilled in front of the loop
+static void generate_loop(struct jit * p, plfl * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(100), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(100), i);
+
+	jit_movi(p, R(101), 0);		// sum
+	jit_movi(p, R(102), 0);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_muli(p, R(103), R(102), 3);
+	jit_addr(p, R(104), R(103), R(100));
+	jit_xori(p, R(105), R(104), 5);
+	jit_addr(p, R(101), R(101), R(105));
+	jit_addi(p, R(102), R(102), 1);
+	jit_blti(p, loop, R(102), ITERATIONS);
+
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(101), R(101), R(i));
+	jit_retr(p, R(101));
+}
+
+static jit_value loop_sum(jit_value arg)
+{
+	jit_value sum = 0;
+	for (int c = 0; c < ITERATIONS; c++)
+		sum += (c * 3 + arg) ^ 5;
+	for (int i = 0; i < LIVE_REGS; i++)
+		sum += arg + i;
+	return sum;
+}
+
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	generate_loop(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(loop_sum(10), f1(10));
+	// each spilled value is loaded only once, after the loop
+	ASSERT_EQ(jit_get_stat(p, JIT_STAT_SPILLS), jit_get_stat(p, JIT_STAT_RELOADS));
+	return 0;
+}
+
+static jit_value nested_sum(jit_value arg)
+{
+	jit_value sum = 0;
+	for (int i = 0; i < LIVE_REGS; i++) {
+		jit_value x = arg + i;
+		for (int j = 0; j < ITERATIONS; j++)
+			if (j & 1) x = x * 3 + j;
+			else x ^= j;
+		sum += x + i;
+	}
+	return sum;
+}
+
+// inner loop with high register pressure inside of an outer loop
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(100), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(100), i);
+
+	jit_movi(p, R(101), 0);		// sum
+	jit_movi(p, R(102), 0);		// outer counter
+	jit_label * outer = jit_get_label(p);
+	jit_addr(p, R(103), R(100), R(102));
+	jit_movi(p, R(104), 0);		// inner counter
+	jit_label * inner = jit_get_label(p);
+	jit_op * odd = jit_bmsi(p, JIT_FORWARD, R(104), 1);
+	jit_xorr(p, R(103), R(103), R(104));
+	jit_op * next = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, odd);
+	jit_muli(p, R(105), R(103), 3);
+	jit_addr(p, R(103), R(105), R(104));
+	jit_patch(p, next);
+	jit_addi(p, R(104), R(104), 1);
+	jit_blti(p, inner, R(104), ITERATIONS);
+
+	jit_addr(p, R(101), R(101), R(103));
+	jit_addr(p, R(101), R(101), R(102));
+	jit_addi(p, R(102), R(102), 1);
+	jit_blti(p, outer, R(102), LIVE_REGS);
+
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(101), R(101), R(i));
+	jit_subr(p, R(101), R(101), R(LIVE_REGS - 1));
+	jit_retr(p, R(101));
+	JIT_GENERATE_CODE(p);
+
+	jit_value expected = nested_sum(10);
+	for (int i = 0; i < LIVE_REGS - 1; i++)
+		expected += 10 + i;
+	ASSERT_EQ(expected, f1(10));
+	return 0;
+}
+
+// register reorganization at the loop exit is placed out of the loop
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(100), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(100), i);
+
+	jit_movi(p, R(101), 0);		// counter
+	jit_label * loop = jit_get_label(p);
+	jit_addi(p, R(102), R(101), 7);
+	jit_op * found = jit_beqr(p, JIT_FORWARD, R(102), R(100));
+	jit_addi(p, R(101), R(101), 1);
+	jit_blti(p, loop, R(101), 100);
+	jit_movi(p, R(101), -1);
+
+	jit_patch(p, found);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(101), R(101), R(i));
+	jit_retr(p, R(101));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(3 + LIVE_REGS * 10 + 120, f1(10));
+	ASSERT_EQ(-1 + LIVE_REGS * 200 + 120, f1(200));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+}
@@ -0,0 +1,162 @@
+#include "tests.h"
+
+#define LIVE_REGS	(10)
+
+static jit_value add_one(jit_value x)
+{
+	return x + 1;
+}
+
+// leaf function using a few registers
+static void generate_leaf(struct jit * p, plfl * f1, int external_call)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	if (external_call) {
+		jit_prepare(p);
+		jit_putargr(p, R(0));
+		jit_call(p, add_one);
+		jit_retval(p, R(0));
+	}
+	jit_muli(p, R(0), R(0), 3);
+	jit_retr(p, R(0));
+}
+
+// values alive across the call are kept in caller-saved registers
+static void generate_caller(struct jit * p, plfl * f1, jit_label * leaf)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(LIVE_REGS), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(LIVE_REGS), i);
+
+	jit_prepare(p);
+	jit_putargr(p, R(LIVE_REGS));
+	jit_call(p, leaf);
+	jit_retval(p, R(LIVE_REGS));
+
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(i));
+	jit_retr(p, R(LIVE_REGS));
+}
+
+DEFINE_TEST(test10)
+{
+	plfl f1, f2;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * leaf = jit_get_label(p);
+	generate_leaf(p, &f2, 0);
+	generate_caller(p, &f1, leaf);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30 + 10 * 10 + 45, f1(10));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_AVOIDED_SAVES) > 0);
+#endif
+	return 0;
+}
+
+// the callee calls an external function which may overwrite any caller-saved register
+DEFINE_TEST(test11)
+{
+	plfl f1, f2;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * leaf = jit_get_label(p);
+	generate_leaf(p, &f2, 1);
+	generate_caller(p, &f1, leaf);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(33 + 10 * 10 + 45, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_AVOIDED_SAVES));
+	return 0;
+}
+
+DEFINE_TEST(test12)
+{
+	plfl f1, f2;
+	jit_disable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * leaf = jit_get_label(p);
+	generate_leaf(p, &f2, 0);
+	generate_caller(p, &f1, leaf);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30 + 10 * 10 + 45, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_AVOIDED_SAVES));
+	return 0;
+}
+
+// registers used by the function called indirectly have to be saved as well
+DEFINE_TEST(test13)
+{
+	plfl f1, f2, f3;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * leaf = jit_get_label(p);
+	jit_prolog(p, &f3);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(LIVE_REGS), 0);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_muli(p, R(i), R(LIVE_REGS), i);
+	for (int i = 0; i < LIVE_REGS; i++)
+		jit_addr(p, R(LIVE_REGS), R(LIVE_REGS), R(i));
+	jit_retr(p, R(LIVE_REGS));
+
+	jit_label * middle = jit_get_label(p);
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, leaf);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	generate_caller(p, &f1, middle);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(10 + 450 + 10 * 10 + 45, f1(10));
+	return 0;
+}
+
+// self-recursive function keeps values alive across calls
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * rec = jit_get_label(p);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	for (int i = 1; i < LIVE_REGS; i++)
+		jit_addi(p, R(i), R(0), i);
+	jit_subi(p, R(0), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, rec);
+	jit_retval(p, R(0));
+	for (int i = 1; i < LIVE_REGS; i++)
+		jit_addr(p, R(0), R(0), R(i));
+	jit_retr(p, R(0));
+	jit_patch(p, br);
+	jit_reti(p, 0);
+	JIT_GENERATE_CODE(p);
+
+	jit_value expected = 0;
+	for (jit_value n = 1; n <= 10; n++)
+		for (int i = 1; i < LIVE_REGS; i++)
+			expected += n + i;
+	ASSERT_EQ(expected, f1(10));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include "tests.h"
+
+typedef jit_value (*plf10)(jit_value, jit_value, jit_value, jit_value, jit_value,
+		jit_value, jit_value, jit_value, jit_value, jit_value);
+typedef jit_value (*plf20)(jit_value, jit_value, double, double, jit_value, jit_value, double, double,
+		jit_value, jit_value, double, double, jit_value, jit_value, double, double,
+		jit_value, jit_value, double, double);
+
+#define SIG10	"iiiiiiiiii"
+#define SIG20	"iiddiiddiiddiiddiidd"
+
+static jit_value weighted_sum(const char * sig, jit_value x)
+{
+	jit_value sum = 0;
+	double fsum = 0.0;
+	for (int i = 0; sig[i]; i++) {
+		if (sig[i] == 'i') sum += (i + 1) * (x + i);
+		else fsum += (i + 1) * (i + 0.25);
+	}
+	return sum + (jit_value) fsum;
+}
+
+// private function returning sum of its arguments multiplied by their positions
+static void generate_weighted_sum(struct jit * p, void * f, const char * sig)
+{
+	jit_prolog(p, f);
+	jit_declare_private(p);
+	for (int i = 0; sig[i]; i++) {
+		if (sig[i] == 'i') jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+		else jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	}
+	jit_movi(p, R(0), 0);
+	jit_fmovi(p, FR(0), 0.0);
+	for (int i = 0; sig[i]; i++) {
+		if (sig[i] == 'i') {
+			jit_getarg(p, R(1), i);
+			jit_muli(p, R(1), R(1), i + 1);
+			jit_addr(p, R(0), R(0), R(1));
+		} else {
+			jit_getarg(p, FR(1), i);
+			jit_fmuli(p, FR(1), FR(1), i + 1);
+			jit_faddr(p, FR(0), FR(0), FR(1));
+		}
+	}
+	jit_truncr(p, R(1), FR(0));
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+}
+
+// passes values x + i and i + 0.25 to the private function, the latter ones
+// as immediate values if imm_fp is set
+static void generate_caller(struct jit * p, plfl * f1, jit_label * callee, const char * sig, int imm_fp)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	for (int i = 0; sig[i]; i++) {
+		if (sig[i] == 'i') jit_addi(p, R(i + 1), R(0), i);
+		else if (!imm_fp) jit_fmovi(p, FR(i), i + 0.25);
+	}
+	jit_prepare(p);
+	for (int i = 0; sig[i]; i++) {
+		if (sig[i] == 'i') jit_putargr(p, R(i + 1));
+		else if (imm_fp) jit_fputargi(p, i + 0.25, sizeof(double));
+		else jit_fputargr(p, FR(i), sizeof(double));
+	}
+	jit_call(p, callee);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+}
+
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	plf10 f2;
+	jit_label * callee = jit_get_label(p);
+	generate_weighted_sum(p, &f2, SIG10);
+	generate_caller(p, &f1, callee, SIG10, 0);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(weighted_sum(SIG10, 10), f1(10));
+	ASSERT_EQ(weighted_sum(SIG10, -5), f1(-5));
+	// called from C through the entry point
+	ASSERT_EQ(weighted_sum(SIG10, 10), f2(10, 11, 12, 13, 14, 15, 16, 17, 18, 19));
+	return 0;
+}
+
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	plf20 f2;
+	jit_label * callee = jit_get_label(p);
+	generate_weighted_sum(p, &f2, SIG20);
+	generate_caller(p, &f1, callee, SIG20, 0);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(weighted_sum(SIG20, 10), f1(10));
+	ASSERT_EQ(weighted_sum(SIG20, 10), f2(10, 11, 2.25, 3.25, 14, 15, 6.25, 7.25, 18, 19,
+				10.25, 11.25, 22, 23, 14.25, 15.25, 26, 27, 18.25, 19.25));
+	return 0;
+}
+
+// loading immediate FP arguments must not overwrite integer arguments which are not in place yet
+DEFINE_TEST(test15)
+{
+	plfl f1;
+	plf20 f2;
+	jit_enable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	jit_label * callee = jit_get_label(p);
+	generate_weighted_sum(p, &f2, SIG20);
+	generate_caller(p, &f1, callee, SIG20, 1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(weighted_sum(SIG20, 10), f1(10));
+	ASSERT_EQ(weighted_sum(SIG20, -7), f1(-7));
+	return 0;
+}
+
+// recursive private function rotating its arguments
+static jit_value rotate(jit_value n, jit_value a, jit_value b, jit_value c, jit_value d, jit_value e, jit_value f, jit_value g)
+{
+	if (n == 0) return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g;
+	return rotate(n - 1, b, c, d, e, f, g, a + n);
+}
+
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_label * rec = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_private(p);
+	for (int i = 0; i < 8; i++)
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	for (int i = 0; i < 8; i++)
+		jit_getarg(p, R(i), i);
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_subi(p, R(0), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	for (int i = 2; i < 8; i++)
+		jit_putargr(p, R(i));
+	jit_putargr(p, R(1));
+	jit_call(p, rec);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	jit_patch(p, br);
+	jit_movi(p, R(0), 0);
+	for (int i = 1; i < 8; i++) {
+		jit_muli(p, R(i), R(i), i);
+		jit_addr(p, R(0), R(0), R(i));
+	}
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	for (int i = 1; i < 8; i++)
+		jit_putargi(p, i * 10);
+	jit_call(p, rec);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(rotate(20, 10, 20, 30, 40, 50, 60, 70), f1(20));
+	return 0;
+}
+
+// the frame pointer is aligned to 16 bytes if the caller aligned the stack
+static jit_value aligned_stack(jit_value x)
+{
+	return ((uintptr_t) __builtin_frame_address(0) % 16 == 0) ? x : -1;
+}
+
+// a chain of private functions, the last one calls a C function
+static void generate_chain(struct jit * p, plfl * f1, int length)
+{
+	jit_label * callee = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_private(p);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, aligned_stack);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	for (int i = 0; i < length; i++) {
+		jit_label * next = jit_get_label(p);
+		jit_prolog(p, (i == length - 1) ? f1 : NULL);
+		if (i != length - 1) jit_declare_private(p);
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+		jit_getarg(p, R(0), 0);
+		jit_addi(p, R(0), R(0), 1);
+		jit_movr(p, R(1), R(0));	// saved on the stack across the call
+		jit_prepare(p);
+		jit_putargr(p, R(0));
+		jit_call(p, callee);
+		jit_retval(p, R(0));
+		jit_addr(p, R(0), R(0), R(1));
+		jit_retr(p, R(0));
+		callee = next;
+	}
+}
+
+// C functions called by private functions get the stack aligned
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	generate_chain(p, &f1, 3);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(13 + 13 + 12 + 11, f1(10));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_INTERPROC_REGS);
+	generate_chain(p, &f1, 3);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(13 + 13 + 12 + 11, f1(10));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+}
@@ -0,0 +1,244 @@
+#include "tests.h"
+
+// deep enough to overflow the stack if frames are not released; tail calls
+// are replaced with jumps only on AMD64, elsewhere each call keeps its frame
+#ifdef JIT_ARCH_AMD64
+#define DEPTH	(10000000)
+#else
+#define DEPTH	(1000)
+#endif
+
+static jit_value sum_to(jit_value n)
+{
+	return n * (n + 1) / 2;
+}
+
+static double scale(double x, jit_value k)
+{
+	return x * k;
+}
+
+static jit_value sum8(jit_value a, jit_value b, jit_value c, jit_value d, jit_value e, jit_value f, jit_value g, jit_value h)
+{
+	return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h;
+}
+
+// sum(n, acc) = (n == 0 ? acc : sum(n - 1, acc + n))
+static void generate_sum(struct jit * p, plfll * f1)
+{
+	jit_label * sum = jit_get_label(p);
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_subi(p, R(0), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_putargr(p, R(1));
+	jit_call(p, sum);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	jit_patch(p, br);
+	jit_retr(p, R(1));
+}
+
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	generate_sum(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(sum_to(DEPTH), f1(DEPTH, 0));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+#endif
+	return 0;
+}
+
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_disable_optimization(p, JIT_OPT_TAIL_CALLS);
+	generate_sum(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(sum_to(1000), f1(1000, 0));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+	return 0;
+}
+
+// overwrites the memory below the caller's stack pointer before it reads the value
+static jit_value deref(jit_value * ptr)
+{
+	volatile jit_value locals[64];
+	for (int i = 0; i < 64; i++)
+		locals[i] = -1;
+	return *ptr + locals[0] + 1;
+}
+
+// rotates its arguments, the private function receives eight arguments in registers
+static jit_value rotate(jit_value n, jit_value a, jit_value b, jit_value c, jit_value d, jit_value e, jit_value f, jit_value g)
+{
+	for (; n > 0; n--) {
+		jit_value t = a + n;
+		a = b; b = c; c = d; d = e; e = f; f = g; g = t;
+	}
+	return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g;
+}
+
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	jit_label * rec = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_private(p);
+	for (int i = 0; i < 8; i++)
+		jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	for (int i = 0; i < 8; i++)
+		jit_getarg(p, R(i), i);
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_subi(p, R(0), R(0), 1);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	for (int i = 2; i < 8; i++)
+		jit_putargr(p, R(i));
+	jit_putargr(p, R(1));
+	jit_call(p, rec);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	jit_patch(p, br);
+	jit_movi(p, R(0), 0);
+	for (int i = 1; i < 8; i++) {
+		jit_muli(p, R(i), R(i), i);
+		jit_addr(p, R(0), R(0), R(i));
+	}
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	for (int i = 1; i < 8; i++)
+		jit_putargi(p, i * 10);
+	jit_call(p, rec);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(rotate(DEPTH, 10, 20, 30, 40, 50, 60, 70), f1(DEPTH));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+#endif
+	return 0;
+}
+
+// external functions, FP values, and calls through registers
+DEFINE_TEST(test13)
+{
+	pdfd f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_fmuli(p, FR(0), FR(0), 2.0);
+	jit_prepare(p);
+	jit_fputargr(p, FR(0), sizeof(double));
+	jit_putargi(p, 3);
+	jit_call(p, scale);
+	jit_fretval(p, FR(0), sizeof(double));
+	jit_fretr(p, FR(0), sizeof(double));
+
+	plfl f2;
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), sum_to);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_callr(p, R(1));
+	jit_retval(p, R(2));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(15.0, f1(2.5));
+	ASSERT_EQ(sum_to(100), f2(100));
+#ifdef JIT_ARCH_AMD64
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+#endif
+	return 0;
+}
+
+// arguments passed on the stack and values used after the call prevent the jump
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	for (int i = 0; i < 8; i++)
+		jit_putargr(p, R(0));
+	jit_call(p, sum8);
+	jit_retval(p, R(1));
+	jit_retr(p, R(1));
+
+	plfl f2;
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, sum_to);
+	jit_retval(p, R(1));
+	jit_addr(p, R(1), R(1), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(sum8(5, 5, 5, 5, 5, 5, 5, 5), f1(5));
+	ASSERT_EQ(sum_to(10) + 10, f2(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+	return 0;
+}
+
+// pointers into the frame must not outlive it
+DEFINE_TEST(test15)
+{
+	plfv f1;
+	jit_enable_optimization(p, JIT_OPT_TAIL_CALLS);
+	jit_prolog(p, &f1);
+	int i = jit_allocai(p, 16 * sizeof(jit_value));
+	jit_movi(p, R(0), 42);
+	jit_stxi(p, i, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(1), R_FP, i);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_call(p, deref);
+	jit_retval(p, R(2));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(42, f1());
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_TAIL_CALLS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+}
@@ -0,0 +1,234 @@
+#include "tests.h"
+
+static jit_value add_one(jit_value x)
+{
+	return x + 1;
+}
+
+// square(x, y) = x * x + y
+static jit_label * generate_square(struct jit * p)
+{
+	jit_label * square = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_mulr(p, R(0), R(0), R(0));
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	return square;
+}
+
+// sum of square(i, n) for i = 0 .. n - 1
+static void generate_sum_of_squares(struct jit * p, plfl * f1, jit_label * square)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_movi(p, R(2), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_putargr(p, R(0));
+	jit_call(p, square);
+	jit_retval(p, R(3));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_addi(p, R(1), R(1), 1);
+	jit_bltr(p, loop, R(1), R(0));
+	jit_retr(p, R(2));
+}
+
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+	generate_sum_of_squares(p, &f1, generate_square(p));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(285 + 100, f1(10));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	generate_sum_of_squares(p, &f1, generate_square(p));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(285 + 100, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+// several returns become jumps behind the inlined code
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+
+	jit_label * clamp = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br1 = jit_bgei(p, JIT_FORWARD, R(0), 0);
+	jit_reti(p, 0);
+	jit_patch(p, br1);
+	jit_op * br2 = jit_blei(p, JIT_FORWARD, R(0), 100);
+	jit_reti(p, 100);
+	jit_patch(p, br2);
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, clamp);
+	jit_retval(p, R(1));
+	jit_muli(p, R(0), R(0), 3);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, clamp);
+	jit_retval(p, R(2));
+	jit_muli(p, R(1), R(1), 1000);
+	jit_addr(p, R(0), R(1), R(2));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(0, f1(-5));
+	ASSERT_EQ(20 * 1000 + 60, f1(20));
+	ASSERT_EQ(50 * 1000 + 100, f1(50));
+	ASSERT_EQ(100 * 1000 + 100, f1(500));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+// floating-point arguments and return values
+DEFINE_TEST(test13)
+{
+	pdfd f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+
+	jit_label * lerp = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_getarg(p, FR(1), 1);
+	jit_getarg(p, FR(2), 2);
+	jit_fsubr(p, FR(1), FR(1), FR(0));
+	jit_fmulr(p, FR(1), FR(1), FR(2));
+	jit_faddr(p, FR(0), FR(0), FR(1));
+	jit_fretr(p, FR(0), sizeof(double));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_prepare(p);
+	jit_fputargi(p, 10.0, sizeof(double));
+	jit_fputargi(p, 20.0, sizeof(double));
+	jit_fputargr(p, FR(0), sizeof(double));
+	jit_call(p, lerp);
+	jit_fretval(p, FR(1), sizeof(double));
+	jit_faddr(p, FR(0), FR(0), FR(1));
+	jit_fretr(p, FR(0), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(15.5, f1(0.5));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+// helpers called by inlined helpers are inlined first
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+	jit_label * square = generate_square(p);
+
+	jit_label * twice = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_putargi(p, 1);
+	jit_call(p, square);
+	jit_retval(p, R(0));
+	jit_muli(p, R(0), R(0), 2);
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, twice);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(2 * (7 * 7 + 1), f1(7));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+// functions with calls and narrow arguments are not inlined
+DEFINE_TEST(test15)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_INLINE);
+
+	jit_label * calls = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, add_one);
+	jit_retval(p, R(0));
+	jit_retr(p, R(0));
+
+	jit_label * narrow = jit_get_label(p);
+	jit_prolog(p, NULL);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(char));
+	jit_getarg(p, R(0), 0);
+	jit_retr(p, R(0));
+
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, calls);
+	jit_retval(p, R(1));
+	jit_prepare(p);
+	jit_putargr(p, R(0));
+	jit_call(p, narrow);
+	jit_retval(p, R(2));
+	jit_muli(p, R(1), R(1), 1000);
+	jit_addr(p, R(0), R(1), R(2));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(11 * 1000 + 10, f1(10));
+	ASSERT_EQ(256 * 1000 - 1, f1(255));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_INLINED_CALLS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+}
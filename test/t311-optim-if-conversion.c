@@ -0,0 +1,199 @@
+#include "tests.h"
+
+// clamp(x) = x < 0 ? 0 : (x > 100 ? 100 : x)
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br1 = jit_bgei(p, JIT_FORWARD, R(0), 0);
+	jit_movi(p, R(0), 0);
+	jit_patch(p, br1);
+	jit_op * br2 = jit_blei(p, JIT_FORWARD, R(0), 100);
+	jit_movi(p, R(0), 100);
+	jit_patch(p, br2);
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++) {
+		jit_value x = test_values[i];
+		ASSERT_EQ(x < 0 ? 0 : (x > 100 ? 100 : x), f1(x));
+	}
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+// diamonds writing the same and different registers, the compared register is written
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 1);
+	jit_movi(p, R(3), 2);
+
+	jit_op * br = jit_bltr_u(p, JIT_FORWARD, R(0), R(1));
+	jit_subr(p, R(0), R(0), R(1));
+	jit_addi(p, R(2), R(0), 10);
+	jit_op * jmp = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, br);
+	jit_subr(p, R(0), R(1), R(0));
+	jit_movr(p, R(3), R(1));
+	jit_patch(p, jmp);
+
+	jit_muli(p, R(0), R(0), 1000);
+	jit_muli(p, R(2), R(2), 100);
+	jit_addr(p, R(0), R(0), R(2));
+	jit_addr(p, R(0), R(0), R(3));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_value r0, r2 = 1, r3 = 2;
+			if ((jit_unsigned_value)a < (jit_unsigned_value)b) {
+				r0 = b - a;
+				r3 = b;
+			} else {
+				r0 = a - b;
+				r2 = r0 + 10;
+			}
+			ASSERT_EQ(r0 * 1000 + r2 * 100 + r3, f1(a, b));
+		}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+// arms swapping values of registers
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+
+	// sorts the arguments
+	jit_op * br = jit_bler(p, JIT_FORWARD, R(0), R(1));
+	jit_movr(p, R(2), R(0));
+	jit_movr(p, R(0), R(1));
+	jit_movr(p, R(1), R(2));
+	jit_patch(p, br);
+
+	jit_muli(p, R(0), R(0), 1000);
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(3 * 1000 + 5, f1(3, 5));
+	ASSERT_EQ(3 * 1000 + 5, f1(5, 3));
+	ASSERT_EQ(-7 * 1000 + 7, f1(7, -7));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+// bit tests
+DEFINE_TEST(test13)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	jit_op * br1 = jit_bmsi(p, JIT_FORWARD, R(0), 1);
+	jit_ori(p, R(2), R(2), 1);
+	jit_patch(p, br1);
+	jit_op * br2 = jit_bmcr(p, JIT_FORWARD, R(0), R(1));
+	jit_ori(p, R(2), R(2), 2);
+	jit_patch(p, br2);
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_value r = 0;
+			if (!(a & 1)) r |= 1;
+			if (a & b) r |= 2;
+			ASSERT_EQ(r, f1(a, b));
+		}
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+// arms which cannot be executed speculatively or which are too long
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+
+	jit_op * br1 = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	jit_movi(p, R(2), 1000);
+	jit_divr(p, R(1), R(2), R(0));
+	jit_patch(p, br1);
+
+	jit_op * br2 = jit_bgei(p, JIT_FORWARD, R(0), 0);
+	jit_addi(p, R(1), R(1), 1);
+	jit_addi(p, R(1), R(1), 1);
+	jit_addi(p, R(1), R(1), 1);
+	jit_addi(p, R(1), R(1), 1);
+	jit_addi(p, R(1), R(1), 1);
+	jit_patch(p, br2);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(0, f1(0));
+	ASSERT_EQ(100, f1(10));
+	ASSERT_EQ(-100 + 5, f1(-10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+DEFINE_TEST(test15)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_bgei(p, JIT_FORWARD, R(0), 0);
+	jit_negr(p, R(0), R(0));
+	jit_patch(p, br);
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(5, f1(-5));
+	ASSERT_EQ(5, f1(5));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+}
@@ -0,0 +1,148 @@
+#include "tests.h"
+
+#define BIT_IF(p, bit, branch) do { \
+	jit_op * br = branch; \
+	jit_ori(p, R(2), R(2), 1 << (bit)); \
+	jit_patch(p, br); \
+} while (0)
+
+// comparisons whose results are used only by branches
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);	// keeps the branches
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	jit_ltr(p, R(3), R(0), R(1));
+	BIT_IF(p, 0, jit_beqi(p, JIT_FORWARD, R(3), 0));
+	jit_ltr_u(p, R(3), R(0), R(1));
+	BIT_IF(p, 1, jit_bnei(p, JIT_FORWARD, R(3), 0));
+	jit_gei(p, R(3), R(0), 7);
+	BIT_IF(p, 2, jit_beqi(p, JIT_FORWARD, R(3), 0));
+	jit_lei_u(p, R(3), R(0), 100);
+	BIT_IF(p, 3, jit_bnei(p, JIT_FORWARD, R(3), 0));
+	jit_eqr(p, R(3), R(0), R(1));
+	BIT_IF(p, 4, jit_beqi(p, JIT_FORWARD, R(3), 0));
+	jit_nei(p, R(3), R(1), -7);
+	BIT_IF(p, 5, jit_bnei(p, JIT_FORWARD, R(3), 0));
+	jit_gtr(p, R(3), R(0), R(1));
+	BIT_IF(p, 6, jit_bnei(p, JIT_FORWARD, R(3), 0));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_unsigned_value ua = a, ub = b;
+			jit_value r = 0;
+			if (a < b) r |= 1;
+			if (!(ua < ub)) r |= 2;
+			if (a >= 7) r |= 4;
+			if (!(ua <= 100)) r |= 8;
+			if (a == b) r |= 16;
+			if (!(b != -7)) r |= 32;
+			if (!(a > b)) r |= 64;
+			ASSERT_EQ(r, f1(a, b));
+		}
+	return 0;
+}
+
+// branches comparing results of arithmetic operations with zero
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);	// keeps the branches
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	jit_movr(p, R(3), R(0));
+	jit_addr(p, R(3), R(3), R(1));
+	BIT_IF(p, 0, jit_beqi(p, JIT_FORWARD, R(3), 0));
+	jit_subr(p, R(3), R(0), R(1));
+	BIT_IF(p, 1, jit_blti(p, JIT_FORWARD, R(3), 0));
+	jit_subi(p, R(3), R(3), 5);
+	BIT_IF(p, 2, jit_bgei(p, JIT_FORWARD, R(3), 0));
+	jit_andi(p, R(3), R(0), 6);
+	BIT_IF(p, 3, jit_bnei(p, JIT_FORWARD, R(3), 0));
+	jit_xorr(p, R(3), R(0), R(1));
+	BIT_IF(p, 4, jit_bgti(p, JIT_FORWARD, R(3), 0));
+	jit_negr(p, R(3), R(0));
+	BIT_IF(p, 5, jit_blei(p, JIT_FORWARD, R(3), 0));
+	jit_addi(p, R(3), R(0), 1);
+	BIT_IF(p, 6, jit_bgei_u(p, JIT_FORWARD, R(3), 0));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_value r = 0;
+			if (a + b != 0) r |= 1;
+			if (!(a - b < 0)) r |= 2;
+			if (!(a - b - 5 >= 0)) r |= 4;
+			if (!((a & 6) != 0)) r |= 8;
+			if (!((a ^ b) > 0)) r |= 16;
+			if (!(-a <= 0)) r |= 32;
+			ASSERT_EQ(r, f1(a, b));
+		}
+	return 0;
+}
+
+// comparison results used after the branch and results of comparisons with zero
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	jit_ltr(p, R(3), R(0), R(1));
+	BIT_IF(p, 0, jit_beqi(p, JIT_FORWARD, R(3), 0));
+	jit_lshi(p, R(3), R(3), 1);
+	jit_orr(p, R(2), R(2), R(3));
+
+	jit_subr(p, R(4), R(0), R(1));
+	jit_lti(p, R(5), R(4), 0);
+	jit_lshi(p, R(5), R(5), 2);
+	jit_orr(p, R(2), R(2), R(5));
+
+	jit_andi(p, R(4), R(0), 1);
+	jit_eqi(p, R(4), R(4), 0);
+	jit_lshi(p, R(4), R(4), 3);
+	jit_orr(p, R(2), R(2), R(4));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++)
+		for (int j = 0; j < TEST_VALUE_CNT; j++) {
+			jit_value a = test_values[i];
+			jit_value b = test_values[j];
+			jit_value r = (a < b ? 3 : 0);
+			if (a - b < 0) r |= 4;
+			if ((a & 1) == 0) r |= 8;
+			ASSERT_EQ(r, f1(a, b));
+		}
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+}
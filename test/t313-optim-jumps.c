@@ -0,0 +1,119 @@
+#include "tests.h"
+
+// branches to unconditional jumps
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_JUMP_THREADING);
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);	// keeps the branches
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 1);
+
+	jit_op * br1 = jit_blti(p, JIT_FORWARD, R(0), 0);
+	jit_op * br2 = jit_bgti(p, JIT_FORWARD, R(0), 100);
+	jit_movi(p, R(1), 2);
+	jit_op * jmp1 = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, br1);
+	jit_op * jmp2 = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, br2);
+	jit_get_label(p);
+	jit_op * jmp3 = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, jmp2);
+	jit_movi(p, R(1), 3);
+	jit_patch(p, jmp1);
+	jit_patch(p, jmp3);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++) {
+		jit_value x = test_values[i];
+		ASSERT_EQ(x < 0 ? 3 : (x > 100 ? 1 : 2), f1(x));
+	}
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_ELIMINATED_JUMPS));
+	return 0;
+}
+
+// jumps to the next operation; the branch is bypassed first and then removed
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_JUMP_THREADING);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(0), 0);
+	jit_comment(p, "empty block");
+	jit_get_label(p);
+	jit_patch(p, br);
+	jit_op * jmp = jit_jmpi(p, JIT_FORWARD);
+	jit_get_label(p);
+	jit_patch(p, jmp);
+	jit_addi(p, R(0), R(0), 1);
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(1, f1(0));
+	ASSERT_EQ(8, f1(7));
+	ASSERT_EQ(3, jit_get_stat(p, JIT_STAT_ELIMINATED_JUMPS));
+	return 0;
+}
+
+// loop whose body skips the rest of the iteration with a branch over a jump
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_JUMP_THREADING);
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);	// sum of odd numbers below x
+	jit_movi(p, R(2), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_op * exit = jit_bger(p, JIT_FORWARD, R(2), R(0));
+	jit_addi(p, R(2), R(2), 1);
+	jit_op * odd = jit_bmsi(p, JIT_FORWARD, R(2), 1);
+	jit_op * even = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, odd);
+	jit_addr(p, R(1), R(1), R(2));
+	jit_patch(p, even);
+	jit_jmpi(p, loop);
+	jit_patch(p, exit);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(0, f1(0));
+	ASSERT_EQ(1, f1(1));
+	ASSERT_EQ(1 + 3 + 5 + 7 + 9, f1(10));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_ELIMINATED_JUMPS));
+	return 0;
+}
+
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_JUMP_THREADING);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * jmp = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, jmp);
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(5, f1(5));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_ELIMINATED_JUMPS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+}
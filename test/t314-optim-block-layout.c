@@ -0,0 +1,138 @@
+#include "tests.h"
+
+// likely taken branch; the skipped code is moved behind the function
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_BLOCK_LAYOUT);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 1);
+
+	jit_op * br = jit_likely(jit_bgei(p, JIT_FORWARD, R(0), 0));
+	jit_muli(p, R(1), R(0), 3);
+	jit_addi(p, R(1), R(1), 2);
+	jit_patch(p, br);
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++) {
+		jit_value x = test_values[i];
+		ASSERT_EQ(x >= 0 ? x + 1 : x + 3 * x + 2, f1(x));
+	}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_COLD_BLOCKS));
+	return 0;
+}
+
+// diamond whose else branch is unlikely
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_BLOCK_LAYOUT);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+
+	jit_op * br = jit_unlikely(jit_beqi(p, JIT_FORWARD, R(0), 7));
+	jit_muli(p, R(1), R(0), 5);
+	jit_op * jmp = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, br);
+	jit_movi(p, R(1), 1);
+	jit_subr(p, R(1), R(1), R(0));
+	jit_patch(p, jmp);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++) {
+		jit_value x = test_values[i];
+		ASSERT_EQ(x == 7 ? 1 - x : x * 5, f1(x));
+	}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_COLD_BLOCKS));
+	return 0;
+}
+
+// branch counts measured in a loop; the rarely executed block is moved
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_BLOCK_LAYOUT);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_movi(p, R(2), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_op * exit = jit_bger(p, JIT_FORWARD, R(2), R(0));
+	jit_branch_counts(exit, 1, 1000);
+	jit_op * rare = jit_bmsi(p, JIT_FORWARD, R(2), 0x3f);
+	jit_branch_counts(rare, 984, 16);
+	ASSERT_EQ(98, rare->probability);
+	jit_addr(p, R(1), R(1), R(2));	// only multiples of 64 are summed
+	jit_patch(p, rare);
+	jit_addi(p, R(2), R(2), 1);
+	jit_jmpi(p, loop);
+	jit_patch(p, exit);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(0, f1(0));
+	ASSERT_EQ(0, f1(64));
+	ASSERT_EQ(64 + 128 + 192, f1(200));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_COLD_BLOCKS));
+	return 0;
+}
+
+// hinted branches are not replaced with conditional moves
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 10);
+	jit_op * br = jit_likely(jit_blti(p, JIT_FORWARD, R(0), 10));
+	jit_movr(p, R(1), R(0));
+	jit_patch(p, br);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	for (int i = 0; i < TEST_VALUE_CNT; i++) {
+		jit_value x = test_values[i];
+		ASSERT_EQ(x < 10 ? 10 : x, f1(x));
+	}
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_IF_CONVERSIONS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_disable_optimization(p, JIT_OPT_BLOCK_LAYOUT);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_op * br = jit_likely(jit_bnei(p, JIT_FORWARD, R(0), 0));
+	jit_movi(p, R(0), 42);
+	jit_patch(p, br);
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(42, f1(0));
+	ASSERT_EQ(5, f1(5));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_COLD_BLOCKS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,244 @@
+#include <limits.h>
+#include "tests.h"
+
+#define ITEMS	(37)
+
+static jit_value src[ITEMS];
+static jit_value dst[ITEMS];
+
+static void init_items()
+{
+	for (int i = 0; i < ITEMS; i++) {
+		src[i] = i * 7 - 50;
+		dst[i] = 0;
+	}
+}
+
+// sum of the first n items; the loop is executed at least once
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	init_items();
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_muli(p, R(0), R(0), sizeof(jit_value));
+	jit_movi(p, R(1), src);
+	jit_movi(p, R(2), 0);	// index
+	jit_movi(p, R(3), 0);	// sum
+
+	jit_label * loop = jit_get_label(p);
+	jit_ldxr(p, R(4), R(1), R(2), sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+	jit_addi(p, R(2), R(2), sizeof(jit_value));
+	jit_bltr(p, loop, R(2), R(0));
+	jit_retr(p, R(3));
+	JIT_GENERATE_CODE(p);
+
+	jit_value sum = 0;
+	for (int n = 1; n <= ITEMS; n++) {
+		sum += src[n - 1];
+		ASSERT_EQ(sum, f1(n));
+	}
+	ASSERT_EQ(src[0], f1(0));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+// copying loop counting down; the value of the temporary register is used after the loop
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	init_items();
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), src);
+	jit_movi(p, R(2), dst);
+
+	jit_label * loop = jit_get_label(p);
+	jit_subi(p, R(0), R(0), 1);
+	jit_muli(p, R(3), R(0), sizeof(jit_value));
+	jit_ldxr(p, R(4), R(1), R(3), sizeof(jit_value));
+	jit_addi(p, R(4), R(4), 1);
+	jit_stxr(p, R(2), R(3), R(4), sizeof(jit_value));
+	jit_bgti(p, loop, R(0), 0);
+	jit_addr(p, R(0), R(0), R(4));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	for (int n = 1; n <= ITEMS; n++) {
+		init_items();
+		ASSERT_EQ(src[0] + 1, f1(n));
+		for (int i = 0; i < ITEMS; i++)
+			ASSERT_EQ(i < n ? src[i] + 1 : 0, dst[i]);
+	}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+// factor given by the front end, non-unit step and the inclusive bound
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_movi(p, R(2), 1);
+
+	jit_label * loop = jit_get_label(p);
+	jit_muli(p, R(3), R(1), 3);
+	jit_xorr(p, R(2), R(2), R(3));
+	jit_addi(p, R(1), R(1), 5);
+	jit_unroll_loop(jit_bler(p, loop, R(1), R(0)), 3);
+	jit_addr(p, R(2), R(2), R(1));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (jit_value n = -3; n < 60; n++) {
+		jit_value i = 0, x = 1;
+		do {
+			x ^= i * 3;
+			i += 5;
+		} while (i <= n);
+		ASSERT_EQ(x + i, f1(n));
+	}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+// loops which are not unrolled
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_movi(p, R(2), 0);
+
+	// the bound changes
+	jit_label * loop1 = jit_get_label(p);
+	jit_addi(p, R(1), R(1), 1);
+	jit_subi(p, R(0), R(0), 1);
+	jit_bltr(p, loop1, R(1), R(0));
+
+	// forbidden by the front end
+	jit_label * loop2 = jit_get_label(p);
+	jit_addr(p, R(2), R(2), R(1));
+	jit_subi(p, R(1), R(1), 1);
+	jit_unroll_loop(jit_bgti(p, loop2, R(1), 0), 1);
+
+	// the induction variable moves away from the bound
+	jit_label * loop3 = jit_get_label(p);
+	jit_addi(p, R(2), R(2), 1);
+	jit_addi(p, R(1), R(1), 1);
+	jit_bgti(p, loop3, R(1), 5);
+
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(1 + 1, f1(0));
+	ASSERT_EQ(3 + 2 + 1 + 1, f1(6));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_label * loop = jit_get_label(p);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, loop, R(0), 0);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(55, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+// unsigned loop counting down to zero; the counter must not wrap around below zero
+DEFINE_TEST(test15)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_UNSIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti_u(p, loop, R(0), 0);
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	for (jit_value n = 1; n <= ITEMS; n++)
+		ASSERT_EQ(n * (n + 1) / 2, f1(n));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+// signed bounds near the limits; the counter must not overflow in the unrolled loop
+DEFINE_TEST(test16)
+{
+	plfll f1, f2;
+	jit_enable_optimization(p, JIT_OPT_UNROLL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+	jit_label * loop1 = jit_get_label(p);
+	jit_addi(p, R(2), R(2), 1);
+	jit_addi(p, R(0), R(0), 1);
+	jit_bler(p, loop1, R(0), R(1));
+	jit_retr(p, R(2));
+
+	jit_prolog(p, &f2);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+	jit_label * loop2 = jit_get_label(p);
+	jit_addi(p, R(2), R(2), 1);
+	jit_subi(p, R(0), R(0), 2);
+	jit_bgtr(p, loop2, R(0), R(1));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	for (jit_value n = 1; n <= ITEMS; n++) {
+		ASSERT_EQ(n, f1(LONG_MAX - n, LONG_MAX - 1));
+		ASSERT_EQ(n, f1(-n, -1));
+		ASSERT_EQ(n, f2(LONG_MIN + 2 * n, LONG_MIN + 1));
+		ASSERT_EQ(n, f2(2 * n, 1));
+	}
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_UNROLLED_LOOPS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+	SETUP_TEST(test15);
+	SETUP_TEST(test16);
+}
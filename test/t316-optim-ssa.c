@@ -0,0 +1,166 @@
+#include <limits.h>
+#include "tests.h"
+
+// constants are propagated through branches and the loop; the branch in the loop is removed
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SSA);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 10);
+	jit_movi(p, R(2), 0);	// sum
+	jit_movi(p, R(3), 3);
+
+	jit_op * br1 = jit_blei(p, JIT_FORWARD, R(1), 5);
+	jit_muli(p, R(4), R(1), 2);
+	jit_op * j1 = jit_jmpi(p, JIT_FORWARD);
+	jit_patch(p, br1);
+	jit_movr(p, R(4), R(0));
+	jit_patch(p, j1);
+
+	jit_label * loop = jit_get_label(p);
+	jit_op * br2 = jit_bnei(p, JIT_FORWARD, R(3), 3);
+	jit_addr(p, R(2), R(2), R(4));
+	jit_patch(p, br2);
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, loop, R(0), 0);
+
+	jit_lshr(p, R(5), R(3), R(3));
+	jit_addr(p, R(2), R(2), R(5));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(20 + 24, f1(1));
+	ASSERT_EQ(7 * 20 + 24, f1(7));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_FOLDED_OPS) >= 5);
+	return 0;
+}
+
+// copies are propagated even if the original register is overwritten in the meantime
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SSA);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	// Fibonacci numbers; registers are swapped through the temporary register
+	jit_label * loop = jit_get_label(p);
+	jit_movr(p, R(3), R(1));
+	jit_movr(p, R(1), R(2));
+	jit_movr(p, R(2), R(3));
+	jit_addr(p, R(2), R(2), R(1));
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, loop, R(0), 0);
+
+	jit_movr(p, R(4), R(2));
+	jit_addi(p, R(2), R(2), 1000);
+	jit_subr(p, R(4), R(2), R(4));
+	jit_mulr(p, R(4), R(4), R(2));
+	jit_retr(p, R(4));
+	JIT_GENERATE_CODE(p);
+
+	jit_value a = 1, b = 0;
+	for (int n = 1; n < 20; n++) {
+		jit_value t = a;
+		a = b;
+		b = t + a;
+		ASSERT_EQ(1000 * (b + 1000), f1(n));
+	}
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_DEAD_OPS) > 0);
+	return 0;
+}
+
+// computations whose results are not used are removed
+DEFINE_TEST(test12)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SSA);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_muli(p, R(1), R(0), 3);
+	jit_addi(p, R(2), R(1), 7);
+	jit_xorr(p, R(3), R(2), R(0));
+	jit_movi(p, R(1), 5);
+
+	// the value of R(3) is used only by the loop itself
+	jit_label * loop = jit_get_label(p);
+	jit_addr(p, R(3), R(3), R(0));
+	jit_addi(p, R(1), R(1), 2);
+	jit_blti(p, loop, R(1), 20);
+	jit_addr(p, R(0), R(0), R(1));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(21, f1(0));
+	ASSERT_EQ(121, f1(100));
+	ASSERT_EQ(4, jit_get_stat(p, JIT_STAT_DEAD_OPS));
+	return 0;
+}
+
+// operations which modify their operands in place or produce the carry flag are kept
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_SSA);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 1);
+	jit_movi(p, R(2), 7);
+
+	jit_movr(p, R(3), R(0));
+	jit_op * br = jit_boaddi(p, JIT_FORWARD, R(3), 1);
+	jit_movi(p, R(1), 0);
+	jit_patch(p, br);
+
+	jit_movzr(p, R(2), R(3), R(0));
+	jit_movi(p, R(4), -1);
+	jit_movi(p, R(6), 0);
+	jit_addcr(p, R(5), R(4), R(1));
+	jit_addxi(p, R(6), R(6), 0);
+	jit_muli(p, R(6), R(6), 100);
+	jit_addr(p, R(2), R(2), R(3));
+	jit_addr(p, R(2), R(2), R(6));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(7 + 11, f1(10));
+	ASSERT_EQ(1 + 1, f1(0));
+	ASSERT_EQ(LONG_MIN + 7 + 100, f1(LONG_MAX));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 3);
+	jit_muli(p, R(2), R(1), 4);
+	jit_addr(p, R(0), R(0), R(2));
+	jit_retr(p, R(0));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(22, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FOLDED_OPS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_DEAD_OPS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
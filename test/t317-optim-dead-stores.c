@@ -0,0 +1,150 @@
+#include "tests.h"
+
+static jit_value twice_slot(jit_value * slot)
+{
+	return *slot * 2;
+}
+
+// overwritten stores and stores which are not read before the return are removed
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_DEAD_STORES);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, 2 * sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_stxi(p, slot, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(1), R(0), 5);
+	jit_stxi(p, slot, R_FP, R(1), sizeof(jit_value));
+	jit_ldxi(p, R(2), R_FP, slot, sizeof(jit_value));
+	jit_stxi(p, slot + sizeof(jit_value), R_FP, R(2), sizeof(jit_value));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(15, f1(10));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_DEAD_STORES));
+	return 0;
+}
+
+// the loaded value is used only by the loop itself; the load is removed, which makes the store dead
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_DEAD_STORES);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_stxi(p, slot, R_FP, R(0), sizeof(jit_value));
+	jit_ldxi(p, R(1), R_FP, slot, sizeof(jit_value));
+	jit_movi(p, R(2), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_addr(p, R(1), R(1), R(2));
+	jit_addi(p, R(2), R(2), 3);
+	jit_subi(p, R(0), R(0), 1);
+	jit_bgti(p, loop, R(0), 0);
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30, f1(10));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_DEAD_STORES));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_DEAD_OPS));
+	return 0;
+}
+
+// stores read through computed addresses, partially overwritten stores,
+// and stores read after the loop are kept; heap stores do not touch the frame
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_value heap = 0;
+	jit_enable_optimization(p, JIT_OPT_DEAD_STORES);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, 4 * sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+
+	jit_addi(p, R(2), R_FP, slot);
+	jit_stxi(p, sizeof(jit_value), R(2), R(0), sizeof(jit_value));
+	jit_str(p, R(1), R(0), sizeof(jit_value));
+	jit_ldxi(p, R(3), R_FP, slot + sizeof(jit_value), sizeof(jit_value));
+
+	jit_stxi(p, slot + 2 * sizeof(jit_value), R_FP, R(0), sizeof(jit_value));
+	jit_movi(p, R(4), 1);
+	jit_stxi(p, slot + 2 * sizeof(jit_value), R_FP, R(4), 1);
+	jit_ldxi(p, R(4), R_FP, slot + 2 * sizeof(jit_value), sizeof(jit_value));
+
+	jit_movi(p, R(5), 0);
+	jit_label * loop = jit_get_label(p);
+	jit_stxi(p, slot + 3 * sizeof(jit_value), R_FP, R(5), sizeof(jit_value));
+	jit_addi(p, R(5), R(5), 1);
+	jit_blti(p, loop, R(5), 5);
+	jit_ldxi(p, R(5), R_FP, slot + 3 * sizeof(jit_value), sizeof(jit_value));
+
+	jit_addr(p, R(3), R(3), R(4));
+	jit_addr(p, R(3), R(3), R(5));
+	jit_retr(p, R(3));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(256 + 257 + 4, f1(256, (jit_value) &heap));
+	ASSERT_EQ(256, heap);
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_DEAD_STORES));
+	return 0;
+}
+
+// stores to the frame are kept if its address leaves the function
+DEFINE_TEST(test13)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_DEAD_STORES);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_stxi(p, slot, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(1), R_FP, slot);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_call(p, twice_slot);
+	jit_retval(p, R(2));
+	jit_stxi(p, slot, R_FP, R(2), sizeof(jit_value));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(42, f1(21));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_DEAD_STORES));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_stxi(p, slot, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(1), R(0), 5);
+	jit_stxi(p, slot, R_FP, R(1), sizeof(jit_value));
+	jit_ldxi(p, R(2), R_FP, slot, sizeof(jit_value));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(15, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_DEAD_STORES));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
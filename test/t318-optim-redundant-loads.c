@@ -0,0 +1,168 @@
+#include "tests.h"
+
+static jit_value cells[4];
+
+static void touch_cells()
+{
+	cells[0] += 100;
+}
+
+// stored values are forwarded to loads; stores to other offsets do not interfere
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_LOADS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_stxi(p, sizeof(jit_value), R(0), R(1), sizeof(jit_value));
+	jit_addi(p, R(2), R(1), 1);
+	jit_stxi(p, 2 * sizeof(jit_value), R(0), R(2), sizeof(jit_value));
+	jit_ldxi(p, R(3), R(0), sizeof(jit_value), sizeof(jit_value));
+	jit_addi(p, R(4), R(0), sizeof(jit_value));
+	jit_ldxi(p, R(5), R(4), sizeof(jit_value), sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(5));
+	jit_retr(p, R(3));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(21, f1((jit_value) cells, 10));
+	ASSERT_EQ(10, cells[1]);
+	ASSERT_EQ(11, cells[2]);
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_FORWARDED_LOADS));
+	return 0;
+}
+
+// repeated loads are replaced, also in blocks with a single predecessor and
+// if the register with the loaded value is overwritten
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_LOADS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_ldxi(p, R(2), R(0), 0, sizeof(jit_value));
+	jit_movr(p, R(3), R(2));
+	jit_movi(p, R(2), 5);
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+
+	jit_op * br = jit_beqi(p, JIT_FORWARD, R(1), 0);
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+	jit_patch(p, br);
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+	jit_addr(p, R(3), R(3), R(2));
+	jit_retr(p, R(3));
+	JIT_GENERATE_CODE(p);
+
+	cells[0] = 7;
+	ASSERT_EQ(4 * 7 + 5, f1((jit_value) cells, 1));
+	ASSERT_EQ(3 * 7 + 5, f1((jit_value) cells, 0));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_REDUNDANT_LOADS));
+	return 0;
+}
+
+// stores through other pointers, calls, and narrow stores prevent the replacement;
+// loads of different sizes or signs are distinguished
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_LOADS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_ldxi(p, R(2), R(0), 0, sizeof(jit_value));
+	jit_addi(p, R(3), R(2), 1);
+	jit_stxi(p, 0, R(1), R(3), sizeof(jit_value));
+	jit_ldxi(p, R(3), R(0), 0, sizeof(jit_value));
+
+	jit_prepare(p);
+	jit_call(p, touch_cells);
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+
+	jit_movi(p, R(4), -1);
+	jit_stxi(p, sizeof(jit_value), R(0), R(4), 2);
+	jit_ldxi(p, R(4), R(0), sizeof(jit_value), 2);
+	jit_addr(p, R(3), R(3), R(4));
+	jit_ldxi_u(p, R(4), R(0), sizeof(jit_value), 2);
+	jit_addr(p, R(3), R(3), R(4));
+	jit_ldxi(p, R(4), R(0), sizeof(jit_value), 1);
+	jit_addr(p, R(3), R(3), R(4));
+	jit_retr(p, R(3));
+	JIT_GENERATE_CODE(p);
+
+	cells[0] = 7;
+	cells[1] = 0;
+	ASSERT_EQ(8 + 108 - 1 + 0xffff - 1, f1((jit_value) cells, (jit_value) cells));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FORWARDED_LOADS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_REDUNDANT_LOADS));
+	return 0;
+}
+
+// values in the frame survive calls and stores through pointers unless the
+// address of the frame leaves the function
+DEFINE_TEST(test13)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_REDUNDANT_LOADS);
+	jit_prolog(p, &f1);
+	int acc = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_stxi(p, acc, R_FP, R(1), sizeof(jit_value));
+	jit_prepare(p);
+	jit_call(p, touch_cells);
+	jit_ldxi(p, R(2), R_FP, acc, sizeof(jit_value));
+	jit_stxi(p, 0, R(0), R(2), sizeof(jit_value));
+	jit_ldxi(p, R(3), R_FP, acc, sizeof(jit_value));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(6, f1((jit_value) cells, 3));
+	ASSERT_EQ(3, cells[0]);
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_FORWARDED_LOADS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_getarg(p, R(0), 0);
+	jit_ldxi(p, R(1), R(0), 0, sizeof(jit_value));
+	jit_stxi(p, sizeof(jit_value), R(0), R(1), sizeof(jit_value));
+	jit_ldxi(p, R(2), R(0), 0, sizeof(jit_value));
+	jit_ldxi(p, R(3), R(0), sizeof(jit_value), sizeof(jit_value));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	cells[0] = 4;
+	ASSERT_EQ(8, f1((jit_value) cells));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FORWARDED_LOADS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_REDUNDANT_LOADS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
@@ -0,0 +1,159 @@
+#include "tests.h"
+
+static jit_value twice_slot(jit_value * slot)
+{
+	return *slot * 2;
+}
+
+static void generate_sum(struct jit * p, void * f1)
+{
+	jit_prolog(p, f1);
+	int sum = jit_allocai(p, sizeof(jit_value));
+	int i = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_stxi(p, sum, R_FP, R(1), sizeof(jit_value));
+	jit_stxi(p, i, R_FP, R(0), sizeof(jit_value));
+
+	jit_label * loop = jit_get_label(p);
+	jit_ldxi(p, R(1), R_FP, sum, sizeof(jit_value));
+	jit_ldxi(p, R(2), R_FP, i, sizeof(jit_value));
+	jit_addr(p, R(1), R(1), R(2));
+	jit_stxi(p, sum, R_FP, R(1), sizeof(jit_value));
+	jit_subi(p, R(2), R(2), 1);
+	jit_stxi(p, i, R_FP, R(2), sizeof(jit_value));
+	jit_bgti(p, loop, R(2), 0);
+
+	jit_ldxi(p, R(1), R_FP, sum, sizeof(jit_value));
+	jit_retr(p, R(1));
+}
+
+// scalar slots are replaced with registers and the frame is released
+DEFINE_TEST(test10)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_MEM2REG);
+	generate_sum(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(55, f1(10));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_PROMOTED_SLOTS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FRAME_SIZE));
+	return 0;
+}
+
+// slots are kept if the address of the frame leaves the function
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_MEM2REG);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, sizeof(jit_value));
+	int other = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_stxi(p, other, R_FP, R(0), sizeof(jit_value));
+	jit_stxi(p, slot, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(1), R_FP, slot);
+	jit_prepare(p);
+	jit_putargr(p, R(1));
+	jit_call(p, twice_slot);
+	jit_retval(p, R(2));
+	jit_ldxi(p, R(3), R_FP, other, sizeof(jit_value));
+	jit_addr(p, R(2), R(2), R(3));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(63, f1(21));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_PROMOTED_SLOTS));
+	return 0;
+}
+
+// the block accessed with an index computed at run time stays in the frame
+// and moves to the space of the released block; accesses with a different
+// size prevent the promotion
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_MEM2REG);
+	jit_prolog(p, &f1);
+	int scalar = jit_allocai(p, sizeof(jit_value));
+	int array = jit_allocai(p, 4 * sizeof(jit_value));
+	int narrow = jit_allocai(p, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+
+	jit_stxi(p, scalar, R_FP, R(0), sizeof(jit_value));
+	jit_stxi(p, narrow, R_FP, R(0), sizeof(jit_value));
+	jit_addi(p, R(5), R_FP, array);
+	jit_movi(p, R(2), 0);
+	jit_label * loop = jit_get_label(p);
+	jit_muli(p, R(3), R(2), sizeof(jit_value));
+	jit_muli(p, R(4), R(2), 10);
+	jit_stxr(p, R(5), R(3), R(4), sizeof(jit_value));
+	jit_addi(p, R(2), R(2), 1);
+	jit_blti(p, loop, R(2), 4);
+
+	jit_ldxi(p, R(6), R(5), 3 * sizeof(jit_value), sizeof(jit_value));
+	jit_muli(p, R(3), R(1), sizeof(jit_value));
+	jit_ldxr(p, R(4), R(5), R(3), sizeof(jit_value));
+	jit_addr(p, R(6), R(6), R(4));
+	jit_ldxi(p, R(4), R_FP, scalar, sizeof(jit_value));
+	jit_addr(p, R(6), R(6), R(4));
+	jit_ldxi_u(p, R(4), R_FP, narrow, 1);
+	jit_addr(p, R(6), R(6), R(4));
+	jit_retr(p, R(6));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(30 + 10 + 1000 + 232, f1(1000, 1));
+	ASSERT_EQ(30 + 20 + 5 + 5, f1(5, 2));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_PROMOTED_SLOTS));
+	return 0;
+}
+
+// floating-point slots are replaced with floating-point registers
+DEFINE_TEST(test13)
+{
+	pdfd f1;
+	jit_enable_optimization(p, JIT_OPT_MEM2REG);
+	jit_prolog(p, &f1);
+	int slot = jit_allocai(p, sizeof(double));
+	jit_declare_arg(p, JIT_FLOAT_NUM, sizeof(double));
+	jit_getarg(p, FR(0), 0);
+	jit_fstxi(p, slot, R_FP, FR(0), sizeof(double));
+	jit_faddr(p, FR(1), FR(0), FR(0));
+	jit_fldxi(p, FR(2), R_FP, slot, sizeof(double));
+	jit_faddr(p, FR(1), FR(1), FR(2));
+	jit_fstxi(p, slot, R_FP, FR(1), sizeof(double));
+	jit_fldxi(p, FR(0), R_FP, slot, sizeof(double));
+	jit_fretr(p, FR(0), sizeof(double));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ_DOUBLE(4.5, f1(1.5));
+	ASSERT_EQ(1, jit_get_stat(p, JIT_STAT_PROMOTED_SLOTS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfl f1;
+	generate_sum(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(55, f1(10));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_PROMOTED_SLOTS));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
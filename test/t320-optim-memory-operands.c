@@ -0,0 +1,168 @@
+#include "tests.h"
+
+static jit_value cells[8] = { 3, 5, 12, 40, 7, 9, 11, 2 };
+static int words[8];
+
+static void generate_alu(struct jit * p, void * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+
+	jit_ldxi(p, R(2), R(0), sizeof(jit_value), sizeof(jit_value));
+	jit_addr(p, R(1), R(1), R(2));
+	jit_ldxi(p, R(2), R(0), 2 * sizeof(jit_value), sizeof(jit_value));
+	jit_subr(p, R(1), R(1), R(2));
+	jit_ldxi(p, R(2), R(0), 3 * sizeof(jit_value), sizeof(jit_value));
+	jit_subr(p, R(1), R(2), R(1));
+	jit_ldr(p, R(2), R(0), sizeof(jit_value));
+	jit_xorr(p, R(1), R(2), R(1));
+	jit_ldxi(p, R(2), R(0), 4 * sizeof(jit_value), sizeof(jit_value));
+	jit_orr(p, R(1), R(1), R(2));
+	jit_ldxi(p, R(2), R(0), 5 * sizeof(jit_value), sizeof(jit_value));
+	jit_andr(p, R(3), R(2), R(1));
+	// the target register is the base of the memory operand
+	jit_ldxi(p, R(2), R(0), 6 * sizeof(jit_value), sizeof(jit_value));
+	jit_subr(p, R(0), R(3), R(2));
+	jit_retr(p, R(0));
+}
+
+// loads used only once are merged into ALU operations
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_MEMORY_OPERANDS);
+	generate_alu(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(((((40 - (100 + 5 - 12)) ^ 3) | 7) & 9) - 11, f1((jit_value) cells, 100));
+	ASSERT_EQ(7, jit_get_stat(p, JIT_STAT_FOLDED_LOADS));
+	return 0;
+}
+
+// loaded values are compared with CMP reg, [mem]; narrow loads and loads
+// whose value is used later are kept
+DEFINE_TEST(test11)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_MEMORY_OPERANDS);
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+	jit_movi(p, R(3), 0);
+
+	jit_label * loop = jit_get_label(p);
+	jit_ldr(p, R(4), R(0), sizeof(jit_value));
+	jit_op * skip = jit_bler(p, JIT_FORWARD, R(4), R(1));
+	jit_addi(p, R(2), R(2), 1);
+	jit_patch(p, skip);
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_ltr(p, R(5), R(1), R(4));
+	jit_addr(p, R(3), R(3), R(5));
+	jit_ldxi(p, R(4), R(0), 0, 4);
+	jit_addr(p, R(3), R(3), R(4));
+	jit_ldxi(p, R(4), R(0), 0, sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(4));
+	jit_addr(p, R(3), R(3), R(4));
+	jit_addi(p, R(0), R(0), sizeof(jit_value));
+	jit_movi(p, R(5), (jit_value) (cells + 8));
+	jit_bltr(p, loop, R(0), R(5));
+
+	jit_muli(p, R(2), R(2), 10000);
+	jit_addr(p, R(2), R(2), R(3));
+	jit_retr(p, R(2));
+	JIT_GENERATE_CODE(p);
+
+	jit_value sum = 0;
+	for (int i = 0; i < 8; i++)
+		sum += (jit_value) (int) cells[i] + 2 * cells[i];
+	ASSERT_EQ(4 * 10000 + 4 + sum, f1((jit_value) cells, 7));
+	ASSERT_EQ(2, jit_get_stat(p, JIT_STAT_FOLDED_LOADS));
+	return 0;
+}
+
+static void generate_addressing(struct jit * p, void * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_PTR, sizeof(void *));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+
+	// cells[i + 2]
+	jit_muli(p, R(2), R(1), sizeof(jit_value));
+	jit_addr(p, R(2), R(0), R(2));
+	jit_ldxi(p, R(3), R(2), 2 * sizeof(jit_value), sizeof(jit_value));
+
+	// words[i] = cells[i + 2]
+	jit_movi(p, R(4), (jit_value) words);
+	jit_lshi(p, R(2), R(1), 2);
+	jit_stxr(p, R(4), R(2), R(3), sizeof(int));
+
+	// cells[1]
+	jit_addi(p, R(2), R(0), sizeof(jit_value));
+	jit_ldr(p, R(5), R(2), sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(5));
+
+	// &cells[i + 3]
+	jit_lshi(p, R(2), R(1), 3);
+	jit_addr(p, R(2), R(0), R(2));
+	jit_addi(p, R(5), R(2), 3 * sizeof(jit_value));
+	jit_ldr(p, R(5), R(5), sizeof(jit_value));
+	jit_addr(p, R(3), R(3), R(5));
+	jit_retr(p, R(3));
+}
+
+// address computations are merged into the addressing modes of loads, stores, and LEA
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_MEMORY_OPERANDS);
+	generate_addressing(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(40 + 5 + 7, f1((jit_value) cells, 1));
+	ASSERT_EQ(40, words[1]);
+	ASSERT_EQ(11 + 5 + 2, f1((jit_value) cells, 4));
+	ASSERT_EQ(11, words[4]);
+	ASSERT_EQ(5, jit_get_stat(p, JIT_STAT_COMBINED_ADDRESSES));
+	return 0;
+}
+
+DEFINE_TEST(test13)
+{
+	plfll f1;
+	generate_alu(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(((((40 - (100 + 5 - 12)) ^ 3) | 7) & 9) - 11, f1((jit_value) cells, 100));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FOLDED_LOADS));
+	return 0;
+}
+
+DEFINE_TEST(test14)
+{
+	plfll f1;
+	generate_addressing(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(40 + 5 + 7, f1((jit_value) cells, 1));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_COMBINED_ADDRESSES));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+	SETUP_TEST(test14);
+}
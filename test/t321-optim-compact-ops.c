@@ -0,0 +1,133 @@
+#include "tests.h"
+
+static void generate_bit_tests(struct jit * p, void * f1)
+{
+	jit_prolog(p, f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_movi(p, R(2), 0);
+
+	jit_andi(p, R(3), R(0), 4);
+	jit_op * skip1 = jit_beqi(p, JIT_FORWARD, R(3), 0);
+	jit_addi(p, R(2), R(2), 1);
+	jit_patch(p, skip1);
+
+	jit_andr(p, R(3), R(0), R(1));
+	jit_op * skip2 = jit_bnei(p, JIT_FORWARD, R(3), 0);
+	jit_addi(p, R(2), R(2), 10);
+	jit_patch(p, skip2);
+
+	jit_andi(p, R(3), R(1), 1);
+	jit_op * skip3 = jit_bnei(p, JIT_FORWARD, R(3), 0);
+	jit_addi(p, R(2), R(2), 100);
+	jit_patch(p, skip3);
+
+	// the result of AND is used later
+	jit_andi(p, R(3), R(0), 3);
+	jit_op * skip4 = jit_beqi(p, JIT_FORWARD, R(3), 0);
+	jit_addr(p, R(2), R(2), R(3));
+	jit_patch(p, skip4);
+	jit_retr(p, R(2));
+}
+
+static jit_value bit_tests(jit_value a, jit_value b)
+{
+	jit_value r = 0;
+	if (a & 4) r += 1;
+	if (!(a & b)) r += 10;
+	if (!(b & 1)) r += 100;
+	if (a & 3) r += a & 3;
+	return r;
+}
+
+// AND followed by a comparison with zero is merged into TEST
+DEFINE_TEST(test10)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_COMPACT_OPS);
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	generate_bit_tests(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(bit_tests(0, 0), f1(0, 0));
+	ASSERT_EQ(bit_tests(5, 2), f1(5, 2));
+	ASSERT_EQ(bit_tests(6, 3), f1(6, 3));
+	ASSERT_EQ(bit_tests(-1, 1), f1(-1, 1));
+	ASSERT_EQ(3, jit_get_stat(p, JIT_STAT_FUSED_TESTS));
+	return 0;
+}
+
+// additions and subtractions of one use INC and DEC
+DEFINE_TEST(test11)
+{
+	plfl f1;
+	jit_enable_optimization(p, JIT_OPT_COMPACT_OPS);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_movi(p, R(1), 0);
+	jit_movi(p, R(2), 100);
+
+	jit_label * loop = jit_get_label(p);
+	jit_addi(p, R(1), R(1), 1);
+	jit_subi(p, R(2), R(2), -1);
+	jit_addi(p, R(0), R(0), -1);
+	jit_bgti(p, loop, R(0), 0);
+
+	jit_subi(p, R(1), R(1), 1);
+	jit_addi(p, R(3), R(2), 1);
+	jit_muli(p, R(3), R(3), 1000);
+	jit_addr(p, R(1), R(1), R(3));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(118000 + 16, f1(17));
+	ASSERT_EQ(102000, f1(1));
+	ASSERT_EQ(4, jit_get_stat(p, JIT_STAT_INC_DEC));
+	return 0;
+}
+
+// the rule saving an instruction wins over INC: addi+addr is merged into LEA
+DEFINE_TEST(test12)
+{
+	plfll f1;
+	jit_enable_optimization(p, JIT_OPT_COMPACT_OPS | JIT_OPT_JOIN_ADDMUL);
+	jit_prolog(p, &f1);
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_declare_arg(p, JIT_SIGNED_NUM, sizeof(jit_value));
+	jit_getarg(p, R(0), 0);
+	jit_getarg(p, R(1), 1);
+	jit_addi(p, R(0), R(0), 1);
+	jit_addr(p, R(1), R(1), R(0));
+	jit_retr(p, R(1));
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(31, f1(10, 20));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_INC_DEC));
+	return 0;
+}
+
+DEFINE_TEST(test13)
+{
+	plfll f1;
+	jit_disable_optimization(p, JIT_OPT_IF_CONVERSION);
+	generate_bit_tests(p, &f1);
+	JIT_GENERATE_CODE(p);
+
+	ASSERT_EQ(bit_tests(5, 2), f1(5, 2));
+	ASSERT_EQ(bit_tests(6, 3), f1(6, 3));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_FUSED_TESTS));
+	ASSERT_EQ(0, jit_get_stat(p, JIT_STAT_INC_DEC));
+	return 0;
+}
+
+void test_setup()
+{
+	test_filename = __FILE__;
+	SETUP_TEST(test10);
+	SETUP_TEST(test11);
+	SETUP_TEST(test12);
+	SETUP_TEST(test13);
+}
@@ -36,6 +36,10 @@ char * test_names[MAX_NUMBER_OF_TEST];
 int test_cnt = 0;
 char *test_filename;
 
+// integers covering boundary cases of comparisons and conditional moves
+jit_value test_values[] = { 0, 1, -1, 7, -7, 100, -100, 0x7fffffff, -0x80000000L };
+#define TEST_VALUE_CNT (sizeof(test_values) / sizeof(jit_value))
+
 #define DEFINE_TEST(_name) \
 	int _name(struct jit *p, char *test_name, int test_flags)
 